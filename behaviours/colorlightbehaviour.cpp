@@ -28,6 +28,41 @@
 using namespace p44;
 
 
+// MARK: - cached color conversions
+
+#define CT_LUT_MIN_MIRED 100 // 10000K
+#define CT_LUT_MAX_MIRED 1000 // 1000K
+#define CT_LUT_SIZE (CT_LUT_MAX_MIRED-CT_LUT_MIN_MIRED+1)
+
+static float ctLut[CT_LUT_SIZE][3];
+static bool ctLutReady = false;
+
+void p44::cachedCTtoxyV(double aMired, Row3 &aXyV)
+{
+  if (aMired<CT_LUT_MIN_MIRED || aMired>CT_LUT_MAX_MIRED) {
+    // outside table range, calculate directly
+    CTtoxyV(aMired, aXyV);
+    return;
+  }
+  if (!ctLutReady) {
+    // calculate the table once
+    Row3 xyV;
+    for (int i=0; i<CT_LUT_SIZE; i++) {
+      CTtoxyV(CT_LUT_MIN_MIRED+i, xyV);
+      for (int c=0; c<3; c++) ctLut[i][c] = xyV[c];
+    }
+    ctLutReady = true;
+  }
+  double p = aMired-CT_LUT_MIN_MIRED;
+  int i = (int)p;
+  double f = p-i;
+  if (i>=CT_LUT_SIZE-1) { i = CT_LUT_SIZE-2; f = 1; }
+  for (int c=0; c<3; c++) {
+    aXyV[c] = ctLut[i][c]+(ctLut[i+1][c]-ctLut[i][c])*f;
+  }
+}
+
+
 // MARK: - ColorChannel
 
 double ColorChannel::getChannelValueCalculated(bool aTransitional)
@@ -463,7 +498,7 @@ bool ColorLightBehaviour::getCIExy(double &aCieX, double &aCieY, bool aTransitio
       aCieY = mCIEy->getChannelValue(aTransitional);
       break;
     case colorLightModeCt:
-      CTtoxyV(mCt->getChannelValue(aTransitional), xyV);
+      cachedCTtoxyV(mCt->getChannelValue(aTransitional), xyV);
       aCieX = xyV[0];
       aCieY = xyV[1];
       break;
@@ -522,7 +557,7 @@ bool ColorLightBehaviour::getHueSaturation(double &aHue, double &aSaturation, bo
       aSaturation = HSV[1]*100; // 0..100%
       break;
     case colorLightModeCt:
-      CTtoxyV(mCt->getChannelValue(aTransitional), xyV);
+      cachedCTtoxyV(mCt->getChannelValue(aTransitional), xyV);
       goto xyVtoHSV;
     default:
       return false; // unknown color mode
@@ -565,7 +600,7 @@ void ColorLightBehaviour::deriveMissingColorChannels(bool aTransitional)
       case colorLightModeCt:
         // missing HSV and xy
         // - xy
-        CTtoxyV(mCt->getChannelValue(aTransitional), xyV);
+        cachedCTtoxyV(mCt->getChannelValue(aTransitional), xyV);
         mCIEx->syncChannelValue(xyV[0], false, true);
         mCIEy->syncChannelValue(xyV[1], false, true);
         // - also create HSV
@@ -897,9 +932,13 @@ string ColorLightBehaviour::description()
 // MARK: - RGBColorLightBehaviour
 
 #define DUMP_CONVERSION_TABLE 0
+#define VERIFY_CACHED_CONVERSIONS 0
 
 RGBColorLightBehaviour::RGBColorLightBehaviour(Device &aDevice, bool aCtOnly) :
-  inherited(aDevice, aCtOnly)
+  inherited(aDevice, aCtOnly),
+  mInverseCalibrationValid(false),
+  mCachedColorMode(colorLightModeNone),
+  mCachedRGBMax(0)
 {
   // default to sRGB with D65 white point
   matrix3x3_copy(sRGB_d65_calibration, mCalibration);
@@ -957,56 +996,124 @@ static double colorCompScaled(double aColorComp, double aMax)
   return aColorComp;
 }
 
-void RGBColorLightBehaviour::getRGB(double &aRed, double &aGreen, double &aBlue, double aMax, bool aNoBrightness, bool aTransitional)
+void RGBColorLightBehaviour::calibrationChanged()
 {
-  Row3 RGB;
-  Row3 xyV;
-  Row3 XYZ;
-  Row3 HSV;
-  double scale = 1;
+  mInverseCalibrationValid = false;
+  mCachedColorMode = colorLightModeNone;
+}
+
+
+bool RGBColorLightBehaviour::getUnscaledRGB(Row3 &aRGB, double &aMaxComp, bool aTransitional)
+{
+  double p0, p1 = 0;
   switch (mColorMode) {
-    case colorLightModeHueSaturation: {
-      HSV[0] = mHue->getChannelValue(aTransitional); // 0..360
-      HSV[1] = mSaturation->getChannelValue(aTransitional)/100; // 0..1
-      HSV[2] = aNoBrightness ? 1 : mBrightness->getChannelValue(aTransitional)/100; // 0..1
-      HSVtoRGB(HSV, RGB);
+    case colorLightModeHueSaturation:
+      p0 = mHue->getChannelValue(aTransitional);
+      p1 = mSaturation->getChannelValue(aTransitional);
+      break;
+    case colorLightModeCt:
+      p0 = mCt->getChannelValue(aTransitional);
       break;
+    case colorLightModeXY:
+      p0 = mCIEx->getChannelValue(aTransitional);
+      p1 = mCIEy->getChannelValue(aTransitional);
+      break;
+    default:
+      return false; // no color
+  }
+  if (mCachedColorMode!=mColorMode || mCachedColorParams[0]!=p0 || mCachedColorParams[1]!=p1) {
+    // color has changed, must (re)calculate
+    Row3 xyV;
+    Row3 XYZ;
+    Row3 HSV;
+    if (mColorMode==colorLightModeHueSaturation) {
+      // Note: HSV->RGB is linear in V, so full brightness result can be scaled later
+      HSV[0] = p0; // 0..360
+      HSV[1] = p1/100; // 0..1
+      HSV[2] = 1;
+      HSVtoRGB(HSV, mCachedRGB);
     }
-    case colorLightModeCt: {
-      // Note: for some reason, passing brightness to V gives bad results,
-      // so for now we always assume 1 and scale resulting RGB
-      CTtoxyV(mCt->getChannelValue(aTransitional), xyV);
+    else {
+      if (!mInverseCalibrationValid) {
+        if (!matrix3x3_inverse(mCalibration, mInverseCalibration)) {
+          // singular calibration matrix, fall back to sRGB
+          matrix3x3_inverse(sRGB_d65_calibration, mInverseCalibration);
+        }
+        mInverseCalibrationValid = true;
+      }
+      if (mColorMode==colorLightModeCt) {
+        cachedCTtoxyV(p0, xyV);
+      }
+      else {
+        xyV[0] = p0;
+        xyV[1] = p1;
+        xyV[2] = 1;
+      }
       xyVtoXYZ(xyV, XYZ);
-      XYZtoRGB(mCalibration, XYZ, RGB);
-      // get maximum component brightness -> gives 100% brightness point, will be scaled down according to actual brightness
-      double m = 0;
-      if (RGB[0]>m) m = RGB[0];
-      if (RGB[1]>m) m = RGB[1];
-      if (RGB[2]>m) m = RGB[2];
-      // include actual brightness into scale calculation
-      if (!aNoBrightness) scale = mBrightness->getChannelValue(aTransitional)/100/m;
-      break;
+      // convert using (inverse) calibration for this lamp
+      for (int i=0; i<3; i++) {
+        mCachedRGB[i] = mInverseCalibration[i][0]*XYZ[0] + mInverseCalibration[i][1]*XYZ[1] + mInverseCalibration[i][2]*XYZ[2];
+      }
     }
-    case colorLightModeXY: {
+    mCachedRGBMax = 0;
+    for (int i=0; i<3; i++) if (mCachedRGB[i]>mCachedRGBMax) mCachedRGBMax = mCachedRGB[i];
+    mCachedColorMode = mColorMode;
+    mCachedColorParams[0] = p0;
+    mCachedColorParams[1] = p1;
+  }
+  for (int i=0; i<3; i++) aRGB[i] = mCachedRGB[i];
+  aMaxComp = mCachedRGBMax;
+  return true;
+}
+
+
+void RGBColorLightBehaviour::getRGB(double &aRed, double &aGreen, double &aBlue, double aMax, bool aNoBrightness, bool aTransitional)
+{
+  Row3 RGB;
+  double m;
+  double scale = 1;
+  if (!getUnscaledRGB(RGB, m, aTransitional)) {
+    // no color, just set R=G=B=brightness
+    RGB[0] = aNoBrightness ? 1 : mBrightness->getChannelValue(aTransitional)/100;
+    RGB[1] = RGB[0];
+    RGB[2] = RGB[0];
+  }
+  else if (!aNoBrightness) {
+    scale = mBrightness->getChannelValue(aTransitional)/100; // 0..1
+    if (mColorMode==colorLightModeCt) {
       // Note: for some reason, passing brightness to V gives bad results,
-      // so for now we always assume 1 and scale resulting RGB
-      xyV[0] = mCIEx->getChannelValue(aTransitional);
-      xyV[1] = mCIEy->getChannelValue(aTransitional);
-      xyV[2] = 1;
-      xyVtoXYZ(xyV, XYZ);
-      // convert using calibration for this lamp
-      XYZtoRGB(mCalibration, XYZ, RGB);
-      if (!aNoBrightness) scale = mBrightness->getChannelValue(aTransitional)/100; // 0..1
-      break;
+      // so for now we always assume 1 and scale resulting RGB such that
+      // maximum component brightness gives 100% brightness point
+      scale /= m;
     }
-    default: {
-      // no color, just set R=G=B=brightness
-      RGB[0] = aNoBrightness ? 1 : mBrightness->getChannelValue(aTransitional)/100;
-      RGB[1] = RGB[0];
-      RGB[2] = RGB[0];
-      break;
+  }
+  #if VERIFY_CACHED_CONVERSIONS
+  if (mColorMode!=colorLightModeNone) {
+    // compare with uncached reference conversion
+    Row3 refRGB, xyV, XYZ, HSV;
+    if (mColorMode==colorLightModeHueSaturation) {
+      HSV[0] = mHue->getChannelValue(aTransitional);
+      HSV[1] = mSaturation->getChannelValue(aTransitional)/100;
+      HSV[2] = 1;
+      HSVtoRGB(HSV, refRGB);
+    }
+    else {
+      if (mColorMode==colorLightModeCt) {
+        CTtoxyV(mCt->getChannelValue(aTransitional), xyV);
+      }
+      else {
+        xyV[0] = mCIEx->getChannelValue(aTransitional);
+        xyV[1] = mCIEy->getChannelValue(aTransitional);
+        xyV[2] = 1;
+      }
+      xyVtoXYZ(xyV, XYZ);
+      XYZtoRGB(mCalibration, XYZ, refRGB);
     }
+    double maxdiff = 0;
+    for (int i=0; i<3; i++) { double d = fabs(refRGB[i]-RGB[i]); if (d>maxdiff) maxdiff = d; }
+    if (maxdiff>1e-3) OLOG(LOG_WARNING, "cached RGB conversion deviates by %.5f from reference", maxdiff);
   }
+  #endif // VERIFY_CACHED_CONVERSIONS
   aRed = colorCompScaled(RGB[0]*scale, aMax);
   aGreen = colorCompScaled(RGB[1]*scale, aMax);
   aBlue = colorCompScaled(RGB[2]*scale, aMax);
@@ -1275,6 +1382,7 @@ void RGBColorLightBehaviour::loadFromRow(sqlite3pp::query::iterator &aRow, int &
       mCalibration[j][i] = aRow->get<double>(aIndex++);
     }
   }
+  calibrationChanged();
   string c;
   if (aRow->getIfNotNull(aIndex++, c)) pixelToRGB(webColorToPixel(c), mWhiteRGB);
   if (aRow->getIfNotNull(aIndex++, c)) pixelToRGB(webColorToPixel(c), mAmberRGB);
@@ -1359,7 +1467,7 @@ bool RGBColorLightBehaviour::accessField(PropertyAccessMode aMode, ApiValuePtr a
       }
       else {
         // write properties
-        setPVar(mCalibration[ix/3][ix%3], aPropValue->doubleValue());
+        if (setPVar(mCalibration[ix/3][ix%3], aPropValue->doubleValue())) calibrationChanged();
       }
       return true;
     }
@@ -47,6 +47,14 @@ namespace p44 {
 
 
 
+  /// fast CT to xyV conversion using a lookup table with 1 mired resolution
+  /// @param aMired color temperature in mired
+  /// @param aXyV will receive CIE x,y and V (=1)
+  /// @note results are interpolated from a table calculated once with CTtoxyV(); mireds outside the
+  ///   table range are calculated directly
+  void cachedCTtoxyV(double aMired, Row3 &aXyV);
+
+
   class ColorChannel : public ChannelBehaviour
   {
     typedef ChannelBehaviour inherited;
@@ -355,6 +363,9 @@ namespace p44 {
 
 
 
+  class RGBColorLightBehaviour;
+  typedef boost::intrusive_ptr<RGBColorLightBehaviour> RGBColorLightBehaviourPtr;
+
   class RGBColorLightBehaviour : public ColorLightBehaviour
   {
     typedef ColorLightBehaviour inherited;
@@ -368,8 +379,29 @@ namespace p44 {
     Row3 mAmberRGB; ///< R,G,B relative intensities that can be replaced by a extra amber (warm white) channel
     /// @}
 
+  private:
+
+    /// @name conversion cache (derived from calibration and last converted color, not persisted)
+    /// @{
+    bool mInverseCalibrationValid; ///< set when mInverseCalibration is up-to-date with mCalibration
+    Matrix3x3 mInverseCalibration; ///< inverse of mCalibration, for XYZ->RGB
+    ColorLightMode mCachedColorMode; ///< color mode the cached full brightness RGB was calculated for, colorLightModeNone if none
+    double mCachedColorParams[2]; ///< hue/saturation, x/y or ct (in [0]) the cached RGB was calculated from
+    Row3 mCachedRGB; ///< cached RGB at full brightness (or unscaled in CT mode)
+    double mCachedRGBMax; ///< maximum component of mCachedRGB
+    /// @}
+
+    /// get full brightness (unscaled) RGB for the current color mode and color channel values, using cache when possible
+    /// @return false if current color mode does not have a color
+    bool getUnscaledRGB(Row3 &aRGB, double &aMaxComp, bool aTransitional);
+
+  public:
+
     RGBColorLightBehaviour(Device &aDevice, bool aCtOnly);
 
+    /// must be called after mCalibration has been modified directly, to invalidate cached conversion data
+    void calibrationChanged();
+
     /// @name color services for implementing color lights
     /// @{
 
@@ -429,7 +461,6 @@ namespace p44 {
     /// @param aMax max value for aBri,aCool
     void setBriCool(double aBri, double aCool, double aMax);
 
-
     /// @}
 
     /// short (text without LFs!) description of object, mainly for referencing it in log messages
@@ -453,8 +484,6 @@ namespace p44 {
 
   };
 
-  typedef boost::intrusive_ptr<RGBColorLightBehaviour> RGBColorLightBehaviourPtr;
-
 } // namespace p44
 
 #endif /* defined(__p44vdc__colorlightbehaviour__) */
@@ -53,6 +53,9 @@ SensorBehaviour::SensorBehaviour(Device &aDevice, const string aId) :
   #if ENABLE_JSONBRIDGEAPI
   mBridgeExclusive(false),
   #endif
+  #if ENABLE_SENSOR_HISTORY
+  mHistoryEnabled(false),
+  #endif
   // state
   #if ENABLE_RRDB
   mLoggingReady(false),
@@ -401,6 +404,11 @@ void SensorBehaviour::updateSensorValue(double aValue, double aMinChange, bool a
     // just assign new current value
     mCurrentValue = aValue;
   }
+  #if ENABLE_SENSOR_HISTORY
+  if (mHistory) {
+    mHistory->addSample(now, aValue, mCurrentValue);
+  }
+  #endif
   // possibly let localcontroller process it
   #if ENABLE_LOCALCONTROLLER
   // also let vdchost know for local dimmer dial handling etc., but only changes!
@@ -598,12 +606,236 @@ int SensorBehaviour::getSourceOpLevel()
 #endif // ENABLE_P44SCRIPT
 
 
-#if ENABLE_RRDB
-// MARK: - RRD sensor value logging
+#if ENABLE_SENSOR_HISTORY
+// MARK: - in-memory sensor history
+
+#define HISTORY_TIME_UNIT (100*MilliSecond) // resolution of the compact time columns
+#define HISTORY_RECENT_SAMPLES 240 // number of most recent samples kept with full resolution
+
+// downsampled tiers
+static const struct {
+  MLMicroSeconds interval;
+  size_t size;
+} historyTiers[] = {
+  { 1*Minute, 180 }, // 3 hours in 1 minute buckets
+  { 15*Minute, 192 }, // 2 days in 15 minute buckets
+  { 1*Hour, 24*14 }, // 2 weeks in 1 hour buckets
+  { 0, 0 } // terminator
+};
+
+
+SensorHistory::Tier::Tier(MLMicroSeconds aInterval, size_t aSize) :
+  mInterval(aInterval),
+  mNextBucket(0),
+  mNumBuckets(0),
+  mTimes(aSize),
+  mMins(aSize),
+  mMaxs(aSize),
+  mAvgs(aSize),
+  mCounts(aSize),
+  mBucketStart(Never),
+  mBucketMin(0),
+  mBucketMax(0),
+  mBucketSum(0),
+  mBucketCount(0)
+{
+}
+
 
+SensorHistory::SensorHistory() :
+  mBaseTime(MainLoop::now()),
+  mNextSample(0),
+  mNumSamples(0),
+  mSampleTimes(HISTORY_RECENT_SAMPLES),
+  mRawValues(HISTORY_RECENT_SAMPLES),
+  mFilteredValues(HISTORY_RECENT_SAMPLES)
+{
+  for (int i=0; historyTiers[i].interval>0; i++) {
+    mTiers.push_back(Tier(historyTiers[i].interval, historyTiers[i].size));
+  }
+}
 
 
-typedef std::vector<string> ArgsVector;
+uint32_t SensorHistory::compactTime(MLMicroSeconds aTime) const
+{
+  if (aTime<mBaseTime) return 0;
+  return (uint32_t)((aTime-mBaseTime)/HISTORY_TIME_UNIT);
+}
+
+
+MLMicroSeconds SensorHistory::expandTime(uint32_t aCompactTime) const
+{
+  return mBaseTime+(MLMicroSeconds)aCompactTime*HISTORY_TIME_UNIT;
+}
+
+
+void SensorHistory::addSample(MLMicroSeconds aTimeStamp, double aRawValue, double aFilteredValue)
+{
+  // recent samples
+  mSampleTimes[mNextSample] = compactTime(aTimeStamp);
+  mRawValues[mNextSample] = aRawValue;
+  mFilteredValues[mNextSample] = aFilteredValue;
+  mNextSample = (mNextSample+1) % mSampleTimes.size();
+  if (mNumSamples<mSampleTimes.size()) mNumSamples++;
+  // downsampled tiers
+  for (TiersVector::iterator pos = mTiers.begin(); pos!=mTiers.end(); ++pos) {
+    Tier &t = *pos;
+    MLMicroSeconds bucketStart = aTimeStamp-(aTimeStamp-mBaseTime)%t.mInterval;
+    if (t.mBucketStart!=Never && bucketStart!=t.mBucketStart) {
+      // close the current bucket
+      t.mTimes[t.mNextBucket] = compactTime(t.mBucketStart);
+      t.mMins[t.mNextBucket] = t.mBucketMin;
+      t.mMaxs[t.mNextBucket] = t.mBucketMax;
+      t.mAvgs[t.mNextBucket] = t.mBucketSum/t.mBucketCount;
+      t.mCounts[t.mNextBucket] = t.mBucketCount>0xFFFF ? 0xFFFF : t.mBucketCount;
+      t.mNextBucket = (t.mNextBucket+1) % t.mTimes.size();
+      if (t.mNumBuckets<t.mTimes.size()) t.mNumBuckets++;
+      t.mBucketStart = Never;
+    }
+    if (t.mBucketStart==Never) {
+      // start new bucket
+      t.mBucketStart = bucketStart;
+      t.mBucketMin = aFilteredValue;
+      t.mBucketMax = aFilteredValue;
+      t.mBucketSum = 0;
+      t.mBucketCount = 0;
+    }
+    if (aFilteredValue<t.mBucketMin) t.mBucketMin = aFilteredValue;
+    if (aFilteredValue>t.mBucketMax) t.mBucketMax = aFilteredValue;
+    t.mBucketSum += aFilteredValue;
+    t.mBucketCount++;
+  }
+}
+
+
+MLMicroSeconds SensorHistory::query(EntriesVector &aEntries, MLMicroSeconds aFrom, MLMicroSeconds aTo, HistoryAggregation aAggregation, MLMicroSeconds aInterval)
+{
+  aEntries.clear();
+  // find best source: the finest resolution that still covers aFrom
+  int source = -1; // recent samples
+  if (aAggregation!=history_raw) {
+    bool covered = mNumSamples>0 && expandTime(mSampleTimes[(mNextSample+mSampleTimes.size()-mNumSamples) % mSampleTimes.size()])<=aFrom;
+    for (int i=0; !covered && i<mTiers.size(); i++) {
+      Tier &t = mTiers[i];
+      if (t.mNumBuckets==0 && t.mBucketStart==Never) break; // no data at all in this tier, coarser tiers won't have any either
+      source = i;
+      MLMicroSeconds oldest = t.mNumBuckets>0 ? expandTime(t.mTimes[(t.mNextBucket+t.mTimes.size()-t.mNumBuckets) % t.mTimes.size()]) : t.mBucketStart;
+      covered = oldest<=aFrom;
+    }
+  }
+  // collect entries
+  EntriesVector entries;
+  Entry e;
+  if (source<0) {
+    for (size_t n=0; n<mNumSamples; n++) {
+      size_t i = (mNextSample+mSampleTimes.size()-mNumSamples+n) % mSampleTimes.size();
+      e.time = expandTime(mSampleTimes[i]);
+      if (e.time<aFrom || e.time>aTo) continue;
+      double v = aAggregation==history_raw ? mRawValues[i] : mFilteredValues[i];
+      e.min = v; e.max = v; e.sum = v; e.count = 1;
+      entries.push_back(e);
+    }
+  }
+  else {
+    Tier &t = mTiers[source];
+    for (size_t n=0; n<t.mNumBuckets; n++) {
+      size_t i = (t.mNextBucket+t.mTimes.size()-t.mNumBuckets+n) % t.mTimes.size();
+      e.time = expandTime(t.mTimes[i]);
+      if (e.time+t.mInterval<=aFrom || e.time>aTo) continue;
+      e.min = t.mMins[i]; e.max = t.mMaxs[i]; e.count = t.mCounts[i]; e.sum = t.mAvgs[i]*e.count;
+      entries.push_back(e);
+    }
+    // include the bucket currently being accumulated
+    if (t.mBucketStart!=Never && t.mBucketCount>0 && t.mBucketStart+t.mInterval>aFrom && t.mBucketStart<=aTo) {
+      e.time = t.mBucketStart; e.min = t.mBucketMin; e.max = t.mBucketMax; e.sum = t.mBucketSum; e.count = t.mBucketCount;
+      entries.push_back(e);
+    }
+  }
+  MLMicroSeconds resolution = source<0 ? 0 : mTiers[source].mInterval;
+  if (aInterval<=resolution) {
+    // no re-bucketing needed
+    aEntries.swap(entries);
+    return resolution;
+  }
+  // aggregate into requested intervals
+  for (EntriesVector::iterator pos = entries.begin(); pos!=entries.end(); ++pos) {
+    MLMicroSeconds bucketStart = pos->time<aFrom ? aFrom : pos->time-(pos->time-aFrom)%aInterval;
+    if (aEntries.empty() || aEntries.back().time!=bucketStart) {
+      e = *pos;
+      e.time = bucketStart;
+      aEntries.push_back(e);
+    }
+    else {
+      Entry &b = aEntries.back();
+      if (pos->min<b.min) b.min = pos->min;
+      if (pos->max>b.max) b.max = pos->max;
+      b.sum += pos->sum;
+      b.count += pos->count;
+    }
+  }
+  return aInterval;
+}
+
+
+void SensorHistory::queryToApiValue(ApiValuePtr aResult, MLMicroSeconds aFrom, MLMicroSeconds aTo, HistoryAggregation aAggregation, MLMicroSeconds aInterval)
+{
+  EntriesVector entries;
+  MLMicroSeconds resolution = query(entries, aFrom, aTo, aAggregation, aInterval);
+  ApiValuePtr times = aResult->newArray();
+  ApiValuePtr values = aResult->newArray();
+  for (EntriesVector::iterator pos = entries.begin(); pos!=entries.end(); ++pos) {
+    times->arrayAppend(aResult->newDouble((double)MainLoop::mainLoopTimeToUnixTime(pos->time)/Second));
+    double v;
+    switch (aAggregation) {
+      case history_min: v = pos->min; break;
+      case history_max: v = pos->max; break;
+      default: v = pos->count>0 ? pos->sum/pos->count : 0; break;
+    }
+    values->arrayAppend(aResult->newDouble(v));
+  }
+  aResult->add("resolution", aResult->newDouble((double)resolution/Second));
+  aResult->add("times", times);
+  aResult->add("values", values);
+}
+
+
+HistoryAggregation SensorHistory::aggregationFromText(const string aText)
+{
+  if (uequals(aText.c_str(), "min")) return history_min;
+  if (uequals(aText.c_str(), "max")) return history_max;
+  if (uequals(aText.c_str(), "raw")) return history_raw;
+  return history_avg;
+}
+
+
+size_t SensorHistory::memoryUsage()
+{
+  size_t m = sizeof(SensorHistory)+mSampleTimes.size()*(sizeof(uint32_t)+2*sizeof(float));
+  for (TiersVector::iterator pos = mTiers.begin(); pos!=mTiers.end(); ++pos) {
+    m += sizeof(Tier)+pos->mTimes.size()*(sizeof(uint32_t)+3*sizeof(float)+sizeof(uint16_t));
+  }
+  return m;
+}
+
+
+void SensorBehaviour::enableHistory(bool aEnable)
+{
+  mHistoryEnabled = aEnable;
+  if (!aEnable) {
+    mHistory.reset();
+  }
+  else if (!mHistory) {
+    mHistory = SensorHistoryPtr(new SensorHistory);
+    OLOG(LOG_INFO, "in-memory history enabled, using %lu bytes", (unsigned long)mHistory->memoryUsage());
+  }
+}
+
+#endif // ENABLE_SENSOR_HISTORY
+
+
+#if ENABLE_RRDB
+// MARK: - RRD sensor value logging
+
 
 #if P44_BUILD_OW
 typedef char* RrdFuncArg;
@@ -614,7 +846,7 @@ typedef const char* RrdFuncArg;
 
 typedef int (*RrdFunc)(int, RrdFuncArg*);
 
-static int rrd_call(RrdFunc aFunc, ArgsVector &aArgs)
+static int rrd_call(RrdFunc aFunc, RrdArgsVector &aArgs)
 {
   RrdFuncArg* argsArrayP = new RrdFuncArg[aArgs.size()+1];
   LOG(LOG_DEBUG, "rrd_call:");
@@ -648,13 +880,336 @@ static string rrdminmax(double aMin, double aMax)
 }
 
 
+// MARK: - RrdUpdateTemplate
+
+bool RrdUpdateTemplate::compile(const string aUpdateString)
+{
+  mSegments.clear();
+  bool hasValues = false;
+  Segment seg;
+  seg.placeholder = 0;
+  const char *p = aUpdateString.c_str();
+  if (*p=='N' && (*(p+1)==':' || *(p+1)==0)) {
+    // "now" timestamp: must be explicit for delayed, batched writing
+    seg.placeholder = 'T';
+    mSegments.push_back(seg);
+    seg.placeholder = 0;
+    p++;
+  }
+  while (*p) {
+    if (*p=='%' && (*(p+1)=='T' || *(p+1)=='R' || *(p+1)=='F' || *(p+1)=='P')) {
+      if (!seg.literal.empty()) {
+        mSegments.push_back(seg);
+        seg.literal.clear();
+      }
+      seg.placeholder = *(p+1);
+      if (seg.placeholder!='T') hasValues = true;
+      mSegments.push_back(seg);
+      seg.placeholder = 0;
+      p += 2;
+      continue;
+    }
+    seg.literal += *p++;
+  }
+  if (!seg.literal.empty()) {
+    mSegments.push_back(seg);
+  }
+  return hasValues;
+}
+
+
+string RrdUpdateTemplate::expand(long aUnixTime, double aRawValue, double aProcessedValue, double aPushedValue, bool aValid, bool aPushedValid) const
+{
+  string ud;
+  for (SegmentsVector::const_iterator pos = mSegments.begin(); pos!=mSegments.end(); ++pos) {
+    switch (pos->placeholder) {
+      case 'T': string_format_append(ud, "%ld", aUnixTime); break;
+      case 'R': ud += rrdval(aRawValue, aValid); break;
+      case 'F': ud += rrdval(aProcessedValue, aValid); break;
+      case 'P': ud += rrdval(aPushedValue, aPushedValid); break;
+      default: ud += pos->literal; break;
+    }
+  }
+  return ud;
+}
+
+
+// MARK: - RrdLogWriter
+
+#define RRD_DEFAULT_MAX_QUEUED_SAMPLES 1000 // max number of samples in the queue
+#define RRD_DEFAULT_MAX_BATCH_DELAY (60*Second) // max delay before samples get written
+#define RRD_WRITER_POLL_INTERVAL (1*Second) // how often the writer thread checks the queue
+#define RRD_MAX_SAMPLES_PER_UPDATE 50 // max number of samples to write in a single rrd_update call
+
+
+static RrdLogWriter* gSharedRrdLogWriterP = nullptr;
+
+RrdLogWriter& RrdLogWriter::sharedRrdLogWriter()
+{
+  if (!gSharedRrdLogWriterP) {
+    gSharedRrdLogWriterP = new RrdLogWriter;
+  }
+  return *gSharedRrdLogWriterP;
+}
+
+
+RrdLogWriter::RrdLogWriter() :
+  mMaxQueuedSamples(RRD_DEFAULT_MAX_QUEUED_SAMPLES),
+  mDropPolicy(rrdqueue_drop_oldest),
+  mMaxBatchDelay(RRD_DEFAULT_MAX_BATCH_DELAY),
+  mSamplesQueued(0),
+  mSamplesWritten(0),
+  mSamplesDropped(0),
+  mSamplesFailed(0),
+  mUpdateCalls(0),
+  mMaxQueueDepth(0),
+  mMaxQueueLatency(0),
+  mLastFlushTime(0),
+  mMaxFlushTime(0)
+{
+  pthread_mutex_init(&mQueueAccess, NULL);
+  pthread_mutex_init(&mRrdAccess, NULL);
+  // make sure queued samples get written when app terminates
+  MainLoop::currentMainLoop().registerCleanupHandler(boost::bind(&RrdLogWriter::flush, this));
+}
+
+
+RrdLogWriter::~RrdLogWriter()
+{
+  if (mWriterThread) {
+    mWriterThread->cancel();
+    mWriterThread.reset();
+  }
+  pthread_mutex_destroy(&mQueueAccess);
+  pthread_mutex_destroy(&mRrdAccess);
+}
+
+
+void RrdLogWriter::setQueueParams(size_t aMaxQueuedSamples, RrdQueueDropPolicy aDropPolicy, MLMicroSeconds aMaxBatchDelay)
+{
+  pthread_mutex_lock(&mQueueAccess);
+  mMaxQueuedSamples = aMaxQueuedSamples>0 ? aMaxQueuedSamples : 1;
+  mDropPolicy = aDropPolicy;
+  mMaxBatchDelay = aMaxBatchDelay;
+  pthread_mutex_unlock(&mQueueAccess);
+}
+
+
+void RrdLogWriter::registerFile(const string aRrdFile, const RrdArgsVector &aCreateArgs)
+{
+  pthread_mutex_lock(&mQueueAccess);
+  RrdFileInfo &fi = mFiles[aRrdFile];
+  fi.createArgs = aCreateArgs;
+  fi.checked = false;
+  fi.failed = false;
+  pthread_mutex_unlock(&mQueueAccess);
+  if (!mWriterThread) {
+    // first file, start the writer thread
+    mWriterThread = MainLoop::currentMainLoop().executeInThread(boost::bind(&RrdLogWriter::writerThread, this, _1), NoOP);
+  }
+}
+
+
+void RrdLogWriter::queueSample(const string aRrdFile, const string aUpdate)
+{
+  RrdSample sample;
+  sample.file = aRrdFile;
+  sample.update = aUpdate;
+  sample.queuedAt = MainLoop::now();
+  pthread_mutex_lock(&mQueueAccess);
+  mSamplesQueued++;
+  if (mQueue.size()>=mMaxQueuedSamples) {
+    // overload
+    mSamplesDropped++;
+    if (mDropPolicy==rrdqueue_drop_oldest) {
+      mQueue.pop_front();
+      mQueue.push_back(sample);
+    }
+  }
+  else {
+    mQueue.push_back(sample);
+  }
+  if (mQueue.size()>mMaxQueueDepth) mMaxQueueDepth = mQueue.size();
+  pthread_mutex_unlock(&mQueueAccess);
+}
+
+
+bool RrdLogWriter::needsFlush(MLMicroSeconds aNow)
+{
+  // Note: must be called with mQueueAccess locked
+  if (mQueue.empty()) return false;
+  return
+    mQueue.size()>=mMaxQueuedSamples/2 || // high water mark reached
+    aNow>=mQueue.front().queuedAt+mMaxBatchDelay; // oldest sample has waited long enough
+}
+
+
+void RrdLogWriter::writerThread(ChildThreadWrapper &aThread)
+{
+  while (!aThread.shouldTerminate()) {
+    pthread_mutex_lock(&mQueueAccess);
+    bool doFlush = needsFlush(MainLoop::now());
+    pthread_mutex_unlock(&mQueueAccess);
+    if (doFlush) {
+      flush();
+    }
+    else {
+      MainLoop::sleep(RRD_WRITER_POLL_INTERVAL);
+    }
+  }
+}
+
+
+bool RrdLogWriter::ensureFile(const string &aRrdFile, RrdFileInfo &aFileInfo)
+{
+  // Note: must be called with mRrdAccess locked
+  if (aFileInfo.failed) return false;
+  if (aFileInfo.checked) return true;
+  struct stat st;
+  if (stat(aRrdFile.c_str(), &st)<0 && errno==ENOENT) {
+    // does not exist yet, create new
+    if (LOGENABLED(LOG_INFO)) {
+      string a;
+      for (int i=0; i<aFileInfo.createArgs.size(); ++i) a += aFileInfo.createArgs[i] + ' ';
+      LOG(LOG_INFO, "rrd: creating new RRD with args: %s", a.c_str());
+    }
+    if (rrd_call(rrd_create, aFileInfo.createArgs)!=0) {
+      LOG(LOG_ERR, "rrd: cannot create rrd file '%s': %s", aRrdFile.c_str(), rrd_get_error());
+      aFileInfo.failed = true;
+      return false;
+    }
+    LOG(LOG_INFO, "rrd: successfully created new rrd file '%s'", aRrdFile.c_str());
+  }
+  else {
+    LOG(LOG_INFO, "rrd: using existing file '%s'", aRrdFile.c_str());
+  }
+  aFileInfo.checked = true;
+  return true;
+}
+
+
+void RrdLogWriter::flush()
+{
+  pthread_mutex_lock(&mRrdAccess);
+  // take over the current queue
+  SampleQueue samples;
+  RrdFilesMap files;
+  pthread_mutex_lock(&mQueueAccess);
+  samples.swap(mQueue);
+  files = mFiles; // snapshot of the file states
+  pthread_mutex_unlock(&mQueueAccess);
+  if (samples.empty()) {
+    pthread_mutex_unlock(&mRrdAccess);
+    return;
+  }
+  MLMicroSeconds started = MainLoop::now();
+  MLMicroSeconds maxLatency = started-samples.front().queuedAt;
+  // group samples by file, preserving order
+  typedef std::map<string, RrdArgsVector> UpdatesMap;
+  UpdatesMap updates;
+  for (SampleQueue::iterator pos = samples.begin(); pos!=samples.end(); ++pos) {
+    updates[pos->file].push_back(pos->update);
+  }
+  uint64_t written = 0;
+  uint64_t failed = 0;
+  uint64_t calls = 0;
+  for (UpdatesMap::iterator upos = updates.begin(); upos!=updates.end(); ++upos) {
+    RrdFilesMap::iterator fpos = files.find(upos->first);
+    if (fpos==files.end() || !ensureFile(upos->first, fpos->second)) {
+      failed += upos->second.size();
+      continue;
+    }
+    // write in batches
+    size_t i = 0;
+    while (i<upos->second.size()) {
+      RrdArgsVector args;
+      args.push_back("rrdupdate");
+      args.push_back(upos->first);
+      size_t n = 0;
+      while (i<upos->second.size() && n<RRD_MAX_SAMPLES_PER_UPDATE) {
+        args.push_back(upos->second[i++]);
+        n++;
+      }
+      calls++;
+      if (rrd_call(rrd_update, args)!=0) {
+        LOG(LOG_WARNING, "rrd: could not update rrd data for file '%s': %s", upos->first.c_str(), rrd_get_error());
+        failed += n;
+        fpos->second.checked = false; // re-check (and possibly re-create) file before next write
+      }
+      else {
+        written += n;
+      }
+    }
+  }
+  MLMicroSeconds flushTime = MainLoop::now()-started;
+  // update file states and statistics
+  pthread_mutex_lock(&mQueueAccess);
+  for (RrdFilesMap::iterator fpos = files.begin(); fpos!=files.end(); ++fpos) {
+    RrdFilesMap::iterator cpos = mFiles.find(fpos->first);
+    // Note: do not overwrite state of files that have been re-registered in the meantime
+    if (cpos!=mFiles.end() && cpos->second.createArgs==fpos->second.createArgs) {
+      cpos->second.checked = fpos->second.checked;
+      cpos->second.failed = fpos->second.failed;
+    }
+  }
+  mSamplesWritten += written;
+  mSamplesFailed += failed;
+  mUpdateCalls += calls;
+  mLastFlushTime = flushTime;
+  if (flushTime>mMaxFlushTime) mMaxFlushTime = flushTime;
+  if (maxLatency>mMaxQueueLatency) mMaxQueueLatency = maxLatency;
+  pthread_mutex_unlock(&mQueueAccess);
+  pthread_mutex_unlock(&mRrdAccess);
+  LOG(LOG_DEBUG, "rrd: flushed %lu samples in %llu rrd_update calls, %lld mS", (unsigned long)samples.size(), (unsigned long long)calls, flushTime/MilliSecond);
+}
+
+
+void RrdLogWriter::getStatistics(ApiValuePtr aStats)
+{
+  pthread_mutex_lock(&mQueueAccess);
+  aStats->add("queued", aStats->newUint64(mSamplesQueued));
+  aStats->add("written", aStats->newUint64(mSamplesWritten));
+  aStats->add("dropped", aStats->newUint64(mSamplesDropped));
+  aStats->add("failed", aStats->newUint64(mSamplesFailed));
+  aStats->add("updateCalls", aStats->newUint64(mUpdateCalls));
+  aStats->add("queueDepth", aStats->newUint64(mQueue.size()));
+  aStats->add("maxQueueDepth", aStats->newUint64(mMaxQueueDepth));
+  aStats->add("maxQueuedSamples", aStats->newUint64(mMaxQueuedSamples));
+  aStats->add("dropPolicy", aStats->newString(mDropPolicy==rrdqueue_drop_newest ? "newest" : "oldest"));
+  aStats->add("maxBatchDelay", aStats->newDouble((double)mMaxBatchDelay/Second));
+  aStats->add("maxQueueLatency", aStats->newDouble((double)mMaxQueueLatency/Second));
+  aStats->add("lastFlushTime", aStats->newDouble((double)mLastFlushTime/Second));
+  aStats->add("maxFlushTime", aStats->newDouble((double)mMaxFlushTime/Second));
+  aStats->add("files", aStats->newUint64(mFiles.size()));
+  pthread_mutex_unlock(&mQueueAccess);
+}
+
+
+string RrdLogWriter::statisticsText()
+{
+  pthread_mutex_lock(&mQueueAccess);
+  string s = string_format(
+    "RRD logging: %lu files, queued=%llu, written=%llu, dropped=%llu, failed=%llu, updateCalls=%llu, queueDepth=%lu (max %lu), maxLatency=%lld mS, maxFlushTime=%lld mS",
+    (unsigned long)mFiles.size(),
+    (unsigned long long)mSamplesQueued, (unsigned long long)mSamplesWritten, (unsigned long long)mSamplesDropped,
+    (unsigned long long)mSamplesFailed, (unsigned long long)mUpdateCalls,
+    (unsigned long)mQueue.size(), (unsigned long)mMaxQueueDepth,
+    mMaxQueueLatency/MilliSecond, mMaxFlushTime/MilliSecond
+  );
+  pthread_mutex_unlock(&mQueueAccess);
+  return s;
+}
+
+
+// MARK: - SensorBehaviour RRD logging
+
 void SensorBehaviour::prepareLogging()
 {
   if (!mLoggingReady && !mRRDBconfig.empty() && mRRDBfile.empty()) {
     // configured but not yet prepared to log
     // Note: not ready and rrdbfile NOT empty means that we could not start logging due to a problem (-> no op)
     // always need to parse config first to get update statement, maybe to (re-)create file
-    ArgsVector cfgArgs;
+    RrdArgsVector cfgArgs;
     const char *p = mRRDBconfig.c_str();
     string arg;
     bool autoRaw = false;
@@ -665,6 +1220,7 @@ void SensorBehaviour::prepareLogging()
     bool autoUpdate = true;
     long step = 1;
     string consolidationFunc = "AVERAGE";
+    string updateString;
     while (nextPart(p, arg, ' ')) {
       arg = trimWhiteSpace(arg);
       // catch special "macros"
@@ -708,9 +1264,9 @@ void SensorBehaviour::prepareLogging()
       }
       else if (arg.substr(0,7)=="update:") {
         // update statement in case no autods is in use (any autods use will create a update string automatically)
-        // Syntax update:<rrdb update string with %R, %F and %P placeholders>
+        // Syntax update:<rrdb update string with %T, %R, %F and %P placeholders>
         autoUpdate = false;
-        mRRDBupdate = arg.substr(7); // rest of string is considered update string
+        updateString = arg.substr(7); // rest of string is considered update string
       }
       else {
         // is regular RRD create argument, use as-is
@@ -718,17 +1274,11 @@ void SensorBehaviour::prepareLogging()
       }
     }
     // in any case, we need the update statement
-    mLoggingReady = true; // assume true
     if (autoUpdate) {
-      mRRDBupdate = "N";
-      if (autoRaw) mRRDBupdate += ":%R";
-      if (autoFiltered) mRRDBupdate += ":%F";
-      if (autoPushed) mRRDBupdate += ":%P";
-      if (mRRDBupdate.size()<4) {
-        OLOG(LOG_WARNING, "Cannot create RRD update string, missing 'auto..' or 'update' config");
-        mRRDBupdate = "";
-        mLoggingReady = false; // no point in trying
-      }
+      updateString = "N";
+      if (autoRaw) updateString += ":%R";
+      if (autoFiltered) updateString += ":%F";
+      if (autoPushed) updateString += ":%P";
     }
     // use or create rrd file
     mRRDBfile = Application::sharedApplication()->tempPath(mRRDBpath);
@@ -736,73 +1286,60 @@ void SensorBehaviour::prepareLogging()
       // auto-generate filename
       pathstring_format_append(mRRDBfile, "Log_%s.rrd", getSourceId().c_str());
     }
-    struct stat st;
-    if (mLoggingReady && stat(mRRDBfile.c_str(), &st)<0 && errno==ENOENT) {
-      // does not exist yet, create new
-      mLoggingReady = false; // not any more, only if we succeed in creating new file it'll get set again
-      string dsname = string_format("%.17s", sensorTypeIds[mSensorType]); // 19 chars max for RRD data sources, we need 2 for suffix
-      // at this spoint, cfgArgs vector contains explicitly specified RRD args from config
-      // - now create the actual
-      ArgsVector args;
-      // command and filename
-      args.push_back("rrdcreate");
-      args.push_back(mRRDBfile);
-      // always start from now
-      args.push_back("--start"); args.push_back("now"); // start now
-      // possibly automatic --step option
-      if (autoStep) {
-        step = mUpdateInterval>15*Second ? mUpdateInterval/Second : 15;
-        // use step from sensor's update interval (but not faster than once in 15 seconds)
-        args.push_back("--step"); args.push_back(string_format("%ld", step)); // use sensor's native interval if known, 15sec otherwise
-      }
-      // possibly automatic datasources
-      long heartbeat = mAliveSignInterval ? mAliveSignInterval/Second : 60*60*24; // without aliveSignInterval, allow a day of no updates
-      if (autoRaw) {
-        args.push_back(string_format("DS:%s_R:GAUGE:%ld:%s", dsname.c_str(), heartbeat, rrdminmax(mMin, mMax).c_str()));
-      }
-      if (autoFiltered) {
-        args.push_back(string_format("DS:%s_F:GAUGE:%ld:%s", dsname.c_str(), heartbeat, rrdminmax(mMin, mMax).c_str()));
-      }
-      if (autoPushed) {
-        args.push_back(string_format("DS:%s_P:GAUGE:%ld:%s", dsname.c_str(), heartbeat, rrdminmax(mMin, mMax).c_str()));
-      }
-      if (autoRRA) {
-        // choose correct consolidation function
-        if (consolidationFunc.empty()) {
-          consolidationFunc = "AVERAGE";
-          if (mProfileP) {
-            if (mProfileP->evalType==eval_max) consolidationFunc = "MAX";
-            else if (mProfileP->evalType==eval_min) consolidationFunc = "MIN";
-          }
+    if (!mRRDBupdate.compile(updateString)) {
+      OLOG(LOG_WARNING, "Cannot create RRD update string, missing 'auto..' or 'update' config");
+      mRRDBupdate.clear();
+      return; // no point in trying
+    }
+    // prepare creation arguments, the log writer will create the file in case it does not exist yet
+    string dsname = string_format("%.17s", sensorTypeIds[mSensorType]); // 19 chars max for RRD data sources, we need 2 for suffix
+    // at this spoint, cfgArgs vector contains explicitly specified RRD args from config
+    // - now create the actual
+    RrdArgsVector args;
+    // command and filename
+    args.push_back("rrdcreate");
+    args.push_back(mRRDBfile);
+    // always start from now
+    // Note: must be explicit time, as file might get created by the log writer only after first samples are already queued
+    args.push_back("--start"); args.push_back(string_format("%ld", (long)(MainLoop::mainLoopTimeToUnixTime(MainLoop::now())/Second)-1)); // start now
+    // possibly automatic --step option
+    if (autoStep) {
+      step = mUpdateInterval>15*Second ? mUpdateInterval/Second : 15;
+      // use step from sensor's update interval (but not faster than once in 15 seconds)
+      args.push_back("--step"); args.push_back(string_format("%ld", step)); // use sensor's native interval if known, 15sec otherwise
+    }
+    // possibly automatic datasources
+    long heartbeat = mAliveSignInterval ? mAliveSignInterval/Second : 60*60*24; // without aliveSignInterval, allow a day of no updates
+    if (autoRaw) {
+      args.push_back(string_format("DS:%s_R:GAUGE:%ld:%s", dsname.c_str(), heartbeat, rrdminmax(mMin, mMax).c_str()));
+    }
+    if (autoFiltered) {
+      args.push_back(string_format("DS:%s_F:GAUGE:%ld:%s", dsname.c_str(), heartbeat, rrdminmax(mMin, mMax).c_str()));
+    }
+    if (autoPushed) {
+      args.push_back(string_format("DS:%s_P:GAUGE:%ld:%s", dsname.c_str(), heartbeat, rrdminmax(mMin, mMax).c_str()));
+    }
+    if (autoRRA) {
+      // choose correct consolidation function
+      if (consolidationFunc.empty()) {
+        consolidationFunc = "AVERAGE";
+        if (mProfileP) {
+          if (mProfileP->evalType==eval_max) consolidationFunc = "MAX";
+          else if (mProfileP->evalType==eval_min) consolidationFunc = "MIN";
         }
-        // now RRAs: RRA:consolidationFunc:xff:steps:rows
-        args.push_back(string_format("RRA:%s:0.5:%ld:%ld", consolidationFunc.c_str(), 1l, 7*24*3600/step)); // 1:1 samples for a week (with autostep: unless updateInterval is <15 sec, see above)
-        args.push_back(string_format("RRA:%s:0.5:%ld:%ld", consolidationFunc.c_str(), 3600/step, 30*24*3600*step/3600)); // hourly datapoints for 1 months (30 days)
-        args.push_back(string_format("RRA:%s:0.5:%ld:%ld", consolidationFunc.c_str(), 24*3600/step, 2*365*24*3600*step/24/3600)); // daily for 2 years
-      }
-      // now add explicit config
-      args.insert(args.end(), cfgArgs.begin(), cfgArgs.end());
-      // create the rrd file from config
-      if (OLOGENABLED(LOG_INFO)) {
-        string a;
-        for (int i=0; i<args.size(); ++i) a += args[i] + ' ';
-        OLOG(LOG_INFO, "rrd: creating new RRD with args: %s", a.c_str());
-      }
-      int ret = rrd_call(rrd_create, args);
-      if (ret==0) {
-        OLOG(LOG_INFO, "rrd: successfully created new rrd file '%s'", mRRDBfile.c_str());
-        mLoggingReady = true;
-        mLastRRDBupdate = MainLoop::currentMainLoop().now(); // creation counts as update, make sure we don't immediately try to send first update afterwards
       }
-      else {
-        OLOG(LOG_ERR, "rrd: cannot create rrd file '%s': %s", mRRDBfile.c_str(), rrd_get_error());
-      }
-    }
-    else {
-      // file apparently already exists
-      OLOG(LOG_INFO, "rrd: using existing file '%s'", mRRDBfile.c_str());
-      mLoggingReady = true;
+      // now RRAs: RRA:consolidationFunc:xff:steps:rows
+      args.push_back(string_format("RRA:%s:0.5:%ld:%ld", consolidationFunc.c_str(), 1l, 7*24*3600/step)); // 1:1 samples for a week (with autostep: unless updateInterval is <15 sec, see above)
+      args.push_back(string_format("RRA:%s:0.5:%ld:%ld", consolidationFunc.c_str(), 3600/step, 30*24*3600*step/3600)); // hourly datapoints for 1 months (30 days)
+      args.push_back(string_format("RRA:%s:0.5:%ld:%ld", consolidationFunc.c_str(), 24*3600/step, 2*365*24*3600*step/24/3600)); // daily for 2 years
     }
+    // now add explicit config
+    args.insert(args.end(), cfgArgs.begin(), cfgArgs.end());
+    // register with the log writer
+    RrdLogWriter::sharedRrdLogWriter().registerFile(mRRDBfile, args);
+    OLOG(LOG_INFO, "rrd: logging into '%s' (written in background)", mRRDBfile.c_str());
+    mLastRRDBupdate = Never;
+    mLoggingReady = true;
   }
 }
 
@@ -811,32 +1348,18 @@ void SensorBehaviour::logSensorValue(MLMicroSeconds aTimeStamp, double aRawValue
 {
   // make sure logging is prepared
   prepareLogging();
-  // now actually log into file
+  // now queue sample for writing into file
   if (mLoggingReady && mLastRRDBupdate<aTimeStamp-10*Second) {
     mLastRRDBupdate = aTimeStamp;
-    ArgsVector args;
-    args.push_back("rrdupdate");
-    args.push_back(mRRDBfile);
-    string ud = mRRDBupdate;
-    // substitute values for placeholders
-    size_t i;
-    i = ud.find("%T");
-    if (i!=string::npos) ud.replace(i, 2, string_format("%lld", aTimeStamp/Second).c_str());
-    // - raw (considered unknown when sensor is invalid)
-    i = ud.find("%R");
-    if (i!=string::npos) ud.replace(i, 2, rrdval(aRawValue, mLastUpdate!=Never).c_str());
-    // - filtered (considered unknown when sensor is invalid)
-    i = ud.find("%F");
-    if (i!=string::npos) ud.replace(i, 2, rrdval(aProcessedValue, mLastUpdate!=Never).c_str());
-    // - pushed (considered unknown when never pushed, or last state pushed must have been NULL because of invalidation)
-    i = ud.find("%P");
-    if (i!=string::npos) ud.replace(i, 2, rrdval(aPushedValue, mLastPush!=Never && mLastUpdate!=Never).c_str());
-    args.push_back(ud);
-    int ret = rrd_call(rrd_update, args);
-    if (ret!=0) {
-      OLOG(LOG_WARNING, "rrd: could not update rrd data for file '%s': %s", mRRDBfile.c_str(), rrd_get_error());
-      mLoggingReady = false; // back to not initialized, might work again after recreating file
-    }
+    RrdLogWriter::sharedRrdLogWriter().queueSample(
+      mRRDBfile,
+      mRRDBupdate.expand(
+        (long)(MainLoop::mainLoopTimeToUnixTime(aTimeStamp)/Second),
+        aRawValue, aProcessedValue, aPushedValue,
+        mLastUpdate!=Never, // raw and filtered considered unknown when sensor is invalid
+        mLastPush!=Never && mLastUpdate!=Never // pushed considered unknown when never pushed, or last state pushed must have been NULL because of invalidation
+      )
+    );
   }
 }
 
@@ -868,7 +1391,13 @@ const char *SensorBehaviour::tableName()
   #define NON_RED_FP_FIELDS 3
 #endif
 
-static const size_t numFields = 3+RRDB_FIELDS+NON_RED_FP_FIELDS;
+#define HISTORY_FIELDS 0
+#if ENABLE_SENSOR_HISTORY
+  #undef HISTORY_FIELDS
+  #define HISTORY_FIELDS 1
+#endif
+
+static const size_t numFields = 3+RRDB_FIELDS+NON_RED_FP_FIELDS+HISTORY_FIELDS;
 
 size_t SensorBehaviour::numFieldDefs()
 {
@@ -891,6 +1420,9 @@ const FieldDefinition *SensorBehaviour::getFieldDef(size_t aIndex)
     { "sensorChannel", SQLITE_INTEGER },
     { "dialSync", SQLITE_INTEGER },
     #endif
+    #if ENABLE_SENSOR_HISTORY
+    { "history", SQLITE_INTEGER },
+    #endif
   };
   if (aIndex<inherited::numFieldDefs())
     return inherited::getFieldDef(aIndex);
@@ -920,6 +1452,11 @@ void SensorBehaviour::loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex,
   aRow->getCastedIfNotNull<DsChannelType, int>(aIndex++, mSensorChannel);
   aRow->getCastedIfNotNull<VdcDialSyncMode, int>(aIndex++, mDialSyncMode);
   #endif
+  #if ENABLE_SENSOR_HISTORY
+  bool h = false;
+  aRow->getCastedIfNotNull<bool, int>(aIndex++, h);
+  enableHistory(h);
+  #endif
 }
 
 
@@ -940,6 +1477,9 @@ void SensorBehaviour::bindToStatement(sqlite3pp::statement &aStatement, int &aIn
   aStatement.bind(aIndex++, mSensorChannel);
   aStatement.bind(aIndex++, mDialSyncMode);
   #endif
+  #if ENABLE_SENSOR_HISTORY
+  aStatement.bind(aIndex++, (int)mHistoryEnabled);
+  #endif
 }
 
 
@@ -1009,6 +1549,9 @@ enum {
   rrdbPath_key,
   rrdbConfig_key,
   #endif
+  #if ENABLE_SENSOR_HISTORY
+  history_key,
+  #endif
   numSettingsProperties
 };
 
@@ -1033,6 +1576,9 @@ const PropertyDescriptorPtr SensorBehaviour::getSettingsDescriptorByIndex(int aP
     { "x-p44-rrdFilePath", apivalue_string, rrdbPath_key+settings_key_offset, OKEY(sensor_key) },
     { "x-p44-rrdConfig", apivalue_string, rrdbConfig_key+settings_key_offset, OKEY(sensor_key) },
     #endif
+    #if ENABLE_SENSOR_HISTORY
+    { "x-p44-history", apivalue_bool, history_key+settings_key_offset, OKEY(sensor_key) },
+    #endif
   };
   return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
 }
@@ -1147,6 +1693,11 @@ bool SensorBehaviour::accessField(PropertyAccessMode aMode, ApiValuePtr aPropVal
           aPropValue->setStringValue(mRRDBconfig);
           return true;
         #endif
+        #if ENABLE_SENSOR_HISTORY
+        case history_key+settings_key_offset:
+          aPropValue->setBoolValue(mHistoryEnabled);
+          return true;
+        #endif
         // States properties
         case value_key+states_key_offset:
           // value
@@ -1211,17 +1762,26 @@ bool SensorBehaviour::accessField(PropertyAccessMode aMode, ApiValuePtr aPropVal
         #if ENABLE_RRDB
         case rrdbPath_key+settings_key_offset:
           if (setPVar(mRRDBpath, aPropValue->stringValue())) {
+            mLoggingReady = false;
             mRRDBfile.clear(); // force re-setup of rrdb logging
             prepareLogging();
           }
           return true;
         case rrdbConfig_key+settings_key_offset:
           if (setPVar(mRRDBconfig, aPropValue->stringValue())) {
+            mLoggingReady = false;
             mRRDBfile.clear(); // force re-setup of rrdb logging
             prepareLogging();
           }
           return true;
         #endif
+        #if ENABLE_SENSOR_HISTORY
+        case history_key+settings_key_offset:
+          if (setPVar(mHistoryEnabled, aPropValue->boolValue())) {
+            enableHistory(mHistoryEnabled);
+          }
+          return true;
+        #endif
       }
     }
   }
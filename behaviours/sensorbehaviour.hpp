@@ -29,6 +29,10 @@
 
 #include <math.h>
 
+#ifndef ENABLE_SENSOR_HISTORY
+  #define ENABLE_SENSOR_HISTORY 1
+#endif
+
 using namespace std;
 
 namespace p44 {
@@ -90,6 +94,247 @@ namespace p44 {
 
 
 
+  #if ENABLE_RRDB
+
+  typedef std::vector<string> RrdArgsVector;
+
+  /// what to do with new samples when the RRD logging queue is full
+  typedef enum {
+    rrdqueue_drop_oldest, ///< discard the oldest queued sample to make room for the new one (default)
+    rrdqueue_drop_newest, ///< discard the new sample, keep what is already queued
+  } RrdQueueDropPolicy;
+
+
+  /// precompiled rrdupdate argument template with %T, %R, %F and %P placeholders
+  /// @note a leading "N" (now) timestamp is converted into a %T placeholder, because samples are written
+  ///   delayed and in batches, so "now" at the time of writing would be wrong (and not unique within a batch)
+  class RrdUpdateTemplate
+  {
+    typedef struct {
+      char placeholder; ///< 0 for literal, 'T', 'R', 'F' or 'P' for value placeholders
+      string literal; ///< literal text
+    } Segment;
+    typedef std::vector<Segment> SegmentsVector;
+    SegmentsVector mSegments;
+
+  public:
+
+    /// compile update string
+    /// @param aUpdateString update string in rrdupdate syntax, with %T, %R, %F and %P placeholders
+    /// @return true if template contains at least one value
+    bool compile(const string aUpdateString);
+
+    /// @return true if template is empty (not compiled)
+    bool empty() const { return mSegments.empty(); };
+
+    /// clear template
+    void clear() { mSegments.clear(); };
+
+    /// generate update argument from template
+    /// @param aUnixTime unix time (seconds) of the sample
+    /// @param aRawValue, aProcessedValue, aPushedValue values for %R, %F and %P
+    /// @param aValid if not set, raw and processed value are rendered as unknown ("U")
+    /// @param aPushedValid if not set, pushed value is rendered as unknown ("U")
+    string expand(long aUnixTime, double aRawValue, double aProcessedValue, double aPushedValue, bool aValid, bool aPushedValid) const;
+  };
+
+
+  /// Background writer for RRD sensor logs
+  /// Sensor samples are queued here from the mainloop, and written in per-file batches by a separate thread
+  /// such that blocking disk I/O of rrd_update and rrd_create never affects the mainloop.
+  class RrdLogWriter : public P44Obj
+  {
+    typedef struct {
+      string file; ///< the rrd file
+      string update; ///< expanded update argument
+      MLMicroSeconds queuedAt; ///< when this sample was queued
+    } RrdSample;
+    typedef std::list<RrdSample> SampleQueue;
+
+    typedef struct {
+      RrdArgsVector createArgs; ///< rrdcreate arguments to use when file does not exist
+      bool checked; ///< set when file is known to exist or has been created
+      bool failed; ///< set when file could not be created, samples are discarded
+    } RrdFileInfo;
+    typedef std::map<string, RrdFileInfo> RrdFilesMap;
+
+    // shared between mainloop and writer thread, protected by mQueueAccess
+    pthread_mutex_t mQueueAccess;
+    SampleQueue mQueue; ///< queued samples, oldest first
+    RrdFilesMap mFiles; ///< known rrd files
+    size_t mMaxQueuedSamples; ///< queue size limit
+    RrdQueueDropPolicy mDropPolicy; ///< what to do when queue is full
+    MLMicroSeconds mMaxBatchDelay; ///< how long samples may wait in the queue to be batched with others
+
+    // only one thread may call into librrd at a time (uses getopt() and global error state)
+    pthread_mutex_t mRrdAccess;
+
+    ChildThreadWrapperPtr mWriterThread;
+
+    // statistics (protected by mQueueAccess)
+    uint64_t mSamplesQueued; ///< total number of samples queued
+    uint64_t mSamplesWritten; ///< total number of samples successfully written
+    uint64_t mSamplesDropped; ///< total number of samples discarded because of full queue
+    uint64_t mSamplesFailed; ///< total number of samples that could not be written
+    uint64_t mUpdateCalls; ///< number of rrd_update calls
+    size_t mMaxQueueDepth; ///< max queue depth seen
+    MLMicroSeconds mMaxQueueLatency; ///< max time a sample was waiting in the queue before being written
+    MLMicroSeconds mLastFlushTime; ///< time needed for last flush run
+    MLMicroSeconds mMaxFlushTime; ///< max time needed for a flush run
+
+    RrdLogWriter();
+    virtual ~RrdLogWriter();
+
+  public:
+
+    /// @return the shared RRD log writer
+    static RrdLogWriter& sharedRrdLogWriter();
+
+    /// configure queueing
+    /// @param aMaxQueuedSamples max number of samples in the queue. When exceeded, samples are dropped according to aDropPolicy
+    /// @param aDropPolicy what samples to drop on overload
+    /// @param aMaxBatchDelay max time samples are held back for being written together with others in one rrd_update call
+    void setQueueParams(size_t aMaxQueuedSamples, RrdQueueDropPolicy aDropPolicy, MLMicroSeconds aMaxBatchDelay);
+
+    /// register a rrd file to be written to
+    /// @param aRrdFile the rrd file path
+    /// @param aCreateArgs the full rrdcreate argument list to use when the file does not exist (yet)
+    /// @note (re-)registering a file causes it to be checked for existence before next write
+    void registerFile(const string aRrdFile, const RrdArgsVector &aCreateArgs);
+
+    /// queue a sample for writing
+    /// @param aRrdFile the rrd file path (must be registered before)
+    /// @param aUpdate the update argument (fully expanded, with explicit timestamp)
+    void queueSample(const string aRrdFile, const string aUpdate);
+
+    /// write out all queued samples now (synchronously)
+    void flush();
+
+    /// get statistics
+    /// @param aStats object type API value to receive statistics fields
+    void getStatistics(ApiValuePtr aStats);
+
+    /// @return one-line statistics summary for logging
+    string statisticsText();
+
+  private:
+
+    void writerThread(ChildThreadWrapper &aThread);
+    bool needsFlush(MLMicroSeconds aNow);
+    bool ensureFile(const string &aRrdFile, RrdFileInfo &aFileInfo);
+
+  };
+
+  #endif // ENABLE_RRDB
+
+
+  #if ENABLE_SENSOR_HISTORY
+
+  /// how to aggregate sensor history values
+  typedef enum {
+    history_avg, ///< average of filtered values
+    history_min, ///< minimum of filtered values
+    history_max, ///< maximum of filtered values
+    history_raw, ///< raw hardware values (only available for the most recent samples)
+  } HistoryAggregation;
+
+  /// Fixed-memory, columnar in-memory history of sensor values
+  /// - the most recent samples are kept as-is (raw and filtered value)
+  /// - several tiers of downsampled buckets keep min/max/avg of the filtered value
+  ///   for increasingly longer periods of time
+  /// @note all memory is allocated at creation, adding samples never allocates
+  class SensorHistory : public P44Obj
+  {
+    typedef std::vector<uint32_t> TimeColumn; ///< time in HISTORY_TIME_UNITs relative to mBaseTime
+    typedef std::vector<float> ValueColumn;
+    typedef std::vector<uint16_t> CountColumn;
+
+    MLMicroSeconds mBaseTime; ///< reference time for the compact time columns
+
+    // most recent samples
+    size_t mNextSample; ///< ring buffer index of the next sample to write
+    size_t mNumSamples; ///< number of valid samples
+    TimeColumn mSampleTimes;
+    ValueColumn mRawValues;
+    ValueColumn mFilteredValues;
+
+    // downsampled tiers
+    class Tier
+    {
+    public:
+      MLMicroSeconds mInterval; ///< the bucket time interval
+      size_t mNextBucket; ///< ring buffer index of next bucket to write
+      size_t mNumBuckets; ///< number of valid buckets
+      TimeColumn mTimes; ///< start time of the bucket
+      ValueColumn mMins;
+      ValueColumn mMaxs;
+      ValueColumn mAvgs;
+      CountColumn mCounts;
+      // the bucket currently accumulating
+      MLMicroSeconds mBucketStart; ///< start of the current bucket, Never if none
+      double mBucketMin;
+      double mBucketMax;
+      double mBucketSum;
+      uint32_t mBucketCount;
+
+      Tier(MLMicroSeconds aInterval, size_t aSize);
+    };
+    typedef std::vector<Tier> TiersVector;
+    TiersVector mTiers;
+
+  public:
+
+    /// a single history entry or aggregated bucket
+    typedef struct {
+      MLMicroSeconds time; ///< start of the entry
+      double min;
+      double max;
+      double sum;
+      uint32_t count;
+    } Entry;
+    typedef std::vector<Entry> EntriesVector;
+
+    SensorHistory();
+
+    /// add a sample
+    /// @param aTimeStamp the mainloop time of the sample
+    /// @param aRawValue the value as reported by hardware
+    /// @param aFilteredValue the value as processed by the sensor filter (same as raw if no filter)
+    void addSample(MLMicroSeconds aTimeStamp, double aRawValue, double aFilteredValue);
+
+    /// query the history
+    /// @param aEntries will receive the entries found, in chronological order
+    /// @param aFrom mainloop time of the beginning of the range to query
+    /// @param aTo mainloop time of the end of the range to query
+    /// @param aAggregation how to aggregate (only relevant for getting raw values)
+    /// @param aInterval if>0, entries are aggregated into buckets of this size (starting at aFrom),
+    ///   otherwise, entries are returned in the best resolution that covers the requested range
+    /// @return the time resolution of the data source used (0 for individual samples)
+    MLMicroSeconds query(EntriesVector &aEntries, MLMicroSeconds aFrom, MLMicroSeconds aTo, HistoryAggregation aAggregation, MLMicroSeconds aInterval);
+
+    /// query the history and return the result as columnar API value
+    /// @param aResult object type API value to receive "resolution", "times" and "values" fields
+    /// @param aFrom, aTo, aAggregation, aInterval see query()
+    void queryToApiValue(ApiValuePtr aResult, MLMicroSeconds aFrom, MLMicroSeconds aTo, HistoryAggregation aAggregation, MLMicroSeconds aInterval);
+
+    /// @return approximate memory used by this history
+    size_t memoryUsage();
+
+    /// @param aText aggregation name ("avg", "min", "max" or "raw")
+    /// @return aggregation mode, history_avg for unknown names
+    static HistoryAggregation aggregationFromText(const string aText);
+
+  private:
+
+    uint32_t compactTime(MLMicroSeconds aTime) const;
+    MLMicroSeconds expandTime(uint32_t aCompactTime) const;
+
+  };
+  typedef boost::intrusive_ptr<SensorHistory> SensorHistoryPtr;
+
+  #endif // ENABLE_SENSOR_HISTORY
+
+
   /// Implements the behaviour of a Digital Strom Sensor. In particular it manages and throttles
   /// pushing updates to the dS upstream, to avoid jitter in hardware reported values to flood
   /// the system with unneded update messages
@@ -140,6 +385,9 @@ namespace p44 {
     string mRRDBpath; ///< the rrd path to log into. If it does not start with a slash, it is considered relative to Application::dataPath(). If it ends with a slash, the rrd file name is autogenerated as a unique sensor id
     string mRRDBconfig; ///< the rrd config for creating a rrdb file to log sensor data into
     #endif
+    #if ENABLE_SENSOR_HISTORY
+    bool mHistoryEnabled; ///< if set, sensor values are kept in a in-memory history
+    #endif
     /// @}
 
 
@@ -159,7 +407,10 @@ namespace p44 {
     bool mLoggingReady; ///< if set, logging is ready
     MLMicroSeconds mLastRRDBupdate; ///< set when rrd was last updated
     string mRRDBfile; ///< if set, this is a currently active and initialized rrd database file and can be written to
-    string mRRDBupdate; ///< the update string with %R, %F and %P placeholders for raw, filtered and pushed values
+    RrdUpdateTemplate mRRDBupdate; ///< the precompiled update template with %T, %R, %F and %P placeholders for time, raw, filtered and pushed values
+    #endif
+    #if ENABLE_SENSOR_HISTORY
+    SensorHistoryPtr mHistory; ///< in-memory history, if enabled
     #endif
     /// @}
 
@@ -296,6 +547,15 @@ namespace p44 {
 
     /// @}
 
+    #if ENABLE_SENSOR_HISTORY
+    /// enable or disable in-memory history
+    /// @param aEnable if set, history is enabled (and allocated), otherwise history is disabled and freed
+    void enableHistory(bool aEnable);
+
+    /// @return the in-memory history, NULL if none
+    SensorHistoryPtr getHistory() { return mHistory; };
+    #endif
+
     /// check if we have a recent value
     /// @param aMaxAge how old a value we consider still "valid"
     /// @return true if the sensor has a value not older than aMaxAge
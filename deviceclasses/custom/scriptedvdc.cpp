@@ -162,7 +162,15 @@ ScriptObjPtr ScriptedDeviceImplementation::runScriptCommand(ScriptCommand aScrip
       SOLOG(mScriptedDevice, LOG_NOTICE, "(Re-)starting device implementation script");
       mRestartTicket.cancel();
       mContext->clearVars(); // clear vars and (especially) context local handlers
-      ret = mScript.run(stopall, boost::bind(&ScriptedDeviceImplementation::implementationEnds, this, _1), ScriptObjPtr(), Infinite);
+      sourceChanged(); // source might have been edited elsewhere (e.g. in the IDE), make sure we have the current statistics
+      {
+        MLMicroSeconds startedAt = MainLoop::now();
+        ret = mScript.run(stopall, boost::bind(&ScriptedDeviceImplementation::implementationEnds, this, _1), ScriptObjPtr(), Infinite);
+        MLMicroSeconds startup = MainLoop::now()-startedAt;
+        mImplInfo->mStarts++;
+        mImplInfo->mStartupTime += startup;
+        if (startup>mImplInfo->mMaxStartupTime) mImplInfo->mMaxStartupTime = startup;
+      }
       break;
     case P44Script::stop:
       SOLOG(mScriptedDevice, LOG_NOTICE, "Stopping device implementation script");
@@ -211,6 +219,27 @@ void ScriptedDeviceImplementation::restartImplementation()
 }
 
 
+void ScriptedDeviceImplementation::sourceChanged()
+{
+  string src = mScript.getSource();
+  if (mImplInfo && mImplInfo->mHash==ScriptedImplementationInfo::sourceHash(src)) return; // still same implementation
+  mImplInfo = mScriptedDevice.getScriptedVdc().implementationInfoFor(src);
+}
+
+
+ScriptObjPtr ScriptedDeviceImplementation::syntaxcheck()
+{
+  sourceChanged(); // source might have been edited elsewhere (e.g. in the IDE)
+  // Note: always check this device's own script, so error positions refer to its source
+  MLMicroSeconds startedAt = MainLoop::now();
+  ScriptObjPtr res = mScript.syntaxcheck();
+  mImplInfo->mCheckTime = MainLoop::now()-startedAt;
+  mImplInfo->mChecks++;
+  mImplInfo->mCheckError = res && res->isErr() ? res->errorValue()->getErrorMessage() : "";
+  return res;
+}
+
+
 
 ErrorPtr ScriptedDevice::sendDeviceMesssage(JsonObjectPtr aMessage)
 {
@@ -270,7 +299,7 @@ ErrorPtr ScriptedDevice::handleMethod(VdcApiRequestPtr aRequest, const string &a
   }
   if (aMethod=="x-p44-checkImpl") {
     // check the implementation script for syntax errors (but do not re-start it)
-    ScriptObjPtr res = mImplementation.mScript.syntaxcheck();
+    ScriptObjPtr res = mImplementation.syntaxcheck();
     ApiValuePtr checkResult = aRequest->newApiValue();
     checkResult->setType(apivalue_object);
     if (!res || !res->isErr()) {
@@ -343,6 +372,7 @@ enum {
   initmessage_key,
   implementation_key,
   implementationId_key,
+  implementationHash_key,
   numProperties
 };
 
@@ -367,6 +397,7 @@ PropertyDescriptorPtr ScriptedDevice::getDescriptorByIndex(int aPropIndex, int a
     { "x-p44-initmessage", apivalue_string, initmessage_key, OKEY(scriptedDevice_key) },
     { "x-p44-implementation", apivalue_string, implementation_key, OKEY(scriptedDevice_key) },
     { "x-p44-implementationId", apivalue_string, implementationId_key, OKEY(scriptedDevice_key) },
+    { "x-p44-implementationHash", apivalue_string, implementationHash_key, OKEY(scriptedDevice_key) },
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level - accessing properties on the Device level
@@ -393,6 +424,11 @@ bool ScriptedDevice::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValu
         case initmessage_key: aPropValue->setStringValue(mInitMessageText); return true;
         case implementation_key: aPropValue->setStringValue(mImplementation.mScript.getSource()); return true;
         case implementationId_key: aPropValue->setStringValue(mImplementation.mScript.getSourceUid()); return true;
+        case implementationHash_key:
+          mImplementation.sourceChanged(); // make sure hash reflects current source
+          if (!mImplementation.mImplInfo) return false;
+          aPropValue->setStringValue(mImplementation.mImplInfo->hashString());
+          return true;
       }
     }
     else {
@@ -401,6 +437,8 @@ bool ScriptedDevice::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValu
         case implementation_key:
           if (mImplementation.mScript.setAndStoreSource(aPropValue->stringValue())) {
             mImplementation.markDirty();
+            mImplementation.sourceChanged();
+            getScriptedVdc().pruneImplementations();
           }
           return true;
       }
@@ -463,6 +501,7 @@ void ScriptedDeviceImplementation::loadFromRow(sqlite3pp::query::iterator &aRow,
   inherited::loadFromRow(aRow, aIndex, aCommonFlagsP);
   // get the field values
   mScript.loadSource(nonNullCStr(aRow->get<const char *>(aIndex++)));
+  sourceChanged();
 }
 
 
@@ -474,6 +513,34 @@ void ScriptedDeviceImplementation::bindToStatement(sqlite3pp::statement &aStatem
 }
 
 
+// MARK: - ScriptedImplementationInfo
+
+ScriptedImplementationInfo::ScriptedImplementationInfo(uint64_t aHash, size_t aSourceSize) :
+  mHash(aHash),
+  mSourceSize(aSourceSize),
+  mChecks(0),
+  mCheckTime(0),
+  mStarts(0),
+  mStartupTime(0),
+  mMaxStartupTime(0)
+{
+}
+
+
+string ScriptedImplementationInfo::hashString() const
+{
+  return string_format("%016llX", (unsigned long long)mHash);
+}
+
+
+uint64_t ScriptedImplementationInfo::sourceHash(const string &aSource)
+{
+  Fnv64 hash;
+  hash.addBytes(aSource.size(), (uint8_t *)aSource.c_str());
+  return hash.getHash();
+}
+
+
 // MARK: - ScriptedDevicePersistence
 
 
@@ -547,6 +614,79 @@ void ScriptedVdc::identifyToUser(MLMicroSeconds aDuration)
 
 
 
+ScriptedImplementationInfoPtr ScriptedVdc::implementationInfoFor(const string &aSource)
+{
+  uint64_t h = ScriptedImplementationInfo::sourceHash(aSource);
+  ScriptedImplementationInfosMap::iterator pos = mImplementations.find(h);
+  if (pos!=mImplementations.end()) return pos->second;
+  ScriptedImplementationInfoPtr impl = new ScriptedImplementationInfo(h, aSource.size());
+  mImplementations[h] = impl;
+  OLOG(LOG_INFO, "new distinct implementation script %s (%zu bytes)", impl->hashString().c_str(), impl->mSourceSize);
+  return impl;
+}
+
+
+void ScriptedVdc::pruneImplementations()
+{
+  std::set<uint64_t> used;
+  for (DeviceVector::iterator pos = mDevices.begin(); pos!=mDevices.end(); ++pos) {
+    ScriptedDevicePtr dev = boost::dynamic_pointer_cast<ScriptedDevice>(*pos);
+    if (dev && dev->mImplementation.mImplInfo) used.insert(dev->mImplementation.mImplInfo->mHash);
+  }
+  for (ScriptedImplementationInfosMap::iterator pos = mImplementations.begin(); pos!=mImplementations.end();) {
+    if (used.find(pos->first)==used.end()) {
+      mImplementations.erase(pos++);
+    }
+    else {
+      ++pos;
+    }
+  }
+}
+
+
+ApiValuePtr ScriptedVdc::implementationsInfo(VdcApiRequestPtr aRequest)
+{
+  pruneImplementations();
+  ApiValuePtr res = aRequest->newApiValue();
+  res->setType(apivalue_object);
+  ApiValuePtr impls = res->newObject();
+  size_t totalSource = 0;
+  size_t distinctSource = 0;
+  for (ScriptedImplementationInfosMap::iterator ipos = mImplementations.begin(); ipos!=mImplementations.end(); ++ipos) {
+    ScriptedImplementationInfoPtr impl = ipos->second;
+    ApiValuePtr i = impls->newObject();
+    ApiValuePtr devs = i->newArray();
+    for (DeviceVector::iterator pos = mDevices.begin(); pos!=mDevices.end(); ++pos) {
+      ScriptedDevicePtr dev = boost::dynamic_pointer_cast<ScriptedDevice>(*pos);
+      if (dev && dev->mImplementation.mImplInfo==impl) {
+        devs->arrayAppend(devs->newBinary(dev->getDsUid().getBinary()));
+        totalSource += impl->mSourceSize;
+      }
+    }
+    i->add("devices", devs);
+    i->add("sourceSize", i->newUint64(impl->mSourceSize));
+    if (impl->mChecks>0) {
+      i->add("checks", i->newInt64(impl->mChecks));
+      i->add("checkTime", i->newDouble((double)impl->mCheckTime/Second));
+      if (!impl->mCheckError.empty()) {
+        i->add("error", i->newString(impl->mCheckError));
+      }
+    }
+    i->add("starts", i->newInt64(impl->mStarts));
+    if (impl->mStarts>0) {
+      i->add("avgStartupTime", i->newDouble((double)impl->mStartupTime/impl->mStarts/Second));
+      i->add("maxStartupTime", i->newDouble((double)impl->mMaxStartupTime/Second));
+    }
+    impls->add(impl->hashString(), i);
+    distinctSource += impl->mSourceSize;
+  }
+  res->add("implementations", impls);
+  res->add("distinctSourceSize", res->newUint64(distinctSource));
+  res->add("totalSourceSize", res->newUint64(totalSource));
+  return res;
+}
+
+
 ScriptedDevicePtr ScriptedVdc::addScriptedDevice(const string aScptDevId, JsonObjectPtr aInitObj, ErrorPtr &aErr)
 {
   ScriptedDevicePtr newDev;
@@ -660,6 +800,10 @@ ErrorPtr ScriptedVdc::handleMethod(VdcApiRequestPtr aRequest, const string &aMet
       }
     }
   }
+  else if (aMethod=="x-p44-implementations") {
+    // list the distinct implementation scripts in use, with statistics
+    aRequest->sendResult(implementationsInfo(aRequest));
+  }
   else {
     respErr = inherited::handleMethod(aRequest, aMethod, aParams);
   }
@@ -39,6 +39,42 @@ namespace p44 {
   class ScriptedDevice;
 
 
+  class ScriptedImplementationInfo;
+  typedef boost::intrusive_ptr<ScriptedImplementationInfo> ScriptedImplementationInfoPtr;
+
+  /// statistics about a distinct implementation script, identified by the hash of its source text.
+  /// All scripted devices with identical implementation source refer to the same instance.
+  /// @note each device still has and compiles its own copy of the source (p44script binds compiled code
+  ///   and error positions to the device's own script), this only collects check and startup statistics.
+  class ScriptedImplementationInfo : public P44Obj
+  {
+    friend class ScriptedVdc;
+    friend class ScriptedDeviceImplementation;
+
+    uint64_t mHash; ///< FNV64 hash of the source text
+    size_t mSourceSize; ///< size of the source text in bytes
+    long mChecks; ///< number of syntax checks of devices using this implementation
+    MLMicroSeconds mCheckTime; ///< time needed for the last syntax check (compile) of the source
+    string mCheckError; ///< error message of the last syntax check, empty if none
+    long mStarts; ///< number of (re)starts of devices using this implementation
+    MLMicroSeconds mStartupTime; ///< accumulated time spent in the synchronous part of starting the implementation
+    MLMicroSeconds mMaxStartupTime; ///< max time spent in a single start
+
+  public:
+
+    ScriptedImplementationInfo(uint64_t aHash, size_t aSourceSize);
+
+    /// @return the hash of the source text as hex string
+    string hashString() const;
+
+    /// @param aSource the source text
+    /// @return hash identifying aSource
+    static uint64_t sourceHash(const string &aSource);
+
+  };
+  typedef std::map<uint64_t, ScriptedImplementationInfoPtr> ScriptedImplementationInfosMap;
+
+
   /// class for independent persistence of implementation details
   /// @note cannot be in DeviceSettings, because these are behaviour-related, not
   ///    implementation related
@@ -46,10 +82,12 @@ namespace p44 {
   {
     typedef PersistentParams inherited;
     friend class ScriptedDevice;
+    friend class ScriptedVdc;
 
     ScriptedDevice &mScriptedDevice; ///< the related scripted device
     ScriptHost mScript; ///< the (p44script) device implementation
     ScriptMainContextPtr mContext; ///< context for implementation script
+    ScriptedImplementationInfoPtr mImplInfo; ///< the statistics for this implementation's source text
     MLTicket mRestartTicket; ///< the implementation
 
   protected:
@@ -68,6 +106,8 @@ namespace p44 {
     ScriptObjPtr runScriptCommand(ScriptCommand aScriptCommand);
     void implementationEnds(ScriptObjPtr aResult);
     void restartImplementation();
+    void sourceChanged();
+    ScriptObjPtr syntaxcheck();
 
   };
 
@@ -196,6 +236,7 @@ namespace p44 {
     friend class ScriptedDevice;
 
     ScriptedDevicePersistence mDb;
+    ScriptedImplementationInfosMap mImplementations; ///< distinct implementation scripts, by source hash
 
   public:
     ScriptedVdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag);
@@ -228,6 +269,17 @@ namespace p44 {
 
     ScriptedDevicePtr addScriptedDevice(const string aScptDevId, JsonObjectPtr aInitObj, ErrorPtr &aErr);
 
+    /// get the implementation statistics for a given source text
+    /// @param aSource the implementation source text
+    /// @return the implementation statistics, newly created if no other device uses the same source yet
+    ScriptedImplementationInfoPtr implementationInfoFor(const string &aSource);
+
+    /// forget implementation statistics no longer used by any device
+    void pruneImplementations();
+
+    /// @return API result listing all distinct implementations with their statistics
+    ApiValuePtr implementationsInfo(VdcApiRequestPtr aRequest);
+
   };
 
 } // namespace p44
@@ -28,9 +28,14 @@
 #define FOCUSLOGLEVEL 7
 
 #include "dalicomm.hpp"
+#include "metrics.hpp"
 
 #if ENABLE_DALI
 
+#if ENABLE_DALI_SIMULATOR
+  #include "dalisimulator.hpp"
+#endif
+
 using namespace p44;
 
 #if P44_BUILD_DIGI
@@ -52,6 +57,7 @@ DaliComm::DaliComm(MainLoop &aMainLoop) :
   mDali2LUNLock(false),
   mRetriedReads(0),
   mRetriedWrites(0),
+  mSentFrames(0),
   mCloseAfterIdleTime(Never),
   mResponsesInSequence(false),
   mExpectedBridgeResponses(0),
@@ -137,13 +143,34 @@ static const char *bridgeAckText(uint8_t aResp1, uint8_t aResp2)
 
 void DaliComm::setConnectionSpecification(const char *aConnectionSpec, uint16_t aDefaultPort, MLMicroSeconds aCloseAfterIdleTime)
 {
+  #if ENABLE_DALI_SIMULATOR
+  if (strncmp(aConnectionSpec, "sim:", 4)==0) {
+    // simulated bridge and bus
+    setSimulator(DaliBusSimulatorPtr(new DaliBusSimulator(aConnectionSpec+4)));
+    return;
+  }
+  #endif
   mCloseAfterIdleTime = aCloseAfterIdleTime;
   mSerialComm->setConnectionSpecification(aConnectionSpec, aDefaultPort, DALIBRIDGE_COMMPARAMS);
 }
 
 
-void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, SerialOperationReceivePtr aOperation, ErrorPtr aError)
+#if ENABLE_DALI_SIMULATOR
+
+void DaliComm::setSimulator(DaliBusSimulatorPtr aSimulator)
 {
+  mSimulator = aSimulator;
+  if (mSimulator) {
+    OLOG(LOG_WARNING, "Using SIMULATED DALI bridge: %s", mSimulator->description().c_str());
+  }
+}
+
+#endif // ENABLE_DALI_SIMULATOR
+
+
+void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, SerialOperationReceivePtr aOperation, MLMicroSeconds aQueuedAt, ErrorPtr aError)
+{
+  METRICS_RECORD("dali_bridge_command_seconds", MainLoop::now()-aQueuedAt);
   // check for operation timeout
   if (Error::isError(aError, OQError::domain(), OQError::TimedOut)) {
     // receive operation (answer from bridge, not from DALI!) has timed out
@@ -152,6 +179,7 @@ void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, Se
     // otherwise, treat like having received an answer (count it, to avoid stalls)
   }
   if (mExpectedBridgeResponses>0) mExpectedBridgeResponses--;
+  METRICS_GAUGE("dali_pending_bridge_responses", mExpectedBridgeResponses);
   if (mExpectedBridgeResponses<BUFFERED_BRIDGE_RESPONSES_LOW) {
     mResponsesInSequence = false; // allow buffered sends without waiting for answers again
   }
@@ -189,6 +217,17 @@ void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, Se
 
 void DaliComm::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, DaliBridgeResultCB aResultCB, int aWithDelay)
 {
+  // count bus frames
+  if (aCmd==CMD_CODE_2SEND16) mSentFrames += 2;
+  else if (aCmd==CMD_CODE_SEND16 || aCmd==CMD_CODE_SEND16_REC8) mSentFrames++;
+  METRICS_COUNT("dali_bridge_commands_total");
+  #if ENABLE_DALI_SIMULATOR
+  if (mSimulator) {
+    FOCUSOLOG("simulated bridge command:  %s (%02X)      %02X %02X", bridgeCmdName(aCmd), aCmd, aDali1, aDali2);
+    mSimulator->sendBridgeCommand(aCmd, aDali1, aDali2, aResultCB, aWithDelay);
+    return;
+  }
+  #endif
   // reset connection closing timeout
   mConnectionTimeoutTicket.cancel();
   if (mCloseAfterIdleTime!=Never) {
@@ -212,6 +251,7 @@ void DaliComm::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, D
   SerialOperationReceivePtr recOp = SerialOperationReceivePtr(new SerialOperationReceive);
   recOp->setExpectedBytes(2); // expected 2 response bytes
   mExpectedBridgeResponses++;
+  METRICS_GAUGE("dali_pending_bridge_responses", mExpectedBridgeResponses);
   if (aWithDelay>0) {
     // delayed sends must always be in sequence (always leave recOp->inSequence at its default, true)
     sendOp->setInitiationDelay(aWithDelay);
@@ -228,7 +268,7 @@ void DaliComm::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, D
   recOp->setTimeout(120*Second); // large timeout, because it can really take time until all expected answers are received, or DEH2 network/serial load might disturb timing for a longer while
   // set callback
   // - for recOp to obtain result or get error
-  recOp->setCompletionCallback(boost::bind(&DaliComm::bridgeResponseHandler, this, aResultCB, recOp, _1));
+  recOp->setCompletionCallback(boost::bind(&DaliComm::bridgeResponseHandler, this, aResultCB, recOp, MainLoop::now(), _1));
   // chain response op
   sendOp->setChainedOperation(recOp);
   // queue op
@@ -32,6 +32,10 @@
 
 #include "dalidefs.h"
 
+#ifndef ENABLE_DALI_SIMULATOR
+  #define ENABLE_DALI_SIMULATOR 0 // simulated DALI bus and x-p44-daliBenchmark, for testing only
+#endif
+
 
 using namespace std;
 
@@ -148,6 +152,11 @@ namespace p44 {
 
   class DaliComm;
 
+  #if ENABLE_DALI_SIMULATOR
+  class DaliBusSimulator;
+  typedef boost::intrusive_ptr<DaliBusSimulator> DaliBusSimulatorPtr;
+  #endif
+
 
   /// abstracted DALI bus address
   typedef uint8_t DaliAddress;
@@ -246,11 +255,16 @@ namespace p44 {
 
     DaliBridgeEventCB mBridgeEventHandler; ///< will be called for bridge events
 
+    #if ENABLE_DALI_SIMULATOR
+    DaliBusSimulatorPtr mSimulator; ///< if set, bridge commands are processed by this simulator instead of a real bridge
+    #endif
+
   public:
 
     // statistics
     long mRetriedReads;
     long mRetriedWrites;
+    long mSentFrames; ///< number of DALI forward frames sent (or queued for sending) on the bus
 
     bool mDali2ScanLock; ///< if set, scanner will interpret memory bank 0 as DALI 1.0 (because there is no real backwards compatibility between 1.0 and 2.0)
     bool mDali2LUNLock; ///< if set, logical unit index will not be used as dSUID subdeviceindex, and old dSUID mix algrorithm (w/o added FNV) will be used
@@ -268,11 +282,21 @@ namespace p44 {
     /// @{
 
     /// set the connection parameters to connect to the DALI bridge
-    /// @param aConnectionSpec serial device path (/dev/...) or host name/address[:port] (1.2.3.4 or xxx.yy)
+    /// @param aConnectionSpec serial device path (/dev/...) or host name/address[:port] (1.2.3.4 or xxx.yy),
+    ///   or `sim:<config>` to use a simulated bridge and bus (see DaliBusSimulator for config)
     /// @param aDefaultPort default port number for TCP connection (irrelevant for direct serial device connection)
     /// @param aCloseAfterIdleTime if not Never, serial port will be closed after being idle for the specified time
     void setConnectionSpecification(const char *aConnectionSpec, uint16_t aDefaultPort, MLMicroSeconds aCloseAfterIdleTime);
 
+    #if ENABLE_DALI_SIMULATOR
+    /// use a simulated DALI bridge and bus
+    /// @param aSimulator the simulator to process all bridge commands, NULL to use the real bridge again
+    void setSimulator(DaliBusSimulatorPtr aSimulator);
+
+    /// @return the simulator in use, NULL if none
+    DaliBusSimulatorPtr simulator() { return mSimulator; };
+    #endif
+
     /// accept extra bytes to resynchronize bridge
     virtual ssize_t acceptExtraBytes(size_t aNumBytes, uint8_t *aBytes) P44_OVERRIDE;
 
@@ -496,7 +520,7 @@ namespace p44 {
     void msbOf16BitQueryReceived(DaliAddress aAddress, Dali16BitValueQueryResultCB aResult16CB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
     void lsbOf16BitQueryReceived(uint16_t aResult16, Dali16BitValueQueryResultCB aResult16CB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
 
-    void bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, SerialOperationReceivePtr aOperation, ErrorPtr aError);
+    void bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, SerialOperationReceivePtr aOperation, MLMicroSeconds aQueuedAt, ErrorPtr aError);
     void daliCommandStatusHandler(DaliCommandStatusCB aResultCB, uint8_t aResp1, uint8_t aResp2, ErrorPtr aError);
     void daliQueryResponseHandler(DaliQueryResultCB aResultCB, uint8_t aResp1, uint8_t aResp2, ErrorPtr aError);
     void connectionTimeout();
@@ -65,6 +65,13 @@ DaliBusDevice::DaliBusDevice(DaliVdc &aDaliVdc) :
   mSupportsDT8(false),
   mDT8Color(false),
   mDT8CT(false),
+  mDT8PrimaryColors(0),
+  mDT8RGBWAFchannels(0),
+  mDT8AutoActivation(false),
+  mProbedDeviceType(-1),
+  mDT8FeaturesByte(0),
+  mDT8GearStatusByte(0),
+  mBypassProbeCache(false),
   mCurrentColorMode(colorLightModeNone),
   mCurrentXorCT(0),
   mCurrentY(0),
@@ -269,6 +276,16 @@ void DaliBusDevice::deviceTypeResponse(StatusCB aCompletedCB, bool aNoOrTimeout,
 {
   // device type query response.
   if (Error::isOK(aError) && !aNoOrTimeout) {
+    mProbedDeviceType = aResponse;
+    if (!mBypassProbeCache) {
+      // device type answer and dSUID form the fingerprint for using persisted probe results
+      DaliProbeInfo probeInfo;
+      if (mDaliVdc.getProbeInfo(mDeviceInfo->mShortAddress, mDSUID, aResponse, probeInfo)) {
+        applyProbeInfo(probeInfo);
+        if (aCompletedCB) aCompletedCB(ErrorPtr());
+        return;
+      }
+    }
     // special case is 0xFF, which means device supports multiple types
     if (aResponse==0xFF) {
       // need to query all possible types
@@ -279,6 +296,8 @@ void DaliBusDevice::deviceTypeResponse(StatusCB aCompletedCB, bool aNoOrTimeout,
     probeDeviceType(aCompletedCB, aResponse, nullptr);
     return;
   }
+  // no reliable answer, do not persist anything
+  mProbedDeviceType = -1;
   // done with device type, check groups now
   queryDTFeatures(aCompletedCB);
 }
@@ -326,7 +345,7 @@ void DaliBusDevice::queryDTFeatures(StatusCB aCompletedCB)
     );
     return;
   }
-  if (aCompletedCB) aCompletedCB(ErrorPtr());
+  featuresProbed(aCompletedCB, ErrorPtr());
 }
 
 
@@ -335,10 +354,7 @@ void DaliBusDevice::dt8FeaturesResponse(StatusCB aCompletedCB, bool aNoOrTimeout
   // extended version type query response.
   if (Error::isOK(aError) && !aNoOrTimeout) {
     // DT8 features response
-    mDT8Color = (aResponse & 0x01)!=0; // x/y color model capable
-    mDT8CT = (aResponse & 0x02)!=0; // mired color temperature capable
-    mDT8PrimaryColors = (aResponse>>2) & 0x07; // bits 2..4 is the number of primary color channels available
-    mDT8RGBWAFchannels = (aResponse>>5) & 0x07; // bits 5..7 is the number of RGBWAF channels available
+    setDT8Features(aResponse);
     OLOG(LOG_INFO, "DT8 features byte = 0x%02X", aResponse);
     mDaliVdc.mDaliComm.daliSendQuery(
       mDeviceInfo->mShortAddress,
@@ -347,7 +363,8 @@ void DaliBusDevice::dt8FeaturesResponse(StatusCB aCompletedCB, bool aNoOrTimeout
     );
     return;
   }
-  if (aCompletedCB) aCompletedCB(aError);
+  mProbedDeviceType = -1; // incomplete, do not persist
+  featuresProbed(aCompletedCB, aError);
 }
 
 
@@ -356,9 +373,54 @@ void DaliBusDevice::dt8GearStatusResponse(StatusCB aCompletedCB, bool aNoOrTimeo
   // extended version type query response.
   if (Error::isOK(aError) && !aNoOrTimeout) {
     // DT8 gear status response
+    mDT8GearStatusByte = aResponse;
     mDT8AutoActivation = (aResponse & 0x01)!=0;
     OLOG(LOG_INFO, "DT8 has auto-activation on DAPC %sABLED", mDT8AutoActivation ? "EN" : "DIS");
   }
+  else {
+    mProbedDeviceType = -1; // incomplete, do not persist
+  }
+  featuresProbed(aCompletedCB, aError);
+}
+
+
+void DaliBusDevice::setDT8Features(uint8_t aDT8Features)
+{
+  mDT8FeaturesByte = aDT8Features;
+  mDT8Color = (aDT8Features & 0x01)!=0; // x/y color model capable
+  mDT8CT = (aDT8Features & 0x02)!=0; // mired color temperature capable
+  mDT8PrimaryColors = (aDT8Features>>2) & 0x07; // bits 2..4 is the number of primary color channels available
+  mDT8RGBWAFchannels = (aDT8Features>>5) & 0x07; // bits 5..7 is the number of RGBWAF channels available
+}
+
+
+void DaliBusDevice::applyProbeInfo(const DaliProbeInfo &aProbeInfo)
+{
+  mSupportsLED = (aProbeInfo.features & daliprobe_led)!=0;
+  mSupportsDT8 = (aProbeInfo.features & daliprobe_dt8)!=0;
+  mFullySupportsDimcurve = (aProbeInfo.features & daliprobe_dimcurve)!=0;
+  if (mSupportsDT8) {
+    setDT8Features(aProbeInfo.dt8Features);
+    mDT8GearStatusByte = aProbeInfo.dt8GearStatus;
+    mDT8AutoActivation = (aProbeInfo.dt8GearStatus & 0x01)!=0;
+  }
+  OLOG(LOG_INFO,
+    "using persisted probe results: LED=%d, DT8=%d (features=0x%02X, gear status=0x%02X), dimcurve=%d",
+    mSupportsLED, mSupportsDT8, aProbeInfo.dt8Features, aProbeInfo.dt8GearStatus, mFullySupportsDimcurve
+  );
+}
+
+
+void DaliBusDevice::featuresProbed(StatusCB aCompletedCB, ErrorPtr aError)
+{
+  if (mProbedDeviceType>=0) {
+    // complete probe results, persist them for next startup
+    mDaliVdc.storeProbeInfo(
+      mDeviceInfo->mShortAddress, mDSUID, mProbedDeviceType,
+      (mSupportsLED ? daliprobe_led : 0) | (mSupportsDT8 ? daliprobe_dt8 : 0) | (mFullySupportsDimcurve ? daliprobe_dimcurve : 0),
+      mSupportsDT8 ? mDT8FeaturesByte : 0, mSupportsDT8 ? mDT8GearStatusByte : 0
+    );
+  }
   if (aCompletedCB) aCompletedCB(aError);
 }
 
@@ -375,15 +437,19 @@ void DaliBusDevice::getGroupMemberShip(DaliGroupsCB aDaliGroupsCB, DaliAddress a
 
 void DaliBusDevice::queryGroup0to7Response(DaliGroupsCB aDaliGroupsCB, DaliAddress aShortAddress, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
 {
-  uint16_t groupBitMask = 0; // no groups yet
-  if (Error::isOK(aError) && !aNoOrTimeout) {
-    groupBitMask = aResponse;
+  if (Error::isOK(aError) && aNoOrTimeout) {
+    // control gear always answers group queries, so no answer means membership is unknown
+    aError = ErrorPtr(new DaliCommError(DaliCommError::DataMissing));
   }
-  // anyway, query other half
+  if (Error::notOK(aError)) {
+    if (aDaliGroupsCB) aDaliGroupsCB(0, aError);
+    return;
+  }
+  // query other half
   mDaliVdc.mDaliComm.daliSendQuery(
     aShortAddress,
     DALICMD_QUERY_GROUPS_8_TO_15,
-    boost::bind(&DaliBusDevice::queryGroup8to15Response, this, aDaliGroupsCB, aShortAddress, groupBitMask, _1, _2, _3)
+    boost::bind(&DaliBusDevice::queryGroup8to15Response, this, aDaliGroupsCB, aShortAddress, (uint16_t)aResponse, _1, _2, _3)
   );
 }
 
@@ -391,9 +457,15 @@ void DaliBusDevice::queryGroup0to7Response(DaliGroupsCB aDaliGroupsCB, DaliAddre
 void DaliBusDevice::queryGroup8to15Response(DaliGroupsCB aDaliGroupsCB, DaliAddress aShortAddress, uint16_t aGroupBitMask, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
 {
   // group 8..15 membership result
-  if (Error::isOK(aError) && !aNoOrTimeout) {
+  if (Error::isOK(aError) && aNoOrTimeout) {
+    aError = ErrorPtr(new DaliCommError(DaliCommError::DataMissing));
+  }
+  if (Error::isOK(aError)) {
     aGroupBitMask |= ((uint16_t)aResponse)<<8;
   }
+  else {
+    aGroupBitMask = 0; // unknown
+  }
   if (aDaliGroupsCB) aDaliGroupsCB(aGroupBitMask, aError);
 }
 
@@ -407,13 +479,14 @@ void DaliBusDevice::initialize(StatusCB aCompletedCB, uint16_t aUsedGroupsMask)
     return;
   }
   // make sure device is in none of the used groups
-  if (aUsedGroupsMask==0) {
+  if (aUsedGroupsMask==0 && !mSupportsDT8) {
     // no groups in use at all, continue to initializing features
+    // Note: DT8 devices are always queried, because knowing their group memberships allows setting colors via group commands
     initializeFeatures(aCompletedCB);
     return;
   }
-  // need to query current groups
-  getGroupMemberShip(boost::bind(&DaliBusDevice::groupMembershipResponse, this, aCompletedCB, aUsedGroupsMask, mDeviceInfo->mShortAddress, _1, _2), mDeviceInfo->mShortAddress);
+  // need current groups
+  queryOwnGroupMembership(aCompletedCB, aUsedGroupsMask);
 }
 
 
@@ -425,6 +498,19 @@ void DaliBusDevice::checkGroupMembership(StatusCB aCompletedCB, uint16_t aUsedGr
     if (aCompletedCB) aCompletedCB(ErrorPtr());
     return;
   }
+  // need current groups
+  queryOwnGroupMembership(aCompletedCB, aUsedGroupsMask);
+}
+
+
+void DaliBusDevice::queryOwnGroupMembership(StatusCB aCompletedCB, uint16_t aUsedGroupsMask)
+{
+  int groups = mDaliVdc.probedGroups(mDeviceInfo->mShortAddress);
+  if (groups>=0) {
+    // known from persisted probe results (which are kept up-to-date with all group changes we make)
+    groupMembershipResponse(aCompletedCB, aUsedGroupsMask, mDeviceInfo->mShortAddress, groups, ErrorPtr());
+    return;
+  }
   // need to query current groups
   getGroupMemberShip(boost::bind(&DaliBusDevice::groupMembershipResponse, this, aCompletedCB, aUsedGroupsMask, mDeviceInfo->mShortAddress, _1, _2), mDeviceInfo->mShortAddress);
 }
@@ -441,6 +527,11 @@ void DaliBusDevice::groupMembershipResponse(StatusCB aCompletedCB, uint16_t aUse
         mDaliVdc.mDaliComm.daliSendConfigCommand(aShortAddress, DALICMD_REMOVE_FROM_GROUP|g);
       }
     }
+    mDaliVdc.noteGroupMemberships(aShortAddress, aGroups & ~aUsedGroupsMask, mSupportsDT8);
+    mDaliVdc.storeProbedGroups(aShortAddress, aGroups & ~aUsedGroupsMask);
+  }
+  else {
+    LOG(LOG_WARNING, "- single DALI bus device with shortaddr %d: could not query group memberships: %s", aShortAddress, aError->text());
   }
   // initialize features now
   initializeFeatures(aCompletedCB);
@@ -491,6 +582,12 @@ void DaliBusDevice::queryActualLevelResponse(StatusCB aCompletedCB, bool aNoOrTi
     // this is my current level, save it in brightness scale for dS system side queries (which will apply gamma in addition)
     mCurrentBrightness = daliLevelToBrightness(aResponse);
     OLOG(LOG_INFO, "retrieved current dimming level: DALI level = %d/0x%02X -> DALI brightness (no gamma corr) = %0.1f%%", aResponse, aResponse, mCurrentBrightness);
+    // physical minimum level does not change, use persisted probe result if we have one
+    int minLevel = mDaliVdc.probedMinLevel(addressForQuery());
+    if (minLevel>=0) {
+      queryMinLevelResponse(aCompletedCB, false, minLevel, ErrorPtr());
+      return;
+    }
   }
   // next: query the minimum dimming level
   mDaliVdc.mDaliComm.daliSendQuery(
@@ -508,6 +605,7 @@ void DaliBusDevice::queryMinLevelResponse(StatusCB aCompletedCB, bool aNoOrTimeo
     mIsPresent = true; // answering a query means presence
     // this is the minimum dali level, in brightness scale for dS system side queries (which will apply gamma in addition)
     mMinBrightness = daliLevelToBrightness(aResponse);
+    mDaliVdc.storeProbedMinLevel(addressForQuery(), aResponse);
     OLOG(LOG_INFO, "retrieved minimum dimming level: DALI level = %d/0x%02X -> DALI brightness (no gamma corr) = %0.1f%%", aResponse, aResponse, mMinBrightness);
   }
   if (mSupportsDT8) {
@@ -726,7 +824,7 @@ void DaliBusDevice::setTransitionTime(MLMicroSeconds aTransitionTime)
 }
 
 
-bool DaliBusDevice::setBrightness(Brightness aBrightness)
+bool DaliBusDevice::setBrightness(Brightness aBrightness, bool aDeferred)
 {
   if (mIsDummy) return false;
   mDimRepeaterTicket.cancel(); // safety: stop dim repeater (should not be running now, but just in case)
@@ -735,8 +833,8 @@ bool DaliBusDevice::setBrightness(Brightness aBrightness)
     mStaleParams = false; // consider everything applied now
     mCurrentBrightness = aBrightness;
     uint8_t power = brightnessToDaliLevel(aBrightness);
-    OLOG(LOG_INFO, "setting new brightness (gamma applied) = %0.2f, DALI level = %d/0x%02X", aBrightness, (int)power, (int)power);
-    mDaliVdc.mDaliComm.daliSendDirectPower(mDeviceInfo->mShortAddress, power);
+    OLOG(LOG_INFO, "setting new brightness (gamma applied) = %0.2f, DALI level = %d/0x%02X%s", aBrightness, (int)power, (int)power, aDeferred ? " (deferred)" : "");
+    if (!aDeferred) mDaliVdc.mDaliComm.daliSendDirectPower(mDeviceInfo->mShortAddress, power);
     return true; // changed
   }
   return false; // not changed
@@ -756,7 +854,7 @@ void DaliBusDevice::setDefaultBrightness(Brightness aBrightness)
 
 
 
-bool DaliBusDevice::setColorParams(ColorLightMode aMode, double aCieXorCT, double aCieY, bool aAlways)
+bool DaliBusDevice::setColorParams(ColorLightMode aMode, double aCieXorCT, double aCieY, bool aAlways, bool aDeferred)
 {
   bool changed = aAlways || mStaleParams;
   mOutputSyncTicket.cancel(); // setting new values now, no need to sync
@@ -771,7 +869,7 @@ bool DaliBusDevice::setColorParams(ColorLightMode aMode, double aCieXorCT, doubl
         mCurrentXorCT = aCieXorCT; // 1:1 in mired
         changed = true;
         mCurrentY = 0;
-        if (mDT8CT) {
+        if (mDT8CT && !aDeferred) {
           mDaliVdc.mDaliComm.daliSend16BitValueAndCommand(mDeviceInfo->mShortAddress, DALICMD_DT8_SET_TEMP_CT, mCurrentXorCT);
         }
       }
@@ -783,7 +881,7 @@ bool DaliBusDevice::setColorParams(ColorLightMode aMode, double aCieXorCT, doubl
         mCurrentXorCT = x;
         mCurrentY = y;
         changed = true;
-        if (mDT8Color) {
+        if (mDT8Color && !aDeferred) {
           mDaliVdc.mDaliComm.daliSend16BitValueAndCommand(mDeviceInfo->mShortAddress, DALICMD_DT8_SET_TEMP_XCOORD, mCurrentXorCT);
           mDaliVdc.mDaliComm.daliSend16BitValueAndCommand(mDeviceInfo->mShortAddress, DALICMD_DT8_SET_TEMP_YCOORD, mCurrentY);
         }
@@ -794,7 +892,7 @@ bool DaliBusDevice::setColorParams(ColorLightMode aMode, double aCieXorCT, doubl
 }
 
 
-bool DaliBusDevice::setRGBWAParams(uint8_t aR, uint8_t aG, uint8_t aB, uint8_t aW, uint8_t aA, bool aAlways)
+bool DaliBusDevice::setRGBWAParams(uint8_t aR, uint8_t aG, uint8_t aB, uint8_t aW, uint8_t aA, bool aAlways, bool aDeferred)
 {
   bool changed = aAlways || mStaleParams;
   mDimRepeaterTicket.cancel(); // safety: stop dim repeater (should not be running now, but just in case)
@@ -803,7 +901,18 @@ bool DaliBusDevice::setRGBWAParams(uint8_t aR, uint8_t aG, uint8_t aB, uint8_t a
       changed = true; // change in mode always means change in parameter
       mCurrentColorMode = colorLightModeRGBWA;
     }
-    if (changed || aR!=mCurrentR || aG!=mCurrentG || aB!=mCurrentB || aW!=mCurrentW || aA!=mCurrentA) {
+    if (aDeferred) {
+      // just update cached values, caller will send them
+      if (changed || aR!=mCurrentR || aG!=mCurrentG || aB!=mCurrentB || aW!=mCurrentW || aA!=mCurrentA) {
+        mCurrentR = aR;
+        mCurrentG = aG;
+        mCurrentB = aB;
+        mCurrentW = aW;
+        mCurrentA = aA;
+        changed = true;
+      }
+    }
+    else if (changed || aR!=mCurrentR || aG!=mCurrentG || aB!=mCurrentB || aW!=mCurrentW || aA!=mCurrentA) {
       // set the mode (channel control)
       mDaliVdc.mDaliComm.daliSendDtrAndCommand(mDeviceInfo->mShortAddress, DALICMD_DT8_SET_TEMP_RGBWAF_CTRL, 0x2<<6); // all not linked, normalised colour control
       if (changed || aR!=mCurrentR || aG!=mCurrentG || aB!=mCurrentB) {
@@ -828,7 +937,7 @@ bool DaliBusDevice::setRGBWAParams(uint8_t aR, uint8_t aG, uint8_t aB, uint8_t a
 }
 
 
-bool DaliBusDevice::setColorParamsFromChannels(ColorLightBehaviourPtr aColorLight, bool aTransitional, bool aAlways, bool aSilent)
+bool DaliBusDevice::setColorParamsFromChannels(ColorLightBehaviourPtr aColorLight, bool aTransitional, bool aAlways, bool aSilent, bool aDeferred)
 {
   bool hasNewColors = false;
   RGBColorLightBehaviourPtr rgbl = boost::dynamic_pointer_cast<RGBColorLightBehaviour>(aColorLight);
@@ -859,7 +968,7 @@ bool DaliBusDevice::setColorParamsFromChannels(ColorLightBehaviourPtr aColorLigh
         SOLOG(aColorLight->getDevice(), LOG_INFO, "DALI DT8 RGB: setting R=%d, G=%d, B=%d", (int)r, (int)g, (int)b);
       }
     }
-    hasNewColors = setRGBWAParams(r, g, b, w, a, aAlways);
+    hasNewColors = setRGBWAParams(r, g, b, w, a, aAlways, aDeferred);
   }
   else {
     // DALI controller understands Cie and/or Ct directly
@@ -870,7 +979,7 @@ bool DaliBusDevice::setColorParamsFromChannels(ColorLightBehaviourPtr aColorLigh
       if (!aSilent) {
         SOLOG(aColorLight->getDevice(), LOG_INFO, "DALI DT8 CIE: setting x=%.3f, y=%.3f", cieX, cieY);
       }
-      hasNewColors = setColorParams(colorLightModeXY, cieX, cieY, aAlways);
+      hasNewColors = setColorParams(colorLightModeXY, cieX, cieY, aAlways, aDeferred);
     }
     else {
       // CT is requested and controller can do CT natively, or color is requested but controller can ONLY do CT
@@ -879,19 +988,59 @@ bool DaliBusDevice::setColorParamsFromChannels(ColorLightBehaviourPtr aColorLigh
       if (!aSilent) {
         SOLOG(aColorLight->getDevice(), LOG_INFO, "DALI DT8 CT: setting mired=%d", (int)mired);
       }
-      hasNewColors = setColorParams(colorLightModeCt, mired, 0, aAlways);
+      hasNewColors = setColorParams(colorLightModeCt, mired, 0, aAlways, aDeferred);
     }
   }
   return hasNewColors;
 }
 
 
-void DaliBusDevice::activateColorParams()
+void DaliBusDevice::sendColorParams(DaliAddress aAddress)
+{
+  if (!mSupportsDT8) return;
+  DaliComm &daliComm = mDaliVdc.mDaliComm;
+  if (mCurrentColorMode==colorLightModeCt) {
+    if (mDT8CT) {
+      daliComm.daliSend16BitValueAndCommand(aAddress, DALICMD_DT8_SET_TEMP_CT, mCurrentXorCT);
+    }
+  }
+  else if (mCurrentColorMode==colorLightModeRGBWA) {
+    daliComm.daliSendDtrAndCommand(aAddress, DALICMD_DT8_SET_TEMP_RGBWAF_CTRL, 0x2<<6); // all not linked, normalised colour control
+    daliComm.daliSend3x8BitValueAndCommand(aAddress, DALICMD_DT8_SET_TEMP_RGB, mCurrentR, mCurrentG, mCurrentB);
+    if (mDT8RGBWAFchannels>3) {
+      daliComm.daliSend3x8BitValueAndCommand(aAddress, DALICMD_DT8_SET_TEMP_WAF, mCurrentW, mCurrentA, 0); // no F
+    }
+  }
+  else if (mDT8Color) {
+    daliComm.daliSend16BitValueAndCommand(aAddress, DALICMD_DT8_SET_TEMP_XCOORD, mCurrentXorCT);
+    daliComm.daliSend16BitValueAndCommand(aAddress, DALICMD_DT8_SET_TEMP_YCOORD, mCurrentY);
+  }
+}
+
+
+string DaliBusDevice::colorParamsKey()
+{
+  if (!mSupportsDT8) return "";
+  if (mCurrentColorMode==colorLightModeCt) {
+    return mDT8CT ? string_format("CT:%u", mCurrentXorCT) : "";
+  }
+  else if (mCurrentColorMode==colorLightModeRGBWA) {
+    if (mDT8RGBWAFchannels>3) return string_format("RGBWA:%u,%u,%u,%u,%u", mCurrentR, mCurrentG, mCurrentB, mCurrentW, mCurrentA);
+    return string_format("RGB:%u,%u,%u", mCurrentR, mCurrentG, mCurrentB);
+  }
+  else if (mDT8Color) {
+    return string_format("XY:%u,%u", mCurrentXorCT, mCurrentY);
+  }
+  return "";
+}
+
+
+void DaliBusDevice::activateColorParams(bool aDeferred)
 {
   mDimRepeaterTicket.cancel(); // safety: stop dim repeater (should not be running now, but just in case)
   mOutputSyncTicket.cancel(); // setting new values now, no need to sync
   mStaleParams = false; // new params activated, not stale any more
-  if (mSupportsDT8) {
+  if (mSupportsDT8 && !aDeferred) {
     mDaliVdc.mDaliComm.daliSendCommand(mDeviceInfo->mShortAddress, DALICMD_DT8_ACTIVATE);
   }
 }
@@ -1094,6 +1243,12 @@ void DaliBusDeviceGroup::initNextGroupMember(StatusCB aCompletedCB, DaliComm::Sh
       ++aNextMember;
       continue;
     }
+    int groups = mDaliVdc.probedGroups(*aNextMember);
+    if (groups>=0) {
+      // known from persisted probe results
+      groupMembershipResponse(aCompletedCB, aNextMember, groups, ErrorPtr());
+      return;
+    }
     // need to query current groups
     getGroupMemberShip(
       boost::bind(&DaliBusDeviceGroup::groupMembershipResponse, this, aCompletedCB, aNextMember, _1, _2),
@@ -1125,6 +1280,15 @@ void DaliBusDeviceGroup::groupMembershipResponse(StatusCB aCompletedCB, DaliComm
       mDaliVdc.mDaliComm.daliSendConfigCommand(*aNextMember, DALICMD_REMOVE_FROM_GROUP|groupNo);
     }
   }
+  if (Error::isOK(aError)) {
+    // note: members of groups are considered DT8 gear, as the group's features only represent the common denominator
+    mDaliVdc.noteGroupMemberships(*aNextMember, 1<<(mDeviceInfo->mShortAddress & DaliGroupMask), true);
+    mDaliVdc.storeProbedGroups(*aNextMember, 1<<(mDeviceInfo->mShortAddress & DaliGroupMask));
+  }
+  else {
+    // actual memberships unknown (other than the group we just added it to), so do not trust or persist them
+    LOG(LOG_WARNING, "- DALI bus device with shortaddr %d: could not query group memberships: %s", *aNextMember, aError->text());
+  }
   // done adding this member to group
   // - check if more to process
   ++aNextMember;
@@ -1469,19 +1633,28 @@ void DaliSingleControllerDevice::applyChannelValueSteps(bool aForDimming, bool a
   LightBehaviourPtr l = getOutput<LightBehaviour>();
   bool needactivation = false;
   bool moreSteps = false;
+  bool deferred = false;
   ColorLightBehaviourPtr cl;
   if (aWithColor) {
     cl = getOutput<ColorLightBehaviour>();
     moreSteps = cl->updateColorTransition(now);
-    needactivation = mDaliController->setColorParamsFromChannels(cl, true, false, aForDimming); // activation needed when color has changed
+    // DT8 color changes of single devices are delivered by the vdc, together with other devices getting the same color
+    deferred = !aForDimming && mDaliController->mSupportsDT8 && !mDaliController->isGrouped();
+    needactivation = mDaliController->setColorParamsFromChannels(cl, true, false, aForDimming, deferred); // activation needed when color has changed
+    if (!needactivation) deferred = false; // no color change, nothing to deliver
   }
   // handle brightness
   if (aWithBrightness || needactivation) {
     // update actual dimmer value
     if (l->updateBrightnessTransition(now)) moreSteps = true; // brightness transition not yet complete
     else aWithBrightness = false; // brightness is done now, if there are further steps, these are color only
-    bool sentDAPC = mDaliController->setBrightness(l->brightnessForHardware());
-    if (sentDAPC && mDaliController->mDT8AutoActivation) needactivation = false; // prevent activating twice!
+    bool sentDAPC = mDaliController->setBrightness(l->brightnessForHardware(), deferred);
+    if (deferred) {
+      // vdc will send color, DAPC and activation
+      daliVdc().queueColorUpdate(mDaliController, sentDAPC);
+      needactivation = false;
+    }
+    else if (sentDAPC && mDaliController->mDT8AutoActivation) needactivation = false; // prevent activating twice!
   }
   // activate color params in case brightness has not changed or device is not in auto-activation mode
   if (needactivation) {
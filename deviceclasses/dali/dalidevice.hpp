@@ -49,6 +49,28 @@ namespace p44 {
   typedef boost::intrusive_ptr<DaliCompositeDevice> DaliCompositeDevicePtr;
   typedef boost::intrusive_ptr<DaliInputDevice> DaliInputDevicePtr;
 
+
+  /// feature flags in persisted probe results
+  enum {
+    daliprobe_led = 0x01, ///< supports device type 6 (LED)
+    daliprobe_dt8 = 0x02, ///< supports device type 8 (color)
+    daliprobe_dimcurve = 0x04, ///< supports device type 17 (dimming curve selection)
+  };
+
+  /// persisted results of probing a control gear's features, group memberships and minimum level
+  typedef struct {
+    string dSUID; ///< dSUID of the bus device the results were probed from
+    uint8_t deviceType; ///< answer to DALICMD_QUERY_DEVICE_TYPE, serves as fingerprint to detect changes
+    uint8_t features; ///< daliprobe_xxx feature flags
+    uint8_t dt8Features; ///< DT8 color features byte
+    uint8_t dt8GearStatus; ///< DT8 gear status byte
+    int groups; ///< group membership bitmask, -1 if not known
+    int minLevel; ///< physical minimum level, -1 if not known
+    bool validated; ///< set when results have been probed or verified by fingerprint since last bus scan
+    bool needsRefresh; ///< set when results were loaded from DB and have not yet been re-probed in the background
+  } DaliProbeInfo;
+
+
   class DaliBusDevice : public P44LoggingObj
   {
     typedef P44LoggingObj inherited;
@@ -78,6 +100,12 @@ namespace p44 {
     uint8_t mDT8RGBWAFchannels; // if>0, how many RGBWAF channels are supported
     bool mDT8AutoActivation; // if set, changing DAPC (brightness) auto-activates colors set in TEMPROARY color registers
 
+    /// probing
+    int mProbedDeviceType; ///< device type as answered to QUERY_DEVICE_TYPE, -1 if no reliable probe result (not to be persisted)
+    uint8_t mDT8FeaturesByte; ///< raw DT8 color features byte
+    uint8_t mDT8GearStatusByte; ///< raw DT8 gear status byte
+    bool mBypassProbeCache; ///< if set, always probe features on the bus, even if persisted results are available
+
     /// cached status (call updateStatus() to update these)
     bool mIsDummy; ///< set if dummy (not found on bus, but known to be part of a composite device)
     bool mIsPresent; ///< set if present
@@ -174,33 +202,48 @@ namespace p44 {
 
     /// set new brightness
     /// @param aBrightness new brightness to set
+    /// @param aDeferred if set, only the cached brightness is updated, sending DAPC is left to the caller
     /// @return true if brightness has changed
-    bool setBrightness(Brightness aBrightness);
+    bool setBrightness(Brightness aBrightness, bool aDeferred = false);
 
     /// set color parameters from behaviour
     /// @param aColorLight the color light
     /// @param aTransitional set to use transitional channel values
     /// @param aAlways set to always write color registers, even if unchanged
     /// @param aSilent set to suppress log messages
+    /// @param aDeferred if set, only the cached color parameters are updated, sending them is left to the caller (see sendColorParams())
     /// @return true if any color parameters were changed in the device
-    bool setColorParamsFromChannels(ColorLightBehaviourPtr aColorLight, bool aTransitional, bool aAlways, bool aSilent);
+    bool setColorParamsFromChannels(ColorLightBehaviourPtr aColorLight, bool aTransitional, bool aAlways, bool aSilent, bool aDeferred = false);
 
     /// set new color parameters as CIE x/y or CT
     /// @param aMode new color mode
     /// @param aCieXorCT CIE X coordinate (0..1) or CT in mired
     /// @param aCieY CIE Y coordinate (0..1)
     /// @param aAlways set to always write color registers, even if unchanged
+    /// @param aDeferred if set, only the cached color parameters are updated
     /// @return true if any color parameters were changed in the device
-    bool setColorParams(ColorLightMode aMode, double aCieXorCT, double aCieY, bool aAlways);
+    bool setColorParams(ColorLightMode aMode, double aCieXorCT, double aCieY, bool aAlways, bool aDeferred = false);
 
     /// set new color parameters in raw RGBWA
     /// @param aR,aG,aB,aW,aA new values
     /// @param aAlways set to always write color registers, even if unchanged
+    /// @param aDeferred if set, only the cached color parameters are updated
     /// @return true if any color parameters were changed in the device
-    bool setRGBWAParams(uint8_t aR, uint8_t aG, uint8_t aB, uint8_t aW, uint8_t aA, bool aAlways);
+    bool setRGBWAParams(uint8_t aR, uint8_t aG, uint8_t aB, uint8_t aW, uint8_t aA, bool aAlways, bool aDeferred = false);
+
+    /// send all cached color parameters of the current color mode into the temporary color registers
+    /// @param aAddress the DALI address to send the parameters to. This can be a group or broadcast address
+    ///   to set the same color in multiple devices at once.
+    void sendColorParams(DaliAddress aAddress);
+
+    /// @return string uniquely representing the DALI commands sendColorParams() would send,
+    ///   so devices with the same key can get their color set with a single group or broadcast sequence.
+    ///   Empty string when no color parameters need to be sent.
+    string colorParamsKey();
 
     /// activate new color parameters
-    void activateColorParams();
+    /// @param aDeferred if set, only internal state is updated, sending DALICMD_DT8_ACTIVATE is left to the caller
+    void activateColorParams(bool aDeferred = false);
 
     /// save brightness as default for DALI dimmer to use after powerup and at failure
     /// @param aBrightness new brightness to set, <0 to save current brightness
@@ -226,7 +269,7 @@ namespace p44 {
 
     typedef boost::function<void (uint16_t aGroupBitMask, ErrorPtr aError)> DaliGroupsCB;
     /// Utility: Retrieve group membership mask for a given short address
-    /// @param aDaliGroupsCB delivers the result
+    /// @param aDaliGroupsCB delivers the result, with an error (and mask 0) when the device did not answer
     /// @param aShortAddress which device to query (note: not necessarily myself!)
     void getGroupMemberShip(DaliGroupsCB aDaliGroupsCB, DaliAddress aShortAddress);
 
@@ -249,10 +292,14 @@ namespace p44 {
     void queryDTFeatures(StatusCB aCompletedCB);
     void dt8FeaturesResponse(StatusCB aCompletedCB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
     void dt8GearStatusResponse(StatusCB aCompletedCB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void setDT8Features(uint8_t aDT8Features);
+    void applyProbeInfo(const DaliProbeInfo &aProbeInfo);
+    void featuresProbed(StatusCB aCompletedCB, ErrorPtr aError);
 
     void queryGroup0to7Response(DaliGroupsCB aDaliGroupsCB, DaliAddress aShortAddress, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
     void queryGroup8to15Response(DaliGroupsCB aDaliGroupsCB, DaliAddress aShortAddress, uint16_t aGroupBitMask, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
     void checkGroupMembership(StatusCB aCompletedCB, uint16_t aUsedGroupsMask);
+    void queryOwnGroupMembership(StatusCB aCompletedCB, uint16_t aUsedGroupsMask);
     void groupMembershipResponse(StatusCB aCompletedCB, uint16_t aUsedGroupsMask, DaliAddress aShortAddress, uint16_t aGroups, ErrorPtr aError);
 
     void queryActualLevelResponse(StatusCB aCompletedCB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
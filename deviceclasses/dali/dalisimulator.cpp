@@ -0,0 +1,955 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// File scope debugging options
+// - Set ALWAYS_DEBUG to 1 to enable DBGLOG output even in non-DEBUG builds of this file
+#define ALWAYS_DEBUG 0
+// - set FOCUSLOGLEVEL to non-zero log level (usually, 5,6, or 7==LOG_DEBUG) to get focus (extensive logging) for this file
+//   Note: must be before including "logger.hpp" (or anything that includes "logger.hpp")
+#define FOCUSLOGLEVEL 0
+
+#include "dalisimulator.hpp"
+
+#if ENABLE_DALI && ENABLE_DALI_SIMULATOR
+
+#include <math.h>
+
+using namespace p44;
+
+
+// DALI timing (IEC 62386-101)
+#define DALI_FORWARD_FRAME_TIME (15833) // 1 start bit + 16 data bits + 2 stop bits at 1200 bit/s, in µS
+#define DALI_BACKWARD_FRAME_TIME (9167) // 1 start bit + 8 data bits + 2 stop bits at 1200 bit/s, in µS
+#define DALI_BACKWARD_SETTLING_TIME (7000) // typical time between end of forward frame and start of backward frame, in µS
+#define DALI_NO_ANSWER_TIME (22000) // time after forward frame after which no answer can be expected anymore, in µS
+#define DALI_FORWARD_SETTLING_TIME (13500) // minimal settling time before next forward frame, in µS
+#define DALI_DOUBLESEND_GAP (10000) // gap between the two frames of a double send (as the bridge does it), in µS
+
+#define DALI_DIM_STEP_TIME (200*MilliSecond) // UP/DOWN commands dim for this time
+
+// simulated device identification
+#define SIM_GTIN_BASE 761234567000ll // 12 digit base, check digit is appended
+#define SIM_FW_VERSION_MAJOR 1
+#define SIM_FW_VERSION_MINOR 4
+#define SIM_BANK0_LAST_LOCATION 0x1A // DALI 2.0 minimum bank 0
+#define SIM_DALI_VERSION DALI_STD_VERS_BYTE(2, 0)
+
+
+static uint64_t gtinWithCheckDigit(uint64_t aBase)
+{
+  // standard GTIN check digit: weights 3,1,3,1... from the rightmost digit of the base
+  int sum = 0;
+  int weight = 3;
+  for (uint64_t b = aBase; b>0; b /= 10) {
+    sum += (b%10)*weight;
+    weight = weight==3 ? 1 : 3;
+  }
+  return aBase*10 + (10-sum%10)%10;
+}
+
+
+// MARK: - DaliSimGear
+
+DaliSimGear::DaliSimGear() :
+  mShortAddress(0xFF),
+  mRandomAddress(0xFFFFFF),
+  mInitialised(false),
+  mWithdrawn(false),
+  mPhysMinLevel(1),
+  mDtr0(0), mDtr1(0), mDtr2(0),
+  mWriteEnabled(false),
+  mDeviceType(DT6_TYPE_LED),
+  mColorFeatures(0),
+  mGearFeatures(0)
+{
+  reset();
+}
+
+
+void DaliSimGear::reset()
+{
+  // as defined for the DALI RESET command
+  mActualLevel = 254;
+  mPowerOnLevel = 254;
+  mFailureLevel = 254;
+  mMinLevel = mPhysMinLevel;
+  mMaxLevel = 254;
+  mFadeRate = 7;
+  mFadeTime = 0;
+  mGroups = 0;
+  for (int i=0; i<DALI_MAXSCENES; i++) mScenes[i] = 0xFF;
+  mRandomAddress = 0xFFFFFF;
+  mLimitError = false;
+  // DT8: CT mode, warm white
+  mColorMode = 0x20;
+  mTempColorMode = 0;
+  mX = 0x5555; mY = 0x5555;
+  mTempX = mX; mTempY = mY;
+  mMired = 370;
+  mTempMired = mMired;
+  for (int i=0; i<5; i++) { mRGBWA[i] = 0; mTempRGBWA[i] = 0; }
+}
+
+
+void DaliSimGear::setLevel(uint8_t aLevel)
+{
+  mLimitError = false;
+  if (aLevel==0xFF) return; // MASK, no change
+  if (aLevel!=0) {
+    if (aLevel<mMinLevel) { aLevel = mMinLevel; mLimitError = true; }
+    else if (aLevel>mMaxLevel) { aLevel = mMaxLevel; mLimitError = true; }
+  }
+  mActualLevel = aLevel;
+}
+
+
+void DaliSimGear::activateColor()
+{
+  if (mTempColorMode==0) return; // nothing to activate
+  mColorMode = mTempColorMode;
+  mX = mTempX; mY = mTempY;
+  mMired = mTempMired;
+  for (int i=0; i<5; i++) mRGBWA[i] = mTempRGBWA[i];
+  mTempColorMode = 0;
+}
+
+
+// MARK: - DaliBusSimulator
+
+DaliBusSimulator::DaliBusSimulator(const string aConfig) :
+  mRandomState(42),
+  mSpeed(0),
+  mDropoutProbability(0),
+  mCollisionProbability(0),
+  mSearchAddress(0xFFFFFF),
+  mEnabledDeviceType(-1),
+  mWallBase(Never),
+  mBusBase(0)
+{
+  resetStats();
+  int numGears = 16;
+  int numDT8 = -1;
+  int numAddressed = 0;
+  // parse config
+  const char *p = aConfig.c_str();
+  string part;
+  while (nextPart(p, part, ',')) {
+    string k, v;
+    if (!keyAndValue(part, k, v, '=')) continue;
+    if (k=="n") numGears = atoi(v.c_str());
+    else if (k=="dt8") numDT8 = atoi(v.c_str());
+    else if (k=="addressed") numAddressed = atoi(v.c_str());
+    else if (k=="seed") mRandomState = (uint32_t)atol(v.c_str());
+    else if (k=="speed") mSpeed = atof(v.c_str());
+    else if (k=="dropout") mDropoutProbability = atof(v.c_str());
+    else if (k=="collision") mCollisionProbability = atof(v.c_str());
+  }
+  if (mRandomState==0) mRandomState = 1; // xorshift must not have zero state
+  if (numGears<0) numGears = 0;
+  if (numDT8<0) numDT8 = numGears/2;
+  // create gears
+  mGears.resize(numGears);
+  for (int i=0; i<numGears; i++) {
+    setupGear(mGears[i], i<numDT8, i);
+    if (i<numAddressed && i<DALI_MAXDEVICES) mGears[i].mShortAddress = i;
+  }
+  LOG(LOG_NOTICE, "DALI bus simulator: %s", description().c_str());
+}
+
+
+string DaliBusSimulator::description()
+{
+  int numDT8 = 0;
+  for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+    if (pos->isDT8()) numDT8++;
+  }
+  return string_format(
+    "%zu control gears (%d DT8), speed=%.2f, dropout=%.3f, collision=%.3f",
+    mGears.size(), numDT8, mSpeed, mDropoutProbability, mCollisionProbability
+  );
+}
+
+
+void DaliBusSimulator::resetStats()
+{
+  mBusTime = 0;
+  mForwardFrames = 0;
+  mBackwardFrames = 0;
+  mCollisions = 0;
+  mDropouts = 0;
+}
+
+
+uint32_t DaliBusSimulator::rand()
+{
+  // xorshift32, reproducible across platforms for a given seed
+  mRandomState ^= mRandomState<<13;
+  mRandomState ^= mRandomState>>17;
+  mRandomState ^= mRandomState<<5;
+  return mRandomState;
+}
+
+
+bool DaliBusSimulator::chance(double aProbability)
+{
+  if (aProbability<=0) return false;
+  return (double)(rand()%1000000)/1000000<aProbability;
+}
+
+
+void DaliBusSimulator::setupGear(DaliSimGear &aGear, bool aDT8, int aIndex)
+{
+  aGear.mDeviceType = aDT8 ? DT8_TYPE_COLOR : DT6_TYPE_LED;
+  if (aDT8) {
+    // tunable white gear with auto-activation disabled
+    aGear.mColorFeatures = 0x02; // CT capable
+    aGear.mGearFeatures = 0x00;
+  }
+  aGear.mPhysMinLevel = 85+(rand()%20);
+  aGear.reset();
+  aGear.mRandomAddress = rand() & 0xFFFFFF; // gears come randomised from factory
+  // bank 0 (DALI 2.0 layout)
+  aGear.mBank0.assign(SIM_BANK0_LAST_LOCATION+1, 0xFF);
+  aGear.mBank0[0x00] = SIM_BANK0_LAST_LOCATION;
+  aGear.mBank0[0x02] = 0; // last accessible bank
+  uint64_t gtin = gtinWithCheckDigit(SIM_GTIN_BASE+(aDT8 ? 8 : 6));
+  for (int i=0x08; i>=0x03; i--) { aGear.mBank0[i] = gtin & 0xFF; gtin >>= 8; }
+  aGear.mBank0[0x09] = SIM_FW_VERSION_MAJOR;
+  aGear.mBank0[0x0A] = SIM_FW_VERSION_MINOR;
+  uint64_t serial = ((uint64_t)(rand() & 0xFFFF)<<32) + 100000 + aIndex;
+  for (int i=0x12; i>=0x0B; i--) { aGear.mBank0[i] = serial & 0xFF; serial >>= 8; }
+  aGear.mBank0[0x13] = 1; // hardware version
+  aGear.mBank0[0x14] = 0;
+  aGear.mBank0[0x15] = SIM_DALI_VERSION; // 101 version
+  aGear.mBank0[0x16] = SIM_DALI_VERSION; // 102 version
+  aGear.mBank0[0x17] = 0xFF; // no 103 control device
+  aGear.mBank0[0x18] = 0; // number of logical control device units
+  aGear.mBank0[0x19] = 1; // number of logical control gear units
+  aGear.mBank0[0x1A] = 0; // index of this logical control gear unit
+}
+
+
+// MARK: - bridge protocol
+
+void DaliBusSimulator::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, DaliBridgeResultCB aResultCB, int aWithDelay)
+{
+  if (mPendingResponses.empty()) {
+    // bus was idle, new timing base
+    mWallBase = MainLoop::now();
+    mBusBase = mBusTime;
+  }
+  if (aWithDelay>0) mBusTime += aWithDelay;
+  uint8_t resp1 = RESP_CODE_ACK;
+  uint8_t resp2 = ACK_OK;
+  int answer = -1;
+  switch (aCmd) {
+    case CMD_CODE_RESET:
+    case CMD_CODE_OVLRESET:
+    case CMD_CODE_EDGEADJ:
+      // bridge internal only
+      break;
+    case CMD_CODE_ECHO_DATA1:
+      resp1 = RESP_CODE_DATA; resp2 = aDali1;
+      break;
+    case CMD_CODE_ECHO_DATA2:
+      resp1 = RESP_CODE_DATA; resp2 = aDali2;
+      break;
+    case CMD_CODE_SEND16:
+      processForwardFrame(aDali1, aDali2, false, answer);
+      mBusTime += DALI_FORWARD_FRAME_TIME+DALI_FORWARD_SETTLING_TIME;
+      break;
+    case CMD_CODE_2SEND16:
+      processForwardFrame(aDali1, aDali2, true, answer);
+      mBusTime += 2*DALI_FORWARD_FRAME_TIME+DALI_DOUBLESEND_GAP+DALI_FORWARD_SETTLING_TIME;
+      break;
+    case CMD_CODE_SEND16_REC8:
+      processForwardFrame(aDali1, aDali2, false, answer);
+      mBusTime += DALI_FORWARD_FRAME_TIME;
+      if (answer==-1) {
+        resp2 = ACK_TIMEOUT;
+        mBusTime += DALI_NO_ANSWER_TIME;
+      }
+      else {
+        mBackwardFrames++;
+        mBusTime += DALI_BACKWARD_SETTLING_TIME+DALI_BACKWARD_FRAME_TIME;
+        if (answer==-2) {
+          resp2 = ACK_FRAME_ERR;
+        }
+        else {
+          resp1 = RESP_CODE_DATA;
+          resp2 = answer;
+        }
+      }
+      mBusTime += DALI_FORWARD_SETTLING_TIME;
+      break;
+    default:
+      resp2 = ACK_INVALIDCMD;
+      break;
+  }
+  FOCUSLOG("DALI sim: bridge cmd %02X %02X %02X -> %02X %02X", aCmd, aDali1, aDali2, resp1, resp2);
+  queueResponse(aResultCB, resp1, resp2);
+}
+
+
+void DaliBusSimulator::queueResponse(DaliBridgeResultCB aResultCB, uint8_t aResp1, uint8_t aResp2)
+{
+  PendingResponse r;
+  r.callback = aResultCB;
+  r.resp1 = aResp1;
+  r.resp2 = aResp2;
+  r.busTime = mBusTime;
+  mPendingResponses.push_back(r);
+  if (mPendingResponses.size()==1) {
+    // first in queue, schedule delivery
+    MLMicroSeconds delay = mWallBase+(MLMicroSeconds)((r.busTime-mBusBase)*mSpeed)-MainLoop::now();
+    mResponseTicket.executeOnce(boost::bind(&DaliBusSimulator::deliverResponses, this), delay>0 ? delay : 0);
+  }
+}
+
+
+void DaliBusSimulator::deliverResponses()
+{
+  // deliver one response per mainloop cycle, like a real serial connection would
+  if (mPendingResponses.empty()) return;
+  PendingResponse r = mPendingResponses.front();
+  mPendingResponses.pop_front();
+  if (!mPendingResponses.empty()) {
+    MLMicroSeconds delay = mWallBase+(MLMicroSeconds)((mPendingResponses.front().busTime-mBusBase)*mSpeed)-MainLoop::now();
+    mResponseTicket.executeOnce(boost::bind(&DaliBusSimulator::deliverResponses, this), delay>0 ? delay : 0);
+  }
+  // Note: callback might cause new commands to be queued (and even delete this simulator), so must be last
+  if (r.callback) r.callback(r.resp1, r.resp2, ErrorPtr());
+}
+
+
+// MARK: - DALI bus and control gear
+
+void DaliBusSimulator::processForwardFrame(uint8_t aDali1, uint8_t aDali2, bool aTwice, int &aAnswer)
+{
+  aAnswer = -1;
+  mForwardFrames += aTwice ? 2 : 1;
+  // frame losses
+  if (aTwice) {
+    bool lost1 = chance(mDropoutProbability);
+    bool lost2 = chance(mDropoutProbability);
+    if (lost1) mDropouts++;
+    if (lost2) mDropouts++;
+    if (lost1 && lost2) return;
+    if (lost1 || lost2) aTwice = false; // only received once, which is not enough for config commands
+  }
+  else if (chance(mDropoutProbability)) {
+    mDropouts++;
+    mEnabledDeviceType = -1;
+    return;
+  }
+  if (aDali1>=0xA1 && aDali1<=0xCB && (aDali1 & 0x01)) {
+    // special command
+    specialCommand(aDali1, aDali2, aTwice, aAnswer);
+    return;
+  }
+  if (aDali1>=0xA0 && aDali1<0xFC) {
+    // reserved
+    mEnabledDeviceType = -1;
+    return;
+  }
+  int numAnswers = 0;
+  bool differing = false;
+  bool single = aDali1<0x80;
+  for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+    if (!gearAddressed(*pos, aDali1)) continue;
+    if ((aDali1 & 0x01)==0) {
+      // direct arc power
+      pos->setLevel(aDali2);
+      if (pos->isDT8() && (pos->mGearFeatures & 0x01)) pos->activateColor(); // auto-activation
+    }
+    else {
+      collectAnswer(gearCommand(*pos, aDali2, aTwice, single), aAnswer, numAnswers, differing);
+    }
+  }
+  if (numAnswers>1 && (differing || chance(mCollisionProbability))) {
+    mCollisions++;
+    aAnswer = -2;
+  }
+  mEnabledDeviceType = -1; // only valid for one command
+}
+
+
+void DaliBusSimulator::collectAnswer(int aGearAnswer, int &aAnswer, int &aNumAnswers, bool &aDiffering)
+{
+  if (aGearAnswer<0) return;
+  if (aNumAnswers>0 && aGearAnswer!=aAnswer) aDiffering = true;
+  aAnswer = aGearAnswer;
+  aNumAnswers++;
+}
+
+
+bool DaliBusSimulator::gearAddressed(const DaliSimGear &aGear, uint8_t aDali1)
+{
+  if (aDali1>=0xFE) return true; // broadcast
+  if (aDali1>=0xFC) return aGear.mShortAddress==0xFF; // broadcast unaddressed
+  if (aDali1 & 0x80) return (aGear.mGroups & (1<<((aDali1>>1) & DaliGroupMask)))!=0; // group
+  return aGear.mShortAddress==((aDali1>>1) & DaliAddressMask); // short address
+}
+
+
+void DaliBusSimulator::specialCommand(uint8_t aDali1, uint8_t aDali2, bool aTwice, int &aAnswer)
+{
+  int numAnswers = 0;
+  bool differing = false;
+  if (aDali1==DALICMD_ENABLE_DEVICE_TYPE) {
+    mEnabledDeviceType = aDali2;
+    return;
+  }
+  mEnabledDeviceType = -1;
+  switch (aDali1) {
+    case DALICMD_TERMINATE:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        pos->mInitialised = false;
+        pos->mWithdrawn = false;
+      }
+      break;
+    case DALICMD_SET_DTR:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) pos->mDtr0 = aDali2;
+      break;
+    case DALICMD_SET_DTR1:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) pos->mDtr1 = aDali2;
+      break;
+    case DALICMD_SET_DTR2:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) pos->mDtr2 = aDali2;
+      break;
+    case DALICMD_INITIALISE:
+      if (!aTwice) break;
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (
+          aDali2==0x00 || // all
+          (aDali2==0xFF && pos->mShortAddress==0xFF) || // those without short address
+          ((aDali2 & 0x81)==0x01 && pos->mShortAddress==((aDali2>>1) & DaliAddressMask)) // specific one
+        ) {
+          pos->mInitialised = true;
+          pos->mWithdrawn = false;
+        }
+      }
+      break;
+    case DALICMD_RANDOMISE:
+      if (!aTwice) break;
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (pos->mInitialised) pos->mRandomAddress = rand() & 0xFFFFFF;
+      }
+      break;
+    case DALICMD_SEARCHADDRH: mSearchAddress = (mSearchAddress & 0x00FFFF) | ((uint32_t)aDali2<<16); break;
+    case DALICMD_SEARCHADDRM: mSearchAddress = (mSearchAddress & 0xFF00FF) | ((uint32_t)aDali2<<8); break;
+    case DALICMD_SEARCHADDRL: mSearchAddress = (mSearchAddress & 0xFFFF00) | aDali2; break;
+    case DALICMD_COMPARE:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (pos->mInitialised && !pos->mWithdrawn && pos->mRandomAddress<=mSearchAddress) {
+          collectAnswer(DALIANSWER_YES, aAnswer, numAnswers, differing);
+        }
+      }
+      break;
+    case DALICMD_WITHDRAW:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (pos->mInitialised && pos->mRandomAddress==mSearchAddress) pos->mWithdrawn = true;
+      }
+      break;
+    case DALICMD_PROGRAM_SHORT_ADDRESS:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (pos->mInitialised && pos->mRandomAddress==mSearchAddress) {
+          pos->mShortAddress = aDali2==0xFF ? 0xFF : (aDali2>>1) & DaliAddressMask;
+        }
+      }
+      break;
+    case DALICMD_VERIFY_SHORT_ADDRESS:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (pos->mInitialised && pos->mShortAddress==((aDali2>>1) & DaliAddressMask)) {
+          collectAnswer(DALIANSWER_YES, aAnswer, numAnswers, differing);
+        }
+      }
+      break;
+    case DALICMD_QUERY_SHORT_ADDRESS:
+      for (DaliSimGearVector::iterator pos = mGears.begin(); pos!=mGears.end(); ++pos) {
+        if (pos->mInitialised && !pos->mWithdrawn && pos->mRandomAddress==mSearchAddress) {
+          collectAnswer(pos->mShortAddress==0xFF ? 0xFF : (pos->mShortAddress<<1)+1, aAnswer, numAnswers, differing);
+        }
+      }
+      break;
+    default:
+      // PING, PHYSICAL_SELECTION, WRITE_MEMORY_LOCATION etc. have no effect on simulated gear
+      break;
+  }
+  if (numAnswers>1 && (differing || chance(mCollisionProbability))) {
+    mCollisions++;
+    aAnswer = -2;
+  }
+}
+
+
+int DaliBusSimulator::gearCommand(DaliSimGear &aGear, uint8_t aCmd, bool aTwice, bool aSingleAddressed)
+{
+  // device type specific extended commands
+  if (aCmd>=0xE0) {
+    if (mEnabledDeviceType<0 || mEnabledDeviceType!=aGear.mDeviceType) return -1; // not for this gear
+    if (aCmd==DALICMD_QUERY_EXTENDED_VERSION) return SIM_DALI_VERSION;
+    if (aGear.isDT8()) return dt8Command(aGear, aCmd, aTwice);
+    // DT6
+    switch (aCmd) {
+      case DALICMD_DT6_SELECT_DIMMING_CURVE & 0xFF: return -1; // only standard curve supported
+      case DALICMD_DT6_QUERY_DIMMING_CURVE & 0xFF: return 0; // standard logarithmic
+      case DALICMD_DT6_QUERY_POSSIBLE_OPERATING_MODES & 0xFF: return 0x01; // PWM
+    }
+    return -1;
+  }
+  // configuration commands must be received twice
+  if (aCmd>=DALICMD_RESET && aCmd<=DALICMD_ENABLE_WRITE_MEMORY && !aTwice) return -1;
+  // standard commands
+  if (aCmd>=DALICMD_GO_TO_SCENE && aCmd<DALICMD_GO_TO_SCENE+DALI_MAXSCENES) {
+    aGear.setLevel(aGear.mScenes[aCmd & DaliSceneMask]);
+    return -1;
+  }
+  if (aCmd>=DALICMD_STORE_DTR_AS_SCENE && aCmd<DALICMD_STORE_DTR_AS_SCENE+DALI_MAXSCENES) {
+    aGear.mScenes[aCmd & DaliSceneMask] = aGear.mDtr0;
+    return -1;
+  }
+  if (aCmd>=DALICMD_REMOVE_FROM_SCENE && aCmd<DALICMD_REMOVE_FROM_SCENE+DALI_MAXSCENES) {
+    aGear.mScenes[aCmd & DaliSceneMask] = 0xFF;
+    return -1;
+  }
+  if (aCmd>=DALICMD_ADD_TO_GROUP && aCmd<DALICMD_ADD_TO_GROUP+DALI_MAXGROUPS) {
+    aGear.mGroups |= 1<<(aCmd & DaliGroupMask);
+    return -1;
+  }
+  if (aCmd>=DALICMD_REMOVE_FROM_GROUP && aCmd<DALICMD_REMOVE_FROM_GROUP+DALI_MAXGROUPS) {
+    aGear.mGroups &= ~(1<<(aCmd & DaliGroupMask));
+    return -1;
+  }
+  if (aCmd>=DALICMD_QUERY_SCENE_LEVEL && aCmd<DALICMD_QUERY_SCENE_LEVEL+DALI_MAXSCENES) {
+    return aGear.mScenes[aCmd & DaliSceneMask];
+  }
+  // steps per dimming period at current fade rate (fade rate 1 = 358 steps/sec, halving every 2 rates)
+  int dimSteps = (int)(506.0/pow(M_SQRT2, aGear.mFadeRate)*DALI_DIM_STEP_TIME/Second);
+  if (dimSteps<1) dimSteps = 1;
+  switch (aCmd) {
+    case DALICMD_OFF: aGear.mActualLevel = 0; break;
+    case DALICMD_UP:
+      if (aGear.mActualLevel>0) aGear.setLevel(aGear.mActualLevel+dimSteps>aGear.mMaxLevel ? aGear.mMaxLevel : aGear.mActualLevel+dimSteps);
+      break;
+    case DALICMD_DOWN:
+      if (aGear.mActualLevel>0) aGear.setLevel(aGear.mActualLevel-dimSteps<aGear.mMinLevel ? aGear.mMinLevel : aGear.mActualLevel-dimSteps);
+      break;
+    case DALICMD_STEP_UP:
+      if (aGear.mActualLevel>0 && aGear.mActualLevel<aGear.mMaxLevel) aGear.mActualLevel++;
+      break;
+    case DALICMD_STEP_DOWN:
+      if (aGear.mActualLevel>aGear.mMinLevel) aGear.mActualLevel--;
+      break;
+    case DALICMD_RECALL_MAX_LEVEL: aGear.mActualLevel = aGear.mMaxLevel; break;
+    case DALICMD_RECALL_MIN_LEVEL: aGear.mActualLevel = aGear.mMinLevel; break;
+    case DALICMD_STEP_DOWN_AND_OFF:
+      if (aGear.mActualLevel<=aGear.mMinLevel) aGear.mActualLevel = 0; else aGear.mActualLevel--;
+      break;
+    case DALICMD_ON_AND_STEP_UP:
+      if (aGear.mActualLevel==0) aGear.mActualLevel = aGear.mMinLevel; else if (aGear.mActualLevel<aGear.mMaxLevel) aGear.mActualLevel++;
+      break;
+    // configuration
+    case DALICMD_RESET: aGear.reset(); break;
+    case DALICMD_STORE_ACTUAL_LEVEL_IN_DTR: aGear.mDtr0 = aGear.mActualLevel; break;
+    case DALICMD_STORE_DTR_AS_MAX_LEVEL: aGear.mMaxLevel = aGear.mDtr0<aGear.mMinLevel ? aGear.mMinLevel : (aGear.mDtr0>254 ? 254 : aGear.mDtr0); break;
+    case DALICMD_STORE_DTR_AS_MIN_LEVEL: aGear.mMinLevel = aGear.mDtr0<aGear.mPhysMinLevel ? aGear.mPhysMinLevel : (aGear.mDtr0>aGear.mMaxLevel ? aGear.mMaxLevel : aGear.mDtr0); break;
+    case DALICMD_STORE_DTR_AS_FAILURE_LEVEL: aGear.mFailureLevel = aGear.mDtr0; break;
+    case DALICMD_STORE_DTR_AS_POWER_ON_LEVEL: aGear.mPowerOnLevel = aGear.mDtr0; break;
+    case DALICMD_STORE_DTR_AS_FADE_TIME: aGear.mFadeTime = aGear.mDtr0>15 ? 15 : aGear.mDtr0; break;
+    case DALICMD_STORE_DTR_AS_FADE_RATE: aGear.mFadeRate = aGear.mDtr0<1 ? 1 : (aGear.mDtr0>15 ? 15 : aGear.mDtr0); break;
+    case DALICMD_STORE_DTR_AS_SHORT_ADDRESS:
+      if (aSingleAddressed) aGear.mShortAddress = aGear.mDtr0==0xFF ? 0xFF : (aGear.mDtr0>>1) & DaliAddressMask;
+      break;
+    case DALICMD_ENABLE_WRITE_MEMORY: aGear.mWriteEnabled = true; break;
+    // queries
+    case DALICMD_QUERY_STATUS:
+      return
+        (aGear.mActualLevel>0 ? 0x04 : 0) |
+        (aGear.mLimitError ? 0x08 : 0) |
+        (aGear.mShortAddress==0xFF ? 0x40 : 0);
+    case DALICMD_QUERY_CONTROL_GEAR: return DALIANSWER_YES;
+    case DALICMD_QUERY_LAMP_FAILURE: return -1;
+    case DALICMD_QUERY_LAMP_POWER_ON: return aGear.mActualLevel>0 ? DALIANSWER_YES : -1;
+    case DALICMD_QUERY_LIMIT_ERROR: return aGear.mLimitError ? DALIANSWER_YES : -1;
+    case DALICMD_QUERY_RESET_STATE: return -1;
+    case DALICMD_QUERY_MISSING_SHORT_ADDRESS: return aGear.mShortAddress==0xFF ? DALIANSWER_YES : -1;
+    case DALICMD_QUERY_VERSION_NUMBER: return aGear.mBank0[0x16];
+    case DALICMD_QUERY_CONTENT_DTR: return aGear.mDtr0;
+    case DALICMD_QUERY_DEVICE_TYPE: return aGear.mDeviceType;
+    case DALICMD_QUERY_PHYSICAL_MINIMUM_LEVEL: return aGear.mPhysMinLevel;
+    case DALICMD_QUERY_POWER_FAILURE: return -1;
+    case DALICMD_QUERY_CONTENT_DTR1: return aGear.mDtr1;
+    case DALICMD_QUERY_CONTENT_DTR2: return aGear.mDtr2;
+    case DALICMD_QUERY_ACTUAL_LEVEL: return aGear.mActualLevel;
+    case DALICMD_QUERY_MAX_LEVEL: return aGear.mMaxLevel;
+    case DALICMD_QUERY_MIN_LEVEL: return aGear.mMinLevel;
+    case DALICMD_QUERY_POWER_ON_LEVEL: return aGear.mPowerOnLevel;
+    case DALICMD_QUERY_FAILURE_LEVEL: return aGear.mFailureLevel;
+    case DALICMD_QUERY_FADE_PARAMS: return (aGear.mFadeTime<<4) | aGear.mFadeRate;
+    case DALICMD_QUERY_GROUPS_0_TO_7: return aGear.mGroups & 0xFF;
+    case DALICMD_QUERY_GROUPS_8_TO_15: return (aGear.mGroups>>8) & 0xFF;
+    case DALICMD_QUERY_RANDOM_ADDRESS_H: return (aGear.mRandomAddress>>16) & 0xFF;
+    case DALICMD_QUERY_RANDOM_ADDRESS_M: return (aGear.mRandomAddress>>8) & 0xFF;
+    case DALICMD_QUERY_RANDOM_ADDRESS_L: return aGear.mRandomAddress & 0xFF;
+    case DALICMD_READ_MEMORY_LOCATION: {
+      // bank in DTR1, location in DTR, DTR auto-increments
+      if (aGear.mDtr1!=0) return -1; // only bank 0 implemented
+      uint8_t loc = aGear.mDtr0;
+      if (loc>aGear.mBank0[0x00]) return -1; // beyond last accessible location
+      if (aGear.mDtr0<0xFF) aGear.mDtr0++;
+      if (loc==0x01) return -1; // reserved location, answers NO in DALI 2.0
+      return aGear.mBank0[loc];
+    }
+  }
+  return -1;
+}
+
+
+int DaliBusSimulator::dt8Command(DaliSimGear &aGear, uint8_t aCmd, bool aTwice)
+{
+  // DT8 configuration commands must be received twice
+  if (aCmd>=0xF0 && aCmd<=0xF6 && !aTwice) return -1;
+  switch (aCmd) {
+    case DALICMD_DT8_SET_TEMP_XCOORD & 0xFF:
+      aGear.mTempX = ((uint16_t)aGear.mDtr1<<8) + aGear.mDtr0;
+      aGear.mTempColorMode = 0x10;
+      break;
+    case DALICMD_DT8_SET_TEMP_YCOORD & 0xFF:
+      aGear.mTempY = ((uint16_t)aGear.mDtr1<<8) + aGear.mDtr0;
+      aGear.mTempColorMode = 0x10;
+      break;
+    case DALICMD_DT8_SET_TEMP_CT & 0xFF:
+      if ((aGear.mColorFeatures & 0x02)==0) break;
+      aGear.mTempMired = ((uint16_t)aGear.mDtr1<<8) + aGear.mDtr0;
+      aGear.mTempColorMode = 0x20;
+      break;
+    case DALICMD_DT8_SET_TEMP_RGB & 0xFF:
+      aGear.mTempRGBWA[0] = aGear.mDtr0;
+      aGear.mTempRGBWA[1] = aGear.mDtr1;
+      aGear.mTempRGBWA[2] = aGear.mDtr2;
+      aGear.mTempColorMode = 0x80;
+      break;
+    case DALICMD_DT8_SET_TEMP_WAF & 0xFF:
+      aGear.mTempRGBWA[3] = aGear.mDtr0;
+      aGear.mTempRGBWA[4] = aGear.mDtr1;
+      aGear.mTempColorMode = 0x80;
+      break;
+    case DALICMD_DT8_SET_TEMP_RGBWAF_CTRL & 0xFF:
+      break;
+    case DALICMD_DT8_ACTIVATE & 0xFF:
+      aGear.activateColor();
+      break;
+    case DALICMD_DT8_SET_GEAR_FEATURES & 0xFF:
+      aGear.mGearFeatures = (aGear.mGearFeatures & ~0x01) | (aGear.mDtr0 & 0x01);
+      break;
+    case DALICMD_DT8_QUERY_GEAR_STATUS & 0xFF: return aGear.mGearFeatures;
+    case DALICMD_DT8_QUERY_COLOR_STATUS & 0xFF: return aGear.mColorMode;
+    case DALICMD_DT8_QUERY_COLOR_FEATURES & 0xFF: return aGear.mColorFeatures;
+    case DALICMD_DT8_QUERY_COLOR_VALUE & 0xFF: {
+      // selector in DTR, MSB is answered, LSB goes to DTR
+      uint16_t v;
+      switch (aGear.mDtr0) {
+        case 0: v = aGear.mX; break;
+        case 1: v = aGear.mY; break;
+        case 2: v = aGear.mMired; break;
+        case 233: case 234: case 235: case 236: case 237:
+          v = aGear.mRGBWA[aGear.mDtr0-233]; break;
+        default: return 0xFF; // MASK: value not available
+      }
+      aGear.mDtr0 = v & 0xFF;
+      return (v>>8) & 0xFF;
+    }
+  }
+  return -1;
+}
+
+
+// MARK: - DaliBusBenchmark
+
+#define BENCHMARK_DIM_REPEATS 10 // number of UP commands per dimming benchmark (= 2 seconds of dimming)
+#define BENCHMARK_SCENE_LEVEL 200 // DALI arc power level used for scene benchmarks
+#define BENCHMARK_SCENE_MIRED 300 // color temperature used for scene benchmarks
+#define BENCHMARK_SCENE_NO 15 // DALI scene number used for native scene benchmark
+
+static const char *benchmarkStepNames[] = {
+  "scan",
+  "startup",
+  "scenesSingle",
+  "scenesBroadcast",
+  "dimSingle",
+  "dimBroadcast"
+};
+
+
+void DaliBusBenchmark::run(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  // create new instance, deletes itself when finished
+  DaliBusBenchmark *bm = new DaliBusBenchmark(aRequest, aParams);
+  bm->nextBus();
+}
+
+
+DaliBusBenchmark::DaliBusBenchmark(VdcApiRequestPtr aRequest, ApiValuePtr aParams) :
+  mRequest(aRequest),
+  mSizeIndex(0),
+  mStep(bm_done),
+  mDT8Mask(0)
+{
+  ApiValuePtr o = aParams->get("sizes");
+  if (o && o->isType(apivalue_array)) {
+    for (int i=0; i<o->arrayLength(); i++) {
+      int n = o->arrayGet(i)->int32Value();
+      if (n>0 && n<=DALI_MAXDEVICES) mSizes.push_back(n);
+    }
+  }
+  if (mSizes.empty()) {
+    mSizes.push_back(16);
+    mSizes.push_back(32);
+    mSizes.push_back(64);
+  }
+  o = aParams->get("config");
+  if (o) mConfig = o->stringValue();
+  mResults = aRequest->newApiValue();
+  mResults->setType(apivalue_array);
+}
+
+
+void DaliBusBenchmark::nextBus()
+{
+  // release previous bus
+  mDaliComm.reset();
+  mSimulator.reset();
+  if (mSizeIndex>=mSizes.size()) {
+    // all done
+    ApiValuePtr res = mRequest->newApiValue();
+    res->setType(apivalue_object);
+    res->add("buses", mResults);
+    mRequest->sendResult(res);
+    delete this;
+    return;
+  }
+  int n = mSizes[mSizeIndex++];
+  mSimulator = DaliBusSimulatorPtr(new DaliBusSimulator(string_format("n=%d,%s", n, mConfig.c_str())));
+  mDaliComm = DaliCommPtr(new DaliComm(MainLoop::currentMainLoop()));
+  mDaliComm->setSimulator(mSimulator);
+  mDT8Mask = 0;
+  mBusResult = mResults->newObject();
+  mBusResult->add("gears", mBusResult->newUint64(n));
+  mBusResult->add("simulator", mBusResult->newString(mSimulator->description()));
+  mBusResult->add("steps", mBusResult->newObject());
+  LOG(LOG_NOTICE, "DALI benchmark: starting with %d control gears", n);
+  startStep(bm_scan);
+}
+
+
+void DaliBusBenchmark::markStart()
+{
+  mStartFrames = mDaliComm->mSentFrames;
+  mStartBusTime = mSimulator->mBusTime;
+  mStartWallTime = MainLoop::now();
+}
+
+
+void DaliBusBenchmark::startStep(BenchmarkStep aStep)
+{
+  mStep = aStep;
+  if (mStep>=bm_done) {
+    // this bus is done
+    mBusResult->add("found", mBusResult->newUint64(mAddresses ? mAddresses->size() : 0));
+    mBusResult->add("collisions", mBusResult->newInt64(mSimulator->mCollisions));
+    mBusResult->add("dropouts", mBusResult->newInt64(mSimulator->mDropouts));
+    mResults->arrayAppend(mBusResult);
+    nextBus();
+    return;
+  }
+  markStart();
+  switch (mStep) {
+    case bm_scan:
+      // full scan, assigning short addresses to all gear
+      mDaliComm->daliFullBusScan(boost::bind(&DaliBusBenchmark::scanDone, this, _1, _2, _3), false);
+      return;
+    case bm_startup:
+      // read the same information from each gear as the vdc does at startup
+      mNextAddress = mAddresses->begin();
+      startupNextDevice();
+      return;
+    case bm_scenesSingle:
+      // scene call delivered device by device: DT8 color and brightness per device
+      for (DaliComm::ShortAddressList::iterator pos = mAddresses->begin(); pos!=mAddresses->end(); ++pos) {
+        DaliAddress a = *pos;
+        bool last = pos==--mAddresses->end();
+        if (mDT8Mask & ((uint64_t)1<<a)) {
+          mDaliComm->daliSend16BitValueAndCommand(a, DALICMD_DT8_SET_TEMP_CT, BENCHMARK_SCENE_MIRED);
+          mDaliComm->daliSendDirectPower(a, BENCHMARK_SCENE_LEVEL);
+          mDaliComm->daliSendCommand(a, DALICMD_DT8_ACTIVATE, doneCB(last));
+        }
+        else {
+          mDaliComm->daliSendDirectPower(a, BENCHMARK_SCENE_LEVEL, doneCB(last));
+        }
+      }
+      break;
+    case bm_scenesBroadcast:
+      // native scene: store scene (not measured, done once by the optimizer), then call it and set common color
+      mDaliComm->daliSendDtrAndConfigCommand(DaliBroadcast, DALICMD_STORE_DTR_AS_SCENE+BENCHMARK_SCENE_NO, BENCHMARK_SCENE_LEVEL, boost::bind(&DaliBusBenchmark::sceneStored, this, _1));
+      return;
+    case bm_dimSingle:
+      // dimming device by device, repeated every 200mS
+      for (int r=0; r<BENCHMARK_DIM_REPEATS; r++) {
+        for (DaliComm::ShortAddressList::iterator pos = mAddresses->begin(); pos!=mAddresses->end(); ++pos) {
+          bool last = r==BENCHMARK_DIM_REPEATS-1 && pos==--mAddresses->end();
+          mDaliComm->daliSendCommand(*pos, DALICMD_UP, doneCB(last), r>0 && pos==mAddresses->begin() ? DALI_DIM_STEP_TIME : -1);
+        }
+      }
+      break;
+    case bm_dimBroadcast:
+      // dimming all with broadcast, repeated every 200mS
+      for (int r=0; r<BENCHMARK_DIM_REPEATS; r++) {
+        bool last = r==BENCHMARK_DIM_REPEATS-1;
+        mDaliComm->daliSendCommand(DaliBroadcast, DALICMD_UP, doneCB(last), r>0 ? DALI_DIM_STEP_TIME : -1);
+      }
+      break;
+    default:
+      break;
+  }
+  if (mAddresses->empty()) {
+    // nothing was sent, no callback will come
+    stepDone(ErrorPtr());
+  }
+}
+
+
+void DaliBusBenchmark::stepDone(ErrorPtr aError)
+{
+  ApiValuePtr s = mBusResult->newObject();
+  s->add("frames", s->newInt64(mDaliComm->mSentFrames-mStartFrames));
+  s->add("busTime", s->newDouble((double)(mSimulator->mBusTime-mStartBusTime)/Second));
+  s->add("wallTime", s->newDouble((double)(MainLoop::now()-mStartWallTime)/Second));
+  if (Error::notOK(aError)) s->add("error", s->newString(aError->text()));
+  mBusResult->get("steps")->add(benchmarkStepNames[mStep], s);
+  LOG(LOG_INFO,
+    "DALI benchmark: %s with %zu gears: %lld frames, bus time %.3f S, wall time %.3f S",
+    benchmarkStepNames[mStep], mSimulator->numGears(),
+    (long long)(mDaliComm->mSentFrames-mStartFrames),
+    (double)(mSimulator->mBusTime-mStartBusTime)/Second,
+    (double)(MainLoop::now()-mStartWallTime)/Second
+  );
+  // continue from mainloop, as we might be called from within DaliComm or simulator
+  mStepTicket.executeOnce(boost::bind(&DaliBusBenchmark::startStep, this, (BenchmarkStep)(mStep+1)));
+}
+
+
+void DaliBusBenchmark::scanDone(DaliComm::ShortAddressListPtr aShortAddressListPtr, DaliComm::ShortAddressListPtr aUnreliableShortAddressListPtr, ErrorPtr aError)
+{
+  mAddresses = aShortAddressListPtr;
+  if (!mAddresses) mAddresses = DaliComm::ShortAddressListPtr(new DaliComm::ShortAddressList);
+  stepDone(aError);
+}
+
+
+void DaliBusBenchmark::startupNextDevice()
+{
+  if (mNextAddress==mAddresses->end()) {
+    stepDone(ErrorPtr());
+    return;
+  }
+  mDaliComm->daliReadDeviceInfo(boost::bind(&DaliBusBenchmark::startupDeviceInfo, this, _1, _2), *mNextAddress);
+}
+
+
+void DaliBusBenchmark::startupDeviceInfo(DaliDeviceInfoPtr aDaliDeviceInfoPtr, ErrorPtr aError)
+{
+  DaliAddress a = *mNextAddress;
+  mDaliComm->daliSendQuery(a, DALICMD_QUERY_DEVICE_TYPE, boost::bind(&DaliBusBenchmark::startupDeviceType, this, a, _1, _2, _3));
+}
+
+
+void DaliBusBenchmark::startupDeviceType(DaliAddress aAddress, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
+{
+  if (Error::isOK(aError) && !aNoOrTimeout) {
+    // extended version of the device type
+    mDaliComm->daliSendQuery(aAddress, ((DaliCommand)aResponse<<8)+DALICMD_QUERY_EXTENDED_VERSION, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+    if (aResponse==DT8_TYPE_COLOR) {
+      mDT8Mask |= (uint64_t)1<<aAddress;
+      mDaliComm->daliSendQuery(aAddress, DALICMD_DT8_QUERY_COLOR_FEATURES, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+      mDaliComm->daliSendQuery(aAddress, DALICMD_DT8_QUERY_GEAR_STATUS, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+      mDaliComm->daliSendQuery(aAddress, DALICMD_DT8_QUERY_COLOR_STATUS, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+      mDaliComm->daliSendDtrAnd16BitQuery(aAddress, DALICMD_DT8_QUERY_COLOR_VALUE, 2, boost::bind(&DaliBusBenchmark::queryDone16, this, _1, _2));
+    }
+  }
+  // groups and status
+  mDaliComm->daliSendQuery(aAddress, DALICMD_QUERY_GROUPS_0_TO_7, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+  mDaliComm->daliSendQuery(aAddress, DALICMD_QUERY_GROUPS_8_TO_15, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+  mDaliComm->daliSendQuery(aAddress, DALICMD_QUERY_MIN_LEVEL, boost::bind(&DaliBusBenchmark::queryDone, this, _1, _2, _3));
+  mDaliComm->daliSendQuery(aAddress, DALICMD_QUERY_ACTUAL_LEVEL, boost::bind(&DaliBusBenchmark::startupQueriesDone, this, _1, _2, _3));
+}
+
+
+void DaliBusBenchmark::queryDone(bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
+{
+  // results not needed, only bus load counts
+}
+
+
+void DaliBusBenchmark::queryDone16(uint16_t a16BitResult, ErrorPtr aError)
+{
+  // results not needed, only bus load counts
+}
+
+
+void DaliBusBenchmark::startupQueriesDone(bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
+{
+  ++mNextAddress;
+  startupNextDevice();
+}
+
+
+void DaliBusBenchmark::sceneStored(ErrorPtr aError)
+{
+  // now measure the actual scene call
+  markStart();
+  if (mDT8Mask) {
+    // common color for all DT8 gear
+    mDaliComm->daliSend16BitValueAndCommand(DaliBroadcast, DALICMD_DT8_SET_TEMP_CT, BENCHMARK_SCENE_MIRED);
+    mDaliComm->daliSendCommand(DaliBroadcast, DALICMD_GO_TO_SCENE+BENCHMARK_SCENE_NO);
+    mDaliComm->daliSendCommand(DaliBroadcast, DALICMD_DT8_ACTIVATE, boost::bind(&DaliBusBenchmark::commandsDone, this, _1));
+  }
+  else {
+    mDaliComm->daliSendCommand(DaliBroadcast, DALICMD_GO_TO_SCENE+BENCHMARK_SCENE_NO, boost::bind(&DaliBusBenchmark::commandsDone, this, _1));
+  }
+}
+
+
+DaliComm::DaliCommandStatusCB DaliBusBenchmark::doneCB(bool aLast)
+{
+  // only the last command of a step needs a callback, as responses arrive in sequence
+  if (!aLast) return DaliComm::DaliCommandStatusCB();
+  return boost::bind(&DaliBusBenchmark::commandsDone, this, _1);
+}
+
+
+void DaliBusBenchmark::commandsDone(ErrorPtr aError)
+{
+  stepDone(aError);
+}
+
+#endif // ENABLE_DALI && ENABLE_DALI_SIMULATOR
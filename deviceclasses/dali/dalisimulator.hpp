@@ -0,0 +1,246 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__dalisimulator__
+#define __p44vdc__dalisimulator__
+
+#include "p44vdc_common.hpp"
+
+#if ENABLE_DALI
+
+#include "dalicomm.hpp"
+
+#if ENABLE_DALI_SIMULATOR
+
+#include "vdcapi.hpp"
+
+#include <deque>
+
+using namespace std;
+
+namespace p44 {
+
+  /// a simulated DALI control gear (ballast)
+  class DaliSimGear
+  {
+  public:
+    DaliSimGear();
+
+    /// reset gear to DALI RESET state (does not affect short address)
+    void reset();
+
+    uint8_t mShortAddress; ///< short address 0..63, 0xFF if none
+    uint32_t mRandomAddress; ///< 24-bit random address
+    bool mInitialised; ///< in initialisation mode (INITIALISE received)
+    bool mWithdrawn; ///< withdrawn from random address search
+    uint16_t mGroups; ///< group membership bitmask
+    uint8_t mScenes[DALI_MAXSCENES]; ///< scene levels, 0xFF=MASK (not part of scene)
+    uint8_t mActualLevel; ///< current arc power level
+    uint8_t mMinLevel;
+    uint8_t mMaxLevel;
+    uint8_t mPhysMinLevel;
+    uint8_t mPowerOnLevel;
+    uint8_t mFailureLevel;
+    uint8_t mFadeTime;
+    uint8_t mFadeRate;
+    uint8_t mDtr0, mDtr1, mDtr2; ///< data transfer registers
+    bool mWriteEnabled; ///< memory writing enabled
+    bool mLimitError; ///< last level request was out of min/max limits
+    // device type
+    uint8_t mDeviceType; ///< 6 (LED) or 8 (color)
+    // DT8 color
+    uint8_t mColorFeatures; ///< DT8 color type features (as returned by QUERY_COLOR_TYPE_FEATURES)
+    uint8_t mGearFeatures; ///< DT8 gear features/status (bit0: auto-activation)
+    uint8_t mColorMode; ///< active color mode: 0x10=xy, 0x20=CT, 0x80=RGBWAF
+    uint8_t mTempColorMode; ///< color mode of temporary values
+    uint16_t mX, mY, mMired; ///< active color
+    uint16_t mTempX, mTempY, mTempMired; ///< temporary color
+    uint8_t mRGBWA[5], mTempRGBWA[5]; ///< active and temporary RGBWA channel levels
+    // memory
+    std::vector<uint8_t> mBank0; ///< memory bank 0 contents
+
+    /// @return true if this gear is DT8 color gear
+    bool isDT8() const { return mDeviceType==DT8_TYPE_COLOR; };
+
+    /// set the level, clamped to min/max as gear would do it
+    void setLevel(uint8_t aLevel);
+
+    /// copy temporary color values to active ones
+    void activateColor();
+  };
+  typedef std::vector<DaliSimGear> DaliSimGearVector;
+
+
+  class DaliBusSimulator;
+  typedef boost::intrusive_ptr<DaliBusSimulator> DaliBusSimulatorPtr;
+
+  /// Simulates a DALI bridge with a DALI bus and a number of control gears connected to it.
+  /// Bridge commands are answered with the same response codes as a real bridge would, after the
+  /// time the DALI frames would take on a real bus (scaled by the speed factor, 0=as fast as possible).
+  class DaliBusSimulator : public P44Obj
+  {
+    typedef struct {
+      DaliBridgeResultCB callback;
+      uint8_t resp1;
+      uint8_t resp2;
+      MLMicroSeconds busTime; ///< simulated bus time when response is complete
+    } PendingResponse;
+    typedef std::deque<PendingResponse> PendingResponseQueue;
+
+    DaliSimGearVector mGears;
+    uint32_t mRandomState; ///< state of the simulator's PRNG (xorshift32)
+    double mSpeed; ///< time scaling factor: 0=no delays, 1=real time
+    double mDropoutProbability; ///< probability of a forward frame not being received by the gears
+    double mCollisionProbability; ///< probability of identical answers from multiple gears still producing a frame error
+
+    // bus wide state
+    uint32_t mSearchAddress; ///< search address for random address search
+    int mEnabledDeviceType; ///< device type enabled for the next command, -1 if none
+
+    // response delivery
+    PendingResponseQueue mPendingResponses;
+    MLTicket mResponseTicket;
+    MLMicroSeconds mWallBase; ///< main loop time corresponding to mBusBase
+    MLMicroSeconds mBusBase; ///< simulated bus time when bus became busy last time
+
+  public:
+
+    // statistics
+    MLMicroSeconds mBusTime; ///< accumulated simulated time the bus was busy
+    long mForwardFrames; ///< number of forward frames sent
+    long mBackwardFrames; ///< number of backward frames (answers) received
+    long mCollisions; ///< number of backward frames that were garbled by multiple gears answering
+    long mDropouts; ///< number of forward frames lost
+
+    /// create simulator
+    /// @param aConfig configuration string: comma separated key=value pairs
+    ///   - n: number of control gears (default 16)
+    ///   - dt8: number of those that are DT8 color gear (default: half of them)
+    ///   - addressed: number of gear having a short address already (default: none, needs a full bus scan)
+    ///   - seed: random seed, for reproducible runs (default: 42)
+    ///   - speed: time scaling factor, 0=no delays (default), 1=real DALI timing
+    ///   - dropout: probability (0..1) of a forward frame getting lost
+    ///   - collision: probability (0..1) of identical simultaneous answers still producing a frame error
+    DaliBusSimulator(const string aConfig);
+
+    /// @return number of simulated control gears
+    size_t numGears() const { return mGears.size(); };
+
+    /// reset statistics
+    void resetStats();
+
+    /// process a bridge command
+    /// @param aCmd bridge command byte
+    /// @param aDali1 first DALI byte
+    /// @param aDali2 second DALI byte
+    /// @param aResultCB callback executed when bridge response arrives
+    /// @param aWithDelay if>0, time (in microseconds) to delay BEFORE sending the command
+    void sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, DaliBridgeResultCB aResultCB, int aWithDelay);
+
+    /// @return description of the simulated bus
+    string description();
+
+  private:
+
+    uint32_t rand();
+    bool chance(double aProbability);
+
+    void setupGear(DaliSimGear &aGear, bool aDT8, int aIndex);
+    void processForwardFrame(uint8_t aDali1, uint8_t aDali2, bool aTwice, int &aAnswer);
+    void specialCommand(uint8_t aDali1, uint8_t aDali2, bool aTwice, int &aAnswer);
+    bool gearAddressed(const DaliSimGear &aGear, uint8_t aDali1);
+    int gearCommand(DaliSimGear &aGear, uint8_t aCmd, bool aTwice, bool aSingleAddressed);
+    int dt8Command(DaliSimGear &aGear, uint8_t aCmd, bool aTwice);
+    void collectAnswer(int aGearAnswer, int &aAnswer, int &aNumAnswers, bool &aDiffering);
+
+    void queueResponse(DaliBridgeResultCB aResultCB, uint8_t aResp1, uint8_t aResp2);
+    void deliverResponses();
+
+  };
+
+
+  /// benchmark for DALI bus operations, running against simulated busses of different sizes
+  class DaliBusBenchmark : public P44Obj
+  {
+    typedef enum {
+      bm_scan,
+      bm_startup,
+      bm_scenesSingle,
+      bm_scenesBroadcast,
+      bm_dimSingle,
+      bm_dimBroadcast,
+      bm_done
+    } BenchmarkStep;
+
+    VdcApiRequestPtr mRequest;
+    std::vector<int> mSizes; ///< bus sizes to benchmark
+    size_t mSizeIndex; ///< index of bus size currently benchmarked
+    string mConfig; ///< additional simulator config
+    ApiValuePtr mResults; ///< results array
+    ApiValuePtr mBusResult; ///< result of current bus
+    // current run
+    DaliBusSimulatorPtr mSimulator;
+    DaliCommPtr mDaliComm;
+    BenchmarkStep mStep;
+    DaliComm::ShortAddressListPtr mAddresses; ///< addresses found in scan
+    DaliComm::ShortAddressList::iterator mNextAddress;
+    uint64_t mDT8Mask; ///< short addresses of DT8 gear found at startup
+    MLTicket mStepTicket;
+    long mStartFrames;
+    MLMicroSeconds mStartBusTime;
+    MLMicroSeconds mStartWallTime;
+
+  public:
+
+    /// run the benchmark and send the results as answer to aRequest
+    /// @param aRequest the API request to answer with the results
+    /// @param aParams the parameters:
+    ///   - sizes: array of bus sizes (number of control gears) to benchmark, default [16,32,64]
+    ///   - config: additional simulator configuration (see DaliBusSimulator), such as "dropout=0.01,speed=1"
+    static void run(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+
+  private:
+
+    DaliBusBenchmark(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+
+    void nextBus();
+    void markStart();
+    void startStep(BenchmarkStep aStep);
+    void stepDone(ErrorPtr aError);
+    void scanDone(DaliComm::ShortAddressListPtr aShortAddressListPtr, DaliComm::ShortAddressListPtr aUnreliableShortAddressListPtr, ErrorPtr aError);
+    void startupNextDevice();
+    void startupDeviceInfo(DaliDeviceInfoPtr aDaliDeviceInfoPtr, ErrorPtr aError);
+    void startupDeviceType(DaliAddress aAddress, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void queryDone(bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void queryDone16(uint16_t a16BitResult, ErrorPtr aError);
+    void startupQueriesDone(bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void sceneStored(ErrorPtr aError);
+    DaliComm::DaliCommandStatusCB doneCB(bool aLast);
+    void commandsDone(ErrorPtr aError);
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_DALI_SIMULATOR
+#endif // ENABLE_DALI
+#endif // __p44vdc__dalisimulator__
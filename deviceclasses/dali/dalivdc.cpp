@@ -26,6 +26,10 @@
 
 #if ENABLE_DALI
 
+#if ENABLE_DALI_SIMULATOR
+  #include "dalisimulator.hpp"
+#endif
+
 using namespace p44;
 
 // Note:
@@ -44,8 +48,19 @@ DaliVdc::DaliVdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag) :
   mUsedDaliScenesMask(0),
   mUsedDaliGroupsMask(0),
   mDaliDefaultGamma(P44_HISTORIC_DALI_GAMMA), // conservative - we fetch that from DB, but in case not, use old behaviour
+  mColorUpdateBatches(0),
+  mColorUpdateFrames(0),
+  mColorUpdateFramesSaved(0),
+  mProbeRefreshFrames(0),
+  mProbeCacheHits(0),
+  mProbeCacheMisses(0),
+  mProbeRefreshes(0),
+  mProbeRefreshChanges(0),
+  mCollectStartedAt(Never),
+  mCollectStartFrames(0),
   mDaliComm(MainLoop::currentMainLoop())
 {
+  resetGroupMemberships();
   mDaliComm.isMemberVariable();
   #if ENABLE_DALI_INPUTS
   mDaliComm.setBridgeEventHandler(boost::bind(&DaliVdc::daliEventHandler, this, _1, _2, _3));
@@ -83,6 +98,16 @@ const char *DaliVdc::vdcClassIdentifier() const
 }
 
 
+#if ENABLE_DALI_SIMULATOR
+
+bool DaliVdc::isSimulated()
+{
+  return mDaliComm.simulator()!=NULL;
+}
+
+#endif // ENABLE_DALI_SIMULATOR
+
+
 bool DaliVdc::getDeviceIcon(string &aIcon, bool aWithData, const char *aResolutionPrefix)
 {
   if (getIcon("vdc_dali", aIcon, aWithData, aResolutionPrefix))
@@ -102,8 +127,9 @@ bool DaliVdc::getDeviceIcon(string &aIcon, bool aWithData, const char *aResoluti
 //  4 : added dali2ScanLock to keep compatibility with old installations that might have scanned DALI 2.x devices as 1.0
 //  5 : extended dali2ScanLock to also use bit1 as dali2LUNLock
 //  6 : added daliDefaultGamma, initializing it with modern value, but using approximation of historic brightness/dalivalue when upgrading
+//  7 : added probeCache table for persisted probe results
 #define DALI_SCHEMA_MIN_VERSION 1 // minimally supported version, anything older will be deleted
-#define DALI_SCHEMA_VERSION 6 // current version
+#define DALI_SCHEMA_VERSION 7 // current version
 
 string DaliPersistence::schemaUpgradeSQL(int aFromVersion, int &aToVersion)
 {
@@ -115,6 +141,19 @@ string DaliPersistence::schemaUpgradeSQL(int aFromVersion, int &aToVersion)
     " daliBaseAddr INTEGER," // DALI base address (internal abstracted DaliAddress type) of input device
     " PRIMARY KEY (daliBaseAddr)"
     ");";
+  // probe cache table needed for fromVersion==0 and 6
+  static const char *probeCacheTable =
+    "CREATE TABLE $PREFIX_probeCache ("
+    " shortAddress INTEGER," // DALI short address of the control gear
+    " dSUID TEXT," // dSUID of the bus device the results were probed from
+    " deviceType INTEGER," // answer to QUERY_DEVICE_TYPE (fingerprint)
+    " features INTEGER," // feature flags
+    " dt8Features INTEGER," // DT8 color features byte
+    " dt8GearStatus INTEGER," // DT8 gear status byte
+    " groups INTEGER," // group membership bitmask, -1 if unknown
+    " minLevel INTEGER," // physical minimum level, -1 if unknown
+    " PRIMARY KEY (shortAddress)"
+    ");";
 
   if (aFromVersion==0) {
     // create table group from scratch
@@ -133,6 +172,7 @@ string DaliPersistence::schemaUpgradeSQL(int aFromVersion, int &aToVersion)
       ");"
     );
     sql.append(inputDevicesTable);
+    sql.append(probeCacheTable);
 		// - add dali2ScanLock to globs table and set it to 0 (this is a fresh installation)
     sql.append(
       "ALTER TABLE $PREFIX_globs ADD dali2ScanLock INTEGER;"
@@ -179,6 +219,12 @@ string DaliPersistence::schemaUpgradeSQL(int aFromVersion, int &aToVersion)
     // reached version 6
     aToVersion = 6;
   }
+  else if (aFromVersion==6) {
+    // V6->V7: added persisted probe results
+    sql = probeCacheTable;
+    // reached version 7
+    aToVersion = 7;
+  }
   return sql;
 }
 
@@ -205,6 +251,8 @@ void DaliVdc::initialize(StatusCB aCompletedCB, bool aFactoryReset)
   }
   // update map of groups and scenes used by manually configured groups and scene-listening input devices
   reserveLocallyUsedGroupsAndScenes();
+  // load persisted probe results
+  loadProbeCache();
   // return status of DB init
 	aCompletedCB(err);
 }
@@ -224,8 +272,22 @@ int DaliVdc::getRescanModes() const
 
 void DaliVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
 {
+  mCollectStartedAt = MainLoop::now();
+  mCollectStartFrames = mDaliComm.mSentFrames;
+  mProbeRefreshTicket.cancel();
+  aCompletedCB = boost::bind(&DaliVdc::collectingDone, this, aCompletedCB, _1);
+  if (aRescanFlags & (rescanmode_exhaustive|rescanmode_reenumerate|rescanmode_clearsettings)) {
+    // short addresses might change, or user wants to start over: do not trust any persisted probe results
+    mProbeCache.clear();
+    mDb.prefixedExecute("DELETE FROM $PREFIX_probeCache");
+  }
   if (!(aRescanFlags & rescanmode_incremental)) {
+    // persisted probe results must be verified again
+    for (DaliProbeInfoMap::iterator pos = mProbeCache.begin(); pos!=mProbeCache.end(); ++pos) {
+      pos->second.validated = false;
+    }
     removeDevices(aRescanFlags & rescanmode_clearsettings);
+    resetGroupMemberships(); // will be collected again while initializing devices
     // clear the cache, we want fresh info from the devices!
     mDeviceInfoCache.clear();
     #if ENABLE_DALI_INPUTS
@@ -266,6 +328,7 @@ void DaliVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
 
 void DaliVdc::removeLightDevices(bool aForget)
 {
+  mPendingColorUpdates.clear(); // bus devices are going away
   DeviceVector::iterator pos = mDevices.begin();
   while (pos!=mDevices.end()) {
     DaliOutputDevicePtr dev = boost::dynamic_pointer_cast<DaliOutputDevice>(*pos);
@@ -289,9 +352,13 @@ void DaliVdc::removeLightDevices(bool aForget)
 // recollect devices after grouping change without scanning bus again
 void DaliVdc::recollectDevices(StatusCB aCompletedCB)
 {
-
+  mCollectStartedAt = MainLoop::now();
+  mCollectStartFrames = mDaliComm.mSentFrames;
+  mProbeRefreshTicket.cancel();
+  aCompletedCB = boost::bind(&DaliVdc::collectingDone, this, aCompletedCB, _1);
   // remove DALI scannable output devices (but not inputs)
   removeLightDevices(false);
+  resetGroupMemberships(); // will be collected again while initializing devices
   // no scan needed, just use the cache
   // - create a Dali bus device for every cached devInf
   DaliBusDeviceListPtr busDevices(new DaliBusDeviceList);
@@ -648,6 +715,12 @@ ErrorPtr DaliVdc::handleMethod(VdcApiRequestPtr aRequest, const string &aMethod,
     // summary: returns documentation about devices on bus, reliability, device assignments etc.
     respErr = daliSummary(aRequest, aParams);
   }
+  #if ENABLE_DALI_SIMULATOR
+  else if (aMethod=="x-p44-daliBenchmark") {
+    // benchmark: scan, startup, scene calls and dimming on simulated busses of different sizes
+    DaliBusBenchmark::run(aRequest, aParams);
+  }
+  #endif
   else {
     respErr = inherited::handleMethod(aRequest, aMethod, aParams);
   }
@@ -1143,6 +1216,8 @@ void DaliVdc::removeMemberships(DaliAddress aSceneOrGroup)
   else if ((aSceneOrGroup&DaliAddressTypeMask)==DaliGroup) {
     // Make sure no old group settings remain -> broadcast DALICMD_REMOVE_FROM_GROUP
     mDaliComm.daliSendConfigCommand(DaliBroadcast, DALICMD_REMOVE_FROM_GROUP+(aSceneOrGroup&DaliGroupMask));
+    mGroupMembers[aSceneOrGroup&DaliGroupMask] = 0;
+    noteGroupChange(DaliBroadcast, aSceneOrGroup&DaliGroupMask, false);
   }
 }
 
@@ -1171,6 +1246,440 @@ void DaliVdc::reserveLocallyUsedGroupsAndScenes()
 
 
 
+// MARK: - persisted probe results
+
+#define PROBE_REFRESH_DELAY (5*Minute) // how long after collecting to start refreshing persisted probe results in the background
+#define PROBE_REFRESH_INTERVAL (15*Second) // interval between background re-probes, bus must have been idle during that time
+
+void DaliVdc::loadProbeCache()
+{
+  mProbeCache.clear();
+  SQLiteTGQuery qry(mDb);
+  if (Error::isOK(qry.prefixedPrepare("SELECT shortAddress, dSUID, deviceType, features, dt8Features, dt8GearStatus, groups, minLevel FROM $PREFIX_probeCache"))) {
+    for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
+      DaliProbeInfo &pi = mProbeCache[i->get<int>(0)];
+      pi.dSUID = nonNullCStr(i->get<const char *>(1));
+      pi.deviceType = i->get<int>(2);
+      pi.features = i->get<int>(3);
+      pi.dt8Features = i->get<int>(4);
+      pi.dt8GearStatus = i->get<int>(5);
+      pi.groups = i->get<int>(6);
+      pi.minLevel = i->get<int>(7);
+      pi.validated = false;
+      pi.needsRefresh = true;
+    }
+  }
+  OLOG(LOG_INFO, "loaded persisted probe results for %zu control gears", mProbeCache.size());
+}
+
+
+void DaliVdc::saveProbeInfo(DaliAddress aShortAddress)
+{
+  DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+  if (pos==mProbeCache.end()) return;
+  DaliProbeInfo &pi = pos->second;
+  ErrorPtr err = mDb.prefixedExecute(
+    "INSERT OR REPLACE INTO $PREFIX_probeCache (shortAddress, dSUID, deviceType, features, dt8Features, dt8GearStatus, groups, minLevel) VALUES (%d,'%q',%d,%d,%d,%d,%d,%d)",
+    aShortAddress, pi.dSUID.c_str(), pi.deviceType, pi.features, pi.dt8Features, pi.dt8GearStatus, pi.groups, pi.minLevel
+  );
+  if (Error::notOK(err)) {
+    OLOG(LOG_ERR, "Error saving probe results for short address %d: %s", aShortAddress, err->text());
+  }
+}
+
+
+bool DaliVdc::getProbeInfo(DaliAddress aShortAddress, const DsUid &aDsUid, uint8_t aDeviceType, DaliProbeInfo &aProbeInfo)
+{
+  DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+  if (pos!=mProbeCache.end()) {
+    if (pos->second.dSUID==aDsUid.getString() && pos->second.deviceType==aDeviceType) {
+      // fingerprint matches, trust persisted results
+      pos->second.validated = true;
+      aProbeInfo = pos->second;
+      mProbeCacheHits++;
+      return true;
+    }
+    // different control gear at this address, or reconfigured: persisted results are no longer valid
+    OLOG(LOG_INFO, "persisted probe results for short address %d do not match device any more -> probing again", aShortAddress);
+    mProbeCache.erase(pos);
+  }
+  mProbeCacheMisses++;
+  return false;
+}
+
+
+void DaliVdc::storeProbeInfo(DaliAddress aShortAddress, const DsUid &aDsUid, uint8_t aDeviceType, uint8_t aFeatures, uint8_t aDT8Features, uint8_t aDT8GearStatus)
+{
+  if ((aShortAddress&DaliAddressTypeMask)!=DaliSingle) return;
+  DaliProbeInfo &pi = mProbeCache[aShortAddress];
+  if (pi.dSUID!=aDsUid.getString()) {
+    // new entry or different device: nothing known about groups and levels
+    pi.dSUID = aDsUid.getString();
+    pi.groups = -1;
+    pi.minLevel = -1;
+  }
+  pi.deviceType = aDeviceType;
+  pi.features = aFeatures;
+  pi.dt8Features = aDT8Features;
+  pi.dt8GearStatus = aDT8GearStatus;
+  pi.validated = true;
+  pi.needsRefresh = false; // just probed
+  saveProbeInfo(aShortAddress);
+}
+
+
+int DaliVdc::probedGroups(DaliAddress aShortAddress)
+{
+  DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+  if (pos==mProbeCache.end() || !pos->second.validated) return -1;
+  return pos->second.groups;
+}
+
+
+void DaliVdc::storeProbedGroups(DaliAddress aShortAddress, uint16_t aGroups)
+{
+  DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+  if (pos==mProbeCache.end() || pos->second.groups==aGroups) return;
+  pos->second.groups = aGroups;
+  saveProbeInfo(aShortAddress);
+}
+
+
+void DaliVdc::noteGroupChange(DaliAddress aAddress, uint8_t aGroupNo, bool aAdded)
+{
+  uint16_t m = 1<<(aGroupNo&DaliGroupMask);
+  for (DaliProbeInfoMap::iterator pos = mProbeCache.begin(); pos!=mProbeCache.end(); ++pos) {
+    if (pos->second.groups<0) continue; // not known anyway
+    if (aAddress==DaliBroadcast || aAddress==pos->first) {
+      uint16_t groups = aAdded ? pos->second.groups|m : pos->second.groups&~m;
+      if (groups!=pos->second.groups) {
+        pos->second.groups = groups;
+        saveProbeInfo(pos->first);
+      }
+    }
+  }
+}
+
+
+int DaliVdc::probedMinLevel(DaliAddress aShortAddress)
+{
+  DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+  if (pos==mProbeCache.end() || !pos->second.validated) return -1;
+  return pos->second.minLevel;
+}
+
+
+void DaliVdc::storeProbedMinLevel(DaliAddress aShortAddress, uint8_t aMinLevel)
+{
+  DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+  if (pos==mProbeCache.end() || pos->second.minLevel==aMinLevel) return;
+  pos->second.minLevel = aMinLevel;
+  saveProbeInfo(aShortAddress);
+}
+
+
+void DaliVdc::collectingDone(StatusCB aCompletedCB, ErrorPtr aError)
+{
+  OLOG(LOG_NOTICE,
+    "collecting DALI bus took %.3f seconds and %ld DALI frames (probe results so far: %ld control gears from DB, %ld probed on the bus)",
+    (double)(MainLoop::now()-mCollectStartedAt)/Second, mDaliComm.mSentFrames-mCollectStartFrames,
+    mProbeCacheHits, mProbeCacheMisses
+  );
+  // verify results taken from DB in the background later
+  for (DaliProbeInfoMap::iterator pos = mProbeCache.begin(); pos!=mProbeCache.end(); ++pos) {
+    if (pos->second.needsRefresh) {
+      mProbeRefreshFrames = mDaliComm.mSentFrames;
+      mProbeRefreshTicket.executeOnce(boost::bind(&DaliVdc::probeRefreshNext, this), PROBE_REFRESH_DELAY);
+      break;
+    }
+  }
+  if (aCompletedCB) aCompletedCB(aError);
+}
+
+
+void DaliVdc::probeRefreshNext()
+{
+  if (mDaliComm.isBusy() || mDaliComm.mSentFrames!=mProbeRefreshFrames) {
+    // bus has been in use recently, try again later
+    mProbeRefreshFrames = mDaliComm.mSentFrames;
+    mProbeRefreshTicket.executeOnce(boost::bind(&DaliVdc::probeRefreshNext, this), PROBE_REFRESH_INTERVAL);
+    return;
+  }
+  for (DaliProbeInfoMap::iterator pos = mProbeCache.begin(); pos!=mProbeCache.end(); ++pos) {
+    if (!pos->second.needsRefresh) continue;
+    pos->second.needsRefresh = false;
+    DaliDeviceInfoMap::iterator ipos = mDeviceInfoCache.find(pos->first);
+    if (!pos->second.validated || ipos==mDeviceInfoCache.end()) continue; // not on the bus (any more)
+    // re-probe this control gear on the bus, bypassing persisted results
+    FOCUSOLOG("re-probing control gear at short address %d in background", pos->first);
+    DaliBusDevicePtr busDevice = DaliBusDevicePtr(new DaliBusDevice(*this));
+    busDevice->setDeviceInfo(ipos->second);
+    busDevice->mBypassProbeCache = true;
+    busDevice->queryFeatureSet(boost::bind(&DaliVdc::probeRefreshFeaturesDone, this, busDevice, pos->second, _1));
+    return;
+  }
+  OLOG(LOG_INFO, "background refresh of persisted probe results done: %ld control gears re-probed, %ld with changes", mProbeRefreshes, mProbeRefreshChanges);
+}
+
+
+void DaliVdc::probeRefreshFeaturesDone(DaliBusDevicePtr aBusDevice, DaliProbeInfo aBefore, ErrorPtr aError)
+{
+  DaliAddress sa = aBusDevice->mDeviceInfo->mShortAddress;
+  bool changed = false;
+  if (Error::isOK(aError)) {
+    DaliProbeInfoMap::iterator pos = mProbeCache.find(sa);
+    if (
+      pos==mProbeCache.end() ||
+      pos->second.deviceType!=aBefore.deviceType ||
+      pos->second.features!=aBefore.features ||
+      pos->second.dt8Features!=aBefore.dt8Features ||
+      pos->second.dt8GearStatus!=aBefore.dt8GearStatus
+    ) {
+      OLOG(LOG_WARNING, "features of control gear at short address %d have changed -> persisted probe results updated, will be used at next rescan", sa);
+      changed = true;
+    }
+  }
+  // - group memberships
+  mDaliComm.daliSendQuery(sa, DALICMD_QUERY_GROUPS_0_TO_7, boost::bind(&DaliVdc::probeRefreshGroups0to7, this, sa, aBefore, changed, _1, _2, _3));
+}
+
+
+void DaliVdc::probeRefreshGroups0to7(DaliAddress aShortAddress, DaliProbeInfo aBefore, bool aChanged, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
+{
+  if (Error::notOK(aError) || aNoOrTimeout) {
+    // no reliable answer, skip groups
+    probeRefreshGroups8to15(aShortAddress, aBefore, aChanged, 0, aNoOrTimeout, aResponse, aError);
+    return;
+  }
+  mDaliComm.daliSendQuery(aShortAddress, DALICMD_QUERY_GROUPS_8_TO_15, boost::bind(&DaliVdc::probeRefreshGroups8to15, this, aShortAddress, aBefore, aChanged, aResponse, _1, _2, _3));
+}
+
+
+void DaliVdc::probeRefreshGroups8to15(DaliAddress aShortAddress, DaliProbeInfo aBefore, bool aChanged, uint16_t aGroups, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
+{
+  if (Error::isOK(aError) && !aNoOrTimeout) {
+    aGroups |= ((uint16_t)aResponse)<<8;
+    int known = probedGroups(aShortAddress);
+    if (known>=0 && known!=aGroups) {
+      OLOG(LOG_WARNING, "group memberships of control gear at short address %d have changed: 0x%04X -> 0x%04X", aShortAddress, known, aGroups);
+      storeProbedGroups(aShortAddress, aGroups);
+      DaliProbeInfoMap::iterator pos = mProbeCache.find(aShortAddress);
+      noteGroupMemberships(aShortAddress, aGroups, pos!=mProbeCache.end() && (pos->second.features & daliprobe_dt8));
+      aChanged = true;
+    }
+  }
+  // - physical minimum level
+  mDaliComm.daliSendQuery(aShortAddress, DALICMD_QUERY_PHYSICAL_MINIMUM_LEVEL, boost::bind(&DaliVdc::probeRefreshMinLevel, this, aShortAddress, aBefore, aChanged, _1, _2, _3));
+}
+
+
+void DaliVdc::probeRefreshMinLevel(DaliAddress aShortAddress, DaliProbeInfo aBefore, bool aChanged, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
+{
+  if (Error::isOK(aError) && !aNoOrTimeout) {
+    int known = probedMinLevel(aShortAddress);
+    if (known>=0 && known!=aResponse) {
+      OLOG(LOG_WARNING, "physical minimum level of control gear at short address %d has changed: %d -> %d", aShortAddress, known, aResponse);
+      storeProbedMinLevel(aShortAddress, aResponse);
+      aChanged = true;
+    }
+  }
+  mProbeRefreshes++;
+  if (aChanged) mProbeRefreshChanges++;
+  // next one, when bus is idle again
+  mProbeRefreshFrames = mDaliComm.mSentFrames;
+  mProbeRefreshTicket.executeOnce(boost::bind(&DaliVdc::probeRefreshNext, this), PROBE_REFRESH_INTERVAL);
+}
+
+
+
+// MARK: - DT8 color delivery
+
+#define COLOR_UPDATE_COLLECT_TIME (10*MilliSecond) // how long to collect color updates from multiple devices before delivering them
+
+void DaliVdc::handleGlobalEvent(VdchostEvent aEvent)
+{
+  if (aEvent==vdchost_logstats) {
+    if (mColorUpdateBatches>0) {
+      OLOG(LOG_INFO,
+        "DT8 color delivery: %ld batches, %ld DALI bus frames used, %ld saved compared to device-by-device delivery",
+        mColorUpdateBatches, mColorUpdateFrames, mColorUpdateFramesSaved
+      );
+    }
+    OLOG(LOG_INFO,
+      "persisted probe results: %zu control gears known, %ld used, %ld probed on the bus, %ld re-probed in background, %ld of these had changed",
+      mProbeCache.size(), mProbeCacheHits, mProbeCacheMisses, mProbeRefreshes, mProbeRefreshChanges
+    );
+  }
+  inherited::handleGlobalEvent(aEvent);
+}
+
+
+void DaliVdc::resetGroupMemberships()
+{
+  mDT8GearMask = 0;
+  mMembershipKnownMask = 0;
+  for (int g=0; g<16; g++) mGroupMembers[g] = 0;
+}
+
+
+void DaliVdc::noteGroupMemberships(DaliAddress aShortAddress, uint16_t aGroups, bool aDT8)
+{
+  if ((aShortAddress&DaliAddressTypeMask)!=DaliSingle) return;
+  uint64_t m = (uint64_t)1<<(aShortAddress&DaliAddressMask);
+  for (int g=0; g<16; g++) {
+    if (aGroups & (1<<g)) mGroupMembers[g] |= m; else mGroupMembers[g] &= ~m;
+  }
+  mMembershipKnownMask |= m;
+  if (aDT8) mDT8GearMask |= m; else mDT8GearMask &= ~m;
+}
+
+
+uint64_t DaliVdc::allGearMask()
+{
+  uint64_t m = 0;
+  for (DaliDeviceInfoMap::iterator pos = mDeviceInfoCache.begin(); pos!=mDeviceInfoCache.end(); ++pos) {
+    if ((pos->first&DaliAddressTypeMask)==DaliSingle) m |= (uint64_t)1<<(pos->first&DaliAddressMask);
+  }
+  return m;
+}
+
+
+DaliAddress DaliVdc::commonAddressFor(uint64_t aMembers, uint64_t aReceivers)
+{
+  // aReceivers is the set of gear that would act upon the command (e.g. only DT8 gear for DT8 commands)
+  // Note: receiver sets such as mDT8GearMask only contain gear with known group memberships, so they are
+  //   complete (and broadcast/groups cannot reach unexpected gear) only when this is known for all gear on the bus
+  if ((allGearMask() & ~mMembershipKnownMask)!=0) return NoDaliAddress;
+  if (aMembers==aReceivers) return DaliBroadcast;
+  // look for group with exactly the members needed
+  for (int g=0; g<16; g++) {
+    if ((mGroupMembers[g] & aReceivers)==aMembers) return DaliGroup+g;
+  }
+  return NoDaliAddress;
+}
+
+
+void DaliVdc::queueColorUpdate(DaliBusDevicePtr aBusDevice, bool aWithBrightness)
+{
+  for (DaliColorUpdateList::iterator pos = mPendingColorUpdates.begin(); pos!=mPendingColorUpdates.end(); ++pos) {
+    if (pos->busDevice==aBusDevice) {
+      // already pending, will be delivered with current values
+      if (aWithBrightness) pos->withBrightness = true;
+      return;
+    }
+  }
+  DaliColorUpdate u;
+  u.busDevice = aBusDevice;
+  u.withBrightness = aWithBrightness;
+  mPendingColorUpdates.push_back(u);
+  if (!mColorUpdateTicket) {
+    mColorUpdateTicket.executeOnce(boost::bind(&DaliVdc::deliverColorUpdates, this), COLOR_UPDATE_COLLECT_TIME);
+  }
+}
+
+
+void DaliVdc::deliverColorUpdates()
+{
+  mColorUpdateTicket.cancel();
+  DaliColorUpdateList updates;
+  updates.swap(mPendingColorUpdates);
+  if (updates.empty()) return;
+  long startFrames = mDaliComm.mSentFrames;
+  long individualFrames = 0; // frames device-by-device delivery would have needed
+  // - collect devices by identical color
+  typedef std::map<string, DaliColorUpdateList> ColorUpdateMap;
+  ColorUpdateMap byColor;
+  for (DaliColorUpdateList::iterator pos = updates.begin(); pos!=updates.end(); ++pos) {
+    byColor[pos->busDevice->colorParamsKey()].push_back(*pos);
+  }
+  // - set temporary colors
+  for (ColorUpdateMap::iterator cpos = byColor.begin(); cpos!=byColor.end(); ++cpos) {
+    if (cpos->first.empty()) continue; // no color registers to set
+    DaliColorUpdateList &devs = cpos->second;
+    DaliAddress a = NoDaliAddress;
+    if (devs.size()>1) {
+      uint64_t members = 0;
+      for (DaliColorUpdateList::iterator pos = devs.begin(); pos!=devs.end(); ++pos) {
+        members |= (uint64_t)1<<(pos->busDevice->mDeviceInfo->mShortAddress&DaliAddressMask);
+      }
+      a = commonAddressFor(members, mDT8GearMask);
+    }
+    long f = mDaliComm.mSentFrames;
+    if (a!=NoDaliAddress) {
+      OLOG(LOG_INFO, "setting color %s for %zu devices at once via %s", cpos->first.c_str(), devs.size(), DaliComm::formatDaliAddress(a).c_str());
+      devs.front().busDevice->sendColorParams(a);
+      individualFrames += (mDaliComm.mSentFrames-f)*devs.size();
+    }
+    else {
+      for (DaliColorUpdateList::iterator pos = devs.begin(); pos!=devs.end(); ++pos) {
+        pos->busDevice->sendColorParams(pos->busDevice->mDeviceInfo->mShortAddress);
+      }
+      individualFrames += mDaliComm.mSentFrames-f;
+    }
+  }
+  // - set brightness (devices with auto-activation will activate the new color with DAPC)
+  typedef std::map<uint8_t, DaliColorUpdateList> LevelUpdateMap;
+  LevelUpdateMap byLevel;
+  int numActivations = 0;
+  for (DaliColorUpdateList::iterator pos = updates.begin(); pos!=updates.end(); ++pos) {
+    DaliBusDevicePtr dev = pos->busDevice;
+    if (pos->withBrightness) {
+      byLevel[dev->brightnessToDaliLevel(dev->mCurrentBrightness)].push_back(*pos);
+    }
+    if (!pos->withBrightness || !dev->mDT8AutoActivation) numActivations++;
+    dev->activateColorParams(true); // only internal state, actual activation is sent below
+  }
+  uint64_t allGear = allGearMask();
+  for (LevelUpdateMap::iterator lpos = byLevel.begin(); lpos!=byLevel.end(); ++lpos) {
+    DaliColorUpdateList &devs = lpos->second;
+    DaliAddress a = NoDaliAddress;
+    if (devs.size()>1) {
+      uint64_t members = 0;
+      for (DaliColorUpdateList::iterator pos = devs.begin(); pos!=devs.end(); ++pos) {
+        members |= (uint64_t)1<<(pos->busDevice->mDeviceInfo->mShortAddress&DaliAddressMask);
+      }
+      a = commonAddressFor(members, allGear);
+    }
+    if (a!=NoDaliAddress) {
+      mDaliComm.daliSendDirectPower(a, lpos->first);
+    }
+    else {
+      for (DaliColorUpdateList::iterator pos = devs.begin(); pos!=devs.end(); ++pos) {
+        mDaliComm.daliSendDirectPower(pos->busDevice->mDeviceInfo->mShortAddress, lpos->first);
+      }
+    }
+    individualFrames += devs.size();
+  }
+  // - activate colors in devices that did not get a DAPC or have no auto-activation
+  if (numActivations>0) {
+    long f = mDaliComm.mSentFrames;
+    if (numActivations>1) {
+      // Note: like for native scene calls, devices not involved have no temporary colors set, so broadcasting activation is safe
+      mDaliComm.daliSendCommand(DaliBroadcast, DALICMD_DT8_ACTIVATE);
+      individualFrames += (mDaliComm.mSentFrames-f)*numActivations;
+    }
+    else {
+      for (DaliColorUpdateList::iterator pos = updates.begin(); pos!=updates.end(); ++pos) {
+        if (!pos->withBrightness || !pos->busDevice->mDT8AutoActivation) {
+          mDaliComm.daliSendCommand(pos->busDevice->mDeviceInfo->mShortAddress, DALICMD_DT8_ACTIVATE);
+        }
+      }
+      individualFrames += mDaliComm.mSentFrames-f;
+    }
+  }
+  // statistics
+  long frames = mDaliComm.mSentFrames-startFrames;
+  mColorUpdateBatches++;
+  mColorUpdateFrames += frames;
+  mColorUpdateFramesSaved += individualFrames-frames;
+  OLOG(LOG_INFO,
+    "color update for %zu devices (%zu distinct colors) uses %ld DALI bus frames (device-by-device: %ld)",
+    updates.size(), byColor.size(), frames, individualFrames
+  );
+}
+
+
+
 // MARK: - Native actions (groups and scenes on vDC level)
 
 static DaliAddress daliAddressFromActionId(const string aNativeActionId)
@@ -1214,6 +1723,7 @@ void DaliVdc::callNativeAction(StatusCB aStatusCB, const string aNativeActionId,
   if (a!=NoDaliAddress) {
     if (aDeliveryState->mOptimizedType==ntfy_callscene) {
       mGroupDimTicket.cancel(); // just safety, should be cancelled already
+      long startFrames = mDaliComm.mSentFrames;
       // set fade time according to scene transition time (usually: already ok, so no time wasted)
       // note: dalicomm will make sure the fade time adjustments are sent before the scene call
       bool needDT8Activation = false;
@@ -1237,6 +1747,7 @@ void DaliVdc::callNativeAction(StatusCB aStatusCB, const string aNativeActionId,
         // just call the scene
         mDaliComm.daliSendCommand(DaliBroadcast, DALICMD_GO_TO_SCENE+(a&DaliSceneMask), boost::bind(&DaliVdc::nativeActionDone, this, aStatusCB, _1));
       }
+      OLOG(LOG_INFO, "native scene call for %zu devices uses %ld DALI bus frames", aDeliveryState->mAffectedDevices.size(), mDaliComm.mSentFrames-startFrames);
       return;
     }
     else if (aDeliveryState->mOptimizedType==ntfy_dimchannel) {
@@ -1352,11 +1863,16 @@ void DaliVdc::createNativeAction(StatusCB aStatusCB, OptimizerEntryPtr aOptimize
     else if (aDeliveryState->mOptimizedType==ntfy_dimchannel) {
       // Make sure no old group settings remain -> broadcast DALICMD_REMOVE_FROM_GROUP
       mDaliComm.daliSendConfigCommand(DaliBroadcast, DALICMD_REMOVE_FROM_GROUP+(a&DaliGroupMask));
+      mGroupMembers[a&DaliGroupMask] = 0;
+      noteGroupChange(DaliBroadcast, a&DaliGroupMask, false);
       // now create new group -> for each affected device sent DALICMD_ADD_TO_GROUP
       for (DeviceList::iterator pos = aDeliveryState->mAffectedDevices.begin(); pos!=aDeliveryState->mAffectedDevices.end(); ++pos) {
         DaliSingleControllerDevicePtr dev = boost::dynamic_pointer_cast<DaliSingleControllerDevice>(*pos);
         if (dev && dev->mDaliController) {
-          mDaliComm.daliSendConfigCommand(dev->mDaliController->mDeviceInfo->mShortAddress, DALICMD_ADD_TO_GROUP+(a&DaliGroupMask));
+          DaliAddress sa = dev->mDaliController->mDeviceInfo->mShortAddress;
+          mDaliComm.daliSendConfigCommand(sa, DALICMD_ADD_TO_GROUP+(a&DaliGroupMask));
+          if ((sa&DaliAddressTypeMask)==DaliSingle) mGroupMembers[a&DaliGroupMask] |= (uint64_t)1<<(sa&DaliAddressMask);
+          noteGroupChange(sa, a&DaliGroupMask, true);
         }
       }
     }
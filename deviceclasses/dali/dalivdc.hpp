@@ -49,6 +49,16 @@ namespace p44 {
 
   typedef boost::shared_ptr<DaliBusDeviceList> DaliBusDeviceListPtr;
 
+  /// pending DT8 color update of a single bus device, to be delivered together with other devices' updates
+  typedef struct {
+    DaliBusDevicePtr busDevice; ///< the bus device, with the new color parameters already cached
+    bool withBrightness; ///< set if brightness (DAPC) must be sent as well
+  } DaliColorUpdate;
+  typedef std::list<DaliColorUpdate> DaliColorUpdateList;
+
+  /// persisted probe results by short address
+  typedef std::map<DaliAddress, DaliProbeInfo> DaliProbeInfoMap;
+
 
   /// persistence for enocean device container
   class DaliPersistence : public SQLite3TableGroup
@@ -76,6 +86,27 @@ namespace p44 {
     MLTicket mGroupDimTicket; ///< timer for group dimming
     MLTicket mRecollectDelayTicket; ///< timer for delayed recollect
 
+    // DT8 color delivery
+    uint64_t mDT8GearMask; ///< bitmask of short addresses of DT8 control gear
+    uint64_t mMembershipKnownMask; ///< bitmask of short addresses of control gear with known group memberships
+    uint64_t mGroupMembers[16]; ///< for each DALI group, bitmask of short addresses of known members
+    DaliColorUpdateList mPendingColorUpdates; ///< color updates waiting to be delivered
+    MLTicket mColorUpdateTicket; ///< timer for delivering pending color updates
+    long mColorUpdateBatches; ///< number of color update batches delivered
+    long mColorUpdateFrames; ///< number of DALI frames used to deliver color update batches
+    long mColorUpdateFramesSaved; ///< number of DALI frames saved compared to device-by-device delivery
+
+    // persisted probe results
+    DaliProbeInfoMap mProbeCache; ///< probe results by short address
+    MLTicket mProbeRefreshTicket; ///< timer for low priority background refresh of probe results
+    long mProbeRefreshFrames; ///< number of DALI frames sent at last background refresh check, to detect bus activity
+    long mProbeCacheHits; ///< number of control gear initialized from persisted probe results
+    long mProbeCacheMisses; ///< number of control gear that needed probing on the bus
+    long mProbeRefreshes; ///< number of control gear re-probed in the background
+    long mProbeRefreshChanges; ///< number of background re-probes that found changed results
+    MLMicroSeconds mCollectStartedAt; ///< when the current bus collect has started
+    long mCollectStartFrames; ///< number of DALI frames sent when the current bus collect has started
+
     #if ENABLE_DALI_INPUTS
     DaliInputDeviceList mInputDevices;
     #endif
@@ -118,6 +149,11 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() const P44_OVERRIDE { return "DALI"; }
 
+    #if ENABLE_DALI_SIMULATOR
+    /// @return true if the DALI bus is simulated
+    virtual bool isSimulated() P44_OVERRIDE;
+    #endif
+
     /// ungroup a previously grouped device
     /// @param aDevice the device to ungroup
     /// @param aRequest the API request that causes the ungroup, will be sent an OK when ungrouping is complete
@@ -135,6 +171,66 @@ namespace p44 {
     /// @return the default gamma to use for devices in this vdc (Note: compatible historic value for pre-Nov 2024 setups, modified one for later)
     double defaultGamma() { return mDaliDefaultGamma; }
 
+    /// handle global events
+    /// @param aEvent the event to handle
+    virtual void handleGlobalEvent(VdchostEvent aEvent) P44_OVERRIDE;
+
+    /// queue a DT8 color update for delivery
+    /// @param aBusDevice the bus device, which must have its new color parameters (and brightness) already
+    ///   set in deferred mode
+    /// @param aWithBrightness set if brightness must be sent as well
+    /// @note updates queued within a short time window are delivered together. Devices getting the same color
+    ///   get it with a single group or broadcast command sequence when the set of devices matches a DALI group
+    ///   or all DT8 gear on the bus.
+    void queueColorUpdate(DaliBusDevicePtr aBusDevice, bool aWithBrightness);
+
+    /// note actual DALI group memberships of a control gear
+    /// @param aShortAddress the short address of the control gear
+    /// @param aGroups bitmask of groups the gear is member of
+    /// @param aDT8 set if the gear is DT8 color gear (or might be)
+    void noteGroupMemberships(DaliAddress aShortAddress, uint16_t aGroups, bool aDT8);
+
+    /// get persisted probe results for a control gear, if they can be trusted
+    /// @param aShortAddress the short address of the control gear
+    /// @param aDsUid the dSUID of the bus device as derived from its device info
+    /// @param aDeviceType the answer of the control gear to DALICMD_QUERY_DEVICE_TYPE (fingerprint)
+    /// @param aProbeInfo will be set to the persisted probe results
+    /// @return true if there are persisted results matching dSUID and fingerprint
+    bool getProbeInfo(DaliAddress aShortAddress, const DsUid &aDsUid, uint8_t aDeviceType, DaliProbeInfo &aProbeInfo);
+
+    /// persist the results of probing a control gear's features
+    /// @param aShortAddress the short address of the control gear
+    /// @param aDsUid the dSUID of the bus device as derived from its device info
+    /// @param aDeviceType the answer of the control gear to DALICMD_QUERY_DEVICE_TYPE
+    /// @param aFeatures daliprobe_xxx feature flags
+    /// @param aDT8Features DT8 color features byte
+    /// @param aDT8GearStatus DT8 gear status byte
+    void storeProbeInfo(DaliAddress aShortAddress, const DsUid &aDsUid, uint8_t aDeviceType, uint8_t aFeatures, uint8_t aDT8Features, uint8_t aDT8GearStatus);
+
+    /// @param aShortAddress the short address of the control gear
+    /// @return persisted group membership bitmask, -1 if not known or not verified since last bus scan
+    int probedGroups(DaliAddress aShortAddress);
+
+    /// persist group memberships of a control gear
+    /// @param aShortAddress the short address of the control gear
+    /// @param aGroups bitmask of groups the gear is member of
+    void storeProbedGroups(DaliAddress aShortAddress, uint16_t aGroups);
+
+    /// update persisted group memberships after sending DALICMD_ADD_TO_GROUP or DALICMD_REMOVE_FROM_GROUP
+    /// @param aAddress the address the command was sent to (single control gear or broadcast)
+    /// @param aGroupNo the group number
+    /// @param aAdded true if added to the group, false if removed
+    void noteGroupChange(DaliAddress aAddress, uint8_t aGroupNo, bool aAdded);
+
+    /// @param aShortAddress the short address of the control gear
+    /// @return persisted physical minimum level, -1 if not known or not verified since last bus scan
+    int probedMinLevel(DaliAddress aShortAddress);
+
+    /// persist physical minimum level of a control gear
+    /// @param aShortAddress the short address of the control gear
+    /// @param aMinLevel the physical minimum level
+    void storeProbedMinLevel(DaliAddress aShortAddress, uint8_t aMinLevel);
+
   protected:
 
     /// @name Implementation methods for native scene and grouped dimming support
@@ -207,6 +303,20 @@ namespace p44 {
     void daliScanNext(VdcApiRequestPtr aRequest, DaliAddress aShortAddress, StringPtr aResult);
     void handleDaliScanResult(VdcApiRequestPtr aRequest, DaliAddress aShortAddress, StringPtr aResult, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
 
+    void loadProbeCache();
+    void saveProbeInfo(DaliAddress aShortAddress);
+    void collectingDone(StatusCB aCompletedCB, ErrorPtr aError);
+    void probeRefreshNext();
+    void probeRefreshFeaturesDone(DaliBusDevicePtr aBusDevice, DaliProbeInfo aBefore, ErrorPtr aError);
+    void probeRefreshGroups0to7(DaliAddress aShortAddress, DaliProbeInfo aBefore, bool aChanged, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void probeRefreshGroups8to15(DaliAddress aShortAddress, DaliProbeInfo aBefore, bool aChanged, uint16_t aGroups, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void probeRefreshMinLevel(DaliAddress aShortAddress, DaliProbeInfo aBefore, bool aChanged, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+
+    void resetGroupMemberships();
+    uint64_t allGearMask();
+    DaliAddress commonAddressFor(uint64_t aMembers, uint64_t aReceivers);
+    void deliverColorUpdates();
+
     void groupDimPrepared(StatusCB aStatusCB, DaliAddress aDaliAddress, NotificationDeliveryStatePtr aDeliveryState, ErrorPtr aError);
     void groupDimRepeater(DaliAddress aDaliAddress, uint8_t aCommand, MLTimer &aTimer);
     void nativeActionDone(StatusCB aStatusCB, ErrorPtr aError);
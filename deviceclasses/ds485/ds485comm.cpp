@@ -46,7 +46,8 @@ const char* Ds485CommError::errorName() const
 
 Ds485Comm::Ds485Comm() :
   mDs485Client(nullptr),
-  mQueryRunning(false)
+  mQueryRunning(false),
+  mSentRequests(0)
 {
 }
 
@@ -423,6 +424,7 @@ ErrorPtr Ds485Comm::issueRequest(DsUid aDestination, uint8_t aCommand, uint8_t a
     logContainer(FOCUSLOGLEVEL, request, "issueRequest sends:");
   }
   // Note: ds485_client_send_command does not block, only performs sockwrite()
+  mSentRequests++;
   return Error::errIfNotOk<Ds485CommError>(ds485_client_send_command(mDs485Client, &request));
 }
 
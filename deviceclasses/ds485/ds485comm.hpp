@@ -98,6 +98,8 @@ namespace p44 {
 
   public:
 
+    long mSentRequests; ///< number of request frames issued, for statistics
+
     Ds485Comm();
     virtual ~Ds485Comm();
 
@@ -704,10 +704,20 @@ bool Ds485Device::prepareSceneApply(DsScenePtr aScene)
     reportOutputState();
   }
   return !mUpdatingCache; // actually apply only when this is not a cache update
-  // TODO: we're completely lacking the mechanisms to apply local scene calls efficiently by invoking DS-side scenes for now
-  // - this should be easy once we are sure our caching is complete, including the don't care flags.
-  // - we can just forward the scene call to the device
-  // - TODO: how would we detect and forward grouped scene calls?
+  // Note: grouped scene calls covering entire dS zones/groups are forwarded as native dS zone/group scene calls
+  //   by the vdc's optimizer, see prepareForOptimizedSet() and Ds485Vdc::callNativeAction()
+}
+
+
+bool Ds485Device::prepareForOptimizedSet(NotificationDeliveryStatePtr aDeliveryState)
+{
+  // only scene calls can be forwarded as native dS zone/group scene calls.
+  // The dS device applies its own stored scene values with its own transition time, so
+  // calls with a transition time override must be applied device by device
+  return
+    aDeliveryState->mOptimizedType==ntfy_callscene &&
+    mPreparedScene &&
+    mPreparedTransitionOverride==Infinite;
 }
 
 
@@ -161,6 +161,11 @@ namespace p44 {
     ///   called (it's not a scene call), but prepareSceneApply() is called with a pseudo-scene having sceneCmd==scene_cmd_undo.
     virtual bool prepareSceneApply(DsScenePtr aScene) P44_OVERRIDE;
 
+    /// let device implementation prepare for (and possibly reject) optimized set
+    /// @param aDeliveryState can be inspected to see the scene or dim parameters
+    /// @return true if device is ok with being part of optimized set (i.e. a native zone/group scene call)
+    virtual bool prepareForOptimizedSet(NotificationDeliveryStatePtr aDeliveryState) P44_OVERRIDE;
+
     /// apply all pending channel value updates to the device's hardware
     /// @note this is the only routine that should trigger actual changes in output values. It must consult all of the device's
     ///   ChannelBehaviours and check isChannelUpdatePending(), and send new values to the device hardware. After successfully
@@ -49,6 +49,11 @@ Ds485Vdc::Ds485Vdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag) :
   mDs485HostKnown(false)
 {
   mDs485Comm.isMemberVariable();
+  // native zone/group scenes always exist in the dS devices and need no configuration writes,
+  // so audiences covering entire zones/groups can be optimized right away
+  mOptimizerMode = opt_auto;
+  mMinCallsBeforeOptimizing = 1;
+  mMinDevicesForOptimizing = 1;
 }
 
 
@@ -569,14 +574,143 @@ void Ds485Vdc::ds485MessageHandler(const DsUid& aSource, const DsUid& aTarget, c
 }
 
 
-void Ds485Vdc::deliverToDevicesAudience(DsAddressablesList aAudience, VdcApiConnectionPtr aApiConnection, const string &aNotification, ApiValuePtr aParams)
+// MARK: - native zone/group scene calls
+
+#define NATIVE_ZONEGROUP_ACTION_FMT "dS_zone_%d_group_%d"
+
+bool Ds485Vdc::zoneGroupForDevices(NotificationDeliveryStatePtr aDeliveryState, DsZoneID &aZoneId, DsGroup &aGroup)
+{
+  const DeviceList &devs = aDeliveryState->mAffectedDevices;
+  if (devs.empty()) return false;
+  std::set<Device*> affected;
+  for (DeviceList::const_iterator pos = devs.begin(); pos!=devs.end(); ++pos) {
+    if (!boost::dynamic_pointer_cast<Ds485Device>(*pos)) return false; // safety, only native dS devices
+    affected.insert(pos->get());
+  }
+  DevicePtr first = devs.front();
+  OutputBehaviourPtr fo = first->getOutput();
+  if (!fo) return false;
+  // the notification usually tells zone and group the audience was derived from
+  int zoneHint = -1;
+  int groupHint = -1;
+  ApiValuePtr o;
+  if (aDeliveryState->mCallParams) {
+    if ((o = aDeliveryState->mCallParams->get("zone_id"))) zoneHint = o->int32Value();
+    if ((o = aDeliveryState->mCallParams->get("group"))) groupHint = o->int32Value();
+  }
+  // candidate zones: the hinted one, or the first device's zone and the global zone
+  std::vector<DsZoneID> zones;
+  if (zoneHint>=0) zones.push_back(zoneHint);
+  else {
+    zones.push_back(first->getZoneID());
+    zones.push_back(zoneId_global);
+  }
+  for (int g = groupHint>0 ? groupHint : 1; g<(groupHint>0 ? groupHint+1 : 64); g++) {
+    if (!fo->isMember((DsGroup)g)) continue;
+    for (std::vector<DsZoneID>::iterator zpos = zones.begin(); zpos!=zones.end(); ++zpos) {
+      // the affected devices must be exactly the devices in this zone and group
+      size_t members = 0;
+      bool complete = true;
+      for (Ds485DeviceMap::iterator dpos = mDs485Devices.begin(); dpos!=mDs485Devices.end(); ++dpos) {
+        Ds485DevicePtr dev = dpos->second;
+        OutputBehaviourPtr out = dev->getOutput();
+        if (out && out->isMember((DsGroup)g) && (*zpos==zoneId_global || dev->getZoneID()==*zpos)) {
+          if (affected.find(dev.get())==affected.end()) {
+            complete = false; // zone/group member not in the audience -> partial
+            break;
+          }
+          members++;
+        }
+      }
+      if (complete && members==affected.size()) {
+        aZoneId = *zpos;
+        aGroup = (DsGroup)g;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+bool Ds485Vdc::shouldUseOptimizerFor(NotificationDeliveryStatePtr aDeliveryState)
+{
+  // partial audiences cannot be reached with a native zone/group call, these are delivered device by device
+  DsZoneID zone;
+  DsGroup group;
+  return
+    inherited::shouldUseOptimizerFor(aDeliveryState) &&
+    aDeliveryState->mOptimizedType==ntfy_callscene &&
+    zoneGroupForDevices(aDeliveryState, zone, group);
+}
+
+
+ErrorPtr Ds485Vdc::announceNativeAction(const string aNativeActionId)
+{
+  int zone, group;
+  if (sscanf(aNativeActionId.c_str(), NATIVE_ZONEGROUP_ACTION_FMT, &zone, &group)!=2) {
+    return TextError::err("invalid dS485 native action '%s'", aNativeActionId.c_str());
+  }
+  return ErrorPtr();
+}
+
+
+void Ds485Vdc::callNativeAction(StatusCB aStatusCB, const string aNativeActionId, NotificationDeliveryStatePtr aDeliveryState)
+{
+  int zone, group;
+  if (
+    aDeliveryState->mOptimizedType==ntfy_callscene &&
+    sscanf(aNativeActionId.c_str(), NATIVE_ZONEGROUP_ACTION_FMT, &zone, &group)==2
+  ) {
+    // devices might have been moved to another zone or group since the action was created
+    DsZoneID currentZone;
+    DsGroup currentGroup;
+    if (!zoneGroupForDevices(aDeliveryState, currentZone, currentGroup) || currentZone!=zone || currentGroup!=group) {
+      aStatusCB(TextError::err("Native action '%s' does not match current zone/group of devices any more", aNativeActionId.c_str())); // causes normal execution
+      return;
+    }
+    bool force = false;
+    ApiValuePtr o;
+    if (aDeliveryState->mCallParams && (o = aDeliveryState->mCallParams->get("force"))) force = o->boolValue();
+    long startFrames = mDs485Comm.mSentRequests;
+    string payload;
+    Ds485Comm::payload_append16(payload, zone);
+    Ds485Comm::payload_append8(payload, group);
+    Ds485Comm::payload_append16(payload, 0); // no origin device
+    Ds485Comm::payload_append8(payload, aDeliveryState->mContentId);
+    // broadcast, all dSMs must see zone/group calls
+    ErrorPtr err = mDs485Comm.issueRequest(
+      DsUid(), ZONE_GROUP_ACTION_REQUEST,
+      force ? ZONE_GROUP_ACTION_REQUEST_ACTION_FORCE_CALL_SCENE : ZONE_GROUP_ACTION_REQUEST_ACTION_CALL_SCENE,
+      payload
+    );
+    OLOG(LOG_INFO, "native zone %d/group %d scene %d call for %zu devices uses %ld dS485 frames", zone, group, aDeliveryState->mContentId, aDeliveryState->mAffectedDevices.size(), mDs485Comm.mSentRequests-startFrames);
+    aStatusCB(err); // in case of error, devices will apply one by one
+    return;
+  }
+  aStatusCB(TextError::err("Native action '%s' not supported", aNativeActionId.c_str())); // causes normal execution
+}
+
+
+void Ds485Vdc::createNativeAction(StatusCB aStatusCB, OptimizerEntryPtr aOptimizerEntry, NotificationDeliveryStatePtr aDeliveryState)
 {
-  inherited::deliverToDevicesAudience(aAudience, aApiConnection, aNotification, aParams);
-  // TODO: implement optimisations to call native scenes instead of device adjustment
+  DsZoneID zone;
+  DsGroup group;
+  if (aOptimizerEntry->mType!=ntfy_callscene || !zoneGroupForDevices(aDeliveryState, zone, group)) {
+    aStatusCB(TextError::err("affected devices are not an entire dS zone/group"));
+    return;
+  }
+  aOptimizerEntry->mNativeActionId = string_format(NATIVE_ZONEGROUP_ACTION_FMT, (int)zone, (int)group);
+  aOptimizerEntry->mLastNativeChange = MainLoop::now();
+  OLOG(LOG_INFO, "using native zone/group scene call '%s'", aOptimizerEntry->mNativeActionId.c_str());
+  aStatusCB(ErrorPtr());
+}
 
-//  for (DsAddressablesList::iterator apos = aAudience.begin(); apos!=aAudience.end(); ++apos) {
-//    // TODO: implement
-//  }
+
+void Ds485Vdc::updateNativeAction(StatusCB aStatusCB, OptimizerEntryPtr aOptimizerEntry, NotificationDeliveryStatePtr aDeliveryState)
+{
+  // nothing to write, dS devices keep their own scene values
+  aStatusCB(ErrorPtr());
 }
 
 
@@ -116,9 +116,6 @@ namespace p44 {
     /// @return true if there is an icon, false if not
     virtual bool getDeviceIcon(string &aIcon, bool aWithData, const char *aResolutionPrefix) P44_OVERRIDE;
 
-    /// deliver (forward) notifications to devices in one call instead of forwarding on device level
-    virtual void deliverToDevicesAudience(DsAddressablesList aAudience, VdcApiConnectionPtr aApiConnection, const string &aNotification, ApiValuePtr aParams) P44_OVERRIDE;
-
     /// vdc level methods
     virtual ErrorPtr handleMethod(VdcApiRequestPtr aRequest, const string &aMethod, ApiValuePtr aParams) P44_OVERRIDE;
 
@@ -130,6 +127,42 @@ namespace p44 {
 
   protected:
 
+    /// @name Implementation methods for native zone/group scene calls
+    /// @{
+
+    /// only audiences consisting of all devices of a dS zone and group can be optimized
+    /// @param aDeliveryState can be inspected to obtain details about the affected devices, actionVariant etc.
+    /// @return true if optimizer should be used with this notification call
+    virtual bool shouldUseOptimizerFor(NotificationDeliveryStatePtr aDeliveryState) P44_OVERRIDE;
+
+    /// this is called once for every native action in use, after startup after existing cache entries have been
+    /// read from persistent storage.
+    /// @param aNativeActionId a ID of a native action that is in use by the optimizer
+    virtual ErrorPtr announceNativeAction(const string aNativeActionId) P44_OVERRIDE;
+
+    /// execute native action (zone/group scene call)
+    /// @param aStatusCB must be called to return status. Must return NULL when action was applied.
+    ///   Can return Error::OK to signal action was not applied and request device-by-device apply.
+    /// @param aNativeActionId the ID of the native action (zone and group) that must be used
+    /// @param aDeliveryState can be inspected to obtain details about the affected devices, actionVariant etc.
+    virtual void callNativeAction(StatusCB aStatusCB, const string aNativeActionId, NotificationDeliveryStatePtr aDeliveryState) P44_OVERRIDE;
+
+    /// create native action
+    /// @note dS zone/group scenes always exist in the dS devices, so this only assigns the zone/group matching the affected devices
+    /// @param aStatusCB must be called to return status. If not ok, aOptimizerEntry must not be changed.
+    /// @param aOptimizerEntry the optimizer entry. If a new action is created, the nativeActionId must be updated to the new actionid.
+    /// @param aDeliveryState can be inspected to obtain details such as list of affected devices etc.
+    virtual void createNativeAction(StatusCB aStatusCB, OptimizerEntryPtr aOptimizerEntry, NotificationDeliveryStatePtr aDeliveryState) P44_OVERRIDE;
+
+    /// update native action
+    /// @note scene values are stored in the dS devices themselves, so there is nothing to update
+    /// @param aStatusCB must be called to return status.
+    /// @param aOptimizerEntry the optimizer entry.
+    /// @param aDeliveryState can be inspected to obtain details such as list of affected devices etc.
+    virtual void updateNativeAction(StatusCB aStatusCB, OptimizerEntryPtr aOptimizerEntry, NotificationDeliveryStatePtr aDeliveryState) P44_OVERRIDE;
+
+    /// @}
+
     /// handle global events
     /// @param aEvent the event to handle
     virtual void handleGlobalEvent(VdchostEvent aEvent) P44_OVERRIDE;
@@ -151,6 +184,8 @@ namespace p44 {
 
     void recollect(RescanMode aRescanMode);
 
+    bool zoneGroupForDevices(NotificationDeliveryStatePtr aDeliveryState, DsZoneID &aZoneId, DsGroup &aGroup);
+
   };
 
 } // namespace p44
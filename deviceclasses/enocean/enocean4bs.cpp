@@ -792,7 +792,7 @@ void Enocean4BSDevice::sendTeachInResponse()
     responsePacket->setRadioDestination(getAddress());
     // now send
     LOG(LOG_INFO, "Sending 4BS teach-in response for EEP %06X", EEP_PURE(getEEProfile()));
-    sendCommand(responsePacket, NoOP);
+    sendCommand(responsePacket, NoOP, enocean_tx_teachin);
   }
 }
 
@@ -1687,6 +1687,12 @@ uint32_t EnOceanSecurity::calcCMAC(const AES128Block &aKey, const AES128Block &a
 
 #define ENOCEAN_ESP3_COMMAND_TIMEOUT (3*Second)
 
+#define DEFAULT_DUTY_CYCLE_LIMIT 0.01 // 1% per hour is the regulatory limit for most 868MHz SRD sub-bands
+#define DEFAULT_DUTY_CYCLE_WINDOW (1*Hour)
+#define ERP1_BITRATE 125000 // bits per second
+#define ERP1_SUBTELEGRAMS 3 // number of subtelegrams sent for each radio telegram
+#define ERP1_SUBTELEGRAM_OVERHEAD_BITS 40 // preamble, sync, header and CRC per subtelegram (approx)
+
 #define ENOCEAN_INIT_RETRIES 5
 #define ENOCEAN_INIT_RETRY_INTERVAL (5*Second)
 
@@ -1697,8 +1703,13 @@ EnoceanComm::EnoceanComm(MainLoop &aMainLoop) :
   mApiVersion(0),
   mAppVersion(0),
   mMyAddress(0),
-  mMyIdBase(0)
+  mMyIdBase(0),
+  mDutyCycleLimit(DEFAULT_DUTY_CYCLE_LIMIT),
+  mDutyCycleWindow(DEFAULT_DUTY_CYCLE_WINDOW),
+  mAirTimeBudget(DEFAULT_DUTY_CYCLE_LIMIT*DEFAULT_DUTY_CYCLE_WINDOW),
+  mLastBudgetUpdate(Never)
 {
+  resetTxStatistics();
 }
 
 
@@ -2054,26 +2065,149 @@ EnoceanAddress EnoceanComm::makeSendAddress(EnoceanAddress aSendAddr)
 }
 
 
-void EnoceanComm::sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB)
+void EnoceanComm::sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB, EnoceanTxPriority aPriority, uint64_t aCoalesceKey)
 {
   // queue command
   EnoceanCmd cmd;
   aCommandPacket->finalize();
-  FOCUSOLOG("Queueing command packet to send: \n%s", aCommandPacket->description().c_str());
+  FOCUSOLOG("Queueing command packet (prio=%d) to send: \n%s", aPriority, aCommandPacket->description().c_str());
   cmd.commandPacket = aCommandPacket;
   cmd.responseCB = aResponsePacketCB;
-  mCmdQueue.push_back(cmd);
+  cmd.priority = aPriority;
+  cmd.coalesceKey = aCoalesceKey;
+  cmd.queuedAt = MainLoop::now();
+  EnoceanCmdList::iterator pos = mCmdQueue.begin();
+  if (aCoalesceKey!=0) {
+    // replace not yet sent command for the same target and function
+    for (; pos!=mCmdQueue.end(); ++pos) {
+      if (pos->commandPacket && pos->coalesceKey==aCoalesceKey) {
+        OLOG(LOG_INFO, "Queued command superseded by newer one before being sent");
+        ESPPacketCB supersededCB = pos->responseCB;
+        cmd.queuedAt = pos->queuedAt; // latency counts from first request for this target
+        mCmdQueue.erase(pos);
+        mTxStats.superseded++;
+        if (supersededCB) supersededCB(Esp3PacketPtr(), ErrorPtr(new EnoceanCommError(EnoceanCommError::Superseded)));
+        break;
+      }
+    }
+  }
+  // insert after all commands with same or higher priority (and after command waiting for response)
+  for (pos = mCmdQueue.begin(); pos!=mCmdQueue.end(); ++pos) {
+    if (pos->commandPacket && pos->priority>aPriority) break;
+  }
+  mCmdQueue.insert(pos, cmd);
+  checkCmdQueue();
+}
+
+
+uint64_t EnoceanComm::makeCoalesceKey(EnoceanAddress aAddress, EnoceanProfile aEEP, uint16_t aSubKey)
+{
+  return
+    ((uint64_t)aAddress<<32) |
+    ((uint64_t)(EEP_RORG(aEEP)&0xFF)<<24) |
+    ((uint64_t)(EEP_FUNC(aEEP)&0xFF)<<16) |
+    aSubKey;
+}
+
+
+size_t EnoceanComm::txQueueLength() const
+{
+  size_t n = 0;
+  for (EnoceanCmdList::const_iterator pos = mCmdQueue.begin(); pos!=mCmdQueue.end(); ++pos) {
+    if (pos->commandPacket) n++;
+  }
+  return n;
+}
+
+
+void EnoceanComm::resetTxStatistics()
+{
+  mTxStats.since = MainLoop::now();
+  mTxStats.sent = 0;
+  mTxStats.superseded = 0;
+  mTxStats.dutyCycleDelayed = 0;
+  mTxStats.latencySum = 0;
+  mTxStats.latencyMax = 0;
+  mTxStats.airTime = 0;
+}
+
+
+void EnoceanComm::setDutyCycleLimit(double aDutyCycle, MLMicroSeconds aWindow)
+{
+  mDutyCycleLimit = aDutyCycle;
+  mDutyCycleWindow = aWindow;
+  mAirTimeBudget = mDutyCycleLimit*mDutyCycleWindow; // start with full budget
+  mLastBudgetUpdate = MainLoop::now();
+  mDutyCycleTicket.cancel();
   checkCmdQueue();
 }
 
 
+void EnoceanComm::updateAirTimeBudget()
+{
+  MLMicroSeconds now = MainLoop::now();
+  if (mLastBudgetUpdate!=Never) {
+    // refill at duty cycle rate, up to the amount allowed within one window
+    mAirTimeBudget += (now-mLastBudgetUpdate)*mDutyCycleLimit;
+    MLMicroSeconds maxBudget = mDutyCycleLimit*mDutyCycleWindow;
+    if (mAirTimeBudget>maxBudget) mAirTimeBudget = maxBudget;
+  }
+  mLastBudgetUpdate = now;
+}
+
+
+MLMicroSeconds EnoceanComm::availableAirTime()
+{
+  if (mDutyCycleLimit<=0) return Infinite;
+  updateAirTimeBudget();
+  return mAirTimeBudget;
+}
+
+
+void EnoceanComm::dutyCycleWaitDone()
+{
+  mDutyCycleTicket.cancel();
+  checkCmdQueue();
+}
+
+
+MLMicroSeconds EnoceanComm::estimatedAirTime(Esp3PacketPtr aPacket)
+{
+  // ERP1 uses 8/12 encoding, so every data byte takes 12 bits on air
+  return (MLMicroSeconds)ERP1_SUBTELEGRAMS*(aPacket->dataLength()*12+ERP1_SUBTELEGRAM_OVERHEAD_BITS)*Second/ERP1_BITRATE;
+}
+
+
 void EnoceanComm::checkCmdQueue()
 {
   if (mCmdQueue.empty()) return; // queue empty
   EnoceanCmd cmd = mCmdQueue.front();
   if (cmd.commandPacket) {
-    // front is command to be sent -> send it
+    // front is command to be sent
+    MLMicroSeconds airTime = 0;
+    if (cmd.commandPacket->packetType()==pt_radio_erp1) {
+      // radio telegram, check duty cycle budget
+      airTime = estimatedAirTime(cmd.commandPacket);
+      if (mDutyCycleLimit>0) {
+        if (mDutyCycleTicket) return; // already waiting for budget
+        updateAirTimeBudget();
+        if (mAirTimeBudget<airTime) {
+          MLMicroSeconds wait = (airTime-mAirTimeBudget)/mDutyCycleLimit;
+          OLOG(LOG_WARNING, "Radio duty cycle limit reached -> delaying next telegram by %.1f seconds", (double)wait/Second);
+          mTxStats.dutyCycleDelayed++;
+          mDutyCycleTicket.executeOnce(boost::bind(&EnoceanComm::dutyCycleWaitDone, this), wait);
+          return;
+        }
+        mAirTimeBudget -= airTime;
+      }
+    }
+    // send it
     sendPacket(cmd.commandPacket);
+    MLMicroSeconds latency = MainLoop::now()-cmd.queuedAt;
+    mTxStats.sent++;
+    mTxStats.latencySum += latency;
+    if (latency>mTxStats.latencyMax) mTxStats.latencyMax = latency;
+    mTxStats.airTime += airTime;
     // remove original entry, put waiting-for-response marker there instead
     cmd.commandPacket.reset(); // clear out, marks this entry for "waiting for response"
     mCmdQueue.pop_front();
@@ -53,6 +53,7 @@ namespace p44 {
       Unsupported,
       BadParam,
       Denied,
+      Superseded,
       numErrorCodes
     } ErrorCodes;
 
@@ -71,6 +72,7 @@ namespace p44 {
       "Unsupported",
       "BadParam",
       "Denied",
+      "Superseded",
     };
     #endif // ENABLE_NAMED_ERRORS
   };
@@ -613,13 +615,36 @@ namespace p44 {
 
   typedef boost::function<void (Esp3PacketPtr aEsp3PacketPtr, ErrorPtr aError)> ESPPacketCB;
 
+  /// transmit priorities, lower values are sent first
+  typedef enum {
+    enocean_tx_interactive, ///< user initiated, latency sensitive (output changes, simulated buttons)
+    enocean_tx_normal, ///< default for modem commands and everything not classified otherwise
+    enocean_tx_service, ///< background service traffic (status queries, maintenance sequences)
+    enocean_tx_teachin, ///< teach-in telegrams
+    enocean_tx_numPriorities
+  } EnoceanTxPriority;
+
   typedef struct {
     Esp3PacketPtr commandPacket; ///< packet to send. If empty, this means we are waiting for the response
     ESPPacketCB responseCB; ///< callback to call when response arrives
+    EnoceanTxPriority priority; ///< transmit priority
+    uint64_t coalesceKey; ///< if not 0, a not yet sent command with the same key will be replaced by a newer one
+    MLMicroSeconds queuedAt; ///< when the command was queued
   } EnoceanCmd;
 
   typedef std::list<EnoceanCmd> EnoceanCmdList;
 
+  /// transmit scheduler statistics
+  typedef struct {
+    MLMicroSeconds since; ///< start of statistics period
+    long sent; ///< number of commands sent
+    long superseded; ///< number of commands replaced by newer ones before being sent
+    long dutyCycleDelayed; ///< number of times sending was delayed by the duty cycle limit
+    MLMicroSeconds latencySum; ///< sum of queue latencies of all sent commands
+    MLMicroSeconds latencyMax; ///< max queue latency of sent commands
+    MLMicroSeconds airTime; ///< total estimated air time of sent radio telegrams
+  } EnoceanTxStatistics;
+
   typedef boost::intrusive_ptr<EnoceanComm> EnoceanCommPtr;
   // Enocean communication
   class EnoceanComm : public SerialOperationQueue
@@ -643,6 +668,15 @@ namespace p44 {
     EnoceanCmdList mCmdQueue; ///< commands awaiting send or receive
     MLTicket mCmdTimeoutTicket; ///< timeout for waiting for command response
 
+    // Radio duty cycle accounting
+    double mDutyCycleLimit; ///< max fraction of time the radio may be transmitting, 0 = no limit
+    MLMicroSeconds mDutyCycleWindow; ///< time window the duty cycle limit applies to
+    MLMicroSeconds mAirTimeBudget; ///< currently available transmit time (refills at mDutyCycleLimit rate up to limit*window)
+    MLMicroSeconds mLastBudgetUpdate; ///< when mAirTimeBudget was last updated
+    MLTicket mDutyCycleTicket; ///< for sending delayed radio telegrams when budget allows again
+
+    EnoceanTxStatistics mTxStats; ///< transmit statistics
+
   public:
 
     EnoceanComm(MainLoop &aMainLoop = MainLoop::currentMainLoop());
@@ -703,8 +737,40 @@ namespace p44 {
     void sendPacket(Esp3PacketPtr aPacket);
 
     /// send a command and await response
+    /// @param aCommandPacket the command (or radio telegram) to send
     /// @param aResponsePacketCB callback to deliver command response to
-    void sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB);
+    /// @param aPriority transmit priority. Higher priority commands are sent before already queued lower priority ones.
+    /// @param aCoalesceKey if not 0, a still queued command with the same key will be replaced by this command
+    ///   (and its callback called with EnoceanCommError::Superseded). Use for telegrams which only carry the latest
+    ///   state for a destination, see makeCoalesceKey().
+    void sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB, EnoceanTxPriority aPriority = enocean_tx_normal, uint64_t aCoalesceKey = 0);
+
+    /// create a coalesce key for sendCommand()
+    /// @param aAddress the address identifying the target (destination, or sender for broadcasts)
+    /// @param aEEP the EEP of the target (only RORG and FUNC are used)
+    /// @param aSubKey further distinction, such as subdevice/channel or command type
+    /// @return key to identify telegrams superseding each other
+    static uint64_t makeCoalesceKey(EnoceanAddress aAddress, EnoceanProfile aEEP, uint16_t aSubKey);
+
+    /// set radio duty cycle limit
+    /// @param aDutyCycle max fraction of time (0..1) radio telegrams may be transmitted, 0 to disable limit
+    /// @param aWindow the time window the limit applies to (regulatory limit for 868MHz SRD is 1% per hour)
+    void setDutyCycleLimit(double aDutyCycle, MLMicroSeconds aWindow = 1*Hour);
+
+    /// @return current radio duty cycle limit, 0 if none
+    double dutyCycleLimit() const { return mDutyCycleLimit; }
+
+    /// @return transmit scheduler statistics
+    const EnoceanTxStatistics &txStatistics() const { return mTxStats; }
+
+    /// reset transmit scheduler statistics
+    void resetTxStatistics();
+
+    /// @return number of commands currently waiting to be sent
+    size_t txQueueLength() const;
+
+    /// @return currently available air time within the duty cycle limit (Infinite when no limit)
+    MLMicroSeconds availableAirTime();
 
     /// manufacturer name lookup
     /// @param aManufacturerCode EEP manufacturer code
@@ -746,6 +812,9 @@ namespace p44 {
 
     void checkCmdQueue();
     void cmdTimeout();
+    void updateAirTimeBudget();
+    void dutyCycleWaitDone();
+    MLMicroSeconds estimatedAirTime(Esp3PacketPtr aPacket);
 
   };
 
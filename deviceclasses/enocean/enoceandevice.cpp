@@ -266,11 +266,15 @@ EnoceanChannelHandlerPtr EnoceanDevice::channelForBehaviour(const DsBehaviour *a
 }
 
 
-void EnoceanDevice::sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB)
+void EnoceanDevice::sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB, EnoceanTxPriority aPriority, int aCoalesceKind)
 {
   aCommandPacket->finalize();
   OLOG(LOG_INFO, "Sending EnOcean Packet:\n%s", aCommandPacket->description().c_str());
-  getEnoceanVdc().mEnoceanComm.sendCommand(aCommandPacket, aResponsePacketCB);
+  uint64_t coalesceKey = 0;
+  if (aCoalesceKind>=0) {
+    coalesceKey = EnoceanComm::makeCoalesceKey(getAddress(), getEEProfile(), ((uint16_t)getSubDevice()<<8) | (aCoalesceKind & 0xFF));
+  }
+  getEnoceanVdc().mEnoceanComm.sendCommand(aCommandPacket, aResponsePacketCB, aPriority, coalesceKey);
 }
 
 
@@ -302,8 +306,8 @@ void EnoceanDevice::sendOutgoingUpdate()
     if (outgoingEsp3Packet) {
       // set destination
       outgoingEsp3Packet->setRadioDestination(mEnoceanAddress); // the target is the device I manage
-      // send it
-      sendCommand(outgoingEsp3Packet, NoOP);
+      // send it, replacing a not yet sent older update
+      sendCommand(outgoingEsp3Packet, NoOP, enocean_tx_interactive, 0);
     }
   }
 }
@@ -413,8 +413,11 @@ namespace p44 {
 
     /// send a command from this device and await response
     /// @param aResponsePacketCB callback to deliver command response to
+    /// @param aPriority transmit priority
+    /// @param aCoalesceKind if >=0, the telegram carries the latest state for this (sub)device, and will replace
+    ///   a still queued telegram of the same kind for the same (sub)device and EEP function.
     /// @note this is just a convenience method which includes logging the packet sent in context of the device
-    void sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB);
+    void sendCommand(Esp3PacketPtr aCommandPacket, ESPPacketCB aResponsePacketCB, EnoceanTxPriority aPriority = enocean_tx_normal, int aCoalesceKind = -1);
 
   private:
 
@@ -91,7 +91,7 @@ void EnoceanRemoteControlDevice::buttonAction(bool aRight, bool aUp, bool aPress
     packet->setRadioStatus(status_T21); // released
   }
   packet->setRadioSender(getEnoceanVdc().mEnoceanComm.makeSendAddress(getAddress()));
-  sendCommand(packet, NoOP);
+  sendCommand(packet, NoOP, enocean_tx_interactive); // press/release sequence must not be coalesced
 }
 
 
@@ -418,7 +418,7 @@ uint8_t EnoceanSEHeatTubeDevice::teachInSignal(int8_t aVariant)
     packet->setRadioDestination(EnoceanBroadcast);
     packet->set4BSdata(0x00000140);
     packet->setRadioSender(getEnoceanVdc().mEnoceanComm.makeSendAddress(getAddress()));
-    sendCommand(packet, NoOP);
+    sendCommand(packet, NoOP, enocean_tx_teachin);
     return 1;
   }
   return inherited::teachInSignal(aVariant);
@@ -460,7 +460,7 @@ void EnoceanSEHeatTubeDevice::setPowerState(int aLevel, bool aInitial)
   packet->setRadioDestination(EnoceanBroadcast);
   packet->set4BSdata(0x00000140+((uint32_t)pwr<<16));
   packet->setRadioSender(getEnoceanVdc().mEnoceanComm.makeSendAddress(getAddress()));
-  sendCommand(packet, NoOP);
+  sendCommand(packet, NoOP, enocean_tx_interactive, 0);
   // repeat non-zero power state level
   if (pwr!=0x00) {
     applyRepeatTicket.executeOnce(
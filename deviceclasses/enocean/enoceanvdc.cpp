@@ -197,6 +197,7 @@ void EnoceanVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
     // start with zero
     removeDevices(aRescanFlags & rescanmode_clearsettings);
     // - read learned-in EnOcean device IDs from DB
+    DeviceList knownDevices;
     SQLiteTGQuery qry(mDb);
     if (Error::isOK(qry.prefixedPrepare("SELECT enoceanAddress, subdevice, eeProfile, eeManufacturer FROM $PREFIX_knownDevices"))) {
       for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
@@ -209,7 +210,7 @@ void EnoceanVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
         );
         if (newdev) {
           // we fetched this from DB, so it is already known (don't save again!)
-          addKnownDevice(newdev);
+          knownDevices.push_back(newdev);
         }
         else {
           OLOG(LOG_ERR,
@@ -220,6 +221,11 @@ void EnoceanVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
         }
       }
     }
+    // - add them all in one batch
+    simpleIdentifyAndAddDevices(knownDevices);
+    for (DeviceList::iterator pos = knownDevices.begin(); pos!=knownDevices.end(); ++pos) {
+      knownDeviceAdded(boost::static_pointer_cast<EnoceanDevice>(*pos));
+    }
   }
   // assume ok
   aCompletedCB(ErrorPtr());
@@ -229,22 +235,29 @@ void EnoceanVdc::scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
 bool EnoceanVdc::addKnownDevice(EnoceanDevicePtr aEnoceanDevice)
 {
   if (simpleIdentifyAndAddDevice(aEnoceanDevice)) {
-    // not a duplicate, actually added - add to my own list
-    mEnoceanDevices.insert(make_pair(aEnoceanDevice->getAddress(), aEnoceanDevice));
-    #if ENABLE_ENOCEAN_SECURE
-    // set device security info if available
-    EnOceanSecurityPtr sec = findSecurityInfoForSender(aEnoceanDevice->getAddress());
-    if (sec) {
-      // associate with device
-      aEnoceanDevice->setSecurity(sec);
-    }
-    #endif
+    // not a duplicate, actually added
+    knownDeviceAdded(aEnoceanDevice);
     return true;
   }
   return false;
 }
 
 
+void EnoceanVdc::knownDeviceAdded(EnoceanDevicePtr aEnoceanDevice)
+{
+  // add to my own list
+  mEnoceanDevices.insert(make_pair(aEnoceanDevice->getAddress(), aEnoceanDevice));
+  #if ENABLE_ENOCEAN_SECURE
+  // set device security info if available
+  EnOceanSecurityPtr sec = findSecurityInfoForSender(aEnoceanDevice->getAddress());
+  if (sec) {
+    // associate with device
+    aEnoceanDevice->setSecurity(sec);
+  }
+  #endif
+}
+
+
 bool EnoceanVdc::addAndRememberDevice(EnoceanDevicePtr aEnoceanDevice)
 {
   if (addKnownDevice(aEnoceanDevice)) {
@@ -327,6 +340,10 @@ ErrorPtr EnoceanVdc::handleMethod(VdcApiRequestPtr aRequest, const string &aMeth
     // send a ESP command
     respErr = sendCommand(aRequest, aParams);
   }
+  else if (aMethod=="x-p44-txScheduler") {
+    // configure transmit scheduler and/or get its statistics
+    respErr = txScheduler(aRequest, aParams);
+  }
   else {
     respErr = inherited::handleMethod(aRequest, aMethod, aParams);
   }
@@ -467,6 +484,36 @@ ErrorPtr EnoceanVdc::sendCommand(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
 }
 
 
+ErrorPtr EnoceanVdc::txScheduler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  ApiValuePtr o = aParams->get("dutyCycle"); // in percent, 0 = no limit
+  if (o) {
+    mEnoceanComm.setDutyCycleLimit(o->doubleValue()/100);
+  }
+  o = aParams->get("reset");
+  bool reset = o && o->boolValue();
+  // return current settings and statistics
+  const EnoceanTxStatistics &st = mEnoceanComm.txStatistics();
+  ApiValuePtr res = aRequest->newApiValue();
+  res->setType(apivalue_object);
+  res->add("dutyCycle", res->newDouble(mEnoceanComm.dutyCycleLimit()*100));
+  if (mEnoceanComm.dutyCycleLimit()>0) {
+    res->add("availableAirTime", res->newDouble((double)mEnoceanComm.availableAirTime()/Second));
+  }
+  res->add("queueLength", res->newUint64(mEnoceanComm.txQueueLength()));
+  res->add("period", res->newDouble((double)(MainLoop::now()-st.since)/Second));
+  res->add("sent", res->newInt64(st.sent));
+  res->add("superseded", res->newInt64(st.superseded));
+  res->add("dutyCycleDelayed", res->newInt64(st.dutyCycleDelayed));
+  res->add("avgLatency", res->newDouble(st.sent>0 ? (double)st.latencySum/st.sent/Second : 0));
+  res->add("maxLatency", res->newDouble((double)st.latencyMax/Second));
+  res->add("airTime", res->newDouble((double)st.airTime/Second));
+  if (reset) mEnoceanComm.resetTxStatistics();
+  aRequest->sendResult(res);
+  return ErrorPtr();
+}
+
+
 void EnoceanVdc::sendCommandResponse(VdcApiRequestPtr aRequest, Esp3PacketPtr aEsp3PacketPtr, ErrorPtr aError)
 {
   if (Error::notOK(aError)) {
@@ -134,6 +134,9 @@ namespace p44 {
     /// @return false if aEnoceanDevice dSUID is already known and thus was *not* added
     bool addKnownDevice(EnoceanDevicePtr aEnoceanDevice);
 
+    /// register device actually added to the container in my own list
+    void knownDeviceAdded(EnoceanDevicePtr aEnoceanDevice);
+
     /// add newly learned device to EnOcean container (and remember it in DB)
     /// @return false if aEnoceanDevice dSUID is already known and thus was *not* added
     bool addAndRememberDevice(EnoceanDevicePtr aEnoceanDevice);
@@ -213,6 +216,7 @@ namespace p44 {
     ErrorPtr addProfile(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     ErrorPtr simulatePacket(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     ErrorPtr sendCommand(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+    ErrorPtr txScheduler(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     void sendCommandResponse(VdcApiRequestPtr aRequest, Esp3PacketPtr aEsp3PacketPtr, ErrorPtr aError);
 
   };
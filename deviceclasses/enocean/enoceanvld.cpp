@@ -515,7 +515,7 @@ void EnoceanD201XXDevice::configureD201XX()
   (0<<6) | // Bit 6: PF: disable power failure detection for now
   (2<<4) | // Bits 5..4: default state: 0=off, 1=100% on, 2=previous state, 3=not used
   (1<<0); // Bits 3..0: dim timer 0, fast, use min = 0.5sec, 0..15 = 0sec..7.5sec (0.5 sec/digit)
-  sendCommand(packet, NoOP);
+  sendCommand(packet, NoOP, enocean_tx_service);
 }
 
 
@@ -585,7 +585,7 @@ void EnoceanD201XXDevice::updateOutput(uint8_t aPercentOn, uint8_t aDimTimeSelec
     (getSubDevice() & 0x1F) | // Bits 0..4: output channel number (1E & 1F reserved)
     ((aDimTimeSelector & 0x07)<<5);
   packet->radioUserData()[2] = aPercentOn; // 0=off, 1..100 = 1..100% on
-  sendCommand(packet, NoOP);
+  sendCommand(packet, NoOP, enocean_tx_interactive, 0x01); // newer output value supersedes older one
 }
 
 
@@ -602,7 +602,7 @@ void EnoceanD201XXDevice::syncChannelValues(SimpleCB aDoneCB)
     packet->setRadioDestination(getAddress());
     packet->radioUserData()[0] = 0x03; // CMD 0x3 - Actuator Status Query
     packet->radioUserData()[1] = (getSubDevice() & 0x1F); // Bits 0..4: output channel number (1E & 1F reserved)
-    sendCommand(packet, NoOP);
+    sendCommand(packet, NoOP, enocean_tx_service, 0x03);
     return;
   }
   inherited::syncChannelValues(aDoneCB);
@@ -780,13 +780,13 @@ void EnoceanD20620Device::requestD20620status()
   packet->setRadioDestination(getAddress());
   packet->radioUserData()[0] = 0x01; // Message ID 0x01 - Query
   packet->radioUserData()[1] = 0x00; // Operational Status
-  sendCommand(packet, NoOP);
+  sendCommand(packet, NoOP, enocean_tx_service);
   packet = Esp3PacketPtr(new Esp3Packet());
   packet->initForRorg(rorg_VLD, 2);
   packet->setRadioDestination(getAddress());
   packet->radioUserData()[0] = 0x01; // Message ID 0x01 - Query
   packet->radioUserData()[1] = 0x01; // Service Status
-  sendCommand(packet, NoOP);
+  sendCommand(packet, NoOP, enocean_tx_service);
 }
 
 
@@ -812,7 +812,7 @@ void EnoceanD20620Device::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
         packet->radioUserData()[1] = percentTilt; // new target value
         packet->radioUserData()[2] = 0xFF; // Aeration timer = 0xFFFE -> no change
         packet->radioUserData()[3] = 0xFE; // Aeration timer = 0xFFFE -> no change
-        sendCommand(packet, NoOP);
+        sendCommand(packet, NoOP, enocean_tx_interactive, 0x00); // newer target value supersedes older one
       }
     }
   }
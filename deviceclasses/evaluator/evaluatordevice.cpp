@@ -48,6 +48,7 @@ EvaluatorDevice::EvaluatorDevice(EvaluatorVdc *aVdcP, const string &aEvaluatorID
   mEvaluatorState(undefined)
 {
   mValueMapper.isMemberVariable();
+  mValueMapper.setSubscriberStats(new ValueSubscriberStats); // subscribe to value sources via dependency index
   // Config is:
   //  <behaviour mode>
   int st, su;
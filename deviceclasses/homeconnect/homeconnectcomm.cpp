@@ -37,6 +37,19 @@ using namespace p44;
 
 #define OAUTH_TOKEN_PATH "/security/oauth/token"
 
+#define ALL_APPLIANCES_EVENTS_PATH "/api/homeappliances/events"
+
+// documented rate limits
+#define RATE_LIMIT_PER_MINUTE 50
+#define RATE_LIMIT_PER_DAY 1000
+#define RATE_LIMIT_SUCCESSIVE_ERRORS 10
+#define RATE_LIMIT_ERROR_WINDOW (10*Minute)
+// parts of the budget that can only be used by user commands
+#define COMMAND_RESERVE_PER_MINUTE 10
+#define COMMAND_RESERVE_PER_DAY 100
+// successive errors after which queries are held back (commands may still use the rest)
+#define QUERY_ERROR_LIMIT 5
+
 // MARK: ===== HomeConnectApiOperation
 
 HomeConnectApiOperation::HomeConnectApiOperation(HomeConnectComm &aHomeConnectComm,
@@ -85,7 +98,9 @@ void HomeConnectApiOperation::sendRequest()
   // initiate the web request
   // - set up the extra auth headers
   homeConnectComm.httpAPIComm.clearRequestHeaders();
-  homeConnectComm.httpAPIComm.addRequestHeader("Authorization", string_format("Bearer %s", homeConnectComm.accessToken.c_str()));
+  if (homeConnectComm.usesOfficialServer()) {
+    homeConnectComm.httpAPIComm.addRequestHeader("Authorization", string_format("Bearer %s", homeConnectComm.accessToken.c_str()));
+  }
   homeConnectComm.httpAPIComm.addRequestHeader("Accept", "application/vnd.bsh.sdk.v1+json");
   homeConnectComm.httpAPIComm.addRequestHeader("Cache-Control", "no-cache");
   // - issue the request
@@ -100,7 +115,8 @@ void HomeConnectApiOperation::refreshAccessToken()
   // - set up the extra auth headers
   homeConnectComm.httpAPIComm.clearRequestHeaders();
   homeConnectComm.httpAPIComm.addRequestHeader("Cache-Control", "no-cache");
-  string postdata = "grant_type=refresh_token&refresh_token=" + homeConnectComm.refreshToken;
+  string postdata = "grant_type=refresh_token&refresh_token=";
+  if (homeConnectComm.usesOfficialServer()) postdata += homeConnectComm.refreshToken;
   // - issue the request
   homeConnectComm.httpAPIComm.jsonReturningRequest(
     (homeConnectComm.baseUrl()+OAUTH_TOKEN_PATH).c_str(),
@@ -223,7 +239,7 @@ void HomeConnectApiOperation::abortOperation(ErrorPtr aError)
 // MARK: ===== HomeConnectEventMonitor
 
 
-HomeConnectEventMonitor::HomeConnectEventMonitor(HomeConnectComm &aHomeConnectComm, const char *aUrlPath, HomeConnectEventResultCB aEventCB) :
+HomeConnectEventMonitor::HomeConnectEventMonitor(HomeConnectComm &aHomeConnectComm, const char *aUrlPath, HomeConnectStreamEventCB aEventCB) :
   inherited(MainLoop::currentMainLoop()),
   homeConnectComm(aHomeConnectComm),
   urlPath(aUrlPath),
@@ -251,7 +267,9 @@ void HomeConnectEventMonitor::sendGetEventRequest()
 	  // - set up the extra auth headers
 	  eventBuffer.clear();
 	  clearRequestHeaders();
-	  addRequestHeader("Authorization", string_format("Bearer %s", homeConnectComm.accessToken.c_str()));
+	  if (homeConnectComm.usesOfficialServer()) {
+	    addRequestHeader("Authorization", string_format("Bearer %s", homeConnectComm.accessToken.c_str()));
+	  }
 	  addRequestHeader("Accept", "text/event-stream");
 	  addRequestHeader("Cache-Control", "no-cache");
 	  // - make the call
@@ -359,6 +377,7 @@ void HomeConnectEventMonitor::parseLine(const string& aLine)
     // done
     eventData.clear();
     eventTypeString.clear();
+    eventId.clear();
     eventGotID = false;
   } else {
     string field;
@@ -372,6 +391,7 @@ void HomeConnectEventMonitor::parseLine(const string& aLine)
         FOCUSLOG(">>> Got event data: %s", eventData.c_str());
       } else if (field == "id") {
         eventGotID = true;
+        eventId = trimWhiteSpace(data);
         FOCUSLOG(">>> Got field id: %s", data.c_str());
       } else if( !eventGotID ) {
         eventData += aLine;
@@ -382,12 +402,33 @@ void HomeConnectEventMonitor::parseLine(const string& aLine)
   }
 }
 
+static string haIdFromUri(JsonObjectPtr aItem)
+{
+  // item uri looks like: /api/homeappliances/<haId>/status/<key>
+  JsonObjectPtr o;
+  if (aItem && aItem->get("uri", o)) {
+    string uri = o->stringValue();
+    const string prefix = "/api/homeappliances/";
+    if (uri.substr(0, prefix.size())==prefix) {
+      size_t e = uri.find('/', prefix.size());
+      return uri.substr(prefix.size(), e==string::npos ? string::npos : e-prefix.size());
+    }
+  }
+  return "";
+}
+
+
 void HomeConnectEventMonitor::completeEvent()
 {
+  // On the all-appliances event stream, the id field carries the home appliance ID.
+  // Use haId in the data or the item uri as fallback
+  string haId = eventId;
   // convert data to JSON
   bool reporteditem = false;
   JsonObjectPtr jsondata = JsonObject::objFromText(eventData.c_str());
   if (jsondata) {
+    JsonObjectPtr o;
+    if (haId.empty() && jsondata->get("haId", o)) haId = o->stringValue();
     // iterate trough items
     JsonObjectPtr items;
     if (jsondata->get("items", items)) {
@@ -397,7 +438,7 @@ void HomeConnectEventMonitor::completeEvent()
           // deliver
           reporteditem = true;
           if (eventCB) {
-            eventCB(getEventType(), item, ErrorPtr());
+            eventCB(haId.empty() ? haIdFromUri(item) : haId, getEventType(), item, ErrorPtr());
           }
         }
       }
@@ -406,7 +447,7 @@ void HomeConnectEventMonitor::completeEvent()
   if (!reporteditem) {
     // event w/o data or without items array in data, report event type along with raw data (or no data)
     if (eventCB)
-      eventCB(getEventType(), jsondata, ErrorPtr());
+      eventCB(haId, getEventType(), jsondata, ErrorPtr());
   }
 }
 
@@ -419,6 +460,71 @@ void HomeConnectEventMonitor::apiQueryDone(JsonObjectPtr aResult, ErrorPtr aErro
 }
 
 
+// MARK: ===== HomeConnectRequestBudget
+
+HomeConnectRequestBudget::HomeConnectRequestBudget() :
+  minuteTokens(RATE_LIMIT_PER_MINUTE),
+  tokensUpdated(MainLoop::now()),
+  dayRequests(0),
+  dayStarted(MainLoop::now()),
+  successiveErrors(0),
+  firstErrorAt(Never)
+{
+}
+
+
+MLMicroSeconds HomeConnectRequestBudget::take(bool aCommand)
+{
+  MLMicroSeconds now = MainLoop::now();
+  // refill per-minute bucket
+  minuteTokens += (double)(now-tokensUpdated)*RATE_LIMIT_PER_MINUTE/Minute;
+  if (minuteTokens>RATE_LIMIT_PER_MINUTE) minuteTokens = RATE_LIMIT_PER_MINUTE;
+  tokensUpdated = now;
+  // restart day window
+  if (now>=dayStarted+Day) {
+    dayStarted = now;
+    dayRequests = 0;
+  }
+  // forget errors that are out of the error window
+  if (successiveErrors>0 && now>=firstErrorAt+RATE_LIMIT_ERROR_WINDOW) {
+    successiveErrors = 0;
+  }
+  // check limits
+  if (dayRequests>=RATE_LIMIT_PER_DAY-(aCommand ? 0 : COMMAND_RESERVE_PER_DAY)) {
+    return dayStarted+Day-now;
+  }
+  if (successiveErrors>=(aCommand ? RATE_LIMIT_SUCCESSIVE_ERRORS-1 : QUERY_ERROR_LIMIT)) {
+    return firstErrorAt+RATE_LIMIT_ERROR_WINDOW-now;
+  }
+  double needed = 1+(aCommand ? 0 : COMMAND_RESERVE_PER_MINUTE);
+  if (minuteTokens<needed) {
+    return (MLMicroSeconds)((needed-minuteTokens)*Minute/RATE_LIMIT_PER_MINUTE)+1;
+  }
+  // consume
+  minuteTokens -= 1;
+  dayRequests++;
+  return 0;
+}
+
+
+void HomeConnectRequestBudget::requestDone(bool aFailed)
+{
+  if (aFailed) {
+    if (successiveErrors==0) firstErrorAt = MainLoop::now();
+    successiveErrors++;
+  }
+  else {
+    successiveErrors = 0;
+  }
+}
+
+
+string HomeConnectRequestBudget::description()
+{
+  return string_format("%.1f/min tokens, %d/day used, %d successive errors", minuteTokens, dayRequests, successiveErrors);
+}
+
+
 // MARK: ===== HomeConnectComm
 
 HomeConnectComm::HomeConnectComm() :
@@ -426,7 +532,8 @@ HomeConnectComm::HomeConnectComm() :
   httpAPIComm(MainLoop::currentMainLoop()),
   findInProgress(false),
   apiReady(false),
-  developerApi(false)
+  developerApi(false),
+  requestsInFlight(0)
 {
   httpAPIComm.isMemberVariable();
   httpAPIComm.setServerCertVfyDir(""); // Use empty string to not verify server certificate
@@ -449,10 +556,23 @@ void HomeConnectComm::setAuthentication(string aAuthData)
 
 string HomeConnectComm::baseUrl()
 {
+  #if ENABLE_HOMECONNECT_TEST_SERVER
+  if (!baseUrlOverride.empty()) return baseUrlOverride;
+  #endif
   return developerApi ? DEVELOPER_BASE_URL : PRODUCTION_BASE_URL;
 }
 
 
+bool HomeConnectComm::usesOfficialServer()
+{
+  #if ENABLE_HOMECONNECT_TEST_SERVER
+  return baseUrlOverride.empty();
+  #else
+  return true;
+  #endif
+}
+
+
 
 HomeConnectComm::~HomeConnectComm()
 {
@@ -468,10 +588,24 @@ void HomeConnectComm::apiQuery(const char* aUrlPath, HomeConnectApiResultCB aRes
 void HomeConnectComm::apiAction(const string& aMethod, const string& aUrlPath, JsonObjectPtr aData, HomeConnectApiResultCB aResultHandler)
 {
   if (!isLockDown()) {
-    HomeConnectApiOperationPtr op = HomeConnectApiOperationPtr(new HomeConnectApiOperation(*this, aMethod, aUrlPath, aData, aResultHandler));
-    queueOperation(op);
-    // process operations
-    processOperations();
+    bool command = aMethod!="GET";
+    if (!command) {
+      // merge with identical query still waiting to be issued
+      for (PendingRequestsList::iterator pos = pendingQueries.begin(); pos!=pendingQueries.end(); ++pos) {
+        if ((*pos)->urlPath==aUrlPath) {
+          FOCUSLOG("Merging query for '%s' with already pending one", aUrlPath.c_str());
+          if (aResultHandler) (*pos)->resultHandlers.push_back(aResultHandler);
+          return;
+        }
+      }
+    }
+    PendingRequestPtr req = PendingRequestPtr(new PendingRequest);
+    req->method = aMethod;
+    req->urlPath = aUrlPath;
+    req->data = aData;
+    if (aResultHandler) req->resultHandlers.push_back(aResultHandler);
+    (command ? pendingCommands : pendingQueries).push_back(req);
+    issuePendingRequests();
   } else {
     LOG(LOG_INFO, "Cannot send command during lock down.");
     if (aResultHandler) {
@@ -480,6 +614,102 @@ void HomeConnectComm::apiAction(const string& aMethod, const string& aUrlPath, J
   }
 }
 
+
+void HomeConnectComm::issuePendingRequests()
+{
+  // Note: requests are issued one by one, so user commands arriving later can still overtake waiting queries
+  while (requestsInFlight==0) {
+    bool command = !pendingCommands.empty();
+    PendingRequestsList &pending = command ? pendingCommands : pendingQueries;
+    if (pending.empty()) return; // nothing to do
+    if (isLockDown()) {
+      // lockdown has started after the request was queued
+      PendingRequestPtr req = pending.front();
+      pending.pop_front();
+      ErrorPtr err = WebError::webErr(429, "Communication temporally disabled");
+      for (std::list<HomeConnectApiResultCB>::iterator pos = req->resultHandlers.begin(); pos!=req->resultHandlers.end(); ++pos) {
+        (*pos)(JsonObjectPtr(), err);
+      }
+      continue;
+    }
+    MLMicroSeconds wait = budget.take(command);
+    if (wait>0) {
+      LOG(LOG_INFO, "HomeConnect: request budget exhausted (%s), delaying %zu commands and %zu queries by %.1f seconds",
+        budget.description().c_str(), pendingCommands.size(), pendingQueries.size(), (double)wait/Second
+      );
+      budgetTicket.executeOnce(boost::bind(&HomeConnectComm::issuePendingRequests, this), wait);
+      return;
+    }
+    PendingRequestPtr req = pending.front();
+    pending.pop_front();
+    requestsInFlight++;
+    FOCUSLOG("Issuing %s request for '%s' (%s)", req->method.c_str(), req->urlPath.c_str(), budget.description().c_str());
+    HomeConnectApiOperationPtr op = HomeConnectApiOperationPtr(new HomeConnectApiOperation(
+      *this, req->method, req->urlPath, req->data,
+      boost::bind(&HomeConnectComm::pendingRequestDone, this, req, _1, _2)
+    ));
+    queueOperation(op);
+    // process operations
+    processOperations();
+  }
+}
+
+
+void HomeConnectComm::pendingRequestDone(PendingRequestPtr aRequest, JsonObjectPtr aResult, ErrorPtr aError)
+{
+  if (requestsInFlight>0) {
+    requestsInFlight--;
+    budget.requestDone(!Error::isOK(aError));
+  }
+  // deliver result to all merged requesters
+  for (std::list<HomeConnectApiResultCB>::iterator pos = aRequest->resultHandlers.begin(); pos!=aRequest->resultHandlers.end(); ++pos) {
+    (*pos)(aResult, aError);
+  }
+  issuePendingRequests();
+}
+
+
+string HomeConnectComm::requestBudgetStatus()
+{
+  return string_format("%s, %zu commands and %zu queries pending", budget.description().c_str(), pendingCommands.size(), pendingQueries.size());
+}
+
+
+void HomeConnectComm::registerEventHandler(const string &aHaId, HomeConnectEventResultCB aEventCB)
+{
+  eventHandlers[aHaId] = aEventCB;
+  if (!eventMonitor) {
+    // all appliances share a single event stream
+    eventMonitor = HomeConnectEventMonitorPtr(new HomeConnectEventMonitor(
+      *this,
+      ALL_APPLIANCES_EVENTS_PATH,
+      boost::bind(&HomeConnectComm::dispatchEvent, this, _1, _2, _3, _4))
+    );
+  }
+}
+
+
+void HomeConnectComm::unregisterEventHandler(const string &aHaId)
+{
+  eventHandlers.erase(aHaId);
+  if (eventHandlers.empty()) {
+    eventMonitor.reset();
+  }
+}
+
+
+void HomeConnectComm::dispatchEvent(const string &aHaId, EventType aEventType, JsonObjectPtr aEventData, ErrorPtr aError)
+{
+  EventHandlerMap::iterator pos = eventHandlers.find(aHaId);
+  if (pos==eventHandlers.end()) {
+    FOCUSLOG("Event for unknown appliance '%s' ignored", aHaId.c_str());
+    return;
+  }
+  // Note: copy callback, handler might unregister itself
+  HomeConnectEventResultCB cb = pos->second;
+  if (cb) cb(aEventType, aEventData, aError);
+}
+
 MLMicroSeconds HomeConnectComm::calculateLockDownTime()
 {
   // try to get the missing time from response header
@@ -26,6 +26,10 @@
 
 #if ENABLE_HOMECONNECT
 
+#ifndef ENABLE_HOMECONNECT_TEST_SERVER
+  #define ENABLE_HOMECONNECT_TEST_SERVER 0 // allows redirecting API requests to a local stand-in server for testing
+#endif
+
 #include "jsonwebclient.hpp"
 #include "operationqueue.hpp"
 
@@ -115,6 +119,13 @@ namespace p44 {
   ///   delivered by the API itself.
   typedef boost::function<void (EventType aEventType, JsonObjectPtr aEventData, ErrorPtr aError)> HomeConnectEventResultCB;
 
+  /// will be called to deliver events from a event stream
+  /// @param aHaId the home appliance ID the event is for (empty if event could not be attributed to an appliance)
+  /// @param aEventType the type of event
+  /// @param aEventData the event data.
+  /// @param aError error in case of failure
+  typedef boost::function<void (const string &aHaId, EventType aEventType, JsonObjectPtr aEventData, ErrorPtr aError)> HomeConnectStreamEventCB;
+
 
   class HomeConnectEventMonitor: public JsonWebClient
   {
@@ -122,11 +133,12 @@ namespace p44 {
 
     HomeConnectComm &homeConnectComm;
     string urlPath;
-    HomeConnectEventResultCB eventCB;
+    HomeConnectStreamEventCB eventCB;
 
     string eventBuffer; ///< accumulating event data
     string eventTypeString;
     string eventData;
+    string eventId; ///< the id field of the event, which is the home appliance ID
     bool eventGotID;
     MLTicket ticket;
 
@@ -136,7 +148,7 @@ namespace p44 {
     /// @param aHomeConnectComm a authorized homeconnect API communication object
     /// @param aUrlPath the path to append to the baseURL (including leading slash)
     /// @param aEventCB will be called when a event is received
-    HomeConnectEventMonitor(HomeConnectComm &aHomeConnectComm, const char *aUrlPath, HomeConnectEventResultCB aEventCB);
+    HomeConnectEventMonitor(HomeConnectComm &aHomeConnectComm, const char *aUrlPath, HomeConnectStreamEventCB aEventCB);
 
     virtual ~HomeConnectEventMonitor();
 
@@ -153,12 +165,68 @@ namespace p44 {
   typedef boost::intrusive_ptr<HomeConnectEventMonitor> HomeConnectEventMonitorPtr;
 
 
+  /// Proactive model of the documented Home Connect API rate limits, so requests can be
+  /// delayed before the cloud starts rejecting them (and locks us out for up to 10 minutes)
+  /// - max 50 requests per minute (modelled as a token bucket)
+  /// - max 1000 requests per day
+  /// - max 10 successive error calls in 10 minutes
+  /// A part of each budget is reserved for user commands, so state polling cannot starve them.
+  class HomeConnectRequestBudget
+  {
+    double minuteTokens; ///< tokens currently available in the per-minute bucket
+    MLMicroSeconds tokensUpdated; ///< when minuteTokens was last refilled
+    int dayRequests; ///< number of requests issued in the current day window
+    MLMicroSeconds dayStarted; ///< start of the current day window
+    int successiveErrors; ///< number of successive failed requests
+    MLMicroSeconds firstErrorAt; ///< time of the first of the successive errors
+
+  public:
+
+    HomeConnectRequestBudget();
+
+    /// try to take budget for a request
+    /// @param aCommand true for user commands, which may use the reserved part of the budget
+    /// @return 0 if the request can be issued now (budget is consumed), time to wait before trying again otherwise
+    MLMicroSeconds take(bool aCommand);
+
+    /// report outcome of an issued request
+    /// @param aFailed true if the request has failed
+    void requestDone(bool aFailed);
+
+    /// @return short description of the current budget state, for logging
+    string description();
+
+  };
+
+
   class HomeConnectComm : public OperationQueue
   {
     typedef OperationQueue inherited;
     friend class HomeConnectApiOperation;
     friend class HomeConnectEventMonitor;
 
+    /// a request waiting for budget. Identical GET requests are merged into one, with multiple result handlers
+    class PendingRequest : public P44Obj
+    {
+    public:
+      string method;
+      string urlPath;
+      JsonObjectPtr data;
+      std::list<HomeConnectApiResultCB> resultHandlers;
+    };
+    typedef boost::intrusive_ptr<PendingRequest> PendingRequestPtr;
+    typedef std::list<PendingRequestPtr> PendingRequestsList;
+
+    PendingRequestsList pendingCommands; ///< user commands (PUT, POST, DELETE) waiting to be issued, always go first
+    PendingRequestsList pendingQueries; ///< state queries (GET) waiting to be issued
+    int requestsInFlight; ///< number of requests issued to the operation queue but not yet answered
+    HomeConnectRequestBudget budget; ///< the rate limit model
+    MLTicket budgetTicket; ///< timer for issuing pending requests when budget becomes available again
+
+    typedef std::map<string, HomeConnectEventResultCB> EventHandlerMap;
+    EventHandlerMap eventHandlers; ///< event handlers by home appliance ID
+    HomeConnectEventMonitorPtr eventMonitor; ///< the single event stream for all appliances
+
     bool findInProgress;
     bool apiReady;
 
@@ -166,6 +234,9 @@ namespace p44 {
     string refreshToken; ///< the Oauth refresh token that can be used to obtain access tokens
 
     bool developerApi;        ///< if set, developer (simulator) API is used
+    #if ENABLE_HOMECONNECT_TEST_SERVER
+    string baseUrlOverride;   ///< if set, this base URL is used instead of the official API servers
+    #endif
     MLTicket lockdownTicket;  ///< A ticket that is used to cancel the currently running lockdown timer
     const static MLMicroSeconds MaxLockdownTimeout = 10 * Minute;
   public:
@@ -199,12 +270,25 @@ namespace p44 {
     /// the API base URL (depends on developerApi setting)
     string baseUrl();
 
+    #if ENABLE_HOMECONNECT_TEST_SERVER
+    /// use a different API server, such as a local stand-in server for testing
+    /// @param aBaseUrl base URL (scheme, host and port, no trailing slash) of the server to use instead
+    ///   of the official servers, empty string to use the official servers again
+    /// @note no access or refresh tokens are ever sent to such a server
+    void setBaseUrlOverride(const string aBaseUrl) { baseUrlOverride = aBaseUrl; };
+    #endif
+
+    /// @return true if requests go to the official API servers, which are the only ones that may see our tokens
+    bool usesOfficialServer();
+
     /// @name executing regular API calls
     /// @{
 
     /// Query information from the API
     /// @param aUrlPath the path to append to the baseURL (including leading slash)
     /// @param aResultHandler will be called with the result
+    /// @note queries have lower priority than actions, and a query for a path that is already waiting
+    ///   to be issued is not sent again, but merged with the waiting one.
     void apiQuery(const char* aUrlPath, HomeConnectApiResultCB aResultHandler);
 
     /// Send information to the API
@@ -212,8 +296,31 @@ namespace p44 {
     /// @param aUrlPath the path to append to the API base URL (including leading slash if not empty)
     /// @param aData the data for the action to perform (JSON body of the request)
     /// @param aResultHandler will be called with the result
+    /// @note requests are issued one at a time, and only when the request budget allows it.
+    ///   Actions other than GET are user commands and are issued before any waiting queries.
     void apiAction(const string& aMethod, const string& aUrlPath, JsonObjectPtr aData, HomeConnectApiResultCB aResultHandler);
 
+    /// @}
+
+    /// @name receiving events
+    /// @{
+
+    /// register handler for events of a home appliance
+    /// @param aHaId the home appliance ID
+    /// @param aEventCB will be called for every event of this appliance
+    /// @note all appliances share the same event stream, which is opened with the first registration
+    void registerEventHandler(const string &aHaId, HomeConnectEventResultCB aEventCB);
+
+    /// unregister handler for events of a home appliance
+    /// @param aHaId the home appliance ID
+    /// @note the event stream is closed when the last handler is unregistered
+    void unregisterEventHandler(const string &aHaId);
+
+    /// @}
+
+    /// @name rate limiting
+    /// @{
+
     /// Get a lockdown time
     MLMicroSeconds calculateLockDownTime();
 
@@ -230,8 +337,17 @@ namespace p44 {
     // check if the lockdown is in effect
     bool isLockDown() { return lockdownTicket; }
 
+    /// @return description of the request budget and pending requests
+    string requestBudgetStatus();
+
     /// @}
 
+  private:
+
+    void issuePendingRequests();
+    void pendingRequestDone(PendingRequestPtr aRequest, JsonObjectPtr aResult, ErrorPtr aError);
+    void dispatchEvent(const string &aHaId, EventType aEventType, JsonObjectPtr aEventData, ErrorPtr aError);
+
   };
   
 } // namespace p44
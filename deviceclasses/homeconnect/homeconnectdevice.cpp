@@ -293,7 +293,7 @@ HomeConnectDevice::HomeConnectDevice(HomeConnectVdc *aVdcP, JsonObjectPtr aHomeA
 
 HomeConnectDevice::~HomeConnectDevice()
 {
-
+  homeConnectComm().unregisterEventHandler(haId);
 }
 
 HomeConnectDevicePtr HomeConnectDevice::createHomeConenctDevice(HomeConnectVdc *aVdcP, JsonObjectPtr aHomeApplicanceInfoRecord)
@@ -549,12 +549,8 @@ HomeConnectComm &HomeConnectDevice::homeConnectComm()
 
 void HomeConnectDevice::initializeDevice(StatusCB aCompletedCB, bool aFactoryReset)
 {
-  // create event stream monitor
-  eventMonitor = HomeConnectEventMonitorPtr(new HomeConnectEventMonitor(
-    homeConnectComm(),
-    string_format("/api/homeappliances/%s/events",haId.c_str()).c_str(),
-    boost::bind(&HomeConnectDevice::handleEvent, this, _1, _2, _3))
-  );
+  // receive events from the event stream shared by all appliances
+  homeConnectComm().registerEventHandler(haId, boost::bind(&HomeConnectDevice::handleEvent, this, _1, _2, _3));
   // we need to poll the state once
   pollState();
 
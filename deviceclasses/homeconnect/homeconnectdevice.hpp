@@ -151,7 +151,6 @@ namespace p44 {
     string gtin;
     bool isConnected;
 
-    HomeConnectEventMonitorPtr eventMonitor; ///< event monitor
 
     // common states, they can be NULL in case this state is not valid for device class
     DeviceStatePtr operationMode;
@@ -239,6 +239,8 @@ static char homeconnect_key;
 enum {
   homeConnectVdcCommStatus,
   homeConnectVdcDeveloperApi,
+  homeConnectVdcBaseUrl,
+  homeConnectVdcRequestBudget,
   homeConnectVdcPropertiesMax
 };
 
@@ -259,6 +261,8 @@ PropertyDescriptorPtr HomeConnectVdc::getDescriptorByIndex(int aPropIndex, int a
   static const PropertyDescription properties[homeConnectVdcPropertiesMax] = {
     { "homeConnectAccountStatus", apivalue_string, homeConnectVdcCommStatus, OKEY(homeconnect_key) },
     { "homeConnectDeveloperApi", apivalue_bool, homeConnectVdcDeveloperApi, OKEY(homeconnect_key) },
+    { "homeConnectBaseUrl", apivalue_string, homeConnectVdcBaseUrl, OKEY(homeconnect_key) },
+    { "homeConnectRequestBudget", apivalue_string, homeConnectVdcRequestBudget, OKEY(homeconnect_key) },
   };
 
   if (aParentDescriptor->isRootOfObject()) {
@@ -298,6 +302,14 @@ bool HomeConnectVdc::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValu
           aPropValue->setBoolValue(homeConnectComm.getDeveloperApi());
           return true;
         }
+        case homeConnectVdcBaseUrl: {
+          aPropValue->setStringValue(homeConnectComm.baseUrl());
+          return true;
+        }
+        case homeConnectVdcRequestBudget: {
+          aPropValue->setStringValue(homeConnectComm.requestBudgetStatus());
+          return true;
+        }
 
       }
     } else if (aMode==access_write) {
@@ -315,6 +327,15 @@ bool HomeConnectVdc::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValu
             return true;
           }
         }
+        #if ENABLE_HOMECONNECT_TEST_SERVER
+        case homeConnectVdcBaseUrl: {
+          // not persistent, allows running against a local stand-in server for testing
+          // Note: no tokens are sent to servers other than the official ones
+          homeConnectComm.setBaseUrlOverride(aPropValue->stringValue());
+          ALOG(LOG_NOTICE, "Using API at: %s", homeConnectComm.baseUrl().c_str());
+          return true;
+        }
+        #endif
       }
     }
   }
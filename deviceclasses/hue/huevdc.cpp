@@ -226,6 +226,35 @@ void HueVdc::handleGlobalEvent(VdchostEvent aEvent)
 
 
 
+void HueVdc::checkPresenceOfDevices(DeviceVector aDevices, StatusCB aDoneCB)
+{
+  // one query for all lights
+  mHueComm.apiQuery("/lights", boost::bind(&HueVdc::presenceListHandler, this, aDevices, aDoneCB, _1, _2));
+}
+
+
+void HueVdc::presenceListHandler(DeviceVector aDevices, StatusCB aDoneCB, JsonObjectPtr aResult, ErrorPtr aError)
+{
+  // Note: bridge not answering means no light is reachable
+  for (DeviceVector::iterator pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+    HueDevicePtr dev = boost::dynamic_pointer_cast<HueDevice>(*pos);
+    if (!dev) continue;
+    bool reachable = false;
+    if (Error::isOK(aError) && aResult) {
+      JsonObjectPtr light = aResult->get(dev->mLightID.c_str());
+      JsonObjectPtr state;
+      if (light && light->get("state", state)) {
+        JsonObjectPtr o = state->get("reachable");
+        reachable = o && o->boolValue();
+      }
+    }
+    dev->updatePresenceState(reachable);
+  }
+  if (aDoneCB) aDoneCB(aError);
+}
+
+
+
 #define REFIND_RETRY_DELAY (30*Second)
 
 void HueVdc::refindBridge(StatusCB aCompletedCB)
@@ -538,6 +567,8 @@ void HueVdc::collectedLightsHandler(StatusCB aCollectedHandler, JsonObjectPtr aR
     aResult->resetKeyIteration();
     string lightID;
     JsonObjectPtr lightInfo;
+    DeviceList newDevices;
+    std::map<Device *, JsonObjectPtr> lightInfos;
     while (aResult->nextKeyValue(lightID, lightInfo)) {
       // create hue device
       if (lightInfo) {
@@ -570,14 +601,18 @@ void HueVdc::collectedLightsHandler(StatusCB aCollectedHandler, JsonObjectPtr aR
         if (o) uniqueID = o->stringValue();
         // create device now
         HueDevicePtr newDev = HueDevicePtr(new HueDevice(this, lightID, hueType, uniqueID));
-        if (simpleIdentifyAndAddDevice(newDev)) {
-          // actually added, no duplicate, set the name
-          // (otherwise, this is an incremental collect and we knew this light already)
-          JsonObjectPtr n = lightInfo->get("name");
-          if (n) newDev->initializeName(n->stringValue());
-        }
+        newDevices.push_back(newDev);
+        lightInfos[newDev.get()] = lightInfo;
       }
     }
+    // add all lights in one batch
+    simpleIdentifyAndAddDevices(newDevices);
+    for (DeviceList::iterator pos = newDevices.begin(); pos!=newDevices.end(); ++pos) {
+      // actually added, no duplicate, set the name
+      // (otherwise, this is an incremental collect and we knew this light already)
+      JsonObjectPtr n = lightInfos[pos->get()]->get("name");
+      if (n) (*pos)->initializeName(n->stringValue());
+    }
   }
   // collect phase done
   if (aCollectedHandler) aCollectedHandler(ErrorPtr());
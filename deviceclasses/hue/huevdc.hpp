@@ -158,12 +158,23 @@ namespace p44 {
     /// @return string, single line extra info describing aspects of the device not visible elsewhere
     virtual string getExtraInfo() P44_OVERRIDE;
 
+    /// check presence of multiple lights with a single query of the bridge's light list
+    /// @param aDevices the devices to check
+    /// @param aDoneCB will be called when all devices have updated their presence state
+    virtual void checkPresenceOfDevices(DeviceVector aDevices, StatusCB aDoneCB) P44_OVERRIDE;
+
   protected:
 
     /// handle global events
     /// @param aEvent the event to handle
     virtual void handleGlobalEvent(VdchostEvent aEvent) P44_OVERRIDE;
 
+    /// the bridge's light list covers all lights, so sample them all at once
+    virtual size_t presenceSampleBatchSize() P44_OVERRIDE { return 0; };
+
+    /// sampling all lights is a single query, so do it in the background by default
+    virtual MLMicroSeconds defaultPresenceSampleInterval() P44_OVERRIDE { return 5*Minute; };
+
     /// @name Implementation methods for native scene and grouped dimming support
     /// @{
 
@@ -222,6 +233,7 @@ namespace p44 {
     void nativeActionFreed(StatusCB aStatusCB, const string aUrl, JsonObjectPtr aResult, ErrorPtr aError);
     void groupDimRepeater(JsonObjectPtr aDimState, int aTransitionTime, MLTimer &aTimer);
     void nativeActionDone(StatusCB aStatusCB, JsonObjectPtr aResult, ErrorPtr aError);
+    void presenceListHandler(DeviceVector aDevices, StatusCB aDoneCB, JsonObjectPtr aResult, ErrorPtr aError);
   };
 
 } // namespace p44
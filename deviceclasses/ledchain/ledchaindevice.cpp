@@ -460,7 +460,7 @@ void LedChainDevice::applyChannelValueSteps(bool aForDimming)
     // simple area, just set foreground color
     mLightView->setForegroundColor(pix);
   }
-  getLedChainVdc().mLedArrangement->render(); // update
+  getLedChainVdc().render(); // update
   // next step
   if (moreSteps) {
     OLOG(LOG_DEBUG, "LED chain transitional values R=%d, G=%d, B=%d, dim=%d", (int)r, (int)g, (int)b, mLightView->getAlpha());
@@ -84,7 +84,8 @@ string LedChainDevicePersistence::schemaUpgradeSQL(int aFromVersion, int &aToVer
 
 LedChainVdc::LedChainVdc(int aInstanceNumber, LEDChainArrangementPtr aLedArrangement, VdcHost *aVdcHostP, int aTag) :
   Vdc(aInstanceNumber, aVdcHostP, aTag),
-  mLedArrangement(aLedArrangement)
+  mLedArrangement(aLedArrangement),
+  mBatchApplying(false)
 {
 }
 
@@ -143,6 +144,22 @@ bool LedChainVdc::getDeviceIcon(string &aIcon, bool aWithData, const char *aReso
 }
 
 
+void LedChainVdc::render()
+{
+  if (mBatchApplying) return; // will render once the whole batch is applied
+  if (mLedArrangement) mLedArrangement->render();
+}
+
+
+void LedChainVdc::applyChannelValuesBatch(BatchApplyList &aBatch)
+{
+  mBatchApplying = true;
+  inherited::applyChannelValuesBatch(aBatch);
+  mBatchApplying = false;
+  render();
+}
+
+
 // vDC name
 const char *LedChainVdc::vdcClassIdentifier() const
 {
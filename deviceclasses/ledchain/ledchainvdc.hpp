@@ -63,6 +63,7 @@ namespace p44 {
     LedChainDevicePersistence mDb;
     LEDChainArrangementPtr mLedArrangement;
     ViewStackPtr mRootView;
+    bool mBatchApplying; ///< set while applying a batch of devices, to render the LED arrangement only once at the end
 
     typedef std::list<LedChainDevicePtr> LedChainDeviceList;
 
@@ -105,10 +106,18 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() const P44_OVERRIDE { return "Smart LED Chains"; }
 
+    /// all devices are views in the same LED arrangement, so changes of many devices can be rendered at once
+    virtual bool supportsBatchApply() P44_OVERRIDE { return true; };
+
+    /// apply the channel values of multiple devices, starting all transitions together with a single render
+    /// @param aBatch the devices with their pending channel values
+    virtual void applyChannelValuesBatch(BatchApplyList &aBatch) P44_OVERRIDE;
+
   private:
 
     LedChainDevicePtr addLedChainDevice(int aX, int aDx, int aY, int aDy, int aZOrder, string aDeviceConfig);
 
+    /// render the LED arrangement (deferred while applying a batch)
     void render();
 
   };
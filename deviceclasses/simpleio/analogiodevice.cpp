@@ -186,17 +186,46 @@ AnalogIODevice::AnalogIODevice(StaticVdc *aVdcP, const string &aDeviceConfig) :
       definedOutRange // when we set output min,max explicitly, we want actual value be clamped to that range
     );
     addBehaviour(sb);
+    #if ENABLE_POLL_SCHEDULER
+    // register for polling: at update interval while value changes, up to twice as long while stable
+    // (alive sign interval is at least 3 times the update interval)
+    mPoller = getVdcHost().getPollScheduler().registerClient(
+      ioname, "analogio", pollIntervalS*Second, 2*pollIntervalS*Second,
+      boost::bind(&AnalogIODevice::analogInputPoll, this)
+    );
+    #else
     // install polling for it, poll first time right now
     mTimerTicket.executeOnce(boost::bind(&AnalogIODevice::analogInputPoll, this, _1, _2));
+    #endif
   }
 	deriveDsUid();
 }
 
 AnalogIODevice::~AnalogIODevice()
 {
+  #if ENABLE_POLL_SCHEDULER
+  if (mPoller) mPoller->unregister();
+  #endif
 }
 
 
+#if ENABLE_POLL_SCHEDULER
+
+void AnalogIODevice::analogInputPoll()
+{
+  SensorBehaviourPtr sb = getSensor(0);
+  PollResult res = poll_failed;
+  if (sb) {
+    // return value with scaling (default==1) and offset (default==0)
+    double v = mAnalogIO->value()*mScaling+mOffset;
+    bool changed = !sb->hasDefinedState() || fabs(v-sb->getCurrentValue())>=sb->getResolution();
+    sb->updateSensorValue(v);
+    res = changed ? poll_changed : poll_unchanged;
+  }
+  mPoller->pollDone(res);
+}
+
+#else
 
 void AnalogIODevice::analogInputPoll(MLTimer &aTimer, MLMicroSeconds aNow)
 {
@@ -208,6 +237,8 @@ void AnalogIODevice::analogInputPoll(MLTimer &aTimer, MLMicroSeconds aNow)
   }
 }
 
+#endif // ENABLE_POLL_SCHEDULER
+
 
 
 
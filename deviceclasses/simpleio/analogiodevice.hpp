@@ -59,6 +59,9 @@ namespace p44 {
     AnalogIoType mAnalogIOType;
 
     MLTicket mTimerTicket; // for output transitions and input poll
+    #if ENABLE_POLL_SCHEDULER
+    PollClientPtr mPoller; // for input poll
+    #endif
     double mScaling; ///< scaling factor for analog sensors (native value will be multiplied by this)
     double mOffset; ///< offset for analog sensors (reported value = native*scale+offset)
 
@@ -107,7 +110,11 @@ namespace p44 {
 
   private:
 
+    #if ENABLE_POLL_SCHEDULER
+    void analogInputPoll();
+    #else
     void analogInputPoll(MLTimer &aTimer, MLMicroSeconds aNow);
+    #endif
     virtual void applyChannelValueSteps(bool aForDimming);
 
   };
@@ -34,6 +34,14 @@
 
 // interval for polling current state and power consumption
 #define STATE_POLL_INTERVAL (30*Second)
+#if ENABLE_POLL_SCHEDULER
+// adaptive poll interval range: faster after changes, slower while state and power are stable
+#define STATE_POLL_MIN_INTERVAL (10*Second)
+#define STATE_POLL_MAX_INTERVAL (60*Second)
+#define POWER_CHANGE_THRESHOLD 1.0 // [W] power changes smaller than this do not speed up polling
+#else
+#define STATE_POLL_MAX_INTERVAL STATE_POLL_INTERVAL
+#endif
 
 using namespace p44;
 
@@ -109,6 +117,9 @@ MyStromDevice::MyStromDevice(StaticVdc *aVdcP, const string &aDeviceConfig) :
 
 MyStromDevice::~MyStromDevice()
 {
+  #if ENABLE_POLL_SCHEDULER
+  if (mPoller) mPoller->unregister();
+  #endif
 }
 
 
@@ -149,7 +160,16 @@ void MyStromDevice::initialStateReceived(StatusCB aCompletedCB, bool aFactoryRes
     }
   }
   // set up regular polling
+  #if ENABLE_POLL_SCHEDULER
+  if (!mPoller) {
+    mPoller = getVdcHost().getPollScheduler().registerClient(
+      shortDesc(), mDeviceHostName, STATE_POLL_MIN_INTERVAL, STATE_POLL_MAX_INTERVAL, // each plug is its own endpoint
+      boost::bind(&MyStromDevice::sampleState, this)
+    );
+  }
+  #else
   mSensorPollTicket.executeOnce(boost::bind(&MyStromDevice::sampleState, this), 1*Second);
+  #endif
   // anyway, consider initialized
   inherited::initializeDevice(aCompletedCB, aFactoryReset);
 }
@@ -157,20 +177,30 @@ void MyStromDevice::initialStateReceived(StatusCB aCompletedCB, bool aFactoryRes
 
 void MyStromDevice::sampleState()
 {
+  #if ENABLE_POLL_SCHEDULER
+  if (!myStromApiQuery(boost::bind(&MyStromDevice::stateReceived, this, mPoller->pollId(), _1, _2), "report")) {
+    // error, scheduler will try again later with backoff
+    mPoller->pollDone(poll_failed);
+  }
+  #else
   mSensorPollTicket.cancel();
-  if (!myStromApiQuery(boost::bind(&MyStromDevice::stateReceived, this, _1, _2), "report")) {
+  if (!myStromApiQuery(boost::bind(&MyStromDevice::stateReceived, this, 0, _1, _2), "report")) {
     // error, try again later (after pausing 10 normal poll periods)
     mSensorPollTicket.executeOnce(boost::bind(&MyStromDevice::sampleState, this), 10*STATE_POLL_INTERVAL);
   }
+  #endif
 }
 
 
-void MyStromDevice::stateReceived(JsonObjectPtr aJsonResponse, ErrorPtr aError)
+void MyStromDevice::stateReceived(uint32_t aPollId, JsonObjectPtr aJsonResponse, ErrorPtr aError)
 {
+  bool changed = false;
   if (Error::isOK(aError) && aJsonResponse) {
     JsonObjectPtr o = aJsonResponse->get("power");
     if (o && mPowerSensor) {
-      mPowerSensor->updateSensorValue(o->doubleValue());
+      double power = o->doubleValue();
+      if (!mPowerSensor->hasDefinedState() || fabs(power-mPowerSensor->getCurrentValue())>=POWER_CHANGE_THRESHOLD) changed = true;
+      mPowerSensor->updateSensorValue(power);
     }
     o = aJsonResponse->get("temperature");
     if (o && mTemperatureSensor) {
@@ -179,12 +209,17 @@ void MyStromDevice::stateReceived(JsonObjectPtr aJsonResponse, ErrorPtr aError)
     o = aJsonResponse->get("relay");
     if (o) {
       if (getOutput()->getChannelByIndex(0)->syncChannelValueBool(o->boolValue())) {
+        changed = true;
         reportOutputState();
       }
     }
   }
   // schedule next poll
+  #if ENABLE_POLL_SCHEDULER
+  if (mPoller) mPoller->pollDone(Error::notOK(aError) ? poll_failed : (changed ? poll_changed : poll_unchanged), aPollId);
+  #else
   mSensorPollTicket.executeOnce(boost::bind(&MyStromDevice::sampleState, this), STATE_POLL_INTERVAL);
+  #endif
 }
 
 
@@ -193,7 +228,7 @@ void MyStromDevice::stateReceived(JsonObjectPtr aJsonResponse, ErrorPtr aError)
 void MyStromDevice::checkPresence(PresenceCB aPresenceResultHandler)
 {
   // assume present if we had a recent succesful poll
-  aPresenceResultHandler(mPowerSensor && mPowerSensor->hasCurrentValue(STATE_POLL_INTERVAL*1.2));
+  aPresenceResultHandler(mPowerSensor && mPowerSensor->hasCurrentValue(STATE_POLL_MAX_INTERVAL*1.2));
 }
 
 
@@ -234,7 +269,11 @@ void MyStromDevice::channelValuesSent(SimpleCB aDoneCB, string aResponse, ErrorP
   if (Error::isOK(aError)) {
     getOutput()->getChannelByIndex(0)->channelValueApplied();
     // sample the state and power
+    #if ENABLE_POLL_SCHEDULER
+    if (mPoller) mPoller->pollSoon();
+    #else
     sampleState();
+    #endif
   }
   else {
     FOCUSLOG("myStrom API error: %s", aError->text());
@@ -51,7 +51,11 @@ namespace p44 {
 
     SensorBehaviourPtr mPowerSensor;
     SensorBehaviourPtr mTemperatureSensor;
+    #if ENABLE_POLL_SCHEDULER
+    PollClientPtr mPoller;
+    #else
     MLTicket mSensorPollTicket;
+    #endif
 
   public:
     MyStromDevice(StaticVdc *aVdcP, const string &aDeviceConfig);
@@ -121,7 +125,7 @@ namespace p44 {
 
     void initialStateReceived(StatusCB aCompletedCB, bool aFactoryReset, JsonObjectPtr aJsonResponse, ErrorPtr aError);
     void sampleState();
-    void stateReceived(JsonObjectPtr aJsonResponse, ErrorPtr aError);
+    void stateReceived(uint32_t aPollId, JsonObjectPtr aJsonResponse, ErrorPtr aError);
 
     void channelValuesSent(SimpleCB aDoneCB, string aResponse, ErrorPtr aError);
     void channelValuesReceived(SimpleCB aDoneCB, JsonObjectPtr aJsonResponse, ErrorPtr aError);
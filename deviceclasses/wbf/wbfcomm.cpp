@@ -177,7 +177,11 @@ void WbfApiOperation::abortOperation(ErrorPtr aError)
 WbfComm::WbfComm() :
   inherited(MainLoop::currentMainLoop()),
   mGatewayAPIComm(MainLoop::currentMainLoop()),
-  mApiReady(false)
+  mApiReady(false),
+  mWebsocketConnected(false),
+  mWebsocketConnectedSince(Never),
+  mWebsocketCommandsDisabled(false),
+  mUnconfirmedWebsocketCommands(0)
 {
   mGatewayAPIComm.isMemberVariable();
   mGatewayWebsocket.isMemberVariable();
@@ -214,6 +218,7 @@ void WbfComm::stopApi(StatusCB aStopCB)
 {
   if (mApiReady) {
     mWebsocketTicket.cancel();
+    mWebsocketConnected = false;
     mGatewayWebsocket.close(aStopCB);
     mApiReady = false;
   }
@@ -228,7 +233,7 @@ void WbfComm::stopApi(StatusCB aStopCB)
 void WbfComm::webSocketStart(StatusCB aStartupCB)
 {
   mWebsocketTicket.cancel();
-  mGatewayWebsocket.setMessageHandler(mWebSocketCB);
+  mGatewayWebsocket.setMessageHandler(boost::bind(&WbfComm::webSocketMessage, this, _1, _2));
   mGatewayWebsocket.connectTo(
     boost::bind(&WbfComm::webStocketStatus, this, aStartupCB, _1),
     #ifdef __APPLE__
@@ -252,10 +257,22 @@ void WbfComm::webStocketStatus(StatusCB aStartupCB, ErrorPtr aError)
     return;
   }
   OLOG(LOG_INFO, "websocket connection established");
+  mWebsocketConnected = true;
+  mWebsocketConnectedSince = MainLoop::now();
   if (aStartupCB) aStartupCB(aError);
 }
 
 
+void WbfComm::webSocketMessage(const string aMessage, ErrorPtr aError)
+{
+  if (Error::notOK(aError)) {
+    // pushed state can no longer be relied upon, send target states via HTTP
+    mWebsocketConnected = false;
+  }
+  if (mWebSocketCB) mWebSocketCB(aMessage, aError);
+}
+
+
 ErrorPtr WbfComm::sendWebSocketTextMsg(const string aTextMessage)
 {
   return mGatewayWebsocket.send(aTextMessage);
@@ -273,6 +290,204 @@ ErrorPtr WbfComm::sendWebSocketJsonMsg(JsonObjectPtr aJsonMessage)
 
 
 
+// MARK: - load target states
+
+#define WBF_WSCMD_CONFIRM_TIMEOUT (3*Second) ///< how long to wait for a load state push confirming a target state sent via websocket
+#define WBF_WSCMD_MAX_UNCONFIRMED 3 ///< after that many target states not confirmed via websocket, use HTTP only
+
+bool WbfComm::websocketCommandsUsable()
+{
+  return WBF_WEBSOCKET_TARGET_STATES && mWebsocketConnected && !mWebsocketCommandsDisabled;
+}
+
+
+/// @return true if all fields of aTargetState have the same value in aState
+static bool targetStateReached(JsonObjectPtr aTargetState, JsonObjectPtr aState)
+{
+  if (!aState) return false;
+  string key;
+  JsonObjectPtr val;
+  aTargetState->resetKeyIteration();
+  while (aTargetState->nextKeyValue(key, val)) {
+    JsonObjectPtr rep;
+    if (!aState->get(key.c_str(), rep) || !rep || !val) return false;
+    if (val->isType(json_type_int) || val->isType(json_type_double)) {
+      if (val->int32Value()!=rep->int32Value()) return false;
+    }
+    else if (val->json_str()!=rep->json_str()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void WbfComm::setLoadTargetState(int aLoadId, JsonObjectPtr aTargetState, WbfApiResultCB aResultHandler)
+{
+  WbfLoadTarget &lt = mLoadTargets[aLoadId];
+  if (lt.mPending) {
+    // not yet sent target state is superseded by the new one: merge, new values override old ones
+    FOCUSOLOG("load %d: coalescing target state %s into not yet sent %s", aLoadId, JsonObject::text(aTargetState), JsonObject::text(lt.mPending));
+    string key;
+    JsonObjectPtr val;
+    aTargetState->resetKeyIteration();
+    while (aTargetState->nextKeyValue(key, val)) {
+      lt.mPending->add(key.c_str(), val);
+    }
+    // superseded target state counts as delivered
+    if (lt.mPendingCB) {
+      WbfApiResultCB cb = lt.mPendingCB;
+      lt.mPendingCB = aResultHandler;
+      cb(JsonObjectPtr(), ErrorPtr());
+    }
+    else {
+      lt.mPendingCB = aResultHandler;
+    }
+  }
+  else {
+    lt.mPending = aTargetState;
+    lt.mPendingCB = aResultHandler;
+  }
+  // send all target states collected in this mainloop cycle together
+  if (!mLoadTargetsTicket) {
+    mLoadTargetsTicket.executeOnce(boost::bind(&WbfComm::sendLoadTargets, this), 0);
+  }
+}
+
+
+void WbfComm::sendLoadTargets()
+{
+  mLoadTargetsTicket.cancel();
+  for (WbfLoadTargetsMap::iterator pos = mLoadTargets.begin(); pos!=mLoadTargets.end(); ++pos) {
+    WbfLoadTarget &lt = pos->second;
+    if (!lt.mPending || lt.mHttpInFlight) continue; // nothing to send, or must wait for previous HTTP PUT to complete
+    JsonObjectPtr targetState = lt.mPending;
+    WbfApiResultCB cb = lt.mPendingCB;
+    lt.mPending.reset();
+    lt.mPendingCB = NoOP;
+    if (websocketCommandsUsable()) {
+      // send via websocket
+      JsonObjectPtr load = JsonObject::newObj();
+      load->add("id", JsonObject::newInt32(pos->first));
+      load->add("target_state", targetState);
+      JsonObjectPtr msg = JsonObject::newObj();
+      msg->add("load", load);
+      OLOG(LOG_INFO, "Sending target state via websocket: %s", JsonObject::text(msg));
+      ErrorPtr err = sendWebSocketJsonMsg(msg);
+      if (Error::isOK(err)) {
+        if (lt.mUnconfirmedCB) {
+          // previous target state still waiting for confirmation is superseded now
+          WbfApiResultCB ucb = lt.mUnconfirmedCB;
+          lt.mUnconfirmedCB = NoOP;
+          ucb(JsonObjectPtr(), ErrorPtr());
+        }
+        if (targetStateReached(targetState, lt.mReported)) {
+          // load is already in the target state, gateway will not push a state change
+          lt.mUnconfirmed.reset();
+          if (cb) cb(JsonObjectPtr(), ErrorPtr());
+          continue;
+        }
+        // report success only when the gateway pushes the target state for this load
+        lt.mUnconfirmed = targetState;
+        lt.mUnconfirmedCB = cb;
+        lt.mUnconfirmedSince = MainLoop::now();
+        if (!mConfirmationTicket) {
+          mConfirmationTicket.executeOnce(boost::bind(&WbfComm::checkLoadTargetConfirmations, this), WBF_WSCMD_CONFIRM_TIMEOUT);
+        }
+        continue;
+      }
+      OLOG(LOG_WARNING, "Cannot send target state via websocket, using HTTP: %s", err->text());
+    }
+    sendLoadTargetViaHttp(pos->first, targetState, cb);
+  }
+}
+
+
+void WbfComm::sendLoadTargetViaHttp(int aLoadId, JsonObjectPtr aTargetState, WbfApiResultCB aResultHandler)
+{
+  mLoadTargets[aLoadId].mHttpInFlight = true;
+  apiAction(
+    WbfApiOperation::PUT,
+    string_format("/loads/%d/target_state", aLoadId).c_str(),
+    aTargetState,
+    boost::bind(&WbfComm::loadTargetSentViaHttp, this, aLoadId, aResultHandler, _1, _2)
+  );
+}
+
+
+void WbfComm::loadTargetSentViaHttp(int aLoadId, WbfApiResultCB aResultHandler, JsonObjectPtr aResult, ErrorPtr aError)
+{
+  WbfLoadTargetsMap::iterator pos = mLoadTargets.find(aLoadId);
+  if (pos!=mLoadTargets.end()) {
+    pos->second.mHttpInFlight = false;
+    if (pos->second.mPending && !mLoadTargetsTicket) {
+      // more recent target state has accumulated in the meantime, send it now
+      mLoadTargetsTicket.executeOnce(boost::bind(&WbfComm::sendLoadTargets, this), 0);
+    }
+  }
+  if (aResultHandler) aResultHandler(aResult, aError);
+}
+
+
+void WbfComm::loadStateReported(int aLoadId, JsonObjectPtr aState)
+{
+  WbfLoadTarget &lt = mLoadTargets[aLoadId];
+  lt.mReported = aState;
+  if (lt.mUnconfirmed && targetStateReached(lt.mUnconfirmed, aState)) {
+    // gateway has confirmed the target state sent via websocket
+    FOCUSOLOG("load %d: target state %s confirmed", aLoadId, JsonObject::text(lt.mUnconfirmed));
+    mUnconfirmedWebsocketCommands = 0;
+    lt.mUnconfirmed.reset();
+    WbfApiResultCB cb = lt.mUnconfirmedCB;
+    lt.mUnconfirmedCB = NoOP;
+    if (cb) cb(JsonObjectPtr(), ErrorPtr());
+  }
+}
+
+
+void WbfComm::checkLoadTargetConfirmations()
+{
+  mConfirmationTicket.cancel();
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds nextCheck = Never;
+  for (WbfLoadTargetsMap::iterator pos = mLoadTargets.begin(); pos!=mLoadTargets.end(); ++pos) {
+    WbfLoadTarget &lt = pos->second;
+    if (!lt.mUnconfirmed) continue;
+    if (now-lt.mUnconfirmedSince<WBF_WSCMD_CONFIRM_TIMEOUT) {
+      if (nextCheck==Never || lt.mUnconfirmedSince+WBF_WSCMD_CONFIRM_TIMEOUT<nextCheck) nextCheck = lt.mUnconfirmedSince+WBF_WSCMD_CONFIRM_TIMEOUT;
+      continue;
+    }
+    // not confirmed in time
+    mUnconfirmedWebsocketCommands++;
+    JsonObjectPtr targetState = lt.mUnconfirmed;
+    WbfApiResultCB cb = lt.mUnconfirmedCB;
+    lt.mUnconfirmed.reset();
+    lt.mUnconfirmedCB = NoOP;
+    if (lt.mPending) {
+      // superseded by a newer target state anyway
+      if (cb) cb(JsonObjectPtr(), ErrorPtr());
+    }
+    else if (lt.mHttpInFlight) {
+      // cannot resend now, let next sendLoadTargets() deliver it after the current HTTP PUT
+      lt.mPending = targetState;
+      lt.mPendingCB = cb;
+    }
+    else {
+      OLOG(LOG_WARNING, "load %d: target state sent via websocket not confirmed -> resending via HTTP", pos->first);
+      sendLoadTargetViaHttp(pos->first, targetState, cb);
+    }
+  }
+  if (mUnconfirmedWebsocketCommands>=WBF_WSCMD_MAX_UNCONFIRMED && !mWebsocketCommandsDisabled) {
+    OLOG(LOG_WARNING, "gateway does not confirm target states sent via websocket -> using HTTP only");
+    mWebsocketCommandsDisabled = true;
+  }
+  if (nextCheck!=Never) {
+    mConfirmationTicket.executeOnceAt(boost::bind(&WbfComm::checkLoadTargetConfirmations, this), nextCheck);
+  }
+}
+
+
+
 // MARK: - REST API
 
 void WbfComm::apiQuery(const char* aUrlSuffix, WbfApiResultCB aResultHandler, MLMicroSeconds aTimeout)
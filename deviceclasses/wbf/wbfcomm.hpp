@@ -35,6 +35,10 @@
 #include "operationqueue.hpp"
 #include "websocket.hpp"
 
+#ifndef WBF_WEBSOCKET_TARGET_STATES
+  #define WBF_WEBSOCKET_TARGET_STATES 0 // set only for gateway firmware known to accept load target states via websocket, HTTP PUT is used otherwise
+#endif
+
 using namespace std;
 
 namespace p44 {
@@ -120,11 +124,34 @@ namespace p44 {
 
 
 
+  /// state of target state delivery for a single load
+  class WbfLoadTarget
+  {
+  public:
+    WbfLoadTarget() : mHttpInFlight(false), mUnconfirmedSince(Never) {};
+    JsonObjectPtr mPending; ///< target state not yet sent to the gateway (possibly merged from multiple superseded ones)
+    WbfApiResultCB mPendingCB; ///< callback for the pending target state
+    bool mHttpInFlight; ///< set while a HTTP PUT for this load is being executed
+    JsonObjectPtr mUnconfirmed; ///< target state sent via websocket, but not yet confirmed by a matching load state push
+    WbfApiResultCB mUnconfirmedCB; ///< callback for the unconfirmed target state
+    MLMicroSeconds mUnconfirmedSince; ///< when mUnconfirmed was sent
+    JsonObjectPtr mReported; ///< last load state pushed by the gateway
+  };
+  typedef std::map<int, WbfLoadTarget> WbfLoadTargetsMap;
+
+
   class WbfComm : public OperationQueue
   {
     typedef OperationQueue inherited;
 
     bool mApiReady;
+    bool mWebsocketConnected; ///< set while websocket is connected
+    MLMicroSeconds mWebsocketConnectedSince; ///< when websocket was (re)connected last time
+    bool mWebsocketCommandsDisabled; ///< set when gateway does not seem to support target states via websocket
+    int mUnconfirmedWebsocketCommands; ///< number of websocket target states that had to be resent via HTTP
+    WbfLoadTargetsMap mLoadTargets; ///< per load target state delivery
+    MLTicket mLoadTargetsTicket; ///< for deferred sending of (coalesced) target states
+    MLTicket mConfirmationTicket; ///< for checking confirmation of websocket target states
 
   public:
 
@@ -203,6 +230,33 @@ namespace p44 {
     ErrorPtr sendWebSocketTextMsg(const string aTextMessage);
     ErrorPtr sendWebSocketJsonMsg(JsonObjectPtr aJsonMessage);
 
+    /// @return true if the websocket is connected, i.e. gateway pushes state changes to us
+    bool websocketConnected() { return mWebsocketConnected; };
+
+    /// @return time when the websocket was (re)connected last time, Never if not connected
+    MLMicroSeconds websocketConnectedSince() { return mWebsocketConnected ? mWebsocketConnectedSince : Never; };
+
+    /// @}
+
+
+    /// @name load target states
+    /// @{
+
+    /// set new target state for a load
+    /// @param aLoadId the load ID
+    /// @param aTargetState the target state
+    /// @param aResultHandler will be called when the gateway has accepted the target state (HTTP PUT) or has
+    ///   confirmed it by pushing a matching load state (websocket), or when it was superseded by a newer target
+    ///   state for the same load before it could be sent
+    /// @note target states are sent via websocket only when WBF_WEBSOCKET_TARGET_STATES is set, via HTTP PUT otherwise.
+    ///   Target states for the same load that are not yet sent are merged, such that only the latest state is sent.
+    void setLoadTargetState(int aLoadId, JsonObjectPtr aTargetState, WbfApiResultCB aResultHandler);
+
+    /// must be called when the gateway reports a load state via websocket
+    /// @param aLoadId the load ID
+    /// @param aState the reported load state
+    void loadStateReported(int aLoadId, JsonObjectPtr aState);
+
     /// @}
 
   private:
@@ -222,6 +276,13 @@ namespace p44 {
 
     void webSocketStart(StatusCB aStartupCB);
     void webStocketStatus(StatusCB aStartupCB, ErrorPtr aError);
+    void webSocketMessage(const string aMessage, ErrorPtr aError);
+
+    bool websocketCommandsUsable();
+    void sendLoadTargets();
+    void sendLoadTargetViaHttp(int aLoadId, JsonObjectPtr aTargetState, WbfApiResultCB aResultHandler);
+    void loadTargetSentViaHttp(int aLoadId, WbfApiResultCB aResultHandler, JsonObjectPtr aResult, ErrorPtr aError);
+    void checkLoadTargetConfirmations();
 
   };
   
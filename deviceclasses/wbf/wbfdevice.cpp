@@ -68,6 +68,7 @@ WbfDevice::WbfDevice(WbfVdc *aVdcP, JsonObjectPtr aDevDesc, JsonObjectPtr aOutDe
   inherited(aVdcP),
   mLoadId(-1),
   mSubDeviceIndex(-1), // not yet assigned
+  mLastStatePush(Never),
   mHasWhiteChannel(false)
 {
   DBGOLOG(LOG_INFO,
@@ -503,23 +504,15 @@ void WbfDevice::checkPresence(PresenceCB aPresenceResultHandler)
     aPresenceResultHandler(true);
   }
   else {
-    // need a refresh
-    wbfVdc().mWbfComm.apiQuery(string_format("/devices/%s", mWbfId.c_str()).c_str(), boost::bind(&WbfDevice::deviceInfoReceived, this, aPresenceResultHandler, _1, _2));
+    // need a refresh, which is done for all devices of the gateway at once
+    wbfVdc().refreshLastSeen(boost::bind(&WbfDevice::lastSeenRefreshed, this, aPresenceResultHandler, _1));
   }
 }
 
 
-void WbfDevice::deviceInfoReceived(PresenceCB aPresenceResultHandler, JsonObjectPtr aDeviceInfo, ErrorPtr aError)
+void WbfDevice::lastSeenRefreshed(PresenceCB aPresenceResultHandler, ErrorPtr aError)
 {
-  JsonObjectPtr o;
-  bool reachable = false;
-  if (Error::isOK(aError) && aDeviceInfo) {
-    if (aDeviceInfo->get("last_seen", o)) {
-      mLastSeen = MainLoop::now()-(o->doubleValue()*Second);
-      reachable = MainLoop::now()-mLastSeen < PRESENT_WHEN_SEEN_EARLIER_THAN;
-    }
-  }
-  aPresenceResultHandler(reachable);
+  aPresenceResultHandler(Error::isOK(aError) && MainLoop::now()-mLastSeen<PRESENT_WHEN_SEEN_EARLIER_THAN);
 }
 
 
@@ -627,10 +620,9 @@ void WbfDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
         }
       }
     } // light or plain output
-    // now send the new target state
-    wbfVdc().mWbfComm.apiAction(
-      WbfApiOperation::PUT,
-      string_format("/loads/%d/target_state", mLoadId).c_str(),
+    // now send the new target state (via websocket if possible, coalesced with not yet sent previous ones)
+    wbfVdc().mWbfComm.setLoadTargetState(
+      mLoadId,
       targetState,
       boost::bind(&WbfDevice::targetStateApplied, this, aDoneCB, _1, _2)
     );
@@ -656,6 +648,13 @@ void WbfDevice::targetStateApplied(SimpleCB aDoneCB, JsonObjectPtr aApplyStateRe
 
 void WbfDevice::syncChannelValues(SimpleCB aDoneCB)
 {
+  MLMicroSeconds since = wbfComm().websocketConnectedSince();
+  if (since!=Never && mLastStatePush!=Never && mLastStatePush>=since) {
+    // state of our load has been pushed via the current websocket connection, channels are up-to-date
+    FOCUSOLOG("load state known from websocket push, no need to query");
+    if (aDoneCB) aDoneCB();
+    return;
+  }
   // query state of our load
   wbfVdc().mWbfComm.apiQuery(string_format("/loads/%d/state", mLoadId).c_str(), boost::bind(&WbfDevice::loadStateReceived, this, aDoneCB, _1, _2));
 }
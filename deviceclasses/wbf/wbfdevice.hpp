@@ -73,6 +73,7 @@ namespace p44 {
     string mWbfCommRefs; ///< the commercial reference(s) of the device's module(s)
     string mSerialNos; ///< the serial no (or c/a serials) of the device's module(s)
     MLMicroSeconds mLastSeen; ///< when seen last time
+    MLMicroSeconds mLastStatePush; ///< when load state was last pushed via websocket, Never if not yet
     bool mHasWhiteChannel; ///< set when connected light is RGBW (vs. only RGB)
     MLTicket mIdentifyTicket;
 
@@ -211,7 +212,7 @@ namespace p44 {
 
     void targetStateApplied(SimpleCB aDoneCB, JsonObjectPtr aApplyStateResult, ErrorPtr aError);
     void loadStateReceived(SimpleCB aDoneCB, JsonObjectPtr aLoadStateResult, ErrorPtr aError);
-    void deviceInfoReceived(PresenceCB aPresenceResultHandler, JsonObjectPtr aDeviceInfo, ErrorPtr aError);
+    void lastSeenRefreshed(PresenceCB aPresenceResultHandler, ErrorPtr aError);
 
   };
   
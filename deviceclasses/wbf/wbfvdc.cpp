@@ -37,7 +37,8 @@ using namespace p44;
 
 
 WbfVdc::WbfVdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag) :
-  inherited(aInstanceNumber, aVdcHostP, aTag)
+  inherited(aInstanceNumber, aVdcHostP, aTag),
+  mLastSeenRefreshed(Never)
 {
   mWbfComm.isMemberVariable();
 }
@@ -337,9 +338,11 @@ void WbfVdc::gatewayWebsocketHandler(const string aMessage, ErrorPtr aError)
       if (part) {
         int id = o->int32Value();
         PartIdToBehaviourMap::iterator pos = mLoadsMap.find(id);
+        mWbfComm.loadStateReported(id, part);
         if (pos!=mLoadsMap.end()) {
           WbfDevice& dev = static_cast<WbfDevice&>(pos->second->getDevice());
           dev.handleLoadState(part, pos->second);
+          dev.mLastStatePush = MainLoop::now();
           dev.reportOutputState();
         }
         else {
@@ -783,6 +786,73 @@ void WbfVdc::buttonsListHandler(StatusCB aCompletedCB, JsonObjectPtr aDevicesArr
 }
 
 
+// MARK: - presence
+
+
+#define WBF_LASTSEEN_REFRESH_INTERVAL (1*Minute) ///< last_seen info younger than this is reused
+
+void WbfVdc::refreshLastSeen(StatusCB aRefreshedCB)
+{
+  if (mLastSeenRefreshed!=Never && MainLoop::now()-mLastSeenRefreshed<WBF_LASTSEEN_REFRESH_INTERVAL) {
+    // recent enough
+    if (aRefreshedCB) aRefreshedCB(ErrorPtr());
+    return;
+  }
+  mLastSeenRefreshCBs.push_back(aRefreshedCB);
+  if (mLastSeenRefreshCBs.size()==1) {
+    // first request, actually query
+    mWbfComm.apiQuery("/devices", boost::bind(&WbfVdc::lastSeenListHandler, this, _1, _2));
+  }
+}
+
+
+void WbfVdc::lastSeenListHandler(JsonObjectPtr aResult, ErrorPtr aError)
+{
+  if (Error::isOK(aError) && aResult) {
+    mLastSeenRefreshed = MainLoop::now();
+    // update last seen of all devices
+    for (int didx = 0; didx<aResult->arrayLength(); didx++) {
+      JsonObjectPtr devDesc = aResult->arrayGet(didx);
+      JsonObjectPtr o;
+      if (!devDesc->get("id", o)) continue;
+      string wbfId = o->stringValue();
+      if (!devDesc->get("last_seen", o)) continue;
+      MLMicroSeconds lastSeen = MainLoop::now()-(o->doubleValue()*Second);
+      for (DeviceVector::iterator pos = mDevices.begin(); pos!=mDevices.end(); ++pos) {
+        WbfDevicePtr dev = boost::dynamic_pointer_cast<WbfDevice>(*pos);
+        if (dev && dev->mWbfId==wbfId) dev->mLastSeen = lastSeen; // all subdevices of the wbf device
+      }
+    }
+  }
+  else {
+    OLOG(LOG_WARNING, "Could not refresh devices' last_seen: %s", Error::text(aError));
+  }
+  // inform all waiting
+  std::list<StatusCB> cbs;
+  cbs.swap(mLastSeenRefreshCBs);
+  for (std::list<StatusCB>::iterator pos = cbs.begin(); pos!=cbs.end(); ++pos) {
+    if (*pos) (*pos)(aError);
+  }
+}
+
+
+void WbfVdc::checkPresenceOfDevices(DeviceVector aDevices, StatusCB aDoneCB)
+{
+  refreshLastSeen(boost::bind(&WbfVdc::lastSeenRefreshedForDevices, this, aDevices, aDoneCB, _1));
+}
+
+
+void WbfVdc::lastSeenRefreshedForDevices(DeviceVector aDevices, StatusCB aDoneCB, ErrorPtr aError)
+{
+  // last seen info is fresh now, so devices can determine presence without further gateway access
+  for (DeviceVector::iterator pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+    (*pos)->checkPresence(boost::bind(&DsAddressable::updatePresenceState, (*pos).get(), _1));
+  }
+  if (aDoneCB) aDoneCB(aError);
+}
+
+
+
 bool WbfVdc::addWbfDevice(WbfDevicePtr aNewDev)
 {
   if (simpleIdentifyAndAddDevice(aNewDev)) {
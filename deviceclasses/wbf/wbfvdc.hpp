@@ -79,6 +79,8 @@ namespace p44 {
     PartIdToBehaviourMap mButtonsMap;
     MLTicket mButtonActivationTimeout;
     VdcApiRequestPtr mButtonActivationRequest;
+    std::list<StatusCB> mLastSeenRefreshCBs; ///< callbacks waiting for the currently running last_seen refresh
+    MLMicroSeconds mLastSeenRefreshed; ///< when last_seen info was refreshed for all devices last time
 
     /// @}
 
@@ -156,12 +158,28 @@ namespace p44 {
     ///   the device is not disconnected (=unlearned) by this.
     virtual void removeDevice(DevicePtr aDevice, bool aForget = false) P44_OVERRIDE;
 
+    /// refresh last seen information for all devices from the gateway at once
+    /// @param aRefreshedCB called when refresh is complete
+    /// @note concurrent requests are served by a single query, and results are reused for a while
+    void refreshLastSeen(StatusCB aRefreshedCB);
+
+    /// check presence of multiple devices with a single last seen refresh from the gateway
+    /// @param aDevices the devices to check
+    /// @param aDoneCB will be called when all devices have updated their presence state
+    virtual void checkPresenceOfDevices(DeviceVector aDevices, StatusCB aDoneCB) P44_OVERRIDE;
+
   protected:
 
     /// handle global events
     /// @param aEvent the event to handle
     virtual void handleGlobalEvent(VdchostEvent aEvent) P44_OVERRIDE;
 
+    /// the gateway's device list covers all devices, so sample them all at once
+    virtual size_t presenceSampleBatchSize() P44_OVERRIDE { return 0; };
+
+    /// sampling all devices is a single (cached) last seen refresh, so do it in the background by default
+    virtual MLMicroSeconds defaultPresenceSampleInterval() P44_OVERRIDE { return 5*Minute; };
+
   private:
 
     void connectGateway(StatusCB aCompletedCB);
@@ -195,6 +213,9 @@ namespace p44 {
 
     void wbfapicallResponse(VdcApiRequestPtr aRequest, JsonObjectPtr aResult, ErrorPtr aError);
 
+    void lastSeenListHandler(JsonObjectPtr aResult, ErrorPtr aError);
+    void lastSeenRefreshedForDevices(DeviceVector aDevices, StatusCB aDoneCB, ErrorPtr aError);
+
     static void unregisterBehaviourMap(PartIdToBehaviourMap &aMap, DsBehaviourPtr aBehaviour);
     static int partIdForBehaviour(PartIdToBehaviourMap &aMap, DsBehaviourPtr aBehaviour);
 
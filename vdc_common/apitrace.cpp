@@ -0,0 +1,513 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// File scope debugging options
+// - Set ALWAYS_DEBUG to 1 to enable DBGLOG output even in non-DEBUG builds of this file
+#define ALWAYS_DEBUG 0
+// - set FOCUSLOGLEVEL to non-zero log level (usually, 5,6, or 7==LOG_DEBUG) to get focus (extensive logging) for this file
+//   Note: must be before including "logger.hpp" (or anything that includes "logger.hpp")
+#define FOCUSLOGLEVEL 0
+
+#include "apitrace.hpp"
+
+#if ENABLE_API_TRACE
+
+#include "vdchost.hpp"
+#include "device.hpp"
+#include "jsonvdcapi.hpp"
+
+using namespace p44;
+
+
+// MARK: - trace files
+
+ErrorPtr p44::apiTraceFilePath(const string aName, const char *aDataDir, string &aPath)
+{
+  // trace files are confined to the persistent data directory, API clients must not be able to
+  // read or overwrite arbitrary files
+  if (aName.empty() || aName[0]=='/' || aName.find("..")!=string::npos) {
+    return WebError::webErr(403, "trace file name must be a plain relative path within the data directory");
+  }
+  aPath = string(nonNullCStr(aDataDir))+aName;
+  return ErrorPtr();
+}
+
+
+/// @return true if aKey names a parameter that might contain a secret
+static bool isSecretKey(const string &aKey)
+{
+  static const char * const secretKeyParts[] = { "password", "passwd", "secret", "token", "authdata", "credential", NULL };
+  string k = lowerCase(aKey);
+  for (const char * const *p = secretKeyParts; *p; ++p) {
+    if (k.find(*p)!=string::npos) return true;
+  }
+  return false;
+}
+
+
+/// @return copy of aJson with the values of all secret fields replaced
+static JsonObjectPtr redactedSecrets(JsonObjectPtr aJson)
+{
+  if (!aJson) return aJson;
+  if (aJson->type()==json_type_object) {
+    JsonObjectPtr r = JsonObject::newObj();
+    string key;
+    JsonObjectPtr val;
+    aJson->resetKeyIteration();
+    while (aJson->nextKeyValue(key, val)) {
+      r->add(key.c_str(), isSecretKey(key) ? JsonObject::newString("***") : redactedSecrets(val));
+    }
+    return r;
+  }
+  if (aJson->type()==json_type_array) {
+    JsonObjectPtr r = JsonObject::newArray();
+    for (int i=0; i<aJson->arrayLength(); i++) {
+      r->arrayAppend(redactedSecrets(aJson->arrayGet(i)));
+    }
+    return r;
+  }
+  return aJson; // leaf values are not modified, can be shared
+}
+
+
+// MARK: - ApiTraceRecorder
+
+ApiTraceRecorder::ApiTraceRecorder() :
+  mTraceFile(NULL),
+  mStartedAt(Never),
+  mNextConnectionId(1),
+  mRecorded(0)
+{
+}
+
+
+ApiTraceRecorder::~ApiTraceRecorder()
+{
+  stop();
+}
+
+
+ErrorPtr ApiTraceRecorder::start(const string aTracePath)
+{
+  stop();
+  mTraceFile = fopen(aTracePath.c_str(), "w");
+  if (!mTraceFile) {
+    return TextError::err("cannot open trace file '%s': %s", aTracePath.c_str(), strerror(errno));
+  }
+  mTracePath = aTracePath;
+  mStartedAt = MainLoop::now();
+  mConnectionIds.clear();
+  mNextConnectionId = 1;
+  mRecorded = 0;
+  fputs(API_TRACE_HEADER "\n", mTraceFile);
+  LOG(LOG_NOTICE, "API trace: started recording to '%s'", mTracePath.c_str());
+  return ErrorPtr();
+}
+
+
+void ApiTraceRecorder::stop()
+{
+  if (mTraceFile) {
+    fclose(mTraceFile);
+    mTraceFile = NULL;
+    LOG(LOG_NOTICE, "API trace: stopped recording to '%s', %ld requests/notifications recorded", mTracePath.c_str(), mRecorded);
+  }
+}
+
+
+void ApiTraceRecorder::record(VdcApiConnectionPtr aConnection, bool aIsMethod, const string &aMethod, ApiValuePtr aParams)
+{
+  if (!mTraceFile) return;
+  int connId = 0; // 0 = no connection (internal)
+  if (aConnection) {
+    ConnectionIdMap::iterator pos = mConnectionIds.find(aConnection.get());
+    if (pos==mConnectionIds.end()) {
+      connId = mNextConnectionId++;
+      mConnectionIds[aConnection.get()] = connId;
+    }
+    else {
+      connId = pos->second;
+    }
+  }
+  JsonObjectPtr params = redactedSecrets(JsonApiValue::getAsJson(aParams));
+  fprintf(mTraceFile, "%lld %d %c %s %s %s\n",
+    (long long)(MainLoop::now()-mStartedAt),
+    connId,
+    aIsMethod ? 'M' : 'N',
+    aConnection ? aConnection->apiName() : "-",
+    aMethod.c_str(),
+    params ? params->json_c_str() : "null"
+  );
+  mRecorded++;
+}
+
+
+void ApiTraceRecorder::connectionClosed(VdcApiConnectionPtr aConnection)
+{
+  mConnectionIds.erase(aConnection.get());
+}
+
+
+ApiValuePtr ApiTraceRecorder::status(ApiValuePtr aFactory)
+{
+  ApiValuePtr st = aFactory->newObject();
+  st->add("recording", st->newBool(isRecording()));
+  if (isRecording()) {
+    st->add("path", st->newString(mTracePath));
+    st->add("recorded", st->newInt64(mRecorded));
+    st->add("duration", st->newDouble((double)(MainLoop::now()-mStartedAt)/Second));
+  }
+  return st;
+}
+
+
+// MARK: - replay connection and request
+
+namespace p44 {
+
+  /// connection representing one of the recorded connections during replay
+  class ReplayApiConnection : public VdcApiConnection
+  {
+    typedef VdcApiConnection inherited;
+    string mApiName;
+
+  public:
+
+    ReplayApiConnection(const string aApiName) : mApiName("replay/"+aApiName) { setApiVersion(VDC_API_VERSION_MAX); };
+
+    virtual SocketCommPtr socketConnection() P44_OVERRIDE { return SocketCommPtr(); };
+    virtual void closeAfterSend() P44_OVERRIDE {};
+    virtual const char* apiName() const P44_OVERRIDE { return mApiName.c_str(); };
+    virtual ApiValuePtr newApiValue() P44_OVERRIDE { return ApiValuePtr(new JsonApiValue); };
+
+  };
+
+
+  /// method call during replay, reports latency to the replayer when answered
+  class ReplayApiRequest : public VdcApiRequest
+  {
+    typedef VdcApiRequest inherited;
+
+    ApiTraceReplayerPtr mReplayer;
+    VdcApiConnectionPtr mConnection;
+    string mMethod;
+    MLMicroSeconds mSentAt;
+
+  public:
+
+    ReplayApiRequest(ApiTraceReplayerPtr aReplayer, VdcApiConnectionPtr aConnection, const string aMethod) :
+      mReplayer(aReplayer),
+      mConnection(aConnection),
+      mMethod(aMethod),
+      mSentAt(MainLoop::now())
+    {};
+
+    virtual string requestId() P44_OVERRIDE { return ""; };
+    virtual VdcApiConnectionPtr connection() P44_OVERRIDE { return mConnection; };
+
+    virtual ErrorPtr sendResult(ApiValuePtr aResult) P44_OVERRIDE
+    {
+      done(false);
+      return ErrorPtr();
+    };
+
+    virtual ErrorPtr sendError(ErrorPtr aError) P44_OVERRIDE
+    {
+      done(Error::notOK(aError));
+      return ErrorPtr();
+    };
+
+  private:
+
+    void done(bool aError)
+    {
+      if (mReplayer) {
+        mReplayer->answered(mMethod, MainLoop::now()-mSentAt, aError);
+        mReplayer.reset(); // only first answer counts
+      }
+    }
+
+  };
+
+} // namespace p44
+
+
+// MARK: - ApiTraceReplayer
+
+#define REPLAY_ANSWER_TIMEOUT (30*Second) // max time to wait for a method call answer before continuing
+
+
+ApiTraceReplayer::ApiTraceReplayer(VdcHost &aVdcHost, VdcApiRequestPtr aRequest) :
+  mVdcHost(aVdcHost),
+  mRequest(aRequest),
+  mNextEntry(0),
+  mSpeed(0),
+  mRemap(true),
+  mNextRemapTarget(0),
+  mPendingAnswers(0),
+  mStartedAt(Never)
+{
+}
+
+
+ErrorPtr ApiTraceReplayer::replay(VdcHost &aVdcHost, VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  ApiValuePtr o = aParams->get("path");
+  if (!o) return WebError::webErr(400, "missing 'path'");
+  string path = o->stringValue();
+  bool allowLive = false;
+  if ((o = aParams->get("allowLive"))) allowLive = o->boolValue();
+  DeviceVector devices;
+  aVdcHost.createDeviceList(devices);
+  if (!allowLive) {
+    for (DeviceVector::iterator pos = devices.begin(); pos!=devices.end(); ++pos) {
+      if (!(*pos)->getVdc().isSimulated()) {
+        return WebError::webErr(409, "vdc host has real devices (%s), replay would change their state - use 'allowLive' to replay anyway", (*pos)->shortDesc().c_str());
+      }
+    }
+  }
+  ApiTraceReplayerPtr replayer = ApiTraceReplayerPtr(new ApiTraceReplayer(aVdcHost, aRequest));
+  ErrorPtr err = replayer->load(path);
+  if (Error::notOK(err)) return err;
+  if ((o = aParams->get("speed"))) replayer->mSpeed = o->doubleValue();
+  if ((o = aParams->get("remap"))) replayer->mRemap = o->boolValue();
+  if (replayer->mRemap) {
+    for (DeviceVector::iterator pos = devices.begin(); pos!=devices.end(); ++pos) {
+      replayer->mRemapTargets.push_back((*pos)->getDsUid());
+    }
+  }
+  LOG(LOG_NOTICE,
+    "API trace: replaying %zu requests/notifications from '%s' %s",
+    replayer->mEntries.size(), path.c_str(),
+    replayer->mSpeed>0 ? string_format("at %.2f times original speed", replayer->mSpeed).c_str() : "as fast as possible"
+  );
+  replayer->mStartedAt = MainLoop::now();
+  replayer->replayNext();
+  return ErrorPtr(); // answer will be sent when replay is done
+}
+
+
+ErrorPtr ApiTraceReplayer::load(const string aTracePath)
+{
+  FILE *file = fopen(aTracePath.c_str(), "r");
+  if (!file) {
+    return TextError::err("cannot open trace file '%s': %s", aTracePath.c_str(), strerror(errno));
+  }
+  string line;
+  int lineNo = 0;
+  ErrorPtr err;
+  while (string_fgetline(file, line)) {
+    lineNo++;
+    if (lineNo==1) {
+      if (line!=API_TRACE_HEADER) {
+        err = TextError::err("'%s' is not a API trace file", aTracePath.c_str());
+        break;
+      }
+      continue;
+    }
+    if (line.empty() || line[0]=='#') continue;
+    // <time> <connid> <M|N> <apiname> <method> <json>
+    TraceEntry e;
+    string f;
+    const char *p = line.c_str();
+    long long t;
+    if (!nextPart(p, f, ' ') || sscanf(f.c_str(), "%lld", &t)!=1) continue;
+    e.time = t;
+    if (!nextPart(p, f, ' ') || sscanf(f.c_str(), "%d", &e.connectionId)!=1) continue;
+    if (!nextPart(p, f, ' ')) continue;
+    e.isMethod = f=="M";
+    if (!nextPart(p, f, ' ')) continue; // api name, not needed for replay
+    if (!nextPart(p, e.method, ' ')) continue;
+    e.params = JsonObject::objFromText(p);
+    if (!e.params) e.params = JsonObject::newObj();
+    mEntries.push_back(e);
+  }
+  fclose(file);
+  if (Error::isOK(err) && mEntries.empty()) {
+    err = TextError::err("trace file '%s' contains no entries", aTracePath.c_str());
+  }
+  return err;
+}
+
+
+void ApiTraceReplayer::replayNext()
+{
+  mReplayTicket.cancel();
+  while (mNextEntry<mEntries.size()) {
+    TraceEntry &e = mEntries[mNextEntry];
+    if (mSpeed>0) {
+      // time accurate replay
+      MLMicroSeconds due = mStartedAt+(MLMicroSeconds)(e.time/mSpeed);
+      MLMicroSeconds now = MainLoop::now();
+      if (due>now) {
+        mReplayTicket.executeOnce(boost::bind(&ApiTraceReplayer::replayNext, ApiTraceReplayerPtr(this)), due-now);
+        return;
+      }
+    }
+    else if (mPendingAnswers>0) {
+      // as fast as possible, but method calls must be answered before sending next request
+      return; // answered() will call us again
+    }
+    mNextEntry++;
+    dispatch(e);
+    if (mSpeed<=0 && !e.isMethod) {
+      // let mainloop run after notifications, as these start activity without being answered
+      mReplayTicket.executeOnce(boost::bind(&ApiTraceReplayer::replayNext, ApiTraceReplayerPtr(this)));
+      return;
+    }
+  }
+  // all dispatched
+  if (mPendingAnswers==0) finish();
+}
+
+
+void ApiTraceReplayer::dispatch(TraceEntry &aEntry)
+{
+  // get or create connection
+  VdcApiConnectionPtr conn;
+  std::map<int, VdcApiConnectionPtr>::iterator pos = mConnections.find(aEntry.connectionId);
+  if (pos==mConnections.end()) {
+    conn = VdcApiConnectionPtr(new ReplayApiConnection(string_format("%d", aEntry.connectionId)));
+    mConnections[aEntry.connectionId] = conn;
+  }
+  else {
+    conn = pos->second;
+  }
+  if (aEntry.method=="hello" || aEntry.method=="bye") {
+    // session handling is not replayed, would interfere with an actual vdSM session
+    return;
+  }
+  if (mRemap) remapDsUids(aEntry.params);
+  ApiValuePtr params = JsonApiValue::newValueFromJson(aEntry.params);
+  FOCUSLOG("API trace replay: %s %s %s", aEntry.isMethod ? "method" : "notification", aEntry.method.c_str(), aEntry.params->json_c_str());
+  if (aEntry.isMethod) {
+    mPendingAnswers++;
+    mAnswerTimeoutTicket.executeOnce(boost::bind(&ApiTraceReplayer::answerTimeout, ApiTraceReplayerPtr(this)), REPLAY_ANSWER_TIMEOUT);
+    VdcApiRequestPtr req = VdcApiRequestPtr(new ReplayApiRequest(this, conn, aEntry.method));
+    ErrorPtr err = mVdcHost.handleMethodForParams(req, aEntry.method, params);
+    if (err) req->sendStatus(err);
+  }
+  else {
+    MLMicroSeconds startedAt = MainLoop::now();
+    ErrorPtr err = mVdcHost.handleNotificationForParams(conn, aEntry.method, params);
+    record(aEntry.method, MainLoop::now()-startedAt, Error::notOK(err));
+  }
+}
+
+
+void ApiTraceReplayer::answered(const string &aMethod, MLMicroSeconds aLatency, bool aError)
+{
+  record(aMethod, aLatency, aError);
+  if (mPendingAnswers>0) mPendingAnswers--;
+  if (mPendingAnswers==0) mAnswerTimeoutTicket.cancel();
+  // continue from mainloop (we might be called synchronously from dispatch())
+  mReplayTicket.executeOnce(boost::bind(&ApiTraceReplayer::replayNext, ApiTraceReplayerPtr(this)));
+}
+
+
+void ApiTraceReplayer::answerTimeout()
+{
+  LOG(LOG_WARNING, "API trace: %ld method calls not answered within %lld seconds - continuing replay", mPendingAnswers, REPLAY_ANSWER_TIMEOUT/Second);
+  mStats["(unanswered)"].count += mPendingAnswers;
+  mPendingAnswers = 0;
+  replayNext();
+}
+
+
+void ApiTraceReplayer::record(const string &aMethod, MLMicroSeconds aLatency, bool aError)
+{
+  MethodStatsMap::iterator pos = mStats.find(aMethod);
+  if (pos==mStats.end()) {
+    MethodStats s = { 0, 0, 0, 0 };
+    pos = mStats.insert(make_pair(aMethod, s)).first;
+  }
+  pos->second.count++;
+  if (aError) pos->second.errors++;
+  pos->second.sum += aLatency;
+  if (aLatency>pos->second.max) pos->second.max = aLatency;
+}
+
+
+void ApiTraceReplayer::remapDsUids(JsonObjectPtr aParams)
+{
+  JsonObjectPtr o;
+  if (!aParams->get("dSUID", o)) return;
+  if (o->isType(json_type_array)) {
+    JsonObjectPtr a = JsonObject::newArray();
+    for (int i=0; i<o->arrayLength(); i++) {
+      a->arrayAppend(remappedDsUid(o->arrayGet(i)));
+    }
+    aParams->add("dSUID", a);
+  }
+  else {
+    aParams->add("dSUID", remappedDsUid(o));
+  }
+}
+
+
+JsonObjectPtr ApiTraceReplayer::remappedDsUid(JsonObjectPtr aValue)
+{
+  DsUid dsuid;
+  if (!aValue || !dsuid.setAsString(aValue->stringValue())) return aValue; // not a dSUID, leave as-is
+  if (mVdcHost.addressableForDsUid(dsuid)) return aValue; // exists here, no need to remap
+  DsUidMap::iterator pos = mDsUidMap.find(dsuid);
+  if (pos==mDsUidMap.end()) {
+    if (mRemapTargets.empty()) return aValue; // nothing to remap to
+    // assign next device in round robin fashion
+    pos = mDsUidMap.insert(make_pair(dsuid, mRemapTargets[mNextRemapTarget])).first;
+    mNextRemapTarget = (mNextRemapTarget+1) % mRemapTargets.size();
+    FOCUSLOG("API trace replay: remapping %s -> %s", dsuid.getString().c_str(), pos->second.getString().c_str());
+  }
+  return JsonObject::newString(pos->second.getString());
+}
+
+
+void ApiTraceReplayer::finish()
+{
+  if (!mRequest) return; // already finished
+  mAnswerTimeoutTicket.cancel();
+  MLMicroSeconds wallTime = MainLoop::now()-mStartedAt;
+  LOG(LOG_NOTICE, "API trace: replay of %zu requests/notifications complete in %.3f seconds", mEntries.size(), (double)wallTime/Second);
+  ApiValuePtr res = mRequest->newApiValue();
+  res->setType(apivalue_object);
+  res->add("entries", res->newUint64(mEntries.size()));
+  res->add("traceTime", res->newDouble((double)mEntries.back().time/Second));
+  res->add("wallTime", res->newDouble((double)wallTime/Second));
+  res->add("remapped", res->newUint64(mDsUidMap.size()));
+  ApiValuePtr methods = res->newObject();
+  for (MethodStatsMap::iterator pos = mStats.begin(); pos!=mStats.end(); ++pos) {
+    ApiValuePtr m = methods->newObject();
+    m->add("count", m->newInt64(pos->second.count));
+    m->add("errors", m->newInt64(pos->second.errors));
+    if (pos->second.count>0) {
+      m->add("avgLatency", m->newDouble((double)pos->second.sum/pos->second.count/Second));
+      m->add("maxLatency", m->newDouble((double)pos->second.max/Second));
+    }
+    methods->add(pos->first, m);
+  }
+  res->add("methods", methods);
+  mRequest->sendResult(res);
+  mRequest.reset();
+}
+
+#endif // ENABLE_API_TRACE
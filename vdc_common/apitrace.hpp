@@ -0,0 +1,186 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__apitrace__
+#define __p44vdc__apitrace__
+
+#include "p44vdc_common.hpp"
+
+#ifndef ENABLE_API_TRACE
+  #define ENABLE_API_TRACE 0 // recording and replaying vdSM API traces, for diagnostics/benchmarking only
+#endif
+
+#if ENABLE_API_TRACE
+
+#include "vdcapi.hpp"
+#include "dsuid.hpp"
+#include "jsonobject.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  class VdcHost;
+
+  /// Trace files are line based text files. The first line is a header ("#p44vdc-apitrace 1"),
+  /// every following line represents one incoming API request or notification:
+  ///   `<time in µS since start> <connection id> <M|N> <api name> <method/notification> <params as JSON>`
+  /// The connection id is a small number identifying the connection within the trace.
+  #define API_TRACE_HEADER "#p44vdc-apitrace 1"
+
+
+  /// get the path for a trace file
+  /// @param aName the trace file name as passed via API, must be relative and must not contain ".."
+  /// @param aDataDir the persistent data directory (with trailing slash) trace files are confined to
+  /// @param aPath will receive the full path
+  /// @return ok or error if aName is not acceptable
+  ErrorPtr apiTraceFilePath(const string aName, const char *aDataDir, string &aPath);
+
+
+  /// records incoming vdc API requests and notifications into a trace file
+  /// @note values of parameters that might contain secrets (passwords, tokens etc.) are not recorded
+  class ApiTraceRecorder
+  {
+    typedef std::map<const VdcApiConnection*, int> ConnectionIdMap;
+
+    FILE *mTraceFile; ///< the trace file, NULL if not recording
+    string mTracePath; ///< path of the trace file
+    MLMicroSeconds mStartedAt; ///< when recording started
+    ConnectionIdMap mConnectionIds; ///< ids of the connections seen so far
+    int mNextConnectionId; ///< next connection id to assign
+    long mRecorded; ///< number of recorded requests and notifications
+
+  public:
+
+    ApiTraceRecorder();
+    ~ApiTraceRecorder();
+
+    /// start recording
+    /// @param aTracePath path of the trace file (will be overwritten)
+    /// @return ok or error
+    ErrorPtr start(const string aTracePath);
+
+    /// stop recording
+    void stop();
+
+    /// @return true if recording
+    bool isRecording() const { return mTraceFile!=NULL; };
+
+    /// record an incoming request or notification
+    /// @param aConnection the connection the request or notification comes from
+    /// @param aIsMethod true for a method call, false for a notification
+    /// @param aMethod the method or notification name
+    /// @param aParams the parameters
+    void record(VdcApiConnectionPtr aConnection, bool aIsMethod, const string &aMethod, ApiValuePtr aParams);
+
+    /// forget a connection (when closed), so its id will not be re-used for another connection at the same address
+    /// @param aConnection the connection
+    void connectionClosed(VdcApiConnectionPtr aConnection);
+
+    /// @return status info as API value
+    ApiValuePtr status(ApiValuePtr aFactory);
+
+  };
+
+
+  class ApiTraceReplayer;
+  typedef boost::intrusive_ptr<ApiTraceReplayer> ApiTraceReplayerPtr;
+
+  /// replays a trace file against the vdc host, reporting latency per method/notification
+  class ApiTraceReplayer : public P44Obj
+  {
+    friend class ReplayApiRequest;
+
+    /// a single entry of the trace
+    typedef struct {
+      MLMicroSeconds time;
+      int connectionId;
+      bool isMethod;
+      string method;
+      JsonObjectPtr params;
+    } TraceEntry;
+    typedef std::vector<TraceEntry> TraceEntryVector;
+
+    /// per method statistics
+    typedef struct {
+      long count;
+      long errors;
+      MLMicroSeconds sum;
+      MLMicroSeconds max;
+    } MethodStats;
+    typedef std::map<string, MethodStats> MethodStatsMap;
+
+    typedef std::map<DsUid, DsUid> DsUidMap;
+
+    VdcHost &mVdcHost;
+    VdcApiRequestPtr mRequest; ///< the request that started the replay, will get the results
+    TraceEntryVector mEntries;
+    size_t mNextEntry;
+    double mSpeed; ///< 0=as fast as possible, 1=original timing, 2=twice as fast etc.
+    bool mRemap; ///< remap dSUIDs not existing in this vdc host to existing devices
+    DsUidMap mDsUidMap; ///< dSUID remapping
+    std::vector<DsUid> mRemapTargets; ///< dSUIDs of the devices to remap to
+    size_t mNextRemapTarget;
+    std::map<int, VdcApiConnectionPtr> mConnections; ///< replay connections, by trace connection id
+    MethodStatsMap mStats;
+    long mPendingAnswers; ///< number of method calls not yet answered
+    MLMicroSeconds mStartedAt;
+    MLTicket mReplayTicket;
+    MLTicket mAnswerTimeoutTicket;
+
+    ApiTraceReplayer(VdcHost &aVdcHost, VdcApiRequestPtr aRequest);
+
+  public:
+
+    /// replay a trace and send the results as answer to aRequest
+    /// @param aVdcHost the vdc host to replay the trace against
+    /// @param aRequest the API request to answer with the results
+    /// @param aParams the parameters:
+    ///   - path: the trace file
+    ///   - speed: 0 (default) = as fast as possible (next request as soon as previous is answered),
+    ///     1 = original timing, >1 = faster than original timing
+    ///   - remap: if true (default), dSUIDs in the trace not known to this vdc host are mapped
+    ///     to existing devices (in order of first appearance), to replay field traces against simulated devices
+    ///   - allowLive: unless set, replay is refused when the vdc host has devices in vdcs that are not simulated,
+    ///     because replayed method calls and notifications would change (and persist) the state of real devices
+    /// @return ok or error
+    static ErrorPtr replay(VdcHost &aVdcHost, VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+
+  private:
+
+    ErrorPtr load(const string aTracePath);
+    void replayNext();
+    void dispatch(TraceEntry &aEntry);
+    void answered(const string &aMethod, MLMicroSeconds aLatency, bool aError);
+    void answerTimeout();
+    void record(const string &aMethod, MLMicroSeconds aLatency, bool aError);
+    void remapDsUids(JsonObjectPtr aParams);
+    JsonObjectPtr remappedDsUid(JsonObjectPtr aValue);
+    void finish();
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_API_TRACE
+#endif // __p44vdc__apitrace__
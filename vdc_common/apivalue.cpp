@@ -89,7 +89,7 @@ void ApiValue::operator=(ApiValue &aApiValue)
       while ((val = aApiValue.arrayGet(i++))) {
         ApiValuePtr myVal = newNull(); // create value of my own
         *myVal = *val; // assign
-        arrayAppend(val);
+        arrayAppend(myVal);
       }
       break;
     }
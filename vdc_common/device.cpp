@@ -32,6 +32,7 @@
 
 #include "device.hpp"
 #include "simplescene.hpp"
+#include "jsonvdcapi.hpp"
 
 #if ENABLE_LOCALCONTROLLER
   #include "localcontroller.hpp"
@@ -41,6 +42,7 @@
 #include "binaryinputbehaviour.hpp"
 #include "outputbehaviour.hpp"
 #include "sensorbehaviour.hpp"
+#include "metrics.hpp"
 
 using namespace p44;
 
@@ -114,7 +116,16 @@ Device::Device(Vdc *aVdcP) :
   mApplyInProgress(false),
   mDoReportApply(false),
   mMissedApplyAttempts(0),
-  mUpdateInProgress(false)
+  mApplyStartedAt(Never),
+  mApplyPendingSince(Never),
+  mUpdateInProgress(false),
+  mAppliesCompleted(0),
+  mAppliesCoalesced(0),
+  mAppliesDelayed(0),
+  mDeadlineHits(0),
+  mAvgApplyLatency(0),
+  mMaxApplyLatency(0),
+  mAvgApplyQueueDelay(0)
   #if P44SCRIPT_FULL_SUPPORT
   ,mPreviousSceneNo(INVALID_SCENE_NO)
   ,mCurrentSceneNo(INVALID_SCENE_NO)
@@ -803,6 +814,37 @@ ErrorPtr Device::handleMethod(VdcApiRequestPtr aRequest, const string &aMethod,
     requestUpdatingChannels(boost::bind(&Device::syncedChannels, this, aRequest));
     return ErrorPtr(); // no response now
   }
+  #if ENABLE_SENSOR_HISTORY
+  else if (aMethod=="x-p44-sensorHistory") {
+    // query in-memory sensor history
+    ApiValuePtr o;
+    if (Error::isOK(respErr = checkParam(aParams, "sensor", o))) {
+      SensorBehaviourPtr sensor = getSensor(by_id_or_index, o->stringValue());
+      SensorHistoryPtr history;
+      if (sensor) history = sensor->getHistory();
+      if (!history) {
+        respErr = WebError::webErr(404, "no sensor '%s' with history found", o->stringValue().c_str());
+      }
+      else {
+        MLMicroSeconds now = MainLoop::now();
+        MLMicroSeconds to = now;
+        MLMicroSeconds from = now-1*Hour; // default to last hour
+        MLMicroSeconds interval = 0;
+        HistoryAggregation aggregation = history_avg;
+        if ((o = aParams->get("age"))) from = now-o->doubleValue()*Second;
+        if ((o = aParams->get("from"))) from = MainLoop::unixTimeToMainLoopTime(o->doubleValue()*Second);
+        if ((o = aParams->get("to"))) to = MainLoop::unixTimeToMainLoopTime(o->doubleValue()*Second);
+        if ((o = aParams->get("interval"))) interval = o->doubleValue()*Second;
+        if ((o = aParams->get("aggregation"))) aggregation = SensorHistory::aggregationFromText(o->stringValue());
+        ApiValuePtr result = aRequest->newApiValue();
+        result->setType(apivalue_object);
+        history->queryToApiValue(result, from, to, aggregation, interval);
+        aRequest->sendResult(result);
+        return ErrorPtr(); // result already sent
+      }
+    }
+  }
+  #endif // ENABLE_SENSOR_HISTORY
   else {
     respErr = inherited::handleMethod(aRequest, aMethod, aParams);
   }
@@ -1241,7 +1283,14 @@ bool Device::addToOptimizedSet(NotificationDeliveryStatePtr aDeliveryState)
 #ifndef SERIALIZER_WATCHDOG
   #define SERIALIZER_WATCHDOG 1
 #endif
-#define SERIALIZER_WATCHDOG_TIMEOUT (20*Second)
+#define UPDATE_DEADLINE_FACTOR 2 // reading back values from hardware gets this multiple of the vdc's apply deadline
+#define APPLY_STATS_AVERAGING 8 // weight of the previous average vs. a new sample in the apply latency moving averages
+
+static void updateAverage(MLMicroSeconds &aAverage, MLMicroSeconds aSample, long aNumSamples)
+{
+  if (aNumSamples<=1) aAverage = aSample;
+  else aAverage += (aSample-aAverage)/APPLY_STATS_AVERAGING;
+}
 
 void Device::requestApplyingChannels(SimpleCB aAppliedOrSupersededCB, bool aForDimming, bool aModeChange, bool aWithReport)
 {
@@ -1272,12 +1321,17 @@ void Device::requestApplyingChannels(SimpleCB aAppliedOrSupersededCB, bool aForD
       mAppliedOrSupersededCB = aAppliedOrSupersededCB;
     }
     // - when previous request actually terminates, we need another update to make sure finally settled values are correct
+    //   Note: values are not queued, the re-apply will apply the latest channel values, coalescing all requests in between
+    if (mMissedApplyAttempts==0) mApplyPendingSince = MainLoop::now();
     mMissedApplyAttempts++;
+    mAppliesCoalesced++;
+    METRICS_COUNT("device_apply_superseded_total");
     FOCUSLOG("- missed requestApplyingChannels requests now %d", mMissedApplyAttempts);
   }
   else if (mUpdateInProgress) {
     FOCUSLOG("- requestApplyingChannels called while update running -> postpone apply");
     // case b) cannot execute until update finishes
+    if (mMissedApplyAttempts==0) mApplyPendingSince = MainLoop::now();
     mMissedApplyAttempts++;
     mAppliedOrSupersededCB = aAppliedOrSupersededCB;
     mApplyInProgress = true;
@@ -1287,15 +1341,29 @@ void Device::requestApplyingChannels(SimpleCB aAppliedOrSupersededCB, bool aForD
     // case c) applying is not currently in progress, can start updating hardware now
     FOCUSOLOG("ready, calling applyChannelValues()");
     #if SERIALIZER_WATCHDOG
-    // - start watchdog
-    mSerializerWatchdogTicket.executeOnce(boost::bind(&Device::serializerWatchdog, this), 10*Second); // new
-    FOCUSLOG("+++++ Serializer watchdog started for apply with ticket #%ld", (MLTicketNo)mSerializerWatchdogTicket);
+    // - start watchdog with the vdc's deadline
+    MLMicroSeconds deadline = mVdcP->applyDeadline();
+    if (deadline>0) {
+      mSerializerWatchdogTicket.executeOnce(boost::bind(&Device::serializerWatchdog, this), deadline);
+      FOCUSLOG("+++++ Serializer watchdog started for apply with ticket #%ld", (MLTicketNo)mSerializerWatchdogTicket);
+    }
     #endif
     // - start applying
     mAppliedOrSupersededCB = aAppliedOrSupersededCB;
     mApplyInProgress = true;
     mDoReportApply = aWithReport;
-    applyChannelValues(boost::bind(&Device::applyingChannelsComplete, this), aForDimming);
+    mApplyStartedAt = MainLoop::now();
+    if (mApplyPendingSince!=Never) {
+      // applying coalesced requests now, record how long these had to wait
+      mAppliesDelayed++;
+      updateAverage(mAvgApplyQueueDelay, mApplyStartedAt-mApplyPendingSince, mAppliesDelayed);
+      mApplyPendingSince = Never;
+    }
+    METRICS_COUNT("device_apply_total");
+    SimpleCB cb = boost::bind(&Device::applyingChannelsComplete, this);
+    if (!mVdcP->collectForBatchApply(DevicePtr(this), cb, aForDimming)) {
+      applyChannelValues(cb, aForDimming);
+    }
   }
 }
 
@@ -1339,13 +1407,17 @@ void Device::serializerWatchdog()
   FOCUSLOG("##### Serializer watchdog ticket #%ld expired", (MLTicketNo)mSerializerWatchdogTicket);
   mSerializerWatchdogTicket = 0;
   if (mApplyInProgress) {
-    OLOG(LOG_WARNING, "##### Serializer watchdog force-ends apply with %d missed attempts", mMissedApplyAttempts);
+    OLOG(LOG_WARNING, "##### Serializer watchdog force-ends apply after %.1f seconds deadline with %d coalesced requests", (double)mVdcP->applyDeadline()/Second, mMissedApplyAttempts);
     mMissedApplyAttempts = 0;
+    mApplyPendingSince = Never;
+    mDeadlineHits++;
+    METRICS_COUNT("device_apply_deadline_hits_total");
     applyingChannelsComplete();
     FOCUSLOG("##### Force-ending apply complete");
   }
   if (mUpdateInProgress) {
     OLOG(LOG_WARNING, "##### Serializer watchdog force-ends update");
+    mDeadlineHits++;
     updatingChannelsComplete();
     FOCUSLOG("##### Force-ending complete");
   }
@@ -1388,6 +1460,14 @@ void Device::applyingChannelsComplete()
   }
   #endif
   mApplyInProgress = false;
+  if (mApplyStartedAt!=Never) {
+    MLMicroSeconds latency = MainLoop::now()-mApplyStartedAt;
+    METRICS_RECORD("device_apply_seconds", latency);
+    mAppliesCompleted++;
+    updateAverage(mAvgApplyLatency, latency, mAppliesCompleted);
+    if (latency>mMaxApplyLatency) mMaxApplyLatency = latency;
+    mApplyStartedAt = Never;
+  }
   bool doReport = mDoReportApply; // capture, callbacks might schedule next apply with different setting
   // if more apply request have happened in the meantime, we need to reapply now
   if (!checkForReapply()) {
@@ -1457,8 +1537,11 @@ void Device::requestUpdatingChannels(SimpleCB aUpdatedOrCachedCB)
     mUpdateInProgress = true;
     #if SERIALIZER_WATCHDOG
     // - start watchdog
-    mSerializerWatchdogTicket.executeOnce(boost::bind(&Device::serializerWatchdog, this), SERIALIZER_WATCHDOG_TIMEOUT);
-    FOCUSLOG("+++++ Serializer watchdog started for update with ticket #%ld", (MLTicketNo)mSerializerWatchdogTicket);
+    MLMicroSeconds deadline = mVdcP->applyDeadline();
+    if (deadline>0) {
+      mSerializerWatchdogTicket.executeOnce(boost::bind(&Device::serializerWatchdog, this), UPDATE_DEADLINE_FACTOR*deadline);
+      FOCUSLOG("+++++ Serializer watchdog started for update with ticket #%ld", (MLTicketNo)mSerializerWatchdogTicket);
+    }
     #endif
     // - trigger querying hardware
     syncChannelValues(boost::bind(&Device::updatingChannelsComplete, this));
@@ -1736,7 +1819,7 @@ void Device::callScenePrepare(PreparedCB aPreparedCB, SceneNo aSceneNo, bool aFo
   SceneDeviceSettingsPtr scenes = getScenes();
   // see if we have a scene table at all
   if (mOutput && scenes) {
-    DsScenePtr scene = scenes->getScene(aSceneNo);
+    DsScenePtr scene = getSceneTarget(aSceneNo)->mScene;
     SceneCmd cmd = scene->mSceneCmd;
     SceneArea area = scene->mSceneArea;
     // check special scene commands first
@@ -1787,6 +1870,37 @@ void Device::callScenePrepare(PreparedCB aPreparedCB, SceneNo aSceneNo, bool aFo
 }
 
 
+SceneTargetPtr Device::getSceneTarget(SceneNo aSceneNo)
+{
+  SceneDeviceSettingsPtr scenes = getScenes();
+  if (!mOutput || !scenes) return SceneTargetPtr();
+  SceneTargetMap::iterator pos = mSceneTargets.find(aSceneNo);
+  if (pos!=mSceneTargets.end()) {
+    // cached, still valid unless scene was modified in the meantime
+    if (pos->second->mScene->isDirty()==pos->second->mSceneWasDirty) return pos->second;
+    mSceneTargets.erase(pos);
+  }
+  // resolve
+  SceneTargetPtr target = SceneTargetPtr(new SceneTarget);
+  target->mScene = scenes->getScene(aSceneNo);
+  target->mSceneWasDirty = target->mScene->isDirty();
+  // - area scenes only apply when the area main scene (area on, Tx_S1) is not dontCare
+  target->mInArea = target->mScene->mSceneArea==0 || !scenes->getScene(SimpleScene::mainSceneForArea(target->mScene->mSceneArea))->isDontCare();
+  // - channel targets
+  int n = numChannels();
+  if (target->mScene->numSceneValues()<n) n = target->mScene->numSceneValues();
+  target->mChannelValues.resize(n);
+  target->mChannelDontCare.resize(n);
+  for (int i=0; i<n; i++) {
+    target->mChannelValues[i] = target->mScene->sceneValue(i);
+    target->mChannelDontCare[i] = target->mScene->isSceneValueFlagSet(i, valueflags_dontCare);
+  }
+  target->mTransitionTime = mOutput->transitionTimeFromScene(target->mScene, true);
+  mSceneTargets[aSceneNo] = target;
+  return target;
+}
+
+
 void Device::callSceneDimStop(PreparedCB aPreparedCB, DsScenePtr aScene, bool aForce)
 {
   dimChannelExecutePrepared(NoOP, ntfy_dimchannel);
@@ -1803,9 +1917,8 @@ void Device::callScenePrepare2(PreparedCB aPreparedCB, DsScenePtr aScene, bool a
   if (area) {
     OLOG(LOG_INFO, "- callScene(%d): is area #%d scene", sceneNo, area);
     // check if device is in area (criteria used is dontCare flag OF THE AREA ON SCENE (other don't care flags are irrelevant!)
-    DsScenePtr areamainscene = getScenes()->getScene(SimpleScene::mainSceneForArea(area));
-    if (areamainscene->isDontCare()) {
-      OLOG(LOG_INFO, "- area main scene(%s) is dontCare -> suppress", VdcHost::sceneText(areamainscene->mSceneNo).c_str());
+    if (!getSceneTarget(sceneNo)->mInArea) {
+      OLOG(LOG_INFO, "- area main scene(%s) is dontCare -> suppress", VdcHost::sceneText(SimpleScene::mainSceneForArea(area)).c_str());
       aPreparedCB(ntfy_none); // not in this area, suppress callScene entirely
       return;
     }
@@ -2099,6 +2212,16 @@ bool Device::canIdentifyToUser()
 }
 
 
+bool Device::presenceStateIsFresh()
+{
+  if (getVdc().backgroundPresenceSampling() && lastPresenceUpdate()!=Never) {
+    // background sampling keeps the state up to date, no need to sample it now unless background sampling is stalled
+    return lastPresenceUpdate()+2*getVdc().presenceSampleInterval()>=MainLoop::now();
+  }
+  return inherited::presenceStateIsFresh();
+}
+
+
 void Device::saveScene(SceneNo aSceneNo)
 {
   // see if we have a scene table at all
@@ -2194,6 +2317,8 @@ ErrorPtr Device::load()
   #if ENABLE_SETTINGS_FROM_FILES
   loadSettingsFromFiles();
   #endif
+  // scenes and settings have changed
+  invalidateSceneTargets();
   return ErrorPtr();
 }
 
@@ -2307,6 +2432,13 @@ enum {
   #if ENABLE_JSONBRIDGEAPI
   bridgingFlags_key,
   #endif
+  // apply pipeline statistics
+  applyCount_key,
+  applySupersedeRate_key,
+  applyDeadlineHits_key,
+  applyLatency_key,
+  applyMaxLatency_key,
+  applyQueueDelay_key,
   numDeviceFieldKeys
 };
 
@@ -2413,6 +2545,13 @@ PropertyDescriptorPtr Device::getDescriptorByIndex(int aPropIndex, int aDomain,
     #if ENABLE_JSONBRIDGEAPI
     { "x-p44-bridgingFlags", apivalue_uint64, bridgingFlags_key, OKEY(device_obj) },
     #endif
+    // apply pipeline statistics
+    { "x-p44-applyCount", apivalue_uint64, applyCount_key, OKEY(device_obj) },
+    { "x-p44-applySupersedeRate", apivalue_double, applySupersedeRate_key, OKEY(device_obj) },
+    { "x-p44-applyDeadlineHits", apivalue_uint64, applyDeadlineHits_key, OKEY(device_obj) },
+    { "x-p44-applyLatency", apivalue_double, applyLatency_key, OKEY(device_obj) },
+    { "x-p44-applyMaxLatency", apivalue_double, applyMaxLatency_key, OKEY(device_obj) },
+    { "x-p44-applyQueueDelay", apivalue_double, applyQueueDelay_key, OKEY(device_obj) },
   };
   // C++ object manages different levels, check aParentDescriptor
   if (aParentDescriptor->isRootOfObject()) {
@@ -2631,6 +2770,23 @@ bool Device::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prope
           return true;
         #endif // ENABLE_JSONBRIDGEAPI
       }
+      // apply pipeline statistics, only for devices with output
+      if (mOutput) switch (aPropertyDescriptor->fieldKey()) {
+        case applyCount_key:
+          aPropValue->setUint64Value(mAppliesCompleted); return true;
+        case applySupersedeRate_key: {
+          long requests = mAppliesCompleted+mAppliesCoalesced;
+          aPropValue->setDoubleValue(requests>0 ? (double)mAppliesCoalesced/requests : 0); return true;
+        }
+        case applyDeadlineHits_key:
+          aPropValue->setUint64Value(mDeadlineHits); return true;
+        case applyLatency_key:
+          aPropValue->setDoubleValue((double)mAvgApplyLatency/Second); return true;
+        case applyMaxLatency_key:
+          aPropValue->setDoubleValue((double)mMaxApplyLatency/Second); return true;
+        case applyQueueDelay_key:
+          aPropValue->setDoubleValue((double)mAvgApplyQueueDelay/Second); return true;
+      }
     }
     else {
       // write properties
@@ -2678,6 +2834,10 @@ ErrorPtr Device::writtenProperty(PropertyAccessMode aMode, PropertyDescriptorPtr
       return ErrorPtr();
     }
   }
+  else if (aMode==access_write && !aPropertyDescriptor->hasObjectKey(device_channels_key)) {
+    // settings might have changed, which might change scene targets
+    invalidateSceneTargets();
+  }
   else if (
     aPropertyDescriptor->hasObjectKey(device_channels_key) && // one or multiple channel's...
     aPropertyDescriptor->fieldKey()==states_key_offset && // ...state(s)...
@@ -2807,6 +2967,34 @@ static void inputValueSource_func(BuiltinFunctionContextPtr f)
 }
 
 
+#if ENABLE_SENSOR_HISTORY
+
+// sensorhistory(id_or_index [, age [, aggregation [, interval]]])
+FUNC_ARG_DEFS(sensorhistory, { text|numeric }, { numeric|optionalarg }, { text|optionalarg }, { numeric|optionalarg } );
+static void sensorhistory_func(BuiltinFunctionContextPtr f)
+{
+  DeviceObj* dev = dynamic_cast<DeviceObj *>(f->thisObj().get());
+  DevicePtr device = dev->device();
+  SensorBehaviourPtr sensor = device->getSensor(Device::by_id_or_index, f->arg(0)->stringValue());
+  SensorHistoryPtr history;
+  if (sensor) history = sensor->getHistory();
+  if (!history) {
+    f->finish(new ErrorValue(ScriptError::NotFound, "sensor '%s' with history not found in device '%s'", f->arg(0)->stringValue().c_str(), device->getName().c_str()));
+    return;
+  }
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds age = f->arg(1)->defined() ? f->arg(1)->doubleValue()*Second : 1*Hour;
+  HistoryAggregation aggregation = f->arg(2)->defined() ? SensorHistory::aggregationFromText(f->arg(2)->stringValue()) : history_avg;
+  MLMicroSeconds interval = f->arg(3)->defined() ? f->arg(3)->doubleValue()*Second : 0;
+  JsonApiValuePtr result = JsonApiValuePtr(new JsonApiValue);
+  result->setType(apivalue_object);
+  history->queryToApiValue(result, now-age, now, aggregation, interval);
+  f->finish(ScriptObj::valueFromJSON(result->jsonObject()));
+}
+
+#endif // ENABLE_SENSOR_HISTORY
+
+
 static const BuiltinMemberDescriptor deviceMembers[] = {
   MEMBER_DEF(currentscene, builtinvalue),
   MEMBER_DEF(lastscene, builtinvalue),
@@ -2816,6 +3004,9 @@ static const BuiltinMemberDescriptor deviceMembers[] = {
   { "button", executable|anyvalid, behaviour_numargs, behaviour_args, &inputValueSource_func },
   { "sensor", executable|anyvalid, behaviour_numargs, behaviour_args, &inputValueSource_func },
   { "input", executable|anyvalid, behaviour_numargs, behaviour_args, &inputValueSource_func },
+  #if ENABLE_SENSOR_HISTORY
+  FUNC_DEF_W_ARG(sensorhistory, executable|structured),
+  #endif
   BUILTINS_TERMINATOR
 };
 
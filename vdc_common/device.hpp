@@ -92,6 +92,26 @@ namespace p44 {
   typedef boost::function<void (NotificationType aNotificationToApply)> PreparedCB;
 
 
+  /// targets of a scene for a specific device, resolved from the device's scene table
+  /// @note these only depend on scene and device settings, not on the current output state
+  ///   (local priority, dimming), and are cached per device until scenes or settings change.
+  class SceneTarget : public P44Obj
+  {
+  public:
+    DsScenePtr mScene; ///< the resolved scene (stored or default)
+    bool mSceneWasDirty; ///< dirty state of mScene when the target was resolved
+    bool mInArea; ///< set unless scene is an area scene and the device is not in that area
+    std::vector<double> mChannelValues; ///< target value by channel index
+    std::vector<bool> mChannelDontCare; ///< dontCare flag by channel index
+    MLMicroSeconds mTransitionTime; ///< transition time defined by the scene
+
+    /// @return true if calling the scene would apply channel values (unless prevented by local priority)
+    bool applies() { return mInArea && !mScene->isDontCare(); };
+  };
+  typedef boost::intrusive_ptr<SceneTarget> SceneTargetPtr;
+  typedef std::map<SceneNo, SceneTargetPtr> SceneTargetMap;
+
+
   /// base class representing a virtual Digital Strom device.
   /// For each type of subsystem (EnOcean, DALI, ...) this class is subclassed to implement
   /// the vDC' specifics, in particular the interface with the hardware.
@@ -153,10 +173,24 @@ namespace p44 {
     SimpleCB mApplyCompleteCB; ///< will be called when apply is complete (set by waitForApplyComplete())
     bool mApplyInProgress; ///< set when applying values is in progress
     bool mDoReportApply; ///< only if set at applyingChannelsComplete, the output state should be reported
-    int mMissedApplyAttempts; ///< number of apply attempts that could not be executed. If>0, completing next apply will trigger a re-apply to finalize values
+    int mMissedApplyAttempts; ///< number of apply attempts coalesced while busy. If>0, completing next apply will trigger a re-apply of the latest values
+    MLMicroSeconds mApplyStartedAt; ///< when the current applyChannelValues() was started (for metrics)
+    MLMicroSeconds mApplyPendingSince; ///< when the oldest coalesced apply request came in, Never if none is pending
     SimpleCB mUpdatedOrCachedCB; ///< will be called when current values are either read from hardware, or new values have been requested for applying
     bool mUpdateInProgress; ///< set when updating channel values from hardware is in progress
-    MLTicket mSerializerWatchdogTicket; ///< watchdog terminating non-responding hardware requests
+    MLTicket mSerializerWatchdogTicket; ///< watchdog terminating non-responding hardware requests after the vdc's apply deadline
+
+    // apply pipeline statistics
+    long mAppliesCompleted; ///< number of applyChannelValues() calls completed (or force-ended)
+    long mAppliesCoalesced; ///< number of apply requests superseded by newer values before they could be applied
+    long mAppliesDelayed; ///< number of applies started after having waited for a previous apply (samples in mAvgApplyQueueDelay)
+    long mDeadlineHits; ///< number of applies or updates force-ended because the deadline has passed
+    MLMicroSeconds mAvgApplyLatency; ///< moving average of time applyChannelValues() took to complete
+    MLMicroSeconds mMaxApplyLatency; ///< max time applyChannelValues() took to complete
+    MLMicroSeconds mAvgApplyQueueDelay; ///< moving average of time coalesced requests had to wait before being applied
+
+    // cached scene targets
+    SceneTargetMap mSceneTargets;
 
     // volatile device configurations list (created when property actually accessed)
     DeviceConfigurationsVector mCachedConfigurations;
@@ -409,6 +443,15 @@ namespace p44 {
     /// @return NULL if device has no scenes, scene device settings otherwise
     SceneDeviceSettingsPtr getScenes() { return boost::dynamic_pointer_cast<SceneDeviceSettings>(mDeviceSettings); };
 
+    /// get the resolved targets of a scene, from the cache if still valid
+    /// @param aSceneNo the scene number
+    /// @return NULL if device has no scenes or no output, scene target otherwise
+    SceneTargetPtr getSceneTarget(SceneNo aSceneNo);
+
+    /// invalidate all cached scene targets
+    /// @note must be called whenever scenes or settings that influence scene targets change
+    void invalidateSceneTargets() { mSceneTargets.clear(); };
+
     /// send a signal needed for some devices to get learned into other devices, or query availability of teach-in signals
     /// @param aVariant -1 to just get number of available teach-in variants. 0..n to send teach-in signal;
     ///   some devices may have different teach-in signals (like: one for ON, one for OFF).
@@ -557,6 +600,9 @@ namespace p44 {
     /// @param aApplyCompleteCB will called when values are applied and no other change is pending
     void waitForApplyComplete(SimpleCB aApplyCompleteCB);
 
+    /// @return moving average of the time this device takes to apply channel values, 0 if not known yet
+    MLMicroSeconds averageApplyLatency() { return mAvgApplyLatency; };
+
     /// request that channel values are updated by reading them back from the device's hardware
     /// @param aUpdatedOrCachedCB will be called when values are updated with actual hardware values
     ///   or pending values are in process to be applied to the hardware and thus these cached values can be considered current.
@@ -842,6 +888,10 @@ namespace p44 {
     /// @return true if the addressable has a way to actually identify to the user (apart from a log message)
     virtual bool canIdentifyToUser() P44_OVERRIDE;
 
+    /// @return true if presence state is fresh enough to be reported without sampling
+    /// @note when the vdc refreshes presence in the background, the cached state is always reported as-is
+    virtual bool presenceStateIsFresh() P44_OVERRIDE;
+
   private:
 
     DsGroupMask behaviourGroups();
@@ -497,6 +497,14 @@ void DsAddressable::checkPresence(PresenceCB aPresenceResultHandler)
 }
 
 
+#define MIN_PRESENCE_SAMPLE_INTERVAL (120*Second)
+
+bool DsAddressable::presenceStateIsFresh()
+{
+  return mLastPresenceUpdate+MIN_PRESENCE_SAMPLE_INTERVAL>=MainLoop::now();
+}
+
+
 // MARK: - property access
 
 enum {
@@ -584,13 +592,11 @@ PropertyDescriptorPtr DsAddressable::getDescriptorByIndex(int aPropIndex, int aD
 }
 
 
-#define MIN_PRESENCE_SAMPLE_INTERVAL (120*Second)
-
 void DsAddressable::prepareAccess(PropertyAccessMode aMode, PropertyPrep& aPrepInfo, StatusCB aPreparedCB)
 {
   if (aPrepInfo.mDescriptor->hasObjectKey(dsAddressable_key) && aPrepInfo.mDescriptor->fieldKey()==active_key) {
     // update status in case
-    if (mLastPresenceUpdate+MIN_PRESENCE_SAMPLE_INTERVAL<MainLoop::now()) {
+    if (!presenceStateIsFresh()) {
       // request update from device
       checkPresence(boost::bind(&DsAddressable::presenceSampleHandler, this, aPreparedCB, _1));
       return;
@@ -805,26 +811,14 @@ string DsAddressable::webuiURLString() const
 bool DsAddressable::loadSettingsFromFile(const char *aCSVFilepath, bool aOnlyExplicitlyOverridden)
 {
   bool anySettingsApplied = false;
-  string line;
-  int lineNo = 0;
-  FILE *file = fopen(aCSVFilepath, "r");
-  if (!file) {
-    int syserr = errno;
-    if (syserr!=ENOENT) {
-      // file not existing is ok, all other errors must be reported
-      OLOG(LOG_ERR, "failed opening file %s - %s", aCSVFilepath, strerror(syserr));
-    }
-    // NOP
-  }
-  else {
-    // file opened
-    while (string_fgetline(file, line)) {
-      lineNo++;
-      const char *p = line.c_str();
+  // Note: file is looked up in the settings file index, and only read once for all addressables
+  const SettingsFileLines *lines = getVdcHost().getSettingsFileIndex().fileLines(aCSVFilepath);
+  if (lines) {
+    for (SettingsFileLines::const_iterator pos = lines->begin(); pos!=lines->end(); ++pos) {
+      const char *p = pos->text.c_str();
       // process CSV line as property name/value pairs
-      anySettingsApplied = readPropsFromCSV(VDC_API_DOMAIN, aOnlyExplicitlyOverridden, p, aCSVFilepath, lineNo) || anySettingsApplied;
+      anySettingsApplied = readPropsFromCSV(VDC_API_DOMAIN, aOnlyExplicitlyOverridden, p, aCSVFilepath, pos->lineNo) || anySettingsApplied;
     }
-    fclose(file);
     if (anySettingsApplied) {
       OLOG(LOG_INFO, "Customized settings from config file %s", aCSVFilepath);
     }
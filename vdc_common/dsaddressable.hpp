@@ -267,6 +267,15 @@ namespace p44 {
     ///   presence state when it is detected as part of another operation
     void updatePresenceState(bool aPresent);
 
+    /// @return time when presence state was last updated, Never if not yet known
+    MLMicroSeconds lastPresenceUpdate() const { return mLastPresenceUpdate; };
+
+    /// check if current presence state can be reported as-is without sampling it
+    /// @return true if presence state is fresh enough to be reported without calling checkPresence() first
+    /// @note base class considers state fresh when it was updated less than MIN_PRESENCE_SAMPLE_INTERVAL ago.
+    ///   Subclasses that have presence refreshed in the background can override this.
+    virtual bool presenceStateIsFresh();
+
     /// @}
 
 
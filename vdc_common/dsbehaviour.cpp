@@ -75,6 +75,13 @@ bool DsBehaviour::pushBehaviourState(bool aDS, bool aBridges)
 {
   bool requestedPushDone = true;
 
+  #if ENABLE_STATE_JOURNAL
+  if (aDS || aBridges) {
+    // record in journal, for clients that were not connected at the time of the push
+    mDevice.getVdcHost().getStateJournal().recordChange(mDevice.getDsUid(), string(getTypeName()).append("States"), getApiId(VDC_API_VERSION_MAX), (int)getIndex());
+  }
+  #endif
+
   if (aDS && mDevice.isPublicDS()) {
     // push to vDC API
     VdcApiConnectionPtr api = mDevice.getVdcHost().getVdsmSessionConnection();
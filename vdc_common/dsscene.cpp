@@ -626,6 +626,8 @@ void SceneDeviceSettings::updateScene(DsScenePtr aScene)
   }
   // anyway, mark scene dirty
   aScene->markDirty();
+  // scene targets (including those of area scenes depending on this one) must be resolved again
+  mDevice.invalidateSceneTargets();
   // as we need the ROWID of the settings as parentID, make sure we get saved if we don't have one
   if (mRowId==0) markDirty();
 }
@@ -742,25 +744,19 @@ void SceneDeviceSettings::loadScenesFromFiles()
   for(int i=0; i<numLevels; ++i) {
     // try to open config file
     string fn = dir+"scenes_"+levelids[i]+".csv";
-    string line;
-    int lineNo = 0;
-    FILE *file = fopen(fn.c_str(), "r");
-    if (!file) {
-      int syserr = errno;
-      if (syserr!=ENOENT) {
-        // file not existing is ok, all other errors must be reported
-        SOLOG(mDevice, LOG_ERR, "failed opening file '%s' - %s", fn.c_str(), strerror(syserr));
-      }
+    // Note: file is looked up in the settings file index, and only read once for all devices
+    const SettingsFileLines *lines = mDevice.getVdcHost().getSettingsFileIndex().fileLines(fn);
+    if (!lines) {
       // don't process, try next
       SOLOG(mDevice, LOG_DEBUG, "loadScenesFromFiles: tried '%s' - not found", fn.c_str());
     }
     else {
-      // file opened
       SOLOG(mDevice, LOG_DEBUG, "loadScenesFromFiles: found '%s' - processing", fn.c_str());
-      while (string_fgetline(file, line)) {
-        lineNo++;
-        // skip empty lines and those starting with #, allowing to format and comment CSV
-        if (line.empty() || line[0]=='#') {
+      for (SettingsFileLines::const_iterator lpos = lines->begin(); lpos!=lines->end(); ++lpos) {
+        int lineNo = lpos->lineNo;
+        const string &line = lpos->text;
+        // skip lines starting with #, allowing to format and comment CSV
+        if (line[0]=='#') {
           // skip this line
           continue;
         }
@@ -803,7 +799,6 @@ void SceneDeviceSettings::loadScenesFromFiles()
           SOLOG(mDevice, LOG_INFO, "Customized scene %d %sfrom config file %s", sceneNo, overridden ? "(with override) " : "", fn.c_str());
         }
       }
-      fclose(file);
     }
   }
 }
@@ -0,0 +1,416 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "jsonencoder.hpp"
+
+#if ENABLE_JSON_TEXT_ENCODER
+
+#include "jsonvdcapi.hpp"
+#include "pbufvdcapi.hpp"
+#include "localapivalue.hpp"
+#include <math.h>
+#ifdef __GLIBC__
+  #include <malloc.h>
+#endif
+
+using namespace p44;
+
+
+// MARK: - encoding
+
+void JsonTextEncoder::appendString(string &aOut, const string &aString)
+{
+  // same escaping as json-c's default (slashes escaped, lowercase \u00xx for other control chars)
+  aOut.reserve(aOut.size()+aString.size()+2);
+  aOut += '"';
+  size_t start = 0;
+  for (size_t i=0; i<aString.size(); i++) {
+    unsigned char c = (unsigned char)aString[i];
+    const char *esc = NULL;
+    switch (c) {
+      case '\b': esc = "\\b"; break;
+      case '\n': esc = "\\n"; break;
+      case '\r': esc = "\\r"; break;
+      case '\t': esc = "\\t"; break;
+      case '\f': esc = "\\f"; break;
+      case '"': esc = "\\\""; break;
+      case '\\': esc = "\\\\"; break;
+      case '/': esc = "\\/"; break;
+      default:
+        if (c>=' ') continue; // plain char
+        break;
+    }
+    // flush plain part
+    if (i>start) aOut.append(aString, start, i-start);
+    start = i+1;
+    if (esc) aOut += esc;
+    else string_format_append(aOut, "\\u00%02x", c);
+  }
+  if (start<aString.size()) aOut.append(aString, start, string::npos);
+  aOut += '"';
+}
+
+
+void JsonTextEncoder::appendDouble(string &aOut, double aDouble)
+{
+  // same format as json-c's default double serializer
+  if (isnan(aDouble)) { aOut += "NaN"; return; }
+  if (isinf(aDouble)) { aOut += aDouble>0 ? "Infinity" : "-Infinity"; return; }
+  char buf[40];
+  int sz = snprintf(buf, sizeof(buf), "%.17g", aDouble);
+  if (sz<0 || sz>=(int)sizeof(buf)) return;
+  char *p = strchr(buf, ',');
+  if (p) *p = '.'; // locale decimal comma
+  else p = strchr(buf, '.');
+  bool looksNumeric = isdigit((unsigned char)buf[0]) || (sz>1 && buf[0]=='-' && isdigit((unsigned char)buf[1]));
+  aOut.append(buf, sz);
+  if (looksNumeric && !p && strchr(buf, 'e')==NULL) {
+    // make sure it is recognized as a double, not an integer
+    aOut += ".0";
+  }
+}
+
+
+void JsonTextEncoder::appendJson(string &aOut, JsonObjectPtr aJson)
+{
+  if (!aJson) {
+    aOut += "null";
+    return;
+  }
+  switch (aJson->type()) {
+    case json_type_boolean:
+      aOut += aJson->boolValue() ? "true" : "false";
+      break;
+    case json_type_double:
+      // Note: json-c re-serializes doubles parsed from text using their original text (e.g. "1.50"),
+      //   which is not available from the value, so let json-c format this leaf itself
+      aOut += aJson->json_str();
+      break;
+    case json_type_int:
+      string_format_append(aOut, "%lld", (long long)aJson->int64Value());
+      break;
+    case json_type_string:
+      appendString(aOut, aJson->stringValue());
+      break;
+    case json_type_object: {
+      aOut += '{';
+      bool first = true;
+      string key;
+      JsonObjectPtr val;
+      aJson->resetKeyIteration();
+      while (aJson->nextKeyValue(key, val)) {
+        if (!first) aOut += ',';
+        first = false;
+        appendString(aOut, key);
+        aOut += ':';
+        appendJson(aOut, val);
+      }
+      aOut += '}';
+      break;
+    }
+    case json_type_array: {
+      aOut += '[';
+      int n = aJson->arrayLength();
+      for (int i=0; i<n; i++) {
+        if (i>0) aOut += ',';
+        appendJson(aOut, aJson->arrayGet(i));
+      }
+      aOut += ']';
+      break;
+    }
+    case json_type_null:
+    default:
+      aOut += "null";
+      break;
+  }
+}
+
+
+void JsonTextEncoder::appendApiValue(string &aOut, ApiValuePtr aValue)
+{
+  if (!aValue) {
+    aOut += "null";
+    return;
+  }
+  JsonApiValuePtr jav = boost::dynamic_pointer_cast<JsonApiValue>(aValue);
+  if (jav) {
+    // JSON already, encode underlying JsonObject tree directly without per-node ApiValue wrappers
+    appendJson(aOut, jav->jsonObject());
+    return;
+  }
+  // other API value type, encode the way a JsonApiValue would represent it, without converting first
+  switch (aValue->getType()) {
+    case apivalue_bool:
+      aOut += aValue->boolValue() ? "true" : "false";
+      break;
+    case apivalue_int64:
+    case apivalue_uint64: // Note: JsonApiValue stores uint64 as int64, too
+      string_format_append(aOut, "%lld", (long long)aValue->int64Value());
+      break;
+    case apivalue_double:
+      appendDouble(aOut, aValue->doubleValue());
+      break;
+    case apivalue_string:
+      appendString(aOut, aValue->stringValue());
+      break;
+    case apivalue_binary:
+      appendString(aOut, binaryToHexString(aValue->binaryValue()));
+      break;
+    case apivalue_object: {
+      aOut += '{';
+      bool first = true;
+      string key;
+      ApiValuePtr val;
+      aValue->resetKeyIteration();
+      while (aValue->nextKeyValue(key, val)) {
+        if (!first) aOut += ',';
+        first = false;
+        appendString(aOut, key);
+        aOut += ':';
+        appendApiValue(aOut, val);
+      }
+      aOut += '}';
+      break;
+    }
+    case apivalue_array: {
+      aOut += '[';
+      int n = aValue->arrayLength();
+      for (int i=0; i<n; i++) {
+        if (i>0) aOut += ',';
+        appendApiValue(aOut, aValue->arrayGet(i));
+      }
+      aOut += ']';
+      break;
+    }
+    case apivalue_null:
+    default:
+      aOut += "null";
+      break;
+  }
+}
+
+
+// MARK: - compatibility and performance check
+
+/// @return bytes currently allocated on the heap, -1 if not available on this platform
+static long heapInUse()
+{
+  #if defined(__GLIBC__) && (__GLIBC__>2 || (__GLIBC__==2 && __GLIBC_MINOR__>=33))
+  return (long)mallinfo2().uordblks;
+  #elif defined(__GLIBC__)
+  return (long)mallinfo().uordblks;
+  #else
+  return -1;
+  #endif
+}
+
+
+ApiValuePtr JsonTextEncoder::syntheticDeviceTree(ApiValuePtr aFactory, int aNumDevices)
+{
+  // roughly resembles a full property read of all devices of a vdc host
+  ApiValuePtr root = aFactory->newObject();
+  ApiValuePtr devices = root->newObject();
+  for (int d=0; d<aNumDevices; d++) {
+    ApiValuePtr dev = devices->newObject();
+    string dsuid = string_format("%032X%02X", d*0x10001, d%256);
+    dev->add("dSUID", dev->newString(dsuid));
+    dev->add("name", dev->newString(string_format("Device #%d \"test\" / zone\t%d", d, d%20)));
+    dev->add("model", dev->newString("p44 synthetic light"));
+    dev->add("primaryGroup", dev->newUint64(1));
+    dev->add("zoneID", dev->newUint64(d%20));
+    dev->add("active", dev->newBool(d%7!=0));
+    dev->add("progMode", dev->newBool(false));
+    dev->add("x-p44-uniqueId", dev->newBinary(string(8, (char)d)));
+    dev->add("x-p44-lastSeen", dev->newNull());
+    // output
+    ApiValuePtr od = dev->newObject();
+    od->add("function", od->newUint64(1));
+    od->add("outputUsage", od->newUint64(0));
+    od->add("variableRamp", od->newBool(true));
+    od->add("maxPower", od->newDouble(d+0.5));
+    dev->add("outputDescription", od);
+    // channel states
+    ApiValuePtr cs = dev->newObject();
+    static const char *channels[] = { "brightness", "hue", "saturation", "colortemp", "x", "y" };
+    for (size_t c=0; c<sizeof(channels)/sizeof(channels[0]); c++) {
+      ApiValuePtr ch = cs->newObject();
+      ch->add("value", ch->newDouble((d*7+c*13)%1000/10.0));
+      ch->add("age", d%3==0 ? ch->newNull() : ch->newDouble(d*0.123));
+      cs->add(channels[c], ch);
+    }
+    dev->add("channelStates", cs);
+    // sensors
+    ApiValuePtr ss = dev->newObject();
+    for (int s=0; s<2; s++) {
+      ApiValuePtr sn = ss->newObject();
+      sn->add("value", sn->newDouble(-20+d%60+s*0.25));
+      sn->add("age", sn->newDouble(1.0/(d+1)));
+      sn->add("error", sn->newUint64(0));
+      ss->add(string_format("sensor%d", s), sn);
+    }
+    dev->add("sensorStates", ss);
+    // scenes
+    ApiValuePtr sc = dev->newArray();
+    for (int s=0; s<16; s++) {
+      ApiValuePtr scene = sc->newObject();
+      ApiValuePtr sch = scene->newObject();
+      ApiValuePtr bri = sch->newObject();
+      bri->add("value", bri->newDouble(s*100.0/15));
+      bri->add("dontCare", bri->newBool(s>8));
+      sch->add("brightness", bri);
+      scene->add("channels", sch);
+      scene->add("effect", scene->newUint64(s%3));
+      scene->add("ignoreLocalPriority", scene->newBool(false));
+      sc->arrayAppend(scene);
+    }
+    dev->add("scenes", sc);
+    devices->add(dsuid, dev);
+  }
+  root->add("x-p44-devices", devices);
+  return root;
+}
+
+
+bool JsonTextEncoder::doublesIdentical(ApiValuePtr aFactory, string &aEncoded, string &aExpected)
+{
+  // doubles json-c might format differently from the encoder (rounding, exponent, negative zero, NaN)
+  static const double doubles[] = { 0.1, 1e21, -0.0, NAN };
+  ApiValuePtr tree = aFactory->newObject();
+  ApiValuePtr arr = tree->newArray();
+  for (size_t i=0; i<sizeof(doubles)/sizeof(doubles[0]); i++) {
+    tree->add(string_format("d%zu", i), tree->newDouble(doubles[i]));
+    arr->arrayAppend(arr->newDouble(doubles[i]));
+  }
+  tree->add("all", arr);
+  tree->add("int", tree->newInt64(-42));
+  aEncoded.clear();
+  appendApiValue(aEncoded, tree);
+  aExpected = JsonApiValue::getAsJson(tree)->json_str(); // converted to JSON first, as before
+  return aEncoded==aExpected;
+}
+
+
+ErrorPtr JsonTextEncoder::encoderCheck(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  int numDevices = 1000;
+  int rounds = 3;
+  ApiValuePtr o;
+  if ((o = aParams->get("devices"))) numDevices = o->int32Value();
+  if ((o = aParams->get("rounds"))) rounds = o->int32Value();
+  if (numDevices<1 || rounds<1) return WebError::webErr(400, "devices and rounds must be >0");
+  // build synthetic property result tree
+  MLMicroSeconds t = MainLoop::now();
+  ApiValuePtr tree = syntheticDeviceTree(JsonApiValue::newValueFromJson(JsonObject::newObj()), numDevices);
+  MLMicroSeconds buildTime = MainLoop::now()-t;
+  // encode with json-c (as sending a JsonObject message does)
+  string refText;
+  MLMicroSeconds refTime = Infinite;
+  for (int r=0; r<rounds; r++) {
+    t = MainLoop::now();
+    refText = JsonApiValue::getAsJson(tree)->json_str();
+    t = MainLoop::now()-t;
+    if (t<refTime) refTime = t;
+  }
+  // encode with the single pass encoder
+  string text;
+  MLMicroSeconds encTime = Infinite;
+  for (int r=0; r<rounds; r++) {
+    t = MainLoop::now();
+    text.clear();
+    appendApiValue(text, tree);
+    t = MainLoop::now()-t;
+    if (t<encTime) encTime = t;
+  }
+  // peak memory: everything each method needs to keep allocated at the same time until the message is sent
+  long refHeap = -1;
+  long encHeap = -1;
+  long h0 = heapInUse();
+  if (h0>=0) {
+    {
+      JsonObjectPtr j = JsonApiValue::getAsJson(tree); // converted tree
+      string s = j->json_str(); // plus json-c print buffer plus message text
+      refHeap = heapInUse()-h0;
+    }
+    h0 = heapInUse();
+    {
+      string s;
+      appendApiValue(s, tree); // message text only
+      encHeap = heapInUse()-h0;
+    }
+  }
+  // doubles parsed from text are re-serialized by json-c using their original text
+  JsonObjectPtr parsed = JsonObject::objFromText("{\"a\":1.50,\"b\":2e3,\"c\":-0.0,\"d\":0.1,\"e\":[1.0,3.14159265358979,1E-7]}");
+  string parsedText;
+  appendJson(parsedText, parsed);
+  bool parsedIdentical = parsed && parsedText==parsed->json_str();
+  bool identical = text==refText;
+  ApiValuePtr res = aRequest->newApiValue();
+  res->setType(apivalue_object);
+  res->add("devices", res->newInt64(numDevices));
+  res->add("identical", res->newBool(identical));
+  res->add("parsedDoublesIdentical", res->newBool(parsedIdentical));
+  // doubles in non-JSON API values are formatted by the encoder itself
+  ApiValuePtr nonJson = res->newObject();
+  string enc, exp;
+  bool nonJsonIdentical = doublesIdentical(ApiValuePtr(new PbufApiValue), enc, exp);
+  nonJson->add("pbuf", nonJson->newBool(nonJsonIdentical));
+  if (!nonJsonIdentical) {
+    nonJson->add("pbufExpected", nonJson->newString(exp));
+    nonJson->add("pbufEncoded", nonJson->newString(enc));
+  }
+  #if ENABLE_LOCAL_APIVALUE
+  bool localIdentical = doublesIdentical(ApiValuePtr(new LocalApiValue), enc, exp);
+  nonJson->add("local", nonJson->newBool(localIdentical));
+  if (!localIdentical) {
+    nonJson->add("localExpected", nonJson->newString(exp));
+    nonJson->add("localEncoded", nonJson->newString(enc));
+  }
+  nonJsonIdentical = nonJsonIdentical && localIdentical;
+  #endif
+  res->add("nonJsonDoubles", nonJson);
+  if (!identical) {
+    // report first difference
+    size_t i = 0;
+    while (i<text.size() && i<refText.size() && text[i]==refText[i]) i++;
+    size_t from = i>40 ? i-40 : 0;
+    res->add("differsAt", res->newUint64(i));
+    res->add("expected", res->newString(refText.substr(from, 80)));
+    res->add("encoded", res->newString(text.substr(from, 80)));
+  }
+  res->add("bytes", res->newUint64(text.size()));
+  res->add("jsoncBytes", res->newUint64(refText.size()));
+  res->add("buildSeconds", res->newDouble((double)buildTime/Second));
+  res->add("jsoncSeconds", res->newDouble((double)refTime/Second));
+  res->add("encoderSeconds", res->newDouble((double)encTime/Second));
+  res->add("jsoncPeakBytes", refHeap>=0 ? res->newInt64(refHeap) : res->newNull());
+  res->add("encoderPeakBytes", encHeap>=0 ? res->newInt64(encHeap) : res->newNull());
+  LOG(LOG_NOTICE,
+    "JSON encoder check: %d devices, %zu bytes, identical=%d, parsed doubles identical=%d, non-JSON doubles identical=%d, json-c: %.3f mS/%ld bytes, single pass: %.3f mS/%ld bytes",
+    numDevices, text.size(), identical, parsedIdentical, nonJsonIdentical,
+    (double)refTime/MilliSecond, refHeap, (double)encTime/MilliSecond, encHeap
+  );
+  aRequest->sendResult(res);
+  return ErrorPtr();
+}
+
+#endif // ENABLE_JSON_TEXT_ENCODER
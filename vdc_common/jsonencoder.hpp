@@ -0,0 +1,96 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__jsonencoder__
+#define __p44vdc__jsonencoder__
+
+#include "p44vdc_common.hpp"
+
+#ifndef ENABLE_JSON_TEXT_ENCODER
+  #define ENABLE_JSON_TEXT_ENCODER 1
+#endif
+
+#if ENABLE_JSON_TEXT_ENCODER
+
+#include "jsonobject.hpp"
+#include "vdcapi.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// Single pass JSON text encoder for API results.
+  /// Encodes JsonObject trees as well as ApiValue trees of any API type directly into one
+  /// output string, without building intermediate JsonObjects (no cross-type conversion
+  /// for non-JSON ApiValues) and without json-c's internal print buffers.
+  /// Output is byte-identical to json-c's plain (JSON_C_TO_STRING_PLAIN) output.
+  /// @note doubles in JsonObject trees are still formatted by json-c, because doubles parsed from
+  ///   text are printed by json-c in their original form (such as "1.50"), which only json-c knows.
+  /// @note property results can only be encoded once complete, because property access
+  ///   fills in placeholders and asynchronously collected values after the fact.
+  class JsonTextEncoder
+  {
+  public:
+
+    /// append JSON text of a JsonObject tree
+    /// @param aOut string to append JSON text to
+    /// @param aJson the JSON value to encode, NULL encodes as JSON null
+    static void appendJson(string &aOut, JsonObjectPtr aJson);
+
+    /// append JSON text of an ApiValue tree, as JsonApiValue would represent it
+    /// @param aOut string to append JSON text to
+    /// @param aValue the API value to encode, NULL encodes as JSON null
+    /// @note binary values are encoded as hex strings
+    static void appendApiValue(string &aOut, ApiValuePtr aValue);
+
+    /// append a quoted and escaped JSON string
+    /// @param aOut string to append JSON text to
+    /// @param aString the string to encode
+    static void appendString(string &aOut, const string &aString);
+
+    /// append a JSON number for a double value
+    /// @param aOut string to append JSON text to
+    /// @param aDouble the value to encode
+    static void appendDouble(string &aOut, double aDouble);
+
+    /// compare output and performance with the json-c encoder on a synthetic device property tree
+    /// @param aRequest the API request to answer with the results
+    /// @param aParams the parameters:
+    ///   - devices: number of devices in the synthetic tree (default 1000)
+    ///   - rounds: number of encoding rounds for timing (default 3)
+    /// @note result also reports the heap memory each method holds until the message is sent (glibc only),
+    ///   whether doubles parsed from JSON text (which json-c prints in their original form) encode identically,
+    ///   and whether edge case doubles in protobuf and local API values encode identically to json-c
+    static ErrorPtr encoderCheck(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+
+  private:
+
+    static ApiValuePtr syntheticDeviceTree(ApiValuePtr aFactory, int aNumDevices);
+    static bool doublesIdentical(ApiValuePtr aFactory, string &aEncoded, string &aExpected);
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_JSON_TEXT_ENCODER
+#endif // __p44vdc__jsonencoder__
@@ -21,6 +21,7 @@
 //
 
 #include "jsonvdcapi.hpp"
+#include "jsonencoder.hpp"
 
 using namespace p44;
 
@@ -203,14 +204,27 @@ VdcApiConnectionPtr VdcJsonApiRequest::connection()
 
 ErrorPtr VdcJsonApiRequest::sendResult(ApiValuePtr aResult)
 {
+  answered();
   LOG(LOG_INFO, "%s <- vDC, id=%s: result=%s", requestId().c_str(), apiName(), aResult ? aResult->description().c_str() : "<none>");
+  #if ENABLE_JSON_TEXT_ENCODER
+  // encode JSON-RPC response in a single pass, without json-c print buffers
+  string msg = "{\"jsonrpc\":\"2.0\",\"result\":";
+  JsonTextEncoder::appendApiValue(msg, aResult);
+  msg += ",\"id\":";
+  JsonTextEncoder::appendString(msg, requestId());
+  msg += "}\n"; // message terminator
+  mJsonConnection->mJsonRpcComm->sendRaw(msg);
+  return ErrorPtr();
+  #else
   JsonApiValuePtr result = boost::dynamic_pointer_cast<JsonApiValue>(aResult);
   return mJsonConnection->mJsonRpcComm->sendResult(JsonObject::newString(requestId()), result ? result->jsonObject() : NULL);
+  #endif
 }
 
 
 ErrorPtr VdcJsonApiRequest::sendError(ErrorPtr aError)
 {
+  answered();
   LOG(LOG_INFO, "%s <- vDC, id=%s: error='%s'", apiName(), requestId().c_str(), Error::text(aError));
   if (!aError) {
     aError = Error::ok();
@@ -284,7 +298,20 @@ ErrorPtr VdcJsonApiConnection::sendRequest(const string &aMethod, ApiValuePtr aP
   else {
     // notification
     LOG(LOG_INFO, "%s <- vDC: sending notification '%s', params=%s", apiName(), aMethod.c_str(), aParams ? aParams->description().c_str() : "<none>");
+    #if ENABLE_JSON_TEXT_ENCODER
+    // encode JSON-RPC notification in a single pass, without json-c print buffers
+    // Note: method calls still go through JsonRpcComm, which needs to track the request id for the response
+    string msg = "{\"jsonrpc\":\"2.0\",\"method\":";
+    JsonTextEncoder::appendString(msg, aMethod);
+    if (aParams) {
+      msg += ",\"params\":";
+      JsonTextEncoder::appendApiValue(msg, aParams);
+    }
+    msg += "}\n"; // message terminator
+    mJsonRpcComm->sendRaw(msg);
+    #else
     err = mJsonRpcComm->sendRequest(aMethod.c_str(), params->jsonObject(), NoOP);
+    #endif
   }
   return err;
 }
@@ -0,0 +1,457 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "localapivalue.hpp"
+
+#if ENABLE_LOCAL_APIVALUE
+
+#include "jsonvdcapi.hpp"
+
+#include <set>
+
+using namespace p44;
+
+
+// MARK: - recycling and key interning
+
+// released instances, linked through their first bytes
+static void* gPoolHead = NULL;
+static size_t gPoolSize = 0;
+
+void* LocalApiValue::operator new(size_t aSize)
+{
+  if (aSize==sizeof(LocalApiValue) && gPoolHead) {
+    void* p = gPoolHead;
+    gPoolHead = *((void**)p);
+    gPoolSize--;
+    return p;
+  }
+  return ::operator new(aSize);
+}
+
+
+void LocalApiValue::operator delete(void* aPtr, size_t aSize)
+{
+  if (aSize==sizeof(LocalApiValue) && gPoolSize<LOCALAPIVALUE_POOL_SIZE) {
+    *((void**)aPtr) = gPoolHead;
+    gPoolHead = aPtr;
+    gPoolSize++;
+    return;
+  }
+  ::operator delete(aPtr);
+}
+
+
+const string *LocalApiValue::internKey(const string &aKey)
+{
+  // Note: std::set nodes never move, so pointers to the keys remain valid
+  static std::set<string> sInternedKeys;
+  return &(*sInternedKeys.insert(aKey).first);
+}
+
+
+// MARK: - LocalApiValue
+
+LocalApiValue::LocalApiValue() :
+  mStoredType(apivalue_null),
+  mNumFields(0),
+  mMoreFieldsP(NULL),
+  mKeyIterator(0)
+{
+  mScalar.uint64Val = 0;
+}
+
+
+LocalApiValue::~LocalApiValue()
+{
+  clear();
+}
+
+
+ApiValuePtr LocalApiValue::newValue(ApiValueType aObjectType)
+{
+  ApiValuePtr newVal = ApiValuePtr(new LocalApiValue);
+  newVal->setType(aObjectType);
+  return newVal;
+}
+
+
+void LocalApiValue::clear()
+{
+  for (size_t i=0; i<mNumFields && i<LOCALAPIVALUE_INLINE_FIELDS; i++) {
+    mFields[i].key = NULL;
+    mFields[i].value.reset();
+  }
+  mNumFields = 0;
+  if (mMoreFieldsP) {
+    delete mMoreFieldsP;
+    mMoreFieldsP = NULL;
+  }
+  mString.clear();
+  mScalar.uint64Val = 0;
+  mStoredType = apivalue_null;
+  mKeyIterator = 0;
+}
+
+
+void LocalApiValue::operator=(ApiValue &aApiValue)
+{
+  LocalApiValue *lavP = dynamic_cast<LocalApiValue *>(&aApiValue);
+  if (lavP) {
+    if (lavP==this) return;
+    setType(aApiValue.getType());
+    clear();
+    mStoredType = lavP->mStoredType;
+    mScalar = lavP->mScalar;
+    mString = lavP->mString;
+    for (size_t i=0; i<lavP->mNumFields; i++) {
+      Field &f = lavP->fieldAt(i);
+      LocalApiValuePtr v = new LocalApiValue;
+      v->operator=(static_cast<ApiValue &>(*(f.value))); // deep copy (virtual assignment, not memberwise copy)
+      appendField(f.key, v);
+    }
+  }
+  else {
+    setNull(); // forget old content
+    inherited::operator=(aApiValue); // cross-type assignment, needs more expensive generic assignment
+  }
+}
+
+
+LocalApiValuePtr LocalApiValue::localValue(ApiValuePtr aObj)
+{
+  if (!aObj) return LocalApiValuePtr();
+  LocalApiValuePtr v = boost::dynamic_pointer_cast<LocalApiValue>(aObj);
+  if (!v) {
+    // foreign API value, must convert
+    v = new LocalApiValue;
+    *v = *aObj;
+  }
+  return v;
+}
+
+
+void LocalApiValue::appendField(const string *aKey, LocalApiValuePtr aValue)
+{
+  if (mNumFields<LOCALAPIVALUE_INLINE_FIELDS) {
+    mFields[mNumFields].key = aKey;
+    mFields[mNumFields].value = aValue;
+  }
+  else {
+    if (!mMoreFieldsP) mMoreFieldsP = new FieldVector;
+    Field f;
+    f.key = aKey;
+    f.value = aValue;
+    mMoreFieldsP->push_back(f);
+  }
+  mNumFields++;
+}
+
+
+ssize_t LocalApiValue::fieldIndex(const string &aKey)
+{
+  for (size_t i=0; i<mNumFields; i++) {
+    const string *k = fieldAt(i).key;
+    if (k && *k==aKey) return i;
+  }
+  return -1;
+}
+
+
+void LocalApiValue::add(const string &aKey, ApiValuePtr aObj)
+{
+  if (getType()!=apivalue_object) return;
+  LocalApiValuePtr v = localValue(aObj);
+  if (!v) return;
+  ssize_t i = fieldIndex(aKey);
+  if (i>=0) fieldAt(i).value = v; // replace existing
+  else appendField(internKey(aKey), v);
+}
+
+
+ApiValuePtr LocalApiValue::get(const string &aKey)
+{
+  if (getType()==apivalue_object) {
+    ssize_t i = fieldIndex(aKey);
+    if (i>=0) return fieldAt(i).value;
+  }
+  return ApiValuePtr();
+}
+
+
+void LocalApiValue::del(const string &aKey)
+{
+  if (getType()!=apivalue_object) return;
+  ssize_t i = fieldIndex(aKey);
+  if (i<0) return;
+  // move subsequent fields down
+  for (size_t j=(size_t)i+1; j<mNumFields; j++) fieldAt(j-1) = fieldAt(j);
+  mNumFields--;
+  if (mNumFields>=LOCALAPIVALUE_INLINE_FIELDS) {
+    mMoreFieldsP->pop_back();
+  }
+  else {
+    mFields[mNumFields].key = NULL;
+    mFields[mNumFields].value.reset();
+  }
+}
+
+
+int LocalApiValue::arrayLength()
+{
+  if (getType()==apivalue_array) return (int)mNumFields;
+  return 0;
+}
+
+
+void LocalApiValue::arrayAppend(ApiValuePtr aObj)
+{
+  if (getType()!=apivalue_array) return;
+  LocalApiValuePtr v = localValue(aObj);
+  if (v) appendField(NULL, v);
+}
+
+
+ApiValuePtr LocalApiValue::arrayGet(int aAtIndex)
+{
+  if (getType()==apivalue_array && aAtIndex>=0 && (size_t)aAtIndex<mNumFields) {
+    return fieldAt(aAtIndex).value;
+  }
+  return ApiValuePtr();
+}
+
+
+void LocalApiValue::arrayPut(int aAtIndex, ApiValuePtr aObj)
+{
+  if (getType()==apivalue_array && aAtIndex>=0 && (size_t)aAtIndex<mNumFields) {
+    LocalApiValuePtr v = localValue(aObj);
+    if (v) fieldAt(aAtIndex).value = v;
+  }
+}
+
+
+bool LocalApiValue::resetKeyIteration()
+{
+  mKeyIterator = 0;
+  return getType()==apivalue_object;
+}
+
+
+bool LocalApiValue::nextKeyValue(string &aKey, ApiValuePtr &aValue)
+{
+  if (getType()==apivalue_object && mKeyIterator<mNumFields) {
+    Field &f = fieldAt(mKeyIterator++);
+    aKey = *f.key;
+    aValue = f.value;
+    return true;
+  }
+  return false;
+}
+
+
+// MARK: - scalar values
+
+void LocalApiValue::setScalarType(ApiValueType aType)
+{
+  mStoredType = aType;
+  // untyped values adopt the type of the first value assigned, like JSON values do
+  if (getType()==apivalue_null) mObjectType = aType;
+}
+
+
+uint64_t LocalApiValue::uint64Value()
+{
+  switch (mStoredType) {
+    case apivalue_uint64: return mScalar.uint64Val;
+    case apivalue_int64: return mScalar.int64Val>=0 ? mScalar.int64Val : 0; // only return positive values
+    case apivalue_double: return mScalar.doubleVal>=0 ? mScalar.doubleVal : 0;
+    case apivalue_bool: return mScalar.boolVal ? 1 : 0;
+    default: return 0;
+  }
+}
+
+
+int64_t LocalApiValue::int64Value()
+{
+  switch (mStoredType) {
+    case apivalue_int64: return mScalar.int64Val;
+    case apivalue_uint64: return mScalar.uint64Val & 0x7FFFFFFFFFFFFFFFll; // prevent returning sign
+    case apivalue_double: return mScalar.doubleVal;
+    case apivalue_bool: return mScalar.boolVal ? 1 : 0;
+    default: return 0;
+  }
+}
+
+
+double LocalApiValue::doubleValue()
+{
+  if (mStoredType==apivalue_double) return mScalar.doubleVal;
+  if (mStoredType==apivalue_uint64) return mScalar.uint64Val;
+  return int64Value();
+}
+
+
+bool LocalApiValue::boolValue()
+{
+  if (mStoredType==apivalue_bool) return mScalar.boolVal;
+  if (mStoredType==apivalue_double) return mScalar.doubleVal!=0;
+  return int64Value()!=0;
+}
+
+
+string LocalApiValue::binaryValue()
+{
+  if (getType()==apivalue_binary) return mString;
+  if (getType()==apivalue_string) return hexToBinaryString(mString.c_str());
+  return ""; // not binary
+}
+
+
+string LocalApiValue::stringValue()
+{
+  if (getType()==apivalue_string) return mString;
+  if (getType()==apivalue_binary) return binaryToHexString(mString); // render as hex string
+  // let base class render the contents as string
+  return inherited::stringValue();
+}
+
+
+size_t LocalApiValue::stringLength()
+{
+  if (getType()==apivalue_string) return mString.size();
+  return inherited::stringLength();
+}
+
+
+void LocalApiValue::setUint64Value(uint64_t aUint64)
+{
+  setScalarType(apivalue_uint64);
+  mScalar.uint64Val = aUint64;
+}
+
+
+void LocalApiValue::setInt64Value(int64_t aInt64)
+{
+  setScalarType(apivalue_int64);
+  mScalar.int64Val = aInt64;
+}
+
+
+void LocalApiValue::setDoubleValue(double aDouble)
+{
+  setScalarType(apivalue_double);
+  mScalar.doubleVal = aDouble;
+}
+
+
+void LocalApiValue::setBoolValue(bool aBool)
+{
+  setScalarType(apivalue_bool);
+  mScalar.boolVal = aBool;
+}
+
+
+void LocalApiValue::setBinaryValue(const string &aBinary)
+{
+  if (getType()==apivalue_null) mObjectType = apivalue_binary;
+  if (getType()==apivalue_binary) mString = aBinary;
+}
+
+
+bool LocalApiValue::setStringValue(const string &aString)
+{
+  if (getType()==apivalue_null) mObjectType = apivalue_string;
+  if (getType()==apivalue_string) {
+    mString = aString;
+    return true;
+  }
+  else if (getType()==apivalue_binary) {
+    // parse string as hex
+    mString = hexToBinaryString(aString.c_str());
+    return true;
+  }
+  // let base class try to convert to type of object
+  return inherited::setStringValue(aString);
+}
+
+
+// MARK: - benchmark
+
+/// simulate what local controller and devices do with a callScene and a setOutputChannelValue notification
+static double simulatedNotifications(ApiValuePtr aFactory, int aRounds)
+{
+  double checksum = 0;
+  for (int r=0; r<aRounds; r++) {
+    // callScene as built by LocalController::callScene()
+    ApiValuePtr params = aFactory->newObject();
+    params->add("scene", params->newUint64(r%64));
+    params->add("force", params->newBool(false));
+    params->add("transitionTime", params->newDouble(0.5));
+    // ...and evaluated by Device::handleNotification()
+    ApiValuePtr o;
+    if ((o = params->get("scene"))) checksum += o->uint16Value();
+    if ((o = params->get("transitionTime"))) checksum += o->doubleValue();
+    if ((o = params->get("force"))) checksum += o->boolValue();
+    // setOutputChannelValue as built by LocalController::processSensorChange()
+    params = aFactory->newObject();
+    params->add("zone_id", params->newUint64(r%16));
+    params->add("group", params->newUint64(1));
+    params->add("value", params->newDouble(r%100));
+    params->add("channelId", params->newString("brightness"));
+    params->add("transitionTime", params->newDouble(0.1));
+    if ((o = params->get("channelId"))) checksum += o->stringValue().size();
+    if ((o = params->get("value"))) checksum += o->doubleValue();
+    if ((o = params->get("transitionTime"))) checksum += o->doubleValue();
+    if ((o = params->get("zone_id"))) checksum += o->int32Value();
+  }
+  return checksum;
+}
+
+
+ErrorPtr LocalApiValue::benchmark(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  int rounds = 10000;
+  ApiValuePtr o;
+  if ((o = aParams->get("rounds"))) rounds = o->int32Value();
+  if (rounds<1) return WebError::webErr(400, "rounds must be >0");
+  MLMicroSeconds t = MainLoop::now();
+  double jsonSum = simulatedNotifications(ApiValuePtr(new JsonApiValue), rounds);
+  MLMicroSeconds jsonTime = MainLoop::now()-t;
+  t = MainLoop::now();
+  double localSum = simulatedNotifications(ApiValuePtr(new LocalApiValue), rounds);
+  MLMicroSeconds localTime = MainLoop::now()-t;
+  ApiValuePtr res = aRequest->newApiValue();
+  res->setType(apivalue_object);
+  res->add("rounds", res->newInt64(rounds));
+  res->add("identical", res->newBool(jsonSum==localSum));
+  res->add("jsonSeconds", res->newDouble((double)jsonTime/Second));
+  res->add("localSeconds", res->newDouble((double)localTime/Second));
+  LOG(LOG_NOTICE,
+    "ApiValue benchmark: %d scene calls+channel sets, JSON: %.3f mS, local: %.3f mS",
+    rounds, (double)jsonTime/MilliSecond, (double)localTime/MilliSecond
+  );
+  aRequest->sendResult(res);
+  return ErrorPtr();
+}
+
+#endif // ENABLE_LOCAL_APIVALUE
@@ -0,0 +1,146 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__localapivalue__
+#define __p44vdc__localapivalue__
+
+#include "p44vdc_common.hpp"
+
+#ifndef ENABLE_LOCAL_APIVALUE
+  #define ENABLE_LOCAL_APIVALUE 1
+#endif
+
+#if ENABLE_LOCAL_APIVALUE
+
+#include "vdcapi.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  #define LOCALAPIVALUE_INLINE_FIELDS 8 // object fields/array elements stored without extra allocation
+  #define LOCALAPIVALUE_POOL_SIZE 64 // max number of released values kept for reuse
+
+  class LocalApiValue;
+  typedef boost::intrusive_ptr<LocalApiValue> LocalApiValuePtr;
+
+  /// Compact, typed implementation of ApiValue for in-process use, such as notifications
+  /// generated by the local controller or scripts.
+  /// - scalars are stored natively (no JSON object behind them)
+  /// - object keys are interned, so objects only store a pointer per key
+  /// - small objects and arrays (up to LOCALAPIVALUE_INLINE_FIELDS entries) store their members inline
+  /// - released values are recycled from a small pool instead of going back to the heap
+  /// Cross-assignment into JSON or protobuf values (via operator=, JsonApiValue::getAsJson() etc.)
+  /// only happens when a value actually leaves the process.
+  /// @note the recycling pool is not thread safe, LocalApiValues must only be used from the mainloop thread
+  class LocalApiValue : public ApiValue
+  {
+    typedef ApiValue inherited;
+
+    typedef struct {
+      const string *key; ///< interned key, NULL for array elements
+      LocalApiValuePtr value;
+    } Field;
+    typedef std::vector<Field> FieldVector;
+
+    // the actual storage
+    ApiValueType mStoredType; ///< type of the scalar in mScalar
+    union {
+      bool boolVal;
+      uint64_t uint64Val;
+      int64_t int64Val;
+      double doubleVal;
+    } mScalar;
+    string mString; ///< for strings and binary values
+    Field mFields[LOCALAPIVALUE_INLINE_FIELDS]; ///< first fields or array elements
+    size_t mNumFields; ///< total number of fields or array elements
+    FieldVector *mMoreFieldsP; ///< fields beyond LOCALAPIVALUE_INLINE_FIELDS, NULL if none
+    size_t mKeyIterator;
+
+    Field &fieldAt(size_t aIndex) { return aIndex<LOCALAPIVALUE_INLINE_FIELDS ? mFields[aIndex] : (*mMoreFieldsP)[aIndex-LOCALAPIVALUE_INLINE_FIELDS]; };
+    void appendField(const string *aKey, LocalApiValuePtr aValue);
+    ssize_t fieldIndex(const string &aKey);
+    LocalApiValuePtr localValue(ApiValuePtr aObj);
+    void setScalarType(ApiValueType aType);
+
+    // not copyable memberwise (children would be shared, mMoreFieldsP deleted twice), use operator=(ApiValue&)
+    LocalApiValue(const LocalApiValue &);
+    LocalApiValue& operator=(const LocalApiValue &);
+
+  public:
+
+    LocalApiValue();
+    virtual ~LocalApiValue();
+
+    /// @name recycling of instances
+    /// @{
+    static void* operator new(size_t aSize);
+    static void operator delete(void* aPtr, size_t aSize);
+    /// @}
+
+    /// @return interned key string. Interned keys are never freed.
+    /// @param aKey the key to intern
+    static const string *internKey(const string &aKey);
+
+    virtual ApiValuePtr newValue(ApiValueType aObjectType) P44_OVERRIDE;
+
+    virtual void clear() P44_OVERRIDE;
+    virtual void operator=(ApiValue &aApiValue) P44_OVERRIDE;
+
+    virtual void add(const string &aKey, ApiValuePtr aObj) P44_OVERRIDE;
+    virtual ApiValuePtr get(const string &aKey) P44_OVERRIDE;
+    virtual void del(const string &aKey) P44_OVERRIDE;
+    virtual int arrayLength() P44_OVERRIDE;
+    virtual void arrayAppend(ApiValuePtr aObj) P44_OVERRIDE;
+    virtual ApiValuePtr arrayGet(int aAtIndex) P44_OVERRIDE;
+    virtual void arrayPut(int aAtIndex, ApiValuePtr aObj) P44_OVERRIDE;
+    virtual bool resetKeyIteration() P44_OVERRIDE;
+    virtual bool nextKeyValue(string &aKey, ApiValuePtr &aValue) P44_OVERRIDE;
+
+    virtual uint64_t uint64Value() P44_OVERRIDE;
+    virtual int64_t int64Value() P44_OVERRIDE;
+    virtual double doubleValue() P44_OVERRIDE;
+    virtual bool boolValue() P44_OVERRIDE;
+    virtual string binaryValue() P44_OVERRIDE;
+    virtual string stringValue() P44_OVERRIDE;
+    virtual size_t stringLength() P44_OVERRIDE;
+
+    virtual void setUint64Value(uint64_t aUint64) P44_OVERRIDE;
+    virtual void setInt64Value(int64_t aInt64) P44_OVERRIDE;
+    virtual void setDoubleValue(double aDouble) P44_OVERRIDE;
+    virtual void setBoolValue(bool aBool) P44_OVERRIDE;
+    virtual void setBinaryValue(const string &aBinary) P44_OVERRIDE;
+    virtual bool setStringValue(const string &aString) P44_OVERRIDE;
+
+    /// compare building and evaluating internal notification parameters as JsonApiValue and as LocalApiValue
+    /// @param aRequest the API request to answer with the results
+    /// @param aParams the parameters:
+    ///   - rounds: number of simulated notifications per variant (default 10000)
+    static ErrorPtr benchmark(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_LOCAL_APIVALUE
+#endif // __p44vdc__localapivalue__
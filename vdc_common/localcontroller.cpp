@@ -30,6 +30,7 @@
 #include "localcontroller.hpp"
 
 #include "jsonvdcapi.hpp"
+#include "localapivalue.hpp"
 
 #include "outputbehaviour.hpp"
 #include "buttonbehaviour.hpp"
@@ -43,6 +44,19 @@
 using namespace p44;
 
 
+/// @return new empty object for the parameters of notifications generated and delivered within vdcd
+static ApiValuePtr newNotificationParams()
+{
+  #if ENABLE_LOCAL_APIVALUE
+  ApiValuePtr params = ApiValuePtr(new LocalApiValue); // never leaves the process, no JSON needed
+  #else
+  ApiValuePtr params = ApiValuePtr(new JsonApiValue);
+  #endif
+  params->setType(apivalue_object);
+  return params;
+}
+
+
 // MARK: - ZoneState
 
 ZoneState::ZoneState() :
@@ -934,6 +948,8 @@ Trigger::Trigger() :
   mConditionMet(undefined)
 {
   mValueMapper.isMemberVariable();
+  mEvalStats = new ValueSubscriberStats;
+  mValueMapper.setSubscriberStats(mEvalStats); // subscribe to value sources via dependency index
   mTriggerContext = mTriggerCondition.domain()->newContext(); // common context for condition and action
   mTriggerContext->registerMemberLookup(&mValueMapper); // allow context to access the mapped values
   mTriggerCondition.setSharedMainContext(mTriggerContext);
@@ -961,11 +977,21 @@ void Trigger::parseVarDefs()
   }
   else if (LocalController::sharedLocalController()->mDevicesReady) {
     // do not run checks (and fire triggers too early) before devices are reported initialized
+    updateEventFiltering();
     mTriggerCondition.compileAndInit();
   }
 }
 
 
+void Trigger::updateEventFiltering()
+{
+  // only trigger modes that act on changes of the condition result can skip evaluations
+  // for value source events that cannot change the result
+  TriggerMode m = mTriggerCondition.getTriggerMode();
+  mEvalStats->mFilterEvents = m==onGettingTrue || m==onChange || m==onChangingBoolRisingHoldoffOnly;
+}
+
+
 void Trigger::processGlobalEvent(VdchostEvent aActivity)
 {
   if (aActivity==vdchost_devices_initialized) {
@@ -1083,6 +1109,15 @@ void Trigger::testTriggerActionExecuted(VdcApiRequestPtr aRequest, ScriptObjPtr
 }
 
 
+void Trigger::getEvaluationStats(ApiValuePtr aStats, bool aReset)
+{
+  aStats->add("id", aStats->newInt64(mTriggerId));
+  aStats->add("name", aStats->newString(mName));
+  mEvalStats->getStatistics(aStats);
+  if (aReset) mEvalStats->reset();
+}
+
+
 void Trigger::stopActions()
 {
   mTriggerContext->abort(stopall, new ErrorValue(ScriptError::Aborted, "trigger action stopped"));
@@ -1208,6 +1243,7 @@ enum {
   triggerAction_key,
   triggerActionId_key,
   logLevelOffset_key,
+  evalStats_key,
   numTriggerProperties
 };
 
@@ -1233,6 +1269,7 @@ PropertyDescriptorPtr Trigger::getDescriptorByIndex(int aPropIndex, int aDomain,
     { "action", apivalue_string, triggerAction_key, OKEY(trigger_key) },
     { "actionId", apivalue_string, triggerActionId_key, OKEY(trigger_key) },
     { "logLevelOffset", apivalue_int64, logLevelOffset_key, OKEY(trigger_key) },
+    { "evalStats", apivalue_null, evalStats_key, OKEY(trigger_key) },
   };
   if (aParentDescriptor->isRootOfObject()) {
     // root level property of this object hierarchy
@@ -1256,6 +1293,10 @@ bool Trigger::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
         case triggerAction_key: aPropValue->setStringValue(mTriggerAction.getSource()); return true;
         case triggerActionId_key: aPropValue->setStringValue(mTriggerAction.getSourceUid()); return true;
         case logLevelOffset_key: aPropValue->setInt32Value(getLocalLogLevelOffset()); return true;
+        case evalStats_key:
+          aPropValue->setType(apivalue_object);
+          mEvalStats->getStatistics(aPropValue);
+          return true;
       }
     }
     else {
@@ -1278,6 +1319,7 @@ bool Trigger::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
           return true;
         case triggerMode_key:
           if (mTriggerCondition.setTriggerMode(TriggerMode(aPropValue->int32Value()), true)) {
+            updateEventFiltering();
             markDirty();
           }
           return true;
@@ -1545,8 +1587,7 @@ bool LocalController::processSensorChange(SensorBehaviour &aSensorBehaviour, dou
   // deliver the channel change
   NotificationAudience audience;
   mVdcHost.addToAudienceByZoneAndGroup(audience, zoneID, group);
-  JsonApiValuePtr params = JsonApiValuePtr(new JsonApiValue);
-  params->setType(apivalue_object);
+  ApiValuePtr params = newNotificationParams();
   // - define audience
   params->add("zone_id", params->newUint64(zoneID));
   params->add("group", params->newUint64(group));
@@ -1744,8 +1785,7 @@ bool LocalController::processButtonClick(ButtonBehaviour &aButtonBehaviour)
     // deliver other notification types
     NotificationAudience audience;
     mVdcHost.addToAudienceByZoneAndGroup(audience, zoneID, group);
-    JsonApiValuePtr params = JsonApiValuePtr(new JsonApiValue);
-    params->setType(apivalue_object);
+    ApiValuePtr params = newNotificationParams();
     string method;
     // - define audience
     params->add("zone_id", params->newUint64(zoneID));
@@ -1790,8 +1830,7 @@ void LocalController::callScene(SceneNo aSceneNo, DsZoneID aZone, DsGroup aGroup
 
 void LocalController::callScene(SceneNo aSceneNo, NotificationAudience &aAudience, MLMicroSeconds aTransitionTimeOverride, bool aForce)
 {
-  JsonApiValuePtr params = JsonApiValuePtr(new JsonApiValue);
-  params->setType(apivalue_object);
+  ApiValuePtr params = newNotificationParams();
   // { "notification":"callScene", "zone_id":0, "group":1, "scene":5, "force":false }
   // Note: we don't need the zone/group params, these are defined by the audience already
   string method = "callScene";
@@ -1815,8 +1854,7 @@ void LocalController::setOutputChannelValues(DsZoneID aZone, DsGroup aGroup, str
 
 void LocalController::setOutputChannelValues(NotificationAudience &aAudience, string aChannelId, double aValue, MLMicroSeconds aTransitionTimeOverride)
 {
-  JsonApiValuePtr params = JsonApiValuePtr(new JsonApiValue);
-  params->setType(apivalue_object);
+  ApiValuePtr params = newNotificationParams();
   // { "notification":"setOutputChannelValue", "zone_id":0, "group":1, "value":50, "channelId":"brightness", "transitionTime":20 }
   string method = "setOutputChannelValue";
   params->add("value", params->newDouble(aValue));
@@ -2149,6 +2187,39 @@ bool LocalController::handleLocalControllerMethod(ErrorPtr &aError, VdcApiReques
     }
     return true;
   }
+  else if (aMethod=="x-p44-triggerStats") {
+    // condition evaluation statistics for one or all triggers
+    bool reset = false;
+    ApiValuePtr o = aParams->get("reset");
+    if (o) reset = o->boolValue();
+    ApiValuePtr result = aRequest->newApiValue();
+    result->setType(apivalue_object);
+    o = aParams->get("triggerID");
+    if (o) {
+      TriggerPtr trig = mLocalTriggers.getTrigger(o->int32Value());
+      if (!trig) {
+        aError = WebError::webErr(400, "Trigger %d not found", o->int32Value());
+        return true;
+      }
+      trig->getEvaluationStats(result, reset);
+    }
+    else {
+      ApiValuePtr triggers = result->newArray();
+      for (TriggerList::TriggersVector::iterator pos = mLocalTriggers.mTriggers.begin(); pos!=mLocalTriggers.mTriggers.end(); ++pos) {
+        ApiValuePtr t = triggers->newObject();
+        (*pos)->getEvaluationStats(t, reset);
+        triggers->arrayAppend(t);
+      }
+      result->add("triggers", triggers);
+      // value source dependency index
+      ApiValuePtr sources = result->newObject();
+      ValueDependencyIndex::sharedIndex().getInfo(sources);
+      result->add("sources", sources);
+    }
+    aRequest->sendResult(result);
+    aError.reset(); // make sure we don't send an extra ErrorOK
+    return true;
+  }
   else {
     return false; // unknown at the localController level
   }
@@ -2386,8 +2457,7 @@ static void savescene_func(BuiltinFunctionContextPtr f)
   // save the scene
   NotificationAudience audience;
   VdcHost::sharedVdcHost()->addToAudienceByZoneAndGroup(audience, zoneid, group);
-  JsonApiValuePtr params = JsonApiValuePtr(new JsonApiValue);
-  params->setType(apivalue_object);
+  ApiValuePtr params = newNotificationParams();
   // { "notification":"saveScene", "zone_id":0, "group":1, "scene":5 }
   string method = "saveScene";
   params->add("scene", params->newUint64(sceneNo));
@@ -365,6 +365,7 @@ namespace p44 {
     ValueSourceMapper mValueMapper;
     MLTicket mVarParseTicket;
     Tristate mConditionMet;
+    ValueSubscriberStatsPtr mEvalStats; ///< condition evaluation statistics
 
   public:
 
@@ -391,6 +392,11 @@ namespace p44 {
     ErrorPtr handleCheckCondition(VdcApiRequestPtr aRequest);
     ErrorPtr handleTestActions(VdcApiRequestPtr aRequest, ScriptObjPtr aTriggerParam);
 
+    /// get condition evaluation statistics
+    /// @param aStats API object to add trigger id, name and statistics to
+    /// @param aReset if set, statistics are reset after reading
+    void getEvaluationStats(ApiValuePtr aStats, bool aReset);
+
     /// @return name (usually user-defined) of the context object
     virtual string contextName() const P44_OVERRIDE { return mName; }
 
@@ -419,6 +425,7 @@ namespace p44 {
   private:
 
     void parseVarDefs();
+    void updateEventFiltering();
 
     void handleTrigger(ScriptObjPtr aResult);
     void executeTriggerAction();
@@ -0,0 +1,196 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "metrics.hpp"
+
+#if ENABLE_METRICS
+
+using namespace p44;
+
+
+// MARK: - MetricsHistogram
+
+const MLMicroSeconds MetricsHistogram::cBucketLimits[METRICS_HISTOGRAM_BUCKETS] = {
+  100, 250, 500,
+  1*MilliSecond, 2500, 5*MilliSecond,
+  10*MilliSecond, 25*MilliSecond, 50*MilliSecond,
+  100*MilliSecond, 250*MilliSecond, 500*MilliSecond,
+  1*Second, 2500*MilliSecond, 10*Second
+};
+
+
+MetricsHistogram::MetricsHistogram()
+{
+  reset();
+}
+
+
+void MetricsHistogram::reset()
+{
+  for (int i=0; i<=METRICS_HISTOGRAM_BUCKETS; i++) mBuckets[i] = 0;
+  mCount = 0;
+  mSum = 0;
+  mMax = 0;
+}
+
+
+void MetricsHistogram::record(MLMicroSeconds aDuration)
+{
+  int i = 0;
+  while (i<METRICS_HISTOGRAM_BUCKETS && aDuration>cBucketLimits[i]) i++;
+  mBuckets[i]++;
+  mCount++;
+  mSum += aDuration;
+  if (aDuration>mMax) mMax = aDuration;
+}
+
+
+// MARK: - Metrics
+
+static Metrics *sharedMetricsP = NULL;
+
+Metrics &Metrics::sharedMetrics()
+{
+  if (!sharedMetricsP) {
+    sharedMetricsP = new Metrics();
+  }
+  return *sharedMetricsP;
+}
+
+
+Metrics::Metrics() :
+  mStarted(MainLoop::now())
+{
+}
+
+
+void Metrics::reset()
+{
+  for (CounterMap::iterator pos = mCounters.begin(); pos!=mCounters.end(); ++pos) pos->second.mCount = 0;
+  for (GaugeMap::iterator pos = mGauges.begin(); pos!=mGauges.end(); ++pos) pos->second.mPeak = pos->second.mValue;
+  for (HistogramMap::iterator pos = mHistograms.begin(); pos!=mHistograms.end(); ++pos) pos->second.reset();
+  mStarted = MainLoop::now();
+}
+
+
+void Metrics::getMetrics(ApiValuePtr aApiObject)
+{
+  aApiObject->add("collectingSince", aApiObject->newDouble((double)(MainLoop::now()-mStarted)/Second));
+  ApiValuePtr o = aApiObject->newObject();
+  for (CounterMap::iterator pos = mCounters.begin(); pos!=mCounters.end(); ++pos) {
+    o->add(pos->first, o->newUint64(pos->second.mCount));
+  }
+  aApiObject->add("counters", o);
+  o = aApiObject->newObject();
+  for (GaugeMap::iterator pos = mGauges.begin(); pos!=mGauges.end(); ++pos) {
+    ApiValuePtr g = o->newObject();
+    g->add("value", g->newInt64(pos->second.mValue));
+    g->add("peak", g->newInt64(pos->second.mPeak));
+    o->add(pos->first, g);
+  }
+  aApiObject->add("gauges", o);
+  o = aApiObject->newObject();
+  for (HistogramMap::iterator pos = mHistograms.begin(); pos!=mHistograms.end(); ++pos) {
+    const MetricsHistogram &hist = pos->second;
+    ApiValuePtr h = o->newObject();
+    h->add("count", h->newUint64(hist.mCount));
+    h->add("sum", h->newDouble((double)hist.mSum/Second));
+    h->add("max", h->newDouble((double)hist.mMax/Second));
+    if (hist.mCount>0) h->add("avg", h->newDouble((double)hist.mSum/hist.mCount/Second));
+    // buckets as le:count pairs (cumulative, like in the text format)
+    ApiValuePtr b = h->newObject();
+    uint64_t cumulated = 0;
+    for (int i=0; i<METRICS_HISTOGRAM_BUCKETS; i++) {
+      cumulated += hist.mBuckets[i];
+      b->add(string_format("%g", (double)MetricsHistogram::cBucketLimits[i]/Second), b->newUint64(cumulated));
+    }
+    h->add("buckets", b);
+    o->add(pos->first, h);
+  }
+  aApiObject->add("histograms", o);
+}
+
+
+/// split metric name into base name and label part (with braces, or empty if none)
+static void splitName(const string &aName, string &aBaseName, string &aLabels)
+{
+  size_t i = aName.find('{');
+  if (i==string::npos) {
+    aBaseName = aName;
+    aLabels.clear();
+  }
+  else {
+    aBaseName = aName.substr(0, i);
+    aLabels = aName.substr(i);
+  }
+}
+
+
+/// add an extra label to a label part
+static string withLabel(const string &aLabels, const string aExtraLabel)
+{
+  if (aLabels.empty()) return "{" + aExtraLabel + "}";
+  return aLabels.substr(0, aLabels.size()-1) + "," + aExtraLabel + "}";
+}
+
+
+string Metrics::metricsText()
+{
+  string t;
+  string base, labels, lastBase;
+  for (CounterMap::iterator pos = mCounters.begin(); pos!=mCounters.end(); ++pos) {
+    splitName(pos->first, base, labels);
+    if (base!=lastBase) string_format_append(t, "# TYPE p44_%s counter\n", base.c_str());
+    lastBase = base;
+    string_format_append(t, "p44_%s%s %llu\n", base.c_str(), labels.c_str(), (unsigned long long)pos->second.mCount);
+  }
+  lastBase.clear();
+  for (GaugeMap::iterator pos = mGauges.begin(); pos!=mGauges.end(); ++pos) {
+    splitName(pos->first, base, labels);
+    if (base!=lastBase) string_format_append(t, "# TYPE p44_%s gauge\n", base.c_str());
+    lastBase = base;
+    string_format_append(t, "p44_%s%s %lld\n", base.c_str(), labels.c_str(), (long long)pos->second.mValue);
+  }
+  lastBase.clear();
+  for (HistogramMap::iterator pos = mHistograms.begin(); pos!=mHistograms.end(); ++pos) {
+    const MetricsHistogram &hist = pos->second;
+    splitName(pos->first, base, labels);
+    if (base!=lastBase) string_format_append(t, "# TYPE p44_%s histogram\n", base.c_str());
+    lastBase = base;
+    uint64_t cumulated = 0;
+    for (int i=0; i<METRICS_HISTOGRAM_BUCKETS; i++) {
+      cumulated += hist.mBuckets[i];
+      string_format_append(t, "p44_%s_bucket%s %llu\n",
+        base.c_str(),
+        withLabel(labels, string_format("le=\"%g\"", (double)MetricsHistogram::cBucketLimits[i]/Second)).c_str(),
+        (unsigned long long)cumulated
+      );
+    }
+    string_format_append(t, "p44_%s_bucket%s %llu\n", base.c_str(), withLabel(labels, "le=\"+Inf\"").c_str(), (unsigned long long)hist.mCount);
+    string_format_append(t, "p44_%s_sum%s %g\n", base.c_str(), labels.c_str(), (double)hist.mSum/Second);
+    string_format_append(t, "p44_%s_count%s %llu\n", base.c_str(), labels.c_str(), (unsigned long long)hist.mCount);
+  }
+  return t;
+}
+
+#endif // ENABLE_METRICS
@@ -0,0 +1,150 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__metrics__
+#define __p44vdc__metrics__
+
+#include "p44vdc_common.hpp"
+
+#ifndef ENABLE_METRICS
+  #define ENABLE_METRICS 1
+#endif
+
+#if ENABLE_METRICS
+
+#include "apivalue.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// a monotonically increasing counter
+  class MetricsCounter
+  {
+  public:
+    uint64_t mCount;
+
+    MetricsCounter() : mCount(0) {};
+    void inc(uint64_t aBy = 1) { mCount += aBy; };
+  };
+
+
+  /// a value that can go up and down (such as a queue depth), with its peak value
+  class MetricsGauge
+  {
+  public:
+    int64_t mValue;
+    int64_t mPeak; ///< highest value seen since last reset
+
+    MetricsGauge() : mValue(0), mPeak(0) {};
+    void set(int64_t aValue) { mValue = aValue; if (aValue>mPeak) mPeak = aValue; };
+  };
+
+
+  /// number of finite buckets of a MetricsHistogram (there is an additional +Inf bucket)
+  #define METRICS_HISTOGRAM_BUCKETS 15
+
+  /// a latency histogram with fixed buckets from 100µS to 10S
+  class MetricsHistogram
+  {
+  public:
+    static const MLMicroSeconds cBucketLimits[METRICS_HISTOGRAM_BUCKETS]; ///< upper (inclusive) limits of the buckets
+    uint64_t mBuckets[METRICS_HISTOGRAM_BUCKETS+1]; ///< NOT cumulative counts per bucket, last is +Inf
+    uint64_t mCount; ///< number of recorded durations
+    MLMicroSeconds mSum; ///< sum of recorded durations
+    MLMicroSeconds mMax; ///< longest recorded duration
+
+    MetricsHistogram();
+
+    /// record a duration
+    /// @param aDuration the duration to record
+    void record(MLMicroSeconds aDuration);
+
+    /// reset to empty state
+    void reset();
+  };
+
+
+  /// registry of all runtime metrics of the vdc host
+  /// @note metric names follow the prometheus conventions and may include labels,
+  ///   such as `vdc_delivery_seconds{vdc="DALI_Bus_Container"}`
+  /// @note metrics objects are never deleted, so references returned by counter(), gauge() and histogram()
+  ///   can be kept by instrumentation points to avoid repeated lookups
+  class Metrics
+  {
+    typedef std::map<string, MetricsCounter> CounterMap;
+    typedef std::map<string, MetricsGauge> GaugeMap;
+    typedef std::map<string, MetricsHistogram> HistogramMap;
+
+    CounterMap mCounters;
+    GaugeMap mGauges;
+    HistogramMap mHistograms;
+    MLMicroSeconds mStarted; ///< when collecting metrics started (or was reset last time)
+
+    Metrics();
+
+  public:
+
+    static Metrics &sharedMetrics();
+
+    /// @param aName name of the metric
+    /// @return counter with the given name, created if not existing before
+    MetricsCounter &counter(const string aName) { return mCounters[aName]; };
+
+    /// @param aName name of the metric
+    /// @return gauge with the given name, created if not existing before
+    MetricsGauge &gauge(const string aName) { return mGauges[aName]; };
+
+    /// @param aName name of the metric
+    /// @return histogram with the given name, created if not existing before
+    MetricsHistogram &histogram(const string aName) { return mHistograms[aName]; };
+
+    /// reset all counters, peaks and histograms
+    void reset();
+
+    /// get all metrics as API values
+    /// @param aApiObject API object to add the metrics to
+    void getMetrics(ApiValuePtr aApiObject);
+
+    /// @return all metrics in plain text format (prometheus text exposition format)
+    string metricsText();
+
+  };
+
+} // namespace p44
+
+/// count an event in a counter with a constant name
+#define METRICS_COUNT(name) { static MetricsCounter &m_ = Metrics::sharedMetrics().counter(name); m_.inc(); }
+/// record a duration in a histogram with a constant name
+#define METRICS_RECORD(name, duration) { static MetricsHistogram &m_ = Metrics::sharedMetrics().histogram(name); m_.record(duration); }
+/// set the value of a gauge with a constant name
+#define METRICS_GAUGE(name, value) { static MetricsGauge &m_ = Metrics::sharedMetrics().gauge(name); m_.set(value); }
+
+#else // ENABLE_METRICS
+
+#define METRICS_COUNT(name)
+#define METRICS_RECORD(name, duration)
+#define METRICS_GAUGE(name, value)
+
+#endif // ENABLE_METRICS
+#endif // __p44vdc__metrics__
@@ -318,6 +318,14 @@ bool OutputBehaviour::pushOutputState(bool aDS, bool aBridges)
 {
   bool requestedPushDone = true;
 
+  #if ENABLE_STATE_JOURNAL
+  if (aDS || aBridges) {
+    // record in journal, for clients that were not connected at the time of the push
+    // Note: only channelStates, so repeated pushes during transitions coalesce into a single journal entry
+    mDevice.getVdcHost().getStateJournal().recordChange(mDevice.getDsUid(), "channelStates");
+  }
+  #endif
+
   if (aDS && mDevice.isPublicDS()) {
     // TODO: remove and re-enable dead code below, should dS-vDC-API ever evolve to allow this
     requestedPushDone = false;
@@ -24,6 +24,7 @@
 
 #include "vdc.hpp"
 #include "device.hpp"
+#include "metrics.hpp"
 
 #include "jsonvdcapi.hpp"
 
@@ -535,6 +536,14 @@ void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError,
         return;
       }
       #endif // P44SCRIPT_REGISTERED_SOURCE
+      #if ENABLE_METRICS
+      else if (apiselector=="metrics") {
+        // plain text metrics for scraping by monitoring tools
+        // Note: not logged to avoid log noise from periodic scraping
+        aJsonComm->sendRaw(Metrics::sharedMetrics().metricsText());
+        return;
+      }
+      #endif // ENABLE_METRICS
       #if ENABLE_LEGACY_P44CFGAPI
       else if (apiselector=="p44") {
         // process p44 specific requests
@@ -705,6 +714,32 @@ void P44VdcHost::sendJsonApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResul
 }
 
 
+#if ENABLE_JSON_TEXT_ENCODER
+
+void P44VdcHost::sendJsonApiResult(JsonCommPtr aJsonComm, ApiValuePtr aResult, string aReqId, P44LoggingObj& aLoggingObj)
+{
+  // encode result of any API value type directly into message text, no conversion to JsonObject needed
+  string msg = "{\"result\":";
+  JsonTextEncoder::appendApiValue(msg, aResult);
+  sendJsonApiResultText(aJsonComm, msg, aReqId, aLoggingObj);
+}
+
+
+void P44VdcHost::sendJsonApiResultText(JsonCommPtr aJsonComm, string &aMsg, const string &aReqId, P44LoggingObj& aLoggingObj)
+{
+  if (!aReqId.empty()) {
+    aMsg += ",\"id\":";
+    JsonTextEncoder::appendString(aMsg, aReqId);
+  }
+  aMsg += "}";
+  SOLOG(aLoggingObj, LOG_INFO, "sending response: %s", aMsg.c_str());
+  aMsg += "\n"; // message terminator
+  aJsonComm->sendRaw(aMsg);
+}
+
+#endif // ENABLE_JSON_TEXT_ENCODER
+
+
 // access to vdc API methods and notifications via web requests or bridge API
 ErrorPtr P44VdcHost::processVdcRequest(VdcApiConnectionPtr aApi, JsonCommPtr aJsonComm, JsonObjectPtr aRequest, string &aReqId, bool aConfirmNotifications)
 {
@@ -733,6 +768,9 @@ ErrorPtr P44VdcHost::processVdcRequest(VdcApiConnectionPtr aApi, JsonCommPtr aJs
     // get params
     // Note: the "method" or "notification" param will also be in the params, but should not cause any problem
     ApiValuePtr params = JsonApiValue::newValueFromJson(aRequest);
+    #if ENABLE_API_TRACE
+    getApiTraceRecorder().record(aApi, isMethod, cmd, params);
+    #endif
     P44JsonApiRequestPtr request = P44JsonApiRequestPtr(new P44JsonApiRequest(aJsonComm, aApi, aReqId));
     if (isMethod) {
       // create request
@@ -808,6 +846,10 @@ VdcApiConnectionPtr P44JsonApiRequest::connection()
 ErrorPtr P44JsonApiRequest::sendResult(ApiValuePtr aResult)
 {
   POLOG(mJsonApi, LOG_INFO, "sending result: %s", aResult ? aResult->description().c_str() : "<none>");
+  #if ENABLE_JSON_TEXT_ENCODER
+  // Note: JSON APIs always return SOMETHING as result, a missing result is encoded as null
+  P44VdcHost::sendJsonApiResult(mJsonComm, aResult, mRequestId, *mJsonApi);
+  #else
   JsonApiValuePtr result = boost::dynamic_pointer_cast<JsonApiValue>(aResult);
   if (result) {
     P44VdcHost::sendJsonApiResponse(mJsonComm, result->jsonObject(), ErrorPtr(), mRequestId, *mJsonApi);
@@ -816,6 +858,7 @@ ErrorPtr P44JsonApiRequest::sendResult(ApiValuePtr aResult)
     // JSON APIs: always return SOMETHING as result
     P44VdcHost::sendJsonApiResponse(mJsonComm, JsonObject::newNull(), ErrorPtr(), mRequestId, *mJsonApi);
   }
+  #endif // ENABLE_JSON_TEXT_ENCODER
   return ErrorPtr();
 }
 
@@ -26,6 +26,7 @@
 #include "vdchost.hpp"
 
 #include "jsoncomm.hpp"
+#include "jsonencoder.hpp"
 
 #ifndef ENABLE_JSONCFGAPI
   // by default, we have _either_ ubus _or_ json config API, depending on ENABLE_UBUS
@@ -511,6 +512,10 @@ namespace p44 {
 
     #if ENABLE_JSONCFGAPI || ENABLE_JSONBRIDGEAPI
     static void sendJsonApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult, ErrorPtr aError, string aRequestIdP, P44LoggingObj& aLoggingObj);
+    #if ENABLE_JSON_TEXT_ENCODER
+    /// send result of any API value type, encoded directly as JSON text
+    static void sendJsonApiResult(JsonCommPtr aJsonComm, ApiValuePtr aResult, string aRequestId, P44LoggingObj& aLoggingObj);
+    #endif
     #endif
 
     /// get logging object for a named topic
@@ -530,6 +535,9 @@ namespace p44 {
     #if ENABLE_JSONCFGAPI || ENABLE_JSONBRIDGEAPI
     void configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError, JsonObjectPtr aJsonObject);
     ErrorPtr processVdcRequest(VdcApiConnectionPtr aApi, JsonCommPtr aJsonComm, JsonObjectPtr aRequest, string &aReqId, bool aConfirmNotifications);
+    #if ENABLE_JSON_TEXT_ENCODER
+    static void sendJsonApiResultText(JsonCommPtr aJsonComm, string &aMsg, const string &aReqId, P44LoggingObj& aLoggingObj);
+    #endif
     #endif
 
     #if ENABLE_JSONCFGAPI
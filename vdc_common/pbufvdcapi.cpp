@@ -950,11 +950,20 @@ void PbufApiValue::putValueIntoPropVal(Vdcapi__PropertyValue &aPropVal)
 
 // MARK: - VdcPbufApiServer
 
+// default max size of messages reassembled from continuation frames
+#define DEFAULT_MAX_CHUNKED_MESSAGE_SIZE (1024*1024)
+
+
+VdcPbufApiServer::VdcPbufApiServer() :
+  mMaxMessageSize(DEFAULT_MAX_CHUNKED_MESSAGE_SIZE)
+{
+}
+
 
 VdcApiConnectionPtr VdcPbufApiServer::newConnection()
 {
   // create the right kind of API connection
-  return VdcApiConnectionPtr(static_cast<VdcApiConnection *>(new VdcPbufApiConnection()));
+  return VdcApiConnectionPtr(static_cast<VdcApiConnection *>(new VdcPbufApiConnection(mMaxMessageSize)));
 }
 
 
@@ -985,6 +994,7 @@ VdcApiConnectionPtr VdcPbufApiRequest::connection()
 
 ErrorPtr VdcPbufApiRequest::sendResult(ApiValuePtr aResult)
 {
+  answered();
   ErrorPtr err;
   if (!aResult || aResult->isNull()) {
     // empty result is like sending no error
@@ -1043,6 +1053,7 @@ ErrorPtr VdcPbufApiRequest::sendResult(ApiValuePtr aResult)
 
 ErrorPtr VdcPbufApiRequest::sendError(ErrorPtr aError)
 {
+  answered();
   ErrorPtr err;
   if (!aError) {
     aError = Error::ok();
@@ -1079,9 +1090,12 @@ ErrorPtr VdcPbufApiRequest::sendError(ErrorPtr aError)
 // MARK: - VdcPbufApiConnection
 
 
-VdcPbufApiConnection::VdcPbufApiConnection() :
+VdcPbufApiConnection::VdcPbufApiConnection(size_t aMaxMessageSize) :
   mCloseWhenSent(false),
   mExpectedMsgBytes(0),
+  mContinued(false),
+  mMaxMessageSize(aMaxMessageSize),
+  mChunking(false),
   mRequestIdCounter(0)
 {
   mSocketComm = SocketCommPtr(new SocketComm(MainLoop::currentMainLoop()));
@@ -1090,8 +1104,10 @@ VdcPbufApiConnection::VdcPbufApiConnection() :
 }
 
 
-// max message size accepted - everything bigger must be an error
+// max frame size accepted - everything bigger must be an error
 #define MAX_DATA_SIZE 16384
+// length header flag for continuation frames (chunking extension)
+#define CONTINUED_FRAME_FLAG 0x8000
 
 
 void VdcPbufApiConnection::gotData(ErrorPtr aError)
@@ -1103,52 +1119,77 @@ void VdcPbufApiConnection::gotData(ErrorPtr aError)
     DBGFOCUSLOG("gotData: numBytesReady()=%d", dataSz);
     // read data we've got so far
     if (dataSz>0) {
-      // temporary buffer
-      uint8_t *buf = new uint8_t[dataSz];
-      size_t receivedBytes = mSocketComm->receiveBytes(dataSz, buf, aError);
+      // receive directly into the receive buffer
+      size_t oldSz = mReceivedMessage.size();
+      mReceivedMessage.resize(oldSz+dataSz);
+      size_t receivedBytes = mSocketComm->receiveBytes(dataSz, (uint8_t *)&mReceivedMessage[oldSz], aError);
       DBGFOCUSLOG("gotData: receiveBytes(%d)=%d", dataSz, receivedBytes);
-      DBGFOCUSLOG("gotData: before appending: receivedMessage.size()=%d", receivedMessage.size());
+      mReceivedMessage.resize(oldSz+(Error::isOK(aError) ? receivedBytes : 0));
       if (Error::isOK(aError)) {
-        // append to receive buffer
-        mReceivedMessage.append((const char *)buf, receivedBytes);
-        DBGFOCUSLOG("gotData: after appending: receivedMessage.size()=%d", receivedMessage.size());
-        // single message extraction
+        // frame extraction, processed bytes are only removed from the buffer at the end
+        size_t pos = 0;
         while(true) {
-          DBGFOCUSLOG("gotData: processing loop beginning, expectedMsgBytes=%d", expectedMsgBytes);
-          if(mExpectedMsgBytes==0 && mReceivedMessage.size()>=2) {
+          DBGFOCUSLOG("gotData: processing loop beginning, expectedMsgBytes=%d", mExpectedMsgBytes);
+          if(mExpectedMsgBytes==0 && mReceivedMessage.size()-pos>=2) {
             // got 2-byte length header, decode it
-            const uint8_t *sz = (const uint8_t *)mReceivedMessage.c_str();
-            mExpectedMsgBytes =
-              (sz[0]<<8) +
-              sz[1];
-            mReceivedMessage.erase(0,2);
-            FOCUSLOG("gotData: parsed new header, now expectedMsgBytes=%d", expectedMsgBytes);
-            DBGFOCUSLOG("gotData: after removing header: receivedMessage.size()=%d", receivedMessage.size());
+            const uint8_t *sz = (const uint8_t *)mReceivedMessage.data()+pos;
+            uint16_t hdr = (sz[0]<<8) + sz[1];
+            pos += 2;
+            if (hdr==0) {
+              // empty frame: peer offers chunking extension
+              if (!mChunking) {
+                mChunking = true;
+                LOG(LOG_INFO, "%s: peer negotiated chunking of large messages", apiName());
+                // confirm with empty frame
+                static const uint8_t emptyFrame[2] = { 0, 0 };
+                aError = transmitFrames(emptyFrame, 2);
+                if (Error::notOK(aError)) break;
+              }
+              continue;
+            }
+            mContinued = mChunking && (hdr & CONTINUED_FRAME_FLAG)!=0;
+            mExpectedMsgBytes = mChunking ? hdr & ~CONTINUED_FRAME_FLAG : hdr;
+            FOCUSLOG("gotData: parsed new header, now expectedMsgBytes=%d%s", mExpectedMsgBytes, mContinued ? " (continued)" : "");
             if (mExpectedMsgBytes>MAX_DATA_SIZE) {
               aError = Error::err<VdcApiError>(413, "message exceeds maximum length of 16kB");
               break;
             }
+            if (mAssembledMessage.size()+mExpectedMsgBytes>mMaxMessageSize) {
+              aError = Error::err<VdcApiError>(413, "chunked message exceeds maximum length of %zu bytes", mMaxMessageSize);
+              break;
+            }
           }
-          // check for complete message
-          if (mExpectedMsgBytes && (mReceivedMessage.size()>=mExpectedMsgBytes)) {
-            FOCUSLOG("gotData: receivedMessage.size()=%d >= expectedMsgBytes=%d -> process", receivedMessage.size(), expectedMsgBytes);
-            // process message
-            aError = processMessage((uint8_t *)mReceivedMessage.c_str(),mExpectedMsgBytes);
-            // erase processed message
-            mReceivedMessage.erase(0,mExpectedMsgBytes);
-            DBGFOCUSLOG("gotData: after removing message: receivedMessage.size()=%d", receivedMessage.size());
+          // check for complete frame
+          if (mExpectedMsgBytes && (mReceivedMessage.size()-pos>=mExpectedMsgBytes)) {
+            FOCUSLOG("gotData: received %zu bytes >= expectedMsgBytes=%d -> process", mReceivedMessage.size()-pos, mExpectedMsgBytes);
+            const uint8_t *frame = (const uint8_t *)mReceivedMessage.data()+pos;
+            if (mContinued || !mAssembledMessage.empty()) {
+              // part of a chunked message, collect
+              mAssembledMessage.append((const char *)frame, mExpectedMsgBytes);
+              if (!mContinued) {
+                // final frame, process reassembled message
+                FOCUSLOG("gotData: reassembled chunked message of %zu bytes", mAssembledMessage.size());
+                aError = processMessage((const uint8_t *)mAssembledMessage.data(), mAssembledMessage.size());
+                mAssembledMessage.clear();
+              }
+            }
+            else {
+              // process single frame message in place
+              aError = processMessage(frame, mExpectedMsgBytes);
+            }
+            pos += mExpectedMsgBytes;
             mExpectedMsgBytes = 0; // reset to unknown
-            // repeat evaluation with remaining bytes (could be another message)
+            // repeat evaluation with remaining bytes (could be another frame)
           }
           else {
-            // no complete message yet, done for now
+            // no complete frame yet, done for now
             break;
           }
         }
-        DBGFOCUSLOG("gotData: end of processing loop: receivedMessage.size()=%d", receivedMessage.size());
+        // remove processed bytes
+        mReceivedMessage.erase(0, pos);
+        DBGFOCUSLOG("gotData: end of processing loop: receivedMessage.size()=%d", mReceivedMessage.size());
       }
-      // forget buffer
-      delete[] buf; buf = NULL;
     } // some data seems to be ready
   } // no connection error
   if (Error::notOK(aError)) {
@@ -1168,6 +1209,18 @@ ErrorPtr VdcPbufApiConnection::sendMessage(const Vdcapi__Message *aVdcApiMessage
     protobufMessagePrint(stdout, &aVdcApiMessage->base, 0);
   }
   #endif
+  if (mChunking) {
+    // pack directly into frames, sending each as soon as it is full
+    FramePacker packer;
+    packer.base.append = &VdcPbufApiConnection::framePackerAppend;
+    packer.connection = this;
+    packer.frame.reserve(MAX_DATA_SIZE+2);
+    packer.frame.assign(2, 0); // room for header
+    vdcapi__message__pack_to_buffer(aVdcApiMessage, &packer.base);
+    // - send final frame
+    sendFrame(packer, false);
+    return packer.err;
+  }
   // generate the binary message
   size_t packedSize = vdcapi__message__get_packed_size(aVdcApiMessage);
   uint8_t *packedMsg = new uint8_t[packedSize+2]; // leave room for header
@@ -1179,21 +1232,62 @@ ErrorPtr VdcPbufApiConnection::sendMessage(const Vdcapi__Message *aVdcApiMessage
   // - adjust the total message length
   packedSize += 2;
   // send the message
+  err = transmitFrames(packedMsg, packedSize);
+  // return the buffer
+  delete[] packedMsg;
+  // done
+  return err;
+}
+
+
+void VdcPbufApiConnection::framePackerAppend(ProtobufCBuffer *aBuffer, size_t aLen, const uint8_t *aData)
+{
+  FramePacker *packer = (FramePacker *)aBuffer;
+  while (aLen>0) {
+    if (packer->frame.size()>=MAX_DATA_SIZE+2) {
+      // frame is full and more data follows: send as continuation frame
+      packer->connection->sendFrame(*packer, true);
+    }
+    size_t n = MAX_DATA_SIZE+2-packer->frame.size();
+    if (n>aLen) n = aLen;
+    packer->frame.append((const char *)aData, n);
+    aData += n;
+    aLen -= n;
+  }
+}
+
+
+void VdcPbufApiConnection::sendFrame(FramePacker &aPacker, bool aContinued)
+{
+  size_t payloadSize = aPacker.frame.size()-2;
+  uint16_t hdr = payloadSize | (aContinued ? CONTINUED_FRAME_FLAG : 0);
+  aPacker.frame[0] = (hdr>>8) & 0xFF;
+  aPacker.frame[1] = hdr & 0xFF;
+  if (Error::isOK(aPacker.err)) {
+    aPacker.err = transmitFrames((const uint8_t *)aPacker.frame.data(), aPacker.frame.size());
+  }
+  aPacker.frame.resize(2); // keep room for next header
+}
+
+
+ErrorPtr VdcPbufApiConnection::transmitFrames(const uint8_t *aFrames, size_t aSize)
+{
+  ErrorPtr err;
   if (mTransmitBuffer.size()>0) {
     // other messages are already waiting, append entire message
-    mTransmitBuffer.append((const char *)packedMsg, packedSize);
+    mTransmitBuffer.append((const char *)aFrames, aSize);
   }
   else {
     // nothing in buffer yet, start new send
-    size_t sentBytes = mSocketComm->transmitBytes(packedSize, packedMsg, err);
+    size_t sentBytes = mSocketComm->transmitBytes(aSize, aFrames, err);
     if (Error::isOK(err)) {
       // check if all could be sent
-      if (sentBytes<packedSize) {
+      if (sentBytes<aSize) {
         // Not everything (or maybe nothing, transmitBytes() can return 0) was sent
         // - enable callback for ready-for-send
         mSocketComm->setTransmitHandler(boost::bind(&VdcPbufApiConnection::canSendData, this, _1));
         // buffer the rest, canSendData handler will take care of writing it out
-        mTransmitBuffer.assign((char *)packedMsg+sentBytes, packedSize-sentBytes);
+        mTransmitBuffer.assign((const char *)aFrames+sentBytes, aSize-sentBytes);
       }
 			else {
 				// all sent
@@ -1202,9 +1296,6 @@ ErrorPtr VdcPbufApiConnection::sendMessage(const Vdcapi__Message *aVdcApiMessage
 			}
     }
   }
-  // return the buffer
-  delete[] packedMsg;
-  // done
   return err;
 }
 
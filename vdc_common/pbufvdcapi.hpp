@@ -164,6 +164,17 @@ namespace p44 {
   {
     typedef VdcApiServer inherited;
 
+    size_t mMaxMessageSize; ///< max size of messages reassembled from continuation frames
+
+  public:
+
+    VdcPbufApiServer();
+
+    /// set upper bound for messages reassembled from continuation frames (chunking extension)
+    /// @param aMaxMessageSize max size of reassembled messages in bytes
+    /// @note single frames are always limited to 16kB, this only applies to peers that have negotiated chunking
+    void setMaxMessageSize(size_t aMaxMessageSize) { mMaxMessageSize = aMaxMessageSize; };
+
   protected:
 
     /// create API connection of correct type for this API server
@@ -220,6 +231,11 @@ namespace p44 {
 
 
   /// Protocol buffer specific implementation of VdcApiConnection
+  /// @note Messages are sent as frames with a 2-byte big endian length header, max 16kB each.
+  ///   Peers can negotiate the chunking extension by sending an empty frame (length 0, which is
+  ///   ignored by implementations not supporting it). The vdc confirms with an empty frame as well.
+  ///   From then on, in both directions, messages larger than 16kB are split into continuation frames,
+  ///   which have bit 15 of the length header set, followed by a final frame without it.
   class VdcPbufApiConnection : public VdcApiConnection
   {
     typedef VdcApiConnection inherited;
@@ -229,13 +245,25 @@ namespace p44 {
     SocketCommPtr mSocketComm;
 
     // receiving
-    uint32_t mExpectedMsgBytes; ///< number of bytes expected of next message
-    string mReceivedMessage; ///< accumulated message bytes, including 4-byte length header
+    uint32_t mExpectedMsgBytes; ///< number of bytes expected of next frame
+    bool mContinued; ///< frame being received is followed by a continuation frame
+    string mReceivedMessage; ///< received bytes not yet processed, starting with a 2-byte length header
+    string mAssembledMessage; ///< message being reassembled from continuation frames
+    size_t mMaxMessageSize; ///< max size of reassembled messages
+    bool mChunking; ///< set when peer has negotiated the chunking extension
 
     // sending
     string mTransmitBuffer; ///< binary buffer for data to be sent
     bool mCloseWhenSent;
 
+    /// protobuf-c output buffer packing directly into frames
+    typedef struct {
+      ProtobufCBuffer base; ///< protobuf-c buffer, must be first
+      VdcPbufApiConnection *connection;
+      string frame; ///< frame being packed, including the 2-byte header
+      ErrorPtr err;
+    } FramePacker;
+
     // pending requests
     int32_t mRequestIdCounter;
     typedef map<int32_t, VdcApiResponseCB> PendingAnswerMap;
@@ -243,7 +271,9 @@ namespace p44 {
 
   public:
 
-    VdcPbufApiConnection();
+    /// create pbuf API connection
+    /// @param aMaxMessageSize max size of messages reassembled from continuation frames
+    VdcPbufApiConnection(size_t aMaxMessageSize);
 
     /// The underlying socket connection
     /// @return socket connection
@@ -271,6 +301,9 @@ namespace p44 {
 
     ErrorPtr processMessage(const uint8_t *aPackedMessageP, size_t aPackedMessageSize);
     ErrorPtr sendMessage(const Vdcapi__Message *aVdcApiMessage);
+    ErrorPtr transmitFrames(const uint8_t *aFrames, size_t aSize);
+    static void framePackerAppend(ProtobufCBuffer *aBuffer, size_t aLen, const uint8_t *aData);
+    void sendFrame(FramePacker &aPacker, bool aContinued);
 
     static ErrorCode pbufToInternalError(Vdcapi__ResultCode aVdcApiResultCode);
     static Vdcapi__ResultCode internalToPbufError(ErrorCode aErrorCode);
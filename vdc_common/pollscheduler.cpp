@@ -0,0 +1,317 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// File scope debugging options
+// - Set ALWAYS_DEBUG to 1 to enable DBGLOG output even in non-DEBUG builds of this file
+#define ALWAYS_DEBUG 0
+// - set FOCUSLOGLEVEL to non-zero log level (usually, 5,6, or 7==LOG_DEBUG) to get focus (extensive logging) for this file
+//   Note: must be before including "logger.hpp" (or anything that includes "logger.hpp")
+#define FOCUSLOGLEVEL 0
+
+#include "pollscheduler.hpp"
+
+#if ENABLE_POLL_SCHEDULER
+
+using namespace p44;
+
+#define DEFAULT_MAX_CONCURRENT_POLLS 8 // max polls running at the same time in total
+#define DEFAULT_ENDPOINT_CONCURRENCY 2 // max polls running at the same time per endpoint
+#define POLL_TIMEOUT (60*Second) // poll not reported done within this time is considered failed
+#define POLL_JITTER 0.1 // +/- 10% random variation of intervals, to keep clients from polling in lockstep
+#define POLL_INTERVAL_GROWTH 1.5 // factor applied to interval after a poll without changes
+#define MAX_FAILURE_BACKOFF 10 // max multiple of max interval for retrying failed polls
+
+
+// MARK: - PollClient
+
+PollClient::PollClient(PollScheduler &aScheduler, const string aName, const string aEndpoint, MLMicroSeconds aMinInterval, MLMicroSeconds aMaxInterval, PollCB aPollCB) :
+  mScheduler(aScheduler),
+  mName(aName),
+  mEndpoint(aEndpoint),
+  mPollCB(aPollCB),
+  mMinInterval(aMinInterval),
+  mMaxInterval(aMaxInterval<aMinInterval ? aMinInterval : aMaxInterval),
+  mInterval(aMinInterval),
+  mDue(Never),
+  mStartedAt(Never),
+  mPollId(0),
+  mRegistered(true),
+  mConsecutiveFailures(0),
+  mPolls(0),
+  mChanges(0),
+  mFailures(0),
+  mSkipped(0),
+  mLatencySum(0),
+  mMaxLatency(0),
+  mDelaySum(0)
+{
+}
+
+
+void PollClient::pollDone(PollResult aResult, uint32_t aPollId)
+{
+  if (!isPolling()) return; // late answer of a timed out poll, or not registered any more
+  if (aPollId!=0 && aPollId!=mPollId) return; // late answer of a timed out poll, while the next one is already running
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds latency = now-mStartedAt;
+  mPolls++;
+  mLatencySum += latency;
+  if (latency>mMaxLatency) mMaxLatency = latency;
+  #if ENABLE_METRICS
+  mScheduler.endpoint(mEndpoint).latencyMetric->record(latency);
+  #endif
+  mScheduler.endPoll(*this);
+  // adapt interval
+  switch (aResult) {
+    case poll_changed:
+      mChanges++;
+      mConsecutiveFailures = 0;
+      mInterval = mMinInterval;
+      break;
+    case poll_unchanged:
+      mConsecutiveFailures = 0;
+      mInterval = mInterval*POLL_INTERVAL_GROWTH;
+      if (mInterval>mMaxInterval) mInterval = mMaxInterval;
+      break;
+    case poll_failed:
+      mFailures++;
+      if (mConsecutiveFailures<MAX_FAILURE_BACKOFF) mConsecutiveFailures++;
+      mInterval = mMaxInterval*mConsecutiveFailures;
+      break;
+  }
+  mDue = now+PollScheduler::jittered(mInterval);
+  FOCUSLOG("poll of '%s' done after %.3f S, result=%d, next in %.1f S", mName.c_str(), (double)latency/Second, aResult, (double)(mDue-now)/Second);
+  mScheduler.triggerSchedule();
+}
+
+
+void PollClient::pollSoon()
+{
+  if (!mRegistered) return;
+  mInterval = mMinInterval;
+  if (!isPolling()) {
+    mDue = MainLoop::now();
+    mScheduler.triggerSchedule();
+  }
+}
+
+
+void PollClient::unregister()
+{
+  if (!mRegistered) return;
+  PollClientPtr keepAlive(this); // removing from list might otherwise delete this
+  if (isPolling()) mScheduler.endPoll(*this);
+  mRegistered = false;
+  for (PollScheduler::ClientList::iterator pos = mScheduler.mClients.begin(); pos!=mScheduler.mClients.end(); ++pos) {
+    if (pos->get()==this) {
+      mScheduler.mClients.erase(pos);
+      break;
+    }
+  }
+  mPollCB = NoOP;
+  mScheduler.triggerSchedule(); // budget might be available for others now
+}
+
+
+// MARK: - PollScheduler
+
+PollScheduler::PollScheduler() :
+  mMaxConcurrent(DEFAULT_MAX_CONCURRENT_POLLS),
+  mActive(0),
+  mScheduling(false),
+  mRescheduleNeeded(false)
+{
+}
+
+
+MLMicroSeconds PollScheduler::jittered(MLMicroSeconds aInterval)
+{
+  return aInterval + aInterval*POLL_JITTER*((double)(random()%2001)/1000-1);
+}
+
+
+PollScheduler::EndpointState &PollScheduler::endpoint(const string &aEndpoint)
+{
+  EndpointMap::iterator pos = mEndpoints.find(aEndpoint);
+  if (pos!=mEndpoints.end()) return pos->second;
+  EndpointState &ep = mEndpoints[aEndpoint];
+  ep.maxConcurrent = DEFAULT_ENDPOINT_CONCURRENCY;
+  ep.minSpacing = 0;
+  ep.active = 0;
+  ep.lastStart = Never;
+  ep.deferrals = 0;
+  #if ENABLE_METRICS
+  ep.latencyMetric = &Metrics::sharedMetrics().histogram(string_format("poll_seconds{endpoint=\"%s\"}", aEndpoint.c_str()));
+  #endif
+  return ep;
+}
+
+
+void PollScheduler::setEndpointBudget(const string aEndpoint, int aMaxConcurrent, MLMicroSeconds aMinSpacing)
+{
+  EndpointState &ep = endpoint(aEndpoint);
+  ep.maxConcurrent = aMaxConcurrent>0 ? aMaxConcurrent : 1;
+  ep.minSpacing = aMinSpacing;
+  triggerSchedule();
+}
+
+
+PollClientPtr PollScheduler::registerClient(const string aName, const string aEndpoint, MLMicroSeconds aMinInterval, MLMicroSeconds aMaxInterval, PollCB aPollCB)
+{
+  PollClientPtr client = PollClientPtr(new PollClient(*this, aName, aEndpoint, aMinInterval, aMaxInterval, aPollCB));
+  // spread first polls of clients registered at the same time over their min interval
+  client->mDue = MainLoop::now() + aMinInterval*((double)(random()%1000)/1000);
+  endpoint(aEndpoint); // make sure endpoint exists
+  mClients.push_back(client);
+  LOG(LOG_INFO, "poll scheduler: registered '%s' on endpoint '%s', interval %.1f..%.1f S", aName.c_str(), aEndpoint.c_str(), (double)aMinInterval/Second, (double)aMaxInterval/Second);
+  triggerSchedule();
+  return client;
+}
+
+
+void PollScheduler::triggerSchedule()
+{
+  if (mScheduling) {
+    mRescheduleNeeded = true;
+    return;
+  }
+  mScheduleTicket.executeOnce(boost::bind(&PollScheduler::schedule, this));
+}
+
+
+void PollScheduler::endPoll(PollClient &aClient)
+{
+  EndpointState &ep = endpoint(aClient.mEndpoint);
+  if (ep.active>0) ep.active--;
+  if (mActive>0) mActive--;
+  aClient.mStartedAt = Never;
+}
+
+
+void PollScheduler::schedule()
+{
+  mScheduleTicket.cancel();
+  mScheduling = true;
+  mRescheduleNeeded = false;
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds next = Infinite;
+  std::vector<PollClientPtr> toStart;
+  for (ClientList::iterator pos = mClients.begin(); pos!=mClients.end(); ++pos) {
+    PollClient &c = **pos;
+    if (c.isPolling()) {
+      if (now<c.mStartedAt+POLL_TIMEOUT) {
+        if (c.mStartedAt+POLL_TIMEOUT<next) next = c.mStartedAt+POLL_TIMEOUT;
+        continue;
+      }
+      LOG(LOG_WARNING, "poll scheduler: poll of '%s' did not complete within %lld seconds", c.mName.c_str(), (long long)(POLL_TIMEOUT/Second));
+      c.pollDone(poll_failed);
+    }
+    if (c.mDue>now) {
+      if (c.mDue<next) next = c.mDue;
+      continue;
+    }
+    // due, check budgets
+    EndpointState &ep = endpoint(c.mEndpoint);
+    MLMicroSeconds earliest = ep.lastStart==Never ? now : ep.lastStart+ep.minSpacing;
+    if (mActive>=mMaxConcurrent || ep.active>=ep.maxConcurrent || earliest>now) {
+      // budget exhausted: end of a running poll will trigger scheduling again, spacing needs a timer
+      ep.deferrals++;
+      if (earliest>now && earliest<next) next = earliest;
+      continue;
+    }
+    // start it (accounted right now, so budgets are correct for the rest of this run)
+    ep.active++;
+    ep.lastStart = now;
+    mActive++;
+    c.mStartedAt = now;
+    if (++c.mPollId==0) c.mPollId = 1; // 0 is reserved for "current poll"
+    toStart.push_back(*pos);
+  }
+  // now actually start polls (outside the client list iteration, callbacks might register or unregister clients)
+  for (std::vector<PollClientPtr>::iterator pos = toStart.begin(); pos!=toStart.end(); ++pos) {
+    startPoll(*pos, now);
+  }
+  mScheduling = false;
+  if (mRescheduleNeeded) next = now;
+  if (next!=Infinite) {
+    mScheduleTicket.executeOnce(boost::bind(&PollScheduler::schedule, this), next>now ? next-now : 0);
+  }
+}
+
+
+void PollScheduler::startPoll(PollClientPtr aClient, MLMicroSeconds aNow)
+{
+  if (!aClient->mRegistered || !aClient->isPolling()) return; // unregistered in the meantime
+  MLMicroSeconds delay = aNow-aClient->mDue;
+  aClient->mDelaySum += delay;
+  if (delay>aClient->mInterval) {
+    // entire poll periods were missed
+    uint64_t missed = delay/aClient->mInterval;
+    aClient->mSkipped += missed;
+    #if ENABLE_METRICS
+    Metrics::sharedMetrics().counter("polls_skipped_total").inc(missed);
+    #endif
+  }
+  FOCUSLOG("poll scheduler: polling '%s' (%.3f S late)", aClient->mName.c_str(), (double)delay/Second);
+  aClient->mPollCB();
+}
+
+
+void PollScheduler::getStats(ApiValuePtr aResult)
+{
+  aResult->add("maxConcurrent", aResult->newInt64(mMaxConcurrent));
+  aResult->add("active", aResult->newInt64(mActive));
+  ApiValuePtr eps = aResult->newObject();
+  for (EndpointMap::iterator pos = mEndpoints.begin(); pos!=mEndpoints.end(); ++pos) {
+    ApiValuePtr ep = eps->newObject();
+    ep->add("maxConcurrent", ep->newInt64(pos->second.maxConcurrent));
+    ep->add("minSpacing", ep->newDouble((double)pos->second.minSpacing/Second));
+    ep->add("active", ep->newInt64(pos->second.active));
+    ep->add("deferrals", ep->newUint64(pos->second.deferrals));
+    eps->add(pos->first, ep);
+  }
+  aResult->add("endpoints", eps);
+  ApiValuePtr clients = aResult->newArray();
+  MLMicroSeconds now = MainLoop::now();
+  for (ClientList::iterator pos = mClients.begin(); pos!=mClients.end(); ++pos) {
+    PollClient &c = **pos;
+    ApiValuePtr cl = clients->newObject();
+    cl->add("name", cl->newString(c.mName));
+    cl->add("endpoint", cl->newString(c.mEndpoint));
+    cl->add("interval", cl->newDouble((double)c.mInterval/Second));
+    cl->add("nextIn", cl->newDouble(c.isPolling() ? 0 : (double)(c.mDue-now)/Second));
+    cl->add("polls", cl->newUint64(c.mPolls));
+    cl->add("changes", cl->newUint64(c.mChanges));
+    cl->add("failures", cl->newUint64(c.mFailures));
+    cl->add("skipped", cl->newUint64(c.mSkipped));
+    if (c.mPolls>0) {
+      cl->add("avgLatency", cl->newDouble((double)c.mLatencySum/c.mPolls/Second));
+      cl->add("maxLatency", cl->newDouble((double)c.mMaxLatency/Second));
+      cl->add("avgDelay", cl->newDouble((double)c.mDelaySum/c.mPolls/Second));
+    }
+    clients->arrayAppend(cl);
+  }
+  aResult->add("clients", clients);
+}
+
+#endif // ENABLE_POLL_SCHEDULER
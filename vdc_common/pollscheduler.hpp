@@ -0,0 +1,182 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__pollscheduler__
+#define __p44vdc__pollscheduler__
+
+#include "p44vdc_common.hpp"
+
+#ifndef ENABLE_POLL_SCHEDULER
+  #define ENABLE_POLL_SCHEDULER 1
+#endif
+
+#if ENABLE_POLL_SCHEDULER
+
+#include "apivalue.hpp"
+#include "metrics.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  class PollScheduler;
+  class PollClient;
+  typedef boost::intrusive_ptr<PollClient> PollClientPtr;
+
+  /// outcome of a poll, determines the next poll interval
+  typedef enum {
+    poll_unchanged, ///< polled values were same as before, interval will grow towards max interval
+    poll_changed, ///< polled values have changed, interval drops to min interval
+    poll_failed ///< poll failed, retry with increasing backoff
+  } PollResult;
+
+  /// callback to perform a poll. Must call PollClient::pollDone() when poll is complete (can be called from within the callback)
+  typedef boost::function<void ()> PollCB;
+
+
+  /// a device (or other entity) registered with the poll scheduler
+  class PollClient : public P44Obj
+  {
+    friend class PollScheduler;
+
+    PollScheduler &mScheduler;
+    string mName; ///< name for statistics and logging
+    string mEndpoint; ///< the endpoint (host, gateway, bus) polled, for concurrency and rate budgets
+    PollCB mPollCB;
+    MLMicroSeconds mMinInterval; ///< interval used after changes
+    MLMicroSeconds mMaxInterval; ///< interval approached while values are stable
+    MLMicroSeconds mInterval; ///< current adaptive interval
+    MLMicroSeconds mDue; ///< when next poll is due
+    MLMicroSeconds mStartedAt; ///< when running poll was started, Never if not polling
+    uint32_t mPollId; ///< id of the running (or last) poll
+    bool mRegistered;
+    int mConsecutiveFailures;
+
+    // statistics
+    uint64_t mPolls; ///< number of completed polls
+    uint64_t mChanges; ///< number of polls that found changes
+    uint64_t mFailures; ///< number of failed or timed out polls
+    uint64_t mSkipped; ///< number of poll periods missed (previous poll still running or endpoint budget exhausted)
+    MLMicroSeconds mLatencySum; ///< sum of poll durations
+    MLMicroSeconds mMaxLatency; ///< longest poll duration
+    MLMicroSeconds mDelaySum; ///< sum of delays between due time and actual start of polls
+
+    PollClient(PollScheduler &aScheduler, const string aName, const string aEndpoint, MLMicroSeconds aMinInterval, MLMicroSeconds aMaxInterval, PollCB aPollCB);
+
+  public:
+
+    /// report completion of a poll
+    /// @param aResult outcome of the poll
+    /// @param aPollId id of the poll being reported (as returned by pollId() when the poll was started),
+    ///   0 for the currently running poll. Late answers of polls that have timed out in the meantime are ignored.
+    void pollDone(PollResult aResult, uint32_t aPollId = 0);
+
+    /// @return id of the currently running poll, to be passed to pollDone() by clients polling asynchronously
+    uint32_t pollId() const { return mPollId; };
+
+    /// request a poll as soon as the budgets allow (e.g. after an action that is likely to change polled values)
+    void pollSoon();
+
+    /// unregister from scheduler, must be called before the object the poll callback refers to is deleted
+    void unregister();
+
+    /// @return true if a poll is currently running
+    bool isPolling() const { return mStartedAt!=Never; };
+
+    /// @return current (adaptive) poll interval
+    MLMicroSeconds currentInterval() const { return mInterval; };
+  };
+
+
+  /// Central scheduler for polled devices.
+  /// Clients register with a min and max interval and the endpoint they are polling. The scheduler
+  /// spreads the poll phases with jitter, adapts intervals (min after changes, growing towards max
+  /// while stable) and limits concurrency and rate of polls per endpoint and in total.
+  class PollScheduler
+  {
+    friend class PollClient;
+
+    typedef struct {
+      int maxConcurrent; ///< max number of concurrently running polls
+      MLMicroSeconds minSpacing; ///< min time between starting two polls
+      int active; ///< currently running polls
+      MLMicroSeconds lastStart; ///< when last poll was started
+      uint64_t deferrals; ///< number of times a poll had to wait for the budget
+      #if ENABLE_METRICS
+      MetricsHistogram *latencyMetric;
+      #endif
+    } EndpointState;
+    typedef std::map<string, EndpointState> EndpointMap;
+    typedef std::list<PollClientPtr> ClientList;
+
+    ClientList mClients;
+    EndpointMap mEndpoints;
+    int mMaxConcurrent; ///< max number of concurrently running polls in total
+    int mActive; ///< total number of running polls
+    MLTicket mScheduleTicket;
+    bool mScheduling; ///< set while schedule() runs
+    bool mRescheduleNeeded; ///< set when schedule() must run again immediately
+
+  public:
+
+    PollScheduler();
+
+    /// register a client for polling
+    /// @param aName name for statistics and logging, usually the device's short description
+    /// @param aEndpoint identifies the endpoint being polled (such as the host name or the gateway), all clients
+    ///   with the same endpoint share the endpoint's concurrency and rate budget
+    /// @param aMinInterval poll interval used after values have changed
+    /// @param aMaxInterval poll interval approached while values are stable
+    /// @param aPollCB called to perform the poll. Must call pollDone() on the returned client when done.
+    /// @return the client object, owner must call unregister() on it before it goes away
+    /// @note first poll will be scheduled at a random time within aMinInterval to spread the poll phases
+    PollClientPtr registerClient(const string aName, const string aEndpoint, MLMicroSeconds aMinInterval, MLMicroSeconds aMaxInterval, PollCB aPollCB);
+
+    /// set budget for an endpoint
+    /// @param aEndpoint the endpoint
+    /// @param aMaxConcurrent max number of polls running at the same time on this endpoint
+    /// @param aMinSpacing min time between starting two polls on this endpoint
+    void setEndpointBudget(const string aEndpoint, int aMaxConcurrent, MLMicroSeconds aMinSpacing);
+
+    /// set max number of polls running at the same time in total
+    void setMaxConcurrent(int aMaxConcurrent) { mMaxConcurrent = aMaxConcurrent; };
+
+    /// get statistics
+    /// @param aResult API object to add statistics to
+    void getStats(ApiValuePtr aResult);
+
+  private:
+
+    EndpointState &endpoint(const string &aEndpoint);
+    void triggerSchedule();
+    void schedule();
+    void startPoll(PollClientPtr aClient, MLMicroSeconds aNow);
+    void endPoll(PollClient &aClient);
+    static MLMicroSeconds jittered(MLMicroSeconds aInterval);
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_POLL_SCHEDULER
+#endif // __p44vdc__pollscheduler__
@@ -0,0 +1,162 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// File scope debugging options
+// - Set ALWAYS_DEBUG to 1 to enable DBGLOG output even in non-DEBUG builds of this file
+#define ALWAYS_DEBUG 0
+// - set FOCUSLOGLEVEL to non-zero log level (usually, 5,6, or 7==LOG_DEBUG) to get focus (extensive logging) for this file
+//   Note: must be before including "logger.hpp" (or anything that includes "logger.hpp")
+#define FOCUSLOGLEVEL 0
+
+#include "settingsfileindex.hpp"
+
+#if ENABLE_SETTINGS_FROM_FILES
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace p44;
+
+#define SETTINGS_INDEX_RECHECK_INTERVAL (3*Second) // how often the index is validated against the file system
+
+
+SettingsFileIndex::SettingsFileIndex() :
+  mDirMTime(0),
+  mLastCheck(Never)
+{
+}
+
+
+void SettingsFileIndex::invalidate()
+{
+  mFiles.clear();
+  mDirMTime = 0;
+  mLastCheck = Never;
+}
+
+
+void SettingsFileIndex::scan()
+{
+  mFiles.clear();
+  mDirMTime = 0;
+  mLastCheck = MainLoop::now();
+  struct stat st;
+  if (stat(mDir.c_str(), &st)==0) mDirMTime = st.st_mtime;
+  DIR *dir = opendir(mDir.c_str());
+  if (!dir) {
+    if (errno!=ENOENT) LOG(LOG_ERR, "cannot scan settings directory '%s' - %s", mDir.c_str(), strerror(errno));
+    return;
+  }
+  struct dirent *de;
+  while ((de = readdir(dir))!=NULL) {
+    if (de->d_type==DT_DIR) continue;
+    string name = de->d_name;
+    if (name.size()<4 || name.compare(name.size()-4, 4, ".csv")!=0) continue;
+    IndexedFile &f = mFiles[name];
+    f.loaded = false;
+    f.mtime = 0;
+  }
+  closedir(dir);
+  LOG(LOG_INFO, "settings directory '%s' indexed: %zu CSV files", mDir.c_str(), mFiles.size());
+}
+
+
+void SettingsFileIndex::revalidate()
+{
+  mLastCheck = MainLoop::now();
+  struct stat st;
+  if (stat(mDir.c_str(), &st)!=0 || st.st_mtime!=mDirMTime) {
+    // files added, removed or renamed
+    LOG(LOG_INFO, "settings directory '%s' has changed, re-indexing", mDir.c_str());
+    scan();
+    return;
+  }
+  // check already read files for modifications
+  for (IndexedFilesMap::iterator pos = mFiles.begin(); pos!=mFiles.end(); ++pos) {
+    if (!pos->second.loaded) continue;
+    if (stat((mDir+pos->first).c_str(), &st)!=0 || st.st_mtime!=pos->second.mtime) {
+      FOCUSLOG("settings file '%s' has changed, will be re-read", pos->first.c_str());
+      pos->second.loaded = false;
+      pos->second.lines.clear();
+    }
+  }
+}
+
+
+bool SettingsFileIndex::readFile(const string &aName, IndexedFile &aFile)
+{
+  string fn = mDir+aName;
+  FILE *file = fopen(fn.c_str(), "r");
+  if (!file) {
+    int syserr = errno;
+    if (syserr!=ENOENT) {
+      // file not existing is ok (could have been deleted since scan), all other errors must be reported
+      LOG(LOG_ERR, "failed opening file %s - %s", fn.c_str(), strerror(syserr));
+    }
+    return false;
+  }
+  struct stat st;
+  aFile.mtime = fstat(fileno(file), &st)==0 ? st.st_mtime : 0;
+  aFile.lines.clear();
+  string line;
+  int lineNo = 0;
+  while (string_fgetline(file, line)) {
+    lineNo++;
+    if (line.empty()) continue;
+    SettingsFileLine l;
+    l.lineNo = lineNo;
+    l.text = line;
+    aFile.lines.push_back(l);
+  }
+  fclose(file);
+  aFile.loaded = true;
+  FOCUSLOG("settings file '%s' read: %zu lines", fn.c_str(), aFile.lines.size());
+  return true;
+}
+
+
+const SettingsFileLines *SettingsFileIndex::fileLines(const string &aFilePath)
+{
+  size_t n = aFilePath.rfind('/');
+  string dir = n==string::npos ? "./" : aFilePath.substr(0, n+1);
+  string name = n==string::npos ? aFilePath : aFilePath.substr(n+1);
+  if (dir!=mDir || mLastCheck==Never) {
+    // (another) directory, index it
+    mDir = dir;
+    scan();
+  }
+  else if (MainLoop::now()>mLastCheck+SETTINGS_INDEX_RECHECK_INTERVAL) {
+    revalidate();
+  }
+  IndexedFilesMap::iterator pos = mFiles.find(name);
+  if (pos==mFiles.end()) return NULL; // no such file
+  if (!pos->second.loaded) {
+    if (!readFile(name, pos->second)) {
+      mFiles.erase(pos);
+      return NULL;
+    }
+  }
+  return &(pos->second.lines);
+}
+
+#endif // ENABLE_SETTINGS_FROM_FILES
@@ -0,0 +1,88 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __p44vdc__settingsfileindex__
+#define __p44vdc__settingsfileindex__
+
+#include "p44vdc_common.hpp"
+
+#if ENABLE_SETTINGS_FROM_FILES
+
+using namespace std;
+
+namespace p44 {
+
+  /// a non-empty line of a settings file
+  typedef struct {
+    int lineNo; ///< line number in the file, for error messages
+    string text; ///< the line's text
+  } SettingsFileLine;
+  typedef std::vector<SettingsFileLine> SettingsFileLines;
+
+
+  /// Index of the CSV settings files in the config directory.
+  /// The directory is scanned once, so looking up the many non-existing per-level files
+  /// does not need any file system access, and every existing file is read only once, no
+  /// matter how many devices, scenes or vdcs apply it.
+  /// @note the index is revalidated (directory and file modification dates checked)
+  ///   at most every few seconds, so changes in the config directory are picked up
+  ///   without an extra stat() per lookup.
+  class SettingsFileIndex
+  {
+    typedef struct {
+      bool loaded; ///< set when lines have been read
+      time_t mtime; ///< modification date of the file when read
+      SettingsFileLines lines; ///< the file's non-empty lines
+    } IndexedFile;
+    typedef std::map<string, IndexedFile> IndexedFilesMap;
+
+    string mDir; ///< the indexed directory, with trailing path delimiter
+    time_t mDirMTime; ///< modification date of the directory when scanned
+    MLMicroSeconds mLastCheck; ///< when index was last validated against the file system
+    IndexedFilesMap mFiles; ///< the CSV files found in the directory
+
+  public:
+
+    SettingsFileIndex();
+
+    /// get the contents of a settings file
+    /// @param aFilePath full path of the CSV file
+    /// @return the non-empty lines of the file, or NULL if the file does not exist.
+    ///   Pointer is valid until next call of fileLines() or invalidate().
+    const SettingsFileLines *fileLines(const string &aFilePath);
+
+    /// forget the index, directory will be re-scanned on next lookup
+    void invalidate();
+
+  private:
+
+    void scan();
+    void revalidate();
+    bool readFile(const string &aName, IndexedFile &aFile);
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_SETTINGS_FROM_FILES
+#endif // __p44vdc__settingsfileindex__
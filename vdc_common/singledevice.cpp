@@ -1029,6 +1029,14 @@ bool DeviceState::pushWithEvents(DeviceEventsList aEventList)
   if (willPushHandler) {
     willPushHandler(DeviceStatePtr(this), aEventList);
   }
+  #if ENABLE_STATE_JOURNAL
+  // record in journal, for clients that were not connected at the time of the push
+  std::vector<string> eventIds;
+  for (DeviceEventsList::iterator pos=aEventList.begin(); pos!=aEventList.end(); ++pos) {
+    eventIds.push_back((*pos)->eventId);
+  }
+  singleDeviceP->getVdcHost().getStateJournal().recordChange(singleDeviceP->getDsUid(), "deviceStates", stateId, -1, &eventIds);
+  #endif
   // try to push to connected vDC API client
   if (api) {
     // create query for state property to get pushed
@@ -1451,6 +1459,10 @@ ValueDescriptorPtr DeviceProperties::getProperty(const string aPropertyId)
 
 bool DeviceProperties::pushProperty(ValueDescriptorPtr aPropertyDesc)
 {
+  #if ENABLE_STATE_JOURNAL
+  // record in journal, for clients that were not connected at the time of the push
+  singleDeviceP->getVdcHost().getStateJournal().recordChange(singleDeviceP->getDsUid(), "deviceProperties", aPropertyDesc->getName());
+  #endif
   // try to push to connected vDC API client
   VdcApiConnectionPtr api = singleDeviceP->getVdcHost().getVdsmSessionConnection();
   if (api) {
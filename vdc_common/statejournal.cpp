@@ -0,0 +1,246 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// File scope debugging options
+// - Set ALWAYS_DEBUG to 1 to enable DBGLOG output even in non-DEBUG builds of this file
+#define ALWAYS_DEBUG 0
+// - set FOCUSLOGLEVEL to non-zero log level (usually, 5,6, or 7==LOG_DEBUG) to get focus (extensive logging) for this file
+//   Note: must be before including "logger.hpp" (or anything that includes "logger.hpp")
+#define FOCUSLOGLEVEL 0
+
+#include "statejournal.hpp"
+
+#if ENABLE_STATE_JOURNAL
+
+#include "vdchost.hpp"
+
+using namespace p44;
+
+#define DEFAULT_STATE_JOURNAL_SIZE 2000 // number of changes kept
+
+
+StateJournal::StateJournal(VdcHost &aVdcHost) :
+  mVdcHost(aVdcHost),
+  mMaxEntries(DEFAULT_STATE_JOURNAL_SIZE),
+  mSeq(0)
+{
+  // sequence numbers are only valid within this instance of the journal
+  mJournalId = string_format("%llx", (long long)MainLoop::mainLoopTimeToUnixTime(MainLoop::now()));
+}
+
+
+void StateJournal::setMaxEntries(size_t aMaxEntries)
+{
+  mMaxEntries = aMaxEntries;
+  while (mEntries.size()>mMaxEntries) mEntries.pop_front();
+}
+
+
+uint64_t StateJournal::recordChange(const DsUid &aDsUid, const string aContainer, const string aItemId, int aItemIndex, const std::vector<string> *aEvents)
+{
+  if (mMaxEntries==0) return mSeq; // journal disabled
+  if (!aEvents || aEvents->empty()) {
+    // repeated change of the same item (e.g. output progress during transitions) just updates the last entry
+    if (!mEntries.empty()) {
+      StateJournalEntry &last = mEntries.back();
+      if (last.mEvents.empty() && last.mDsUid==aDsUid && last.mContainer==aContainer && last.mItemId==aItemId) {
+        last.mSeq = ++mSeq;
+        return mSeq;
+      }
+    }
+  }
+  while (mEntries.size()>=mMaxEntries) mEntries.pop_front();
+  mEntries.push_back(StateJournalEntry());
+  StateJournalEntry &e = mEntries.back();
+  e.mSeq = ++mSeq;
+  e.mDsUid = aDsUid;
+  e.mContainer = aContainer;
+  e.mItemId = aItemId;
+  e.mItemIndex = aItemIndex;
+  if (aEvents) e.mEvents = *aEvents;
+  FOCUSLOG("state journal #%llu: %s %s[%s]", (unsigned long long)e.mSeq, aDsUid.getString().c_str(), aContainer.c_str(), aItemId.c_str());
+  return mSeq;
+}
+
+
+// MARK: - delta resync
+
+namespace p44 {
+
+  /// changes of a single addressable, collected for a delta resync answer
+  class AddressableChanges
+  {
+  public:
+    DsUid mDsUid;
+    uint64_t mLastSeq;
+    ApiValuePtr mQuery;
+    ApiValuePtr mEvents;
+  };
+  typedef std::vector<AddressableChanges> AddressableChangesVector;
+
+  /// state of a running delta resync request
+  class ChangesRequestState : public P44Obj
+  {
+  public:
+    VdcApiRequestPtr mRequest;
+    AddressableChangesVector mChanges;
+    size_t mNext;
+    ApiValuePtr mResult;
+    ApiValuePtr mChangesArray;
+  };
+
+} // namespace p44
+
+
+static void addToQuery(ApiValuePtr aQuery, const StateJournalEntry &aEntry, int aApiVersion)
+{
+  ApiValuePtr c = aQuery->get(aEntry.mContainer);
+  if (c && c->isNull()) return; // entire container already requested
+  if (aEntry.mItemId.empty()) {
+    // entire container
+    aQuery->add(aEntry.mContainer, aQuery->newNull());
+    return;
+  }
+  if (!c) {
+    c = aQuery->newObject();
+    aQuery->add(aEntry.mContainer, c);
+  }
+  // Note: pre-v3 API clients address behaviours by index
+  string id = aApiVersion>=3 || aEntry.mItemIndex<0 ? aEntry.mItemId : string_format("%d", aEntry.mItemIndex);
+  c->add(id, c->newNull());
+}
+
+
+void StateJournal::changesRead(ChangesRequestStatePtr aState, ApiValuePtr aResultObject, ErrorPtr aError)
+{
+  AddressableChanges &ch = aState->mChanges[aState->mNext++];
+  ApiValuePtr c = aState->mChangesArray->newObject();
+  c->add("dSUID", c->newBinary(ch.mDsUid.getBinary()));
+  c->add("seq", c->newUint64(ch.mLastSeq));
+  if (Error::isOK(aError)) {
+    if (aResultObject) c->add("changedproperties", aResultObject);
+  }
+  else {
+    c->add("error", c->newString(aError->text()));
+  }
+  if (ch.mEvents) c->add("deviceevents", ch.mEvents);
+  aState->mChangesArray->arrayAppend(c);
+  readNextChanges(aState);
+}
+
+
+void StateJournal::readNextChanges(ChangesRequestStatePtr aState)
+{
+  while (aState->mNext<aState->mChanges.size()) {
+    AddressableChanges &ch = aState->mChanges[aState->mNext];
+    DsAddressablePtr a = mVdcHost.addressableForDsUid(ch.mDsUid);
+    if (a) {
+      if (ch.mQuery) {
+        VdcApiConnectionPtr conn = aState->mRequest->connection();
+        a->accessProperty(
+          access_read, ch.mQuery, conn ? conn->domain() : VDC_API_DOMAIN, aState->mRequest->getApiVersion(),
+          boost::bind(&StateJournal::changesRead, this, aState, _1, _2)
+        );
+        return;
+      }
+      // events only
+      changesRead(aState, ApiValuePtr(), ErrorPtr());
+      return;
+    }
+    // addressable no longer exists
+    ApiValuePtr c = aState->mChangesArray->newObject();
+    c->add("dSUID", c->newBinary(ch.mDsUid.getBinary()));
+    c->add("seq", c->newUint64(ch.mLastSeq));
+    c->add("gone", c->newBool(true));
+    aState->mChangesArray->arrayAppend(c);
+    aState->mNext++;
+  }
+  // all done
+  aState->mResult->add("changes", aState->mChangesArray);
+  aState->mRequest->sendResult(aState->mResult);
+}
+
+
+void StateJournal::handleChangesRequest(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  ApiValuePtr result = aRequest->newApiValue();
+  result->setType(apivalue_object);
+  result->add("journalId", result->newString(mJournalId));
+  result->add("seq", result->newUint64(mSeq));
+  ApiValuePtr o = aParams->get("since");
+  if (!o) {
+    // just current position, for starting to track changes
+    aRequest->sendResult(result);
+    return;
+  }
+  uint64_t since = o->uint64Value();
+  o = aParams->get("journalId");
+  uint64_t oldestAvailable = mEntries.empty() ? mSeq+1 : mEntries.front().mSeq;
+  if (
+    (o && o->stringValue()!=mJournalId) || // different journal (vdchost restarted)
+    since>mSeq || // not a seq of this journal
+    since+1<oldestAvailable // journal has wrapped, changes lost
+  ) {
+    LOG(LOG_INFO, "state journal: client needs full resync (since=%llu, oldest=%llu, current=%llu)", (unsigned long long)since, (unsigned long long)oldestAvailable, (unsigned long long)mSeq);
+    result->add("fullResync", result->newBool(true));
+    aRequest->sendResult(result);
+    return;
+  }
+  // collect changes per addressable
+  ChangesRequestStatePtr state = new ChangesRequestState;
+  state->mRequest = aRequest;
+  state->mNext = 0;
+  state->mResult = result;
+  state->mChangesArray = result->newArray();
+  std::map<DsUid, size_t> changesIndex;
+  int apiVersion = aRequest->getApiVersion();
+  for (EntryDeque::iterator pos = mEntries.begin(); pos!=mEntries.end(); ++pos) {
+    if (pos->mSeq<=since) continue;
+    std::map<DsUid, size_t>::iterator ci = changesIndex.find(pos->mDsUid);
+    if (ci==changesIndex.end()) {
+      changesIndex[pos->mDsUid] = state->mChanges.size();
+      state->mChanges.push_back(AddressableChanges());
+      state->mChanges.back().mDsUid = pos->mDsUid;
+      ci = changesIndex.find(pos->mDsUid);
+    }
+    AddressableChanges &ch = state->mChanges[ci->second];
+    ch.mLastSeq = pos->mSeq;
+    if (!pos->mContainer.empty()) {
+      if (!ch.mQuery) {
+        ch.mQuery = aRequest->newApiValue();
+        ch.mQuery->setType(apivalue_object);
+      }
+      addToQuery(ch.mQuery, *pos, apiVersion);
+    }
+    for (std::vector<string>::iterator epos = pos->mEvents.begin(); epos!=pos->mEvents.end(); ++epos) {
+      if (!ch.mEvents) {
+        ch.mEvents = aRequest->newApiValue();
+        ch.mEvents->setType(apivalue_object);
+      }
+      ch.mEvents->add(*epos, ch.mEvents->newNull());
+    }
+  }
+  LOG(LOG_INFO, "state journal: delta resync since %llu: %zu addressables changed", (unsigned long long)since, state->mChanges.size());
+  readNextChanges(state);
+}
+
+#endif // ENABLE_STATE_JOURNAL
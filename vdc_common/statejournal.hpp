@@ -0,0 +1,118 @@
+//  SPDX-License-Identifier: GPL-3.0-or-later
+//
+//  Copyright (c) 2026 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44vdc.
+//
+//  p44vdc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44vdc is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44vdc. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44vdc__statejournal__
+#define __p44vdc__statejournal__
+
+#include "p44vdc_common.hpp"
+
+#ifndef ENABLE_STATE_JOURNAL
+  #define ENABLE_STATE_JOURNAL 1
+#endif
+
+#if ENABLE_STATE_JOURNAL
+
+#include "dsuid.hpp"
+#include "vdcapi.hpp"
+
+#include <deque>
+
+using namespace std;
+
+namespace p44 {
+
+  class VdcHost;
+  class ChangesRequestState;
+  typedef boost::intrusive_ptr<ChangesRequestState> ChangesRequestStatePtr;
+
+  /// a single state change as recorded in the journal
+  /// @note the journal does not record values, only *what* has changed. Current values
+  ///   are read when changes are requested, so multiple changes of the same item
+  ///   are transferred only once.
+  class StateJournalEntry
+  {
+  public:
+    uint64_t mSeq; ///< host-wide sequence number of this change
+    DsUid mDsUid; ///< the addressable that has changed
+    string mContainer; ///< the property container, such as "sensorStates" or "deviceProperties"
+    string mItemId; ///< the id of the changed item within the container, empty if entire container has changed
+    int mItemIndex; ///< index of the changed item for pre-v3 API clients, -1 if none
+    std::vector<string> mEvents; ///< device event ids pushed along with the change
+  };
+
+
+  /// bounded in-memory journal of state changes, allowing (re)connecting API clients
+  /// to obtain what has changed since the last change they have seen.
+  class StateJournal
+  {
+    typedef std::deque<StateJournalEntry> EntryDeque;
+
+    VdcHost &mVdcHost;
+    EntryDeque mEntries; ///< the journal, oldest first
+    size_t mMaxEntries; ///< max number of entries
+    uint64_t mSeq; ///< sequence number of the most recent change
+    string mJournalId; ///< identifies this journal instance (changes when vdchost restarts)
+
+  public:
+
+    StateJournal(VdcHost &aVdcHost);
+
+    /// record a state change
+    /// @param aDsUid the addressable that has changed
+    /// @param aContainer the property container that has changed (such as "sensorStates")
+    /// @param aItemId id of the changed item within the container, empty if entire container has changed
+    /// @param aItemIndex index of the changed item for pre-v3 API clients, -1 if none
+    /// @param aEvents the device event ids pushed along with the change, if any
+    /// @return the sequence number of the recorded change
+    uint64_t recordChange(const DsUid &aDsUid, const string aContainer, const string aItemId = "", int aItemIndex = -1, const std::vector<string> *aEvents = NULL);
+
+    /// @return sequence number of the most recent change
+    uint64_t currentSeq() const { return mSeq; };
+
+    /// @return id of this journal instance. Sequence numbers of different journal ids are not comparable.
+    const string &journalId() const { return mJournalId; };
+
+    /// set max journal size
+    /// @param aMaxEntries max number of entries to keep
+    void setMaxEntries(size_t aMaxEntries);
+
+    /// handle API request for changes since a given sequence number
+    /// @param aRequest the request to answer
+    /// @param aParams the parameters:
+    ///   - since: sequence number of last change the client has seen. If missing, only current seq is returned.
+    ///   - journalId: the journal id the since sequence number refers to. If it does not match, a full resync is required.
+    /// @note result contains journalId, seq (to be used as next `since`), and either fullResync=true or
+    ///   a changes array with one entry per changed addressable, containing dSUID, seq,
+    ///   changedproperties and deviceevents in the same format as pushNotification.
+    void handleChangesRequest(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+
+  private:
+
+    void readNextChanges(ChangesRequestStatePtr aState);
+    void changesRead(ChangesRequestStatePtr aState, ApiValuePtr aResultObject, ErrorPtr aError);
+
+  };
+
+} // namespace p44
+
+#endif // ENABLE_STATE_JOURNAL
+#endif // __p44vdc__statejournal__
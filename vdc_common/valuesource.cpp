@@ -39,12 +39,202 @@ ValueSource::ValueSource()
 }
 
 
+ValueSource::~ValueSource()
+{
+  ValueDependencyIndex::sharedIndex().valueSourceDeleted(this);
+}
+
+
 void ValueSource::sendValueEvent()
 {
   if (!hasSinks()) return; // optimisation
   sendEvent(new ValueSourceObj(this));
 }
 
+// MARK: - ValueSubscriberStats
+
+ValueSubscriberStats::ValueSubscriberStats() :
+  mFilterEvents(true)
+{
+  reset();
+}
+
+
+void ValueSubscriberStats::reset()
+{
+  mEventsReceived = 0;
+  mEvaluations = 0;
+  mEvaluationTime = 0;
+  mMaxEvaluationTime = 0;
+  mLastEvaluation = Never;
+}
+
+
+void ValueSubscriberStats::getStatistics(ApiValuePtr aStats)
+{
+  aStats->add("filtered", aStats->newBool(mFilterEvents));
+  aStats->add("events", aStats->newUint64(mEventsReceived));
+  aStats->add("evaluations", aStats->newUint64(mEvaluations));
+  aStats->add("suppressed", aStats->newUint64(mEventsReceived-mEvaluations));
+  aStats->add("totalTime", aStats->newDouble((double)mEvaluationTime/Second));
+  aStats->add("avgTime", aStats->newDouble(mEvaluations>0 ? (double)mEvaluationTime/mEvaluations/Second : 0));
+  aStats->add("maxTime", aStats->newDouble((double)mMaxEvaluationTime/Second));
+  if (mLastEvaluation!=Never) {
+    aStats->add("lastEvaluation", aStats->newDouble((double)MainLoop::mainLoopTimeToUnixTime(mLastEvaluation)/Second));
+  }
+  aStats->add("dependencies", aStats->newUint64(ValueDependencyIndex::sharedIndex().numDependencies(this)));
+}
+
+
+// MARK: - ValueSubscription
+
+/// Events confirming an unchanged value are still forwarded when the previous update is older than this,
+/// because conditions might depend on the source's age.
+#define UNCHANGED_VALUE_AGE_RELEVANCE (30*Second)
+
+ValueSubscription::ValueSubscription(ValueSource* aValueSource, EventSink* aSubscriber, ValueSubscriberStatsPtr aStats) :
+  mValueSource(aValueSource),
+  mSubscriber(aSubscriber),
+  mStats(aStats),
+  mForwarded(false),
+  mLastValue(0),
+  mLastValid(false),
+  mLastOpLevel(-1),
+  mLastUpdate(Never)
+{
+  mValueSource->registerForEvents(this);
+}
+
+
+ValueSubscription::~ValueSubscription()
+{
+}
+
+
+void ValueSubscription::processEvent(ScriptObjPtr aEvent, EventSource &aSource, intptr_t aRegId)
+{
+  if (!hasSinks()) return; // subscriber is gone, will be removed from index later
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds prevUpdate = mLastUpdate;
+  mLastUpdate = mValueSource->getSourceLastUpdate();
+  bool valid = mLastUpdate!=Never;
+  double value = mValueSource->getSourceValue();
+  int opLevel = mValueSource->getSourceOpLevel();
+  mStats->mEventsReceived++;
+  if (
+    mStats->mFilterEvents && mForwarded &&
+    valid==mLastValid && opLevel==mLastOpLevel && (!valid || value==mLastValue) &&
+    prevUpdate!=Never && now-prevUpdate<UNCHANGED_VALUE_AGE_RELEVANCE
+  ) {
+    // nothing the subscriber's evaluation could depend on has changed
+    return;
+  }
+  mForwarded = true;
+  mLastValid = valid;
+  mLastValue = value;
+  mLastOpLevel = opLevel;
+  // forward, which causes (synchronous) evaluation
+  ValueSubscriptionPtr keepMe = this; // evaluation might cause changes in the index
+  ValueSubscriberStatsPtr stats = mStats;
+  sendEvent(aEvent);
+  MLMicroSeconds t = MainLoop::now()-now;
+  stats->mEvaluations++;
+  stats->mEvaluationTime += t;
+  if (t>stats->mMaxEvaluationTime) stats->mMaxEvaluationTime = t;
+  stats->mLastEvaluation = now;
+}
+
+
+// MARK: - ValueDependencyIndex
+
+static ValueDependencyIndex* gValueDependencyIndex = NULL;
+
+ValueDependencyIndex& ValueDependencyIndex::sharedIndex()
+{
+  if (!gValueDependencyIndex) {
+    gValueDependencyIndex = new ValueDependencyIndex; // never deleted, value sources might be deleted late at shutdown
+  }
+  return *gValueDependencyIndex;
+}
+
+
+#define UNUSED_SUBSCRIPTIONS_CLEANUP_DELAY (10*Second)
+
+void ValueDependencyIndex::subscribe(ValueSource* aValueSource, EventSink* aSubscriber, intptr_t aRegId, ValueSubscriberStatsPtr aStats)
+{
+  // Note: subscribing usually happens while events are delivered, so unused subscriptions are removed later
+  if (!mCleanupTicket) {
+    mCleanupTicket.executeOnce(boost::bind(&ValueDependencyIndex::removeUnused, this), UNUSED_SUBSCRIPTIONS_CLEANUP_DELAY);
+  }
+  ValueSubscriptionPtr subscription;
+  pair<SubscriptionsMap::iterator, SubscriptionsMap::iterator> r = mSubscriptions.equal_range(aValueSource);
+  for (SubscriptionsMap::iterator pos = r.first; pos!=r.second; ++pos) {
+    if (pos->second->mSubscriber==aSubscriber) {
+      subscription = pos->second;
+      subscription->mStats = aStats; // in case it has changed
+      break;
+    }
+  }
+  if (!subscription) {
+    subscription = new ValueSubscription(aValueSource, aSubscriber, aStats);
+    mSubscriptions.insert(make_pair(aValueSource, subscription));
+  }
+  subscription->registerForEvents(aSubscriber, aRegId);
+}
+
+
+void ValueDependencyIndex::valueSourceDeleted(ValueSource* aValueSource)
+{
+  mSubscriptions.erase(aValueSource);
+}
+
+
+void ValueDependencyIndex::removeUnused()
+{
+  mCleanupTicket.cancel();
+  SubscriptionsMap::iterator pos = mSubscriptions.begin();
+  while (pos!=mSubscriptions.end()) {
+    if (!pos->second->hasSinks()) {
+      mSubscriptions.erase(pos++);
+    }
+    else {
+      ++pos;
+    }
+  }
+}
+
+
+size_t ValueDependencyIndex::numDependencies(ValueSubscriberStatsPtr aStats)
+{
+  size_t n = 0;
+  for (SubscriptionsMap::iterator pos = mSubscriptions.begin(); pos!=mSubscriptions.end(); ++pos) {
+    if (pos->second->mStats==aStats && pos->second->hasSinks()) n++;
+  }
+  return n;
+}
+
+
+void ValueDependencyIndex::getInfo(ApiValuePtr aInfo)
+{
+  ValueSource* vs = NULL;
+  ApiValuePtr sourceInfo;
+  for (SubscriptionsMap::iterator pos = mSubscriptions.begin(); pos!=mSubscriptions.end(); ++pos) {
+    if (pos->first!=vs) {
+      vs = pos->first;
+      sourceInfo = aInfo->newObject();
+      sourceInfo->add("name", sourceInfo->newString(vs->getSourceName()));
+      size_t n = 0;
+      pair<SubscriptionsMap::iterator, SubscriptionsMap::iterator> r = mSubscriptions.equal_range(vs);
+      for (SubscriptionsMap::iterator spos = r.first; spos!=r.second; ++spos) {
+        if (spos->second->hasSinks()) n++;
+      }
+      sourceInfo->add("subscribers", sourceInfo->newUint64(n));
+      aInfo->add(vs->getSourceId(), sourceInfo);
+    }
+  }
+}
+
+
 // MARK: - ValueSourceMapper
 
 ValueSourceMapper::ValueSourceMapper()
@@ -125,12 +315,13 @@ bool ValueSourceMapper::parseMappingDefs(const string &aValueDefs, string *aMigr
 }
 
 
-ValueSourceObj::ValueSourceObj(ValueSource* aValueSourceP) :
+ValueSourceObj::ValueSourceObj(ValueSource* aValueSourceP, ValueSubscriberStatsPtr aSubscriberStats) :
   inherited(aValueSourceP->getSourceValue()),
   mLastUpdate(aValueSourceP->getSourceLastUpdate()),
-  mOpLevel(aValueSourceP->getSourceOpLevel())
+  mOpLevel(aValueSourceP->getSourceOpLevel()),
+  mValueSource(aValueSourceP),
+  mSubscriberStats(aSubscriberStats)
 {
-  mEventSource = dynamic_cast<EventSource*>(aValueSourceP);
 }
 
 
@@ -148,13 +339,20 @@ TypeInfo ValueSourceObj::getTypeInfo() const
 
 bool ValueSourceObj::isEventSource() const
 {
-  return mEventSource; // yes if it exists
+  return mValueSource; // yes if it exists
 }
 
 
 void ValueSourceObj::registerForFilteredEvents(EventSink* aEventSink, intptr_t aRegId)
 {
-  if (mEventSource) mEventSource->registerForEvents(aEventSink, aRegId); // no filtering
+  if (!mValueSource) return;
+  if (mSubscriberStats) {
+    // subscribe via dependency index, which filters events irrelevant for evaluation
+    ValueDependencyIndex::sharedIndex().subscribe(mValueSource, aEventSink, aRegId, mSubscriberStats);
+  }
+  else {
+    mValueSource->registerForEvents(aEventSink, aRegId); // no filtering
+  }
 }
 
 
@@ -189,7 +387,7 @@ ScriptObjPtr ValueSourceMapper::memberByNameFrom(ScriptObjPtr aThisObj, const st
   ScriptObjPtr vsMember;
   ValueSource* vs = valueSourceByAlias(aName);
   if (vs) {
-    vsMember = new ValueSourceObj(vs);
+    vsMember = new ValueSourceObj(vs, mSubscriberStats);
   }
   return vsMember;
 }
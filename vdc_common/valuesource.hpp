@@ -57,6 +57,9 @@ namespace p44 {
     /// constructor
     ValueSource();
 
+    /// destructor
+    virtual ~ValueSource();
+
     /// return true only if enabled for being used
     /// @return true if enabled for use (e.g. non-app buttons are not enabled)
     virtual bool isEnabled() { return true; /* enabled by default */ };
@@ -87,11 +90,103 @@ namespace p44 {
   };
 
 
+  /// evaluation statistics of a subscriber (such as a trigger or evaluator) to value sources
+  class ValueSubscriberStats : public P44Obj
+  {
+  public:
+
+    ValueSubscriberStats();
+
+    bool mFilterEvents; ///< if set, events that cannot change the subscriber's evaluation result are suppressed
+    uint64_t mEventsReceived; ///< number of events received from value sources
+    uint64_t mEvaluations; ///< number of events forwarded to the subscriber (each causing an evaluation)
+    MLMicroSeconds mEvaluationTime; ///< total time spent in evaluations caused by forwarded events
+    MLMicroSeconds mMaxEvaluationTime; ///< longest single evaluation
+    MLMicroSeconds mLastEvaluation; ///< time of last evaluation, Never if none yet
+
+    /// reset statistics
+    void reset();
+
+    /// get statistics
+    /// @param aStats API object to add statistics fields to
+    void getStatistics(ApiValuePtr aStats);
+
+  };
+  typedef boost::intrusive_ptr<ValueSubscriberStats> ValueSubscriberStatsPtr;
+
+
+  /// subscription of a single event sink (usually a trigger condition) to a single value source.
+  /// Forwards only those events that can possibly change the outcome of an evaluation depending on
+  /// the value source's value, validity or operation level.
+  class ValueSubscription : public P44Obj, public EventSink, public EventSource
+  {
+    friend class ValueDependencyIndex;
+
+    ValueSource* mValueSource; ///< the source (subscription is deleted before source is deleted)
+    EventSink* mSubscriber; ///< the subscriber, only used as key, never dereferenced
+    ValueSubscriberStatsPtr mStats;
+    bool mForwarded; ///< set once an event has been forwarded
+    double mLastValue; ///< value at last forwarded event
+    bool mLastValid; ///< validity at last forwarded event
+    int mLastOpLevel; ///< oplevel at last forwarded event
+    MLMicroSeconds mLastUpdate; ///< source's last update time at last event received
+
+  public:
+
+    ValueSubscription(ValueSource* aValueSource, EventSink* aSubscriber, ValueSubscriberStatsPtr aStats);
+    virtual ~ValueSubscription();
+
+    virtual void processEvent(ScriptObjPtr aEvent, EventSource &aSource, intptr_t aRegId) P44_OVERRIDE;
+
+  };
+  typedef boost::intrusive_ptr<ValueSubscription> ValueSubscriptionPtr;
+
+
+  /// host-wide index of value sources to the subscribers (trigger and evaluator conditions) that read them
+  class ValueDependencyIndex
+  {
+    typedef std::multimap<ValueSource*, ValueSubscriptionPtr> SubscriptionsMap;
+    SubscriptionsMap mSubscriptions;
+    MLTicket mCleanupTicket;
+
+    ValueDependencyIndex() {};
+
+  public:
+
+    /// @return the shared index
+    static ValueDependencyIndex& sharedIndex();
+
+    /// subscribe a sink to events from a value source via an (existing or new) filtering subscription
+    /// @param aValueSource the value source
+    /// @param aSubscriber the event sink to receive (filtered) events
+    /// @param aRegId the registration id to deliver events to aSubscriber with
+    /// @param aStats the subscriber's statistics
+    void subscribe(ValueSource* aValueSource, EventSink* aSubscriber, intptr_t aRegId, ValueSubscriberStatsPtr aStats);
+
+    /// must be called when a value source is deleted
+    void valueSourceDeleted(ValueSource* aValueSource);
+
+    /// @param aStats subscriber statistics object identifying a subscriber
+    /// @return number of value sources this subscriber currently depends on
+    size_t numDependencies(ValueSubscriberStatsPtr aStats);
+
+    /// get info about the index
+    /// @param aInfo API object to add info fields to
+    void getInfo(ApiValuePtr aInfo);
+
+  private:
+
+    void removeUnused();
+
+  };
+
+
   class ValueSourceMapper : public MemberLookup
   {
 
     typedef map<string, ValueSource *, lessStrucmp> ValueSourcesMap;
     ValueSourcesMap valueMap;
+    ValueSubscriberStatsPtr mSubscriberStats;
 
   public:
 
@@ -138,6 +233,13 @@ namespace p44 {
     /// @return textual description of valuemapper in name=value list form
     string shortDesc() const;
 
+    /// make conditions using this mapper subscribe to value sources via the ValueDependencyIndex
+    /// @param aStats statistics object for the subscriber, NULL to subscribe directly (unfiltered)
+    void setSubscriberStats(ValueSubscriberStatsPtr aStats) { mSubscriberStats = aStats; };
+
+    /// @return subscriber statistics or NULL if none
+    ValueSubscriberStatsPtr getSubscriberStats() { return mSubscriberStats; };
+
   };
 
   class ValueSourceObj : public NumericValue
@@ -145,9 +247,10 @@ namespace p44 {
     typedef NumericValue inherited;
     MLMicroSeconds mLastUpdate;
     int mOpLevel;
-    EventSource* mEventSource;
+    ValueSource* mValueSource;
+    ValueSubscriberStatsPtr mSubscriberStats;
   public:
-    ValueSourceObj(ValueSource* aValueSourceP);
+    ValueSourceObj(ValueSource* aValueSourceP, ValueSubscriberStatsPtr aSubscriberStats = ValueSubscriberStatsPtr());
     virtual string getAnnotation() const P44_OVERRIDE;
     virtual TypeInfo getTypeInfo() const P44_OVERRIDE;
 
@@ -30,6 +30,7 @@
 
 #include "device.hpp"
 #include "vdc.hpp"
+#include "metrics.hpp"
 
 using namespace p44;
 
@@ -42,6 +43,11 @@ using namespace p44;
 #define DEFAULT_MAX_OPTIMIZER_SCENES 50 // general upper limit suggestion, individual vdcs might set other defaults
 #define DEFAULT_MAX_OPTIMIZER_GROUPS 20 // general upper limit suggestion, individual vdcs might set other defaults
 
+#define MIN_PRESENCE_SAMPLE_STEP (1*Second) // minimal time between two background presence samples
+
+#define DEFAULT_APPLY_DEADLINE (10*Second) // default time a device gets to apply channel values before the pipeline force-ends the apply
+#define SLOW_APPLY_LATENCY (1*Second) // devices taking longer than this to apply individually are worth optimizing even in small sets
+
 
 
 Vdc::Vdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag) :
@@ -55,7 +61,13 @@ Vdc::Vdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag) :
   mRescanInterval(Never),
   mRescanMode(rescanmode_incremental),
   mCollecting(false),
+  mPresenceSampleInterval(-1), // vdc default
+  mPresenceSamplingBusy(false),
+  mPresenceSamples(0),
+  mPresenceSamplingStarted(Never),
+  mApplyDeadline(-1), // vdc default
   mDelivering(false),
+  mCollectingBatch(false),
   mTotalOptimizableCalls(0),
   mMinCallsBeforeOptimizing(DEFAULT_MIN_CALLS_BEFORE_OPTIMIZING),
   mMinDevicesForOptimizing(DEFAULT_MIN_DEVICES_FOR_OPTIMIZING),
@@ -65,6 +77,13 @@ Vdc::Vdc(int aInstanceNumber, VdcHost *aVdcHostP, int aTag) :
   , mDefaultBridgingFlags(DeviceSettings::bridge_none)
   #endif // ENABLE_JSONBRIDGEAPI
 {
+  #if ENABLE_METRICS
+  mSingleDeliveryMetric = NULL;
+  mGroupedDeliveryMetric = NULL;
+  mPendingDeliveriesMetric = NULL;
+  mBatchAppliesMetric = NULL;
+  mBatchAppliedDevicesMetric = NULL;
+  #endif
 }
 
 
@@ -79,6 +98,16 @@ void Vdc::addVdcToVdcHost()
   // Note: dSUID derived here (early) might be non-final (but must be unique!).
   //   Final dSUID must be stable after initialize(), latest.
   deriveDsUid();
+  #if ENABLE_METRICS
+  // resolve per-vdc metrics once, to avoid formatting names and looking them up for every event
+  const char *vci = vdcClassIdentifier();
+  Metrics &m = Metrics::sharedMetrics();
+  mSingleDeliveryMetric = &m.histogram(string_format("vdc_delivery_seconds{vdc=\"%s\",mode=\"single\"}", vci));
+  mGroupedDeliveryMetric = &m.histogram(string_format("vdc_delivery_seconds{vdc=\"%s\",mode=\"grouped\"}", vci));
+  mPendingDeliveriesMetric = &m.gauge(string_format("vdc_pending_deliveries{vdc=\"%s\"}", vci));
+  mBatchAppliesMetric = &m.counter(string_format("vdc_batch_applies_total{vdc=\"%s\"}", vci));
+  mBatchAppliedDevicesMetric = &m.counter(string_format("vdc_batch_applied_devices_total{vdc=\"%s\"}", vci));
+  #endif
   // add to container mapped to the current dSUID
   getVdcHost().addVdc(VdcPtr(this));
   // Note: vdchost will re-map all vdcs to their final (possibly differing) dSUID later
@@ -119,6 +148,14 @@ void Vdc::handleGlobalEvent(VdchostEvent aEvent)
       optimizerCacheStats();
     }
   }
+  else if (aEvent==vdchost_devices_initialized) {
+    // devices are ready, make sure background presence sampling is running
+    if (!mPresenceSamplingTicket && !mPresenceSamplingBusy) {
+      mPresenceSamplingStarted = MainLoop::now();
+      mPresenceSamples = 0;
+      schedulePresenceSampling(presenceSampleStep());
+    }
+  }
   for (DeviceVector::iterator pos = mDevices.begin(); pos!=mDevices.end(); ++pos) {
     (*pos)->handleGlobalEvent(aEvent);
   }
@@ -333,9 +370,15 @@ void Vdc::deliverToDevicesAudience(DsAddressablesList aAudience, VdcApiConnectio
   else {
     // not a specially handled/optimized notification: just let every device handle it individually
     OLOG(LOG_INFO, "===== '%s' one-by-one delivery to %lu devices starts now", aNotification.c_str(), aAudience.size());
+    #if ENABLE_METRICS
+    MLMicroSeconds startedAt = MainLoop::now();
+    #endif
     for (DsAddressablesList::iterator apos = aAudience.begin(); apos!=aAudience.end(); ++apos) {
       (*apos)->handleNotificationFromConnection(aApiConnection, aNotification, aParams, NoOP);
     }
+    #if ENABLE_METRICS
+    if (mSingleDeliveryMetric) mSingleDeliveryMetric->record(MainLoop::now()-startedAt);
+    #endif
     OLOG(LOG_INFO, "===== '%s' one-by-one delivery complete", aNotification.c_str());
   }
 }
@@ -348,6 +391,9 @@ void Vdc::queueDelivery(NotificationDeliveryStatePtr aDeliveryState)
   if (mDelivering) {
     // queue for when current delivery is done
     mPendingDeliveries.push_back(aDeliveryState);
+    #if ENABLE_METRICS
+    if (mPendingDeliveriesMetric) mPendingDeliveriesMetric->set((int64_t)mPendingDeliveries.size());
+    #endif
     OLOG(LOG_INFO, "'%s' grouped delivery queued (previous delivery still running) - now %lu queued deliveries", NotificationNames[aDeliveryState->mCallType], mPendingDeliveries.size());
     // now make sure delivery is not blocked by previous delivery waiting for long-running scene actions
     // Note: iterate only as long as still delivering 
@@ -370,6 +416,9 @@ void Vdc::notificationDeliveryComplete(NotificationDeliveryState &aDeliveryState
   // - done
   mDelivering = false;
   OLOG(LOG_INFO, "===== '%s' grouped delivery complete", NotificationNames[aDeliveryStateBeingDeleted.mCallType]);
+  #if ENABLE_METRICS
+  if (mGroupedDeliveryMetric) mGroupedDeliveryMetric->record(MainLoop::now()-aDeliveryStateBeingDeleted.mCreatedAt);
+  #endif
   // check for pending deliveries
   if (mPendingDeliveries.size()>0) {
     // get next from queue
@@ -377,6 +426,9 @@ void Vdc::notificationDeliveryComplete(NotificationDeliveryState &aDeliveryState
     // - remove from queue, only passed smart pointer keeps the object now. This is important
     //   because we rely on the NotificationDeliveryState's destructor to call us back here when done!
     mPendingDeliveries.pop_front();
+    #if ENABLE_METRICS
+    if (mPendingDeliveriesMetric) mPendingDeliveriesMetric->set((int64_t)mPendingDeliveries.size());
+    #endif
     // - now start
     OLOG(LOG_INFO, "===== '%s' queued grouped delivery to %ld devices starts now", NotificationNames[nds->mCallType], nds->mAudience.size());
     mDelivering = true;
@@ -390,7 +442,12 @@ void Vdc::prepareNextNotification(NotificationDeliveryStatePtr aDeliveryState)
 {
   if (aDeliveryState->mAudience.empty()) {
     // preparation complete, now process affected devices
+    // - collect the applies executing the notification causes right now
+    mCollectingBatch = supportsBatchApply();
     executePreparedNotification(aDeliveryState);
+    mCollectingBatch = false;
+    // apply what has been collected from all devices of this delivery
+    applyCollectedBatch();
   }
   else {
     // need to prepare next device
@@ -426,7 +483,12 @@ void Vdc::notificationPrepared(NotificationDeliveryStatePtr aDeliveryState, Noti
       // optimisation off, different notification type than others in set, or otherwise not optimizable -> just execute and apply right now
       dev->updateDeliveryState(aDeliveryState, false); // still: do basic updating of state such that processing has all the info
       getVdcHost().deviceWillApplyNotification(dev, *aDeliveryState); // let vdchost process for possibly updating global zone state
+      // - collect the apply this causes right now for applying at the end of the delivery
+      //   Note: only within this synchronous scope, so unrelated applies happening while the delivery
+      //   goes on (via mainloop) are not captured and delayed
+      mCollectingBatch = supportsBatchApply();
       dev->executePreparedOperation(boost::bind(&Vdc::preparedOperationExecuted, this, dev), aNotificationToApply);
+      mCollectingBatch = false;
     }
   }
   dev->didExamineNotificationFromConnection(aDeliveryState->mConnection);
@@ -442,14 +504,65 @@ void Vdc::preparedOperationExecuted(DevicePtr aDevice)
 }
 
 
+// MARK: - batch apply
+
+bool Vdc::collectForBatchApply(DevicePtr aDevice, SimpleCB aDoneCB, bool aForDimming)
+{
+  if (!mCollectingBatch) return false;
+  mBatchApplyItems.push_back(BatchApplyItem());
+  BatchApplyItem &item = mBatchApplyItems.back();
+  item.mDevice = aDevice;
+  item.mTransitionTime = 0;
+  aDevice->needsToApplyChannels(&item.mTransitionTime);
+  item.mForDimming = aForDimming;
+  item.mDoneCB = aDoneCB;
+  return true;
+}
+
+
+void Vdc::applyCollectedBatch()
+{
+  mCollectingBatch = false;
+  if (mBatchApplyItems.empty()) return;
+  BatchApplyList batch;
+  batch.swap(mBatchApplyItems); // applyChannelValuesBatch() might cause new deliveries
+  OLOG(LOG_INFO, "applying channel values of %zu devices in one batch", batch.size());
+  #if ENABLE_METRICS
+  if (mBatchAppliesMetric) mBatchAppliesMetric->inc();
+  if (mBatchAppliedDevicesMetric) mBatchAppliedDevicesMetric->inc(batch.size());
+  #endif
+  applyChannelValuesBatch(batch);
+}
+
+
+void Vdc::applyChannelValuesBatch(BatchApplyList &aBatch)
+{
+  // base class: just apply one by one
+  for (BatchApplyList::iterator pos = aBatch.begin(); pos!=aBatch.end(); ++pos) {
+    pos->mDevice->applyChannelValues(pos->mDoneCB, pos->mForDimming);
+  }
+}
+
+
 bool Vdc::shouldUseOptimizerFor(NotificationDeliveryStatePtr aDeliveryState)
 {
   // simple base class strategy: at least MIN_DEVICES_TO_OPTIMIZE devices must be involved.
   // explicit optimizeHint will force or prevent optimisation
   // derived classes can use refined strategy more suitable for the hardware
-  return
-    aDeliveryState->mOptimizeHint==yes || // forced yes
-    (aDeliveryState->mAffectedDevices.size()>=mMinDevicesForOptimizing && aDeliveryState->mOptimizeHint!=no); // enough devices and not explicitly prevented
+  if (aDeliveryState->mOptimizeHint==yes) return true; // forced yes
+  if (aDeliveryState->mOptimizeHint==no) return false; // explicitly prevented
+  if (aDeliveryState->mAffectedDevices.size()>=mMinDevicesForOptimizing) return true; // enough devices
+  // fewer devices, but still worth optimizing when applying one of them individually is known to be slow
+  // Note: devices of a vdc are usually applied concurrently, so the slowest device (not the sum) determines the delay
+  if (aDeliveryState->mAffectedDevices.size()>1) {
+    MLMicroSeconds maxLatency = 0;
+    for (DeviceList::iterator pos = aDeliveryState->mAffectedDevices.begin(); pos!=aDeliveryState->mAffectedDevices.end(); ++pos) {
+      MLMicroSeconds l = (*pos)->averageApplyLatency();
+      if (l>maxLatency) maxLatency = l;
+    }
+    return maxLatency>=SLOW_APPLY_LATENCY;
+  }
+  return false;
 }
 
 
@@ -971,7 +1084,9 @@ void Vdc::schedulePeriodicRecollecting()
 {
   mRescanTicket.cancel();
   if (mRescanInterval!=Never) {
-    mRescanTicket.executeOnce(boost::bind(&Vdc::initiateRecollect, this, mRescanMode), mRescanInterval);
+    // +/-10% random variation, so vdcs started at the same time do not recollect in lockstep
+    MLMicroSeconds jitter = mRescanInterval/10*((double)(random()%2001)/1000-1);
+    mRescanTicket.executeOnce(boost::bind(&Vdc::initiateRecollect, this, mRescanMode), mRescanInterval+jitter);
   }
 }
 
@@ -1009,6 +1124,132 @@ void Vdc::setPeriodicRecollection(MLMicroSeconds aRecollectInterval, RescanMode
 
 
 
+// MARK: - Background presence sampling
+
+MLMicroSeconds Vdc::defaultPresenceSampleInterval()
+{
+  return Never; // no background sampling by default, vdcs where sampling is cheap opt in
+}
+
+
+MLMicroSeconds Vdc::presenceSampleInterval()
+{
+  if (mPresenceSampleInterval<0) return defaultPresenceSampleInterval();
+  return mPresenceSampleInterval;
+}
+
+
+// MARK: - apply pipeline deadline
+
+MLMicroSeconds Vdc::defaultApplyDeadline()
+{
+  return DEFAULT_APPLY_DEADLINE;
+}
+
+
+MLMicroSeconds Vdc::applyDeadline()
+{
+  if (mApplyDeadline<0) return defaultApplyDeadline();
+  return mApplyDeadline;
+}
+
+
+void Vdc::schedulePresenceSampling(MLMicroSeconds aDelay)
+{
+  mPresenceSamplingTicket.cancel();
+  if (backgroundPresenceSampling()) {
+    mPresenceSamplingTicket.executeOnce(boost::bind(&Vdc::presenceSamplingStep, this), aDelay);
+  }
+}
+
+
+MLMicroSeconds Vdc::presenceSampleStep()
+{
+  // spread the samples evenly over the sample interval
+  MLMicroSeconds interval = presenceSampleInterval();
+  size_t batchSize = presenceSampleBatchSize();
+  size_t numBatches = mDevices.size();
+  if (batchSize==0) numBatches = 1;
+  else numBatches = (numBatches+batchSize-1)/batchSize;
+  if (numBatches==0) return interval;
+  MLMicroSeconds step = interval/(MLMicroSeconds)numBatches;
+  return step<MIN_PRESENCE_SAMPLE_STEP ? MIN_PRESENCE_SAMPLE_STEP : step;
+}
+
+
+static bool olderPresenceState(DevicePtr aDev1, DevicePtr aDev2)
+{
+  return aDev1->lastPresenceUpdate()<aDev2->lastPresenceUpdate();
+}
+
+
+void Vdc::presenceSamplingStep()
+{
+  MLMicroSeconds step = presenceSampleStep();
+  if (mCollecting || mPresenceSamplingBusy) {
+    // do not interfere with collecting, try later
+    schedulePresenceSampling(step);
+    return;
+  }
+  // collect devices whose presence state will be outdated before the next step
+  // Note: devices that report their presence by themselves (or were sampled on access) might not be due
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds maxAge = presenceSampleInterval()-step;
+  DeviceVector due;
+  for (DeviceVector::iterator pos = mDevices.begin(); pos!=mDevices.end(); ++pos) {
+    if ((*pos)->lastPresenceUpdate()==Never || now-(*pos)->lastPresenceUpdate()>=maxAge) {
+      due.push_back(*pos);
+    }
+  }
+  if (due.empty()) {
+    schedulePresenceSampling(step);
+    return;
+  }
+  // sample the oldest first
+  std::sort(due.begin(), due.end(), olderPresenceState);
+  size_t batchSize = presenceSampleBatchSize();
+  if (batchSize>0 && due.size()>batchSize) due.resize(batchSize);
+  OLOG(LOG_DEBUG, "background presence sampling of %zu device(s)", due.size());
+  mPresenceSamplingBusy = true;
+  mPresenceSamples += due.size();
+  checkPresenceOfDevices(due, boost::bind(&Vdc::presenceSamplingDone, this, now));
+}
+
+
+void Vdc::presenceSamplingDone(MLMicroSeconds aStepStarted)
+{
+  mPresenceSamplingBusy = false;
+  // next step relative to start of this step, but not before MIN_PRESENCE_SAMPLE_STEP from now
+  MLMicroSeconds delay = aStepStarted+presenceSampleStep()-MainLoop::now();
+  schedulePresenceSampling(delay<MIN_PRESENCE_SAMPLE_STEP ? MIN_PRESENCE_SAMPLE_STEP : delay);
+}
+
+
+void Vdc::checkPresenceOfDevices(DeviceVector aDevices, StatusCB aDoneCB)
+{
+  // base class: one by one
+  checkNextDevicePresence(aDevices, 0, aDoneCB);
+}
+
+
+void Vdc::checkNextDevicePresence(DeviceVector aDevices, size_t aIndex, StatusCB aDoneCB)
+{
+  if (aIndex>=aDevices.size()) {
+    if (aDoneCB) aDoneCB(ErrorPtr());
+    return;
+  }
+  aDevices[aIndex]->checkPresence(boost::bind(&Vdc::devicePresenceChecked, this, aDevices, aIndex, aDoneCB, _1));
+}
+
+
+void Vdc::devicePresenceChecked(DeviceVector aDevices, size_t aIndex, StatusCB aDoneCB, bool aPresent)
+{
+  aDevices[aIndex]->updatePresenceState(aPresent);
+  checkNextDevicePresence(aDevices, aIndex+1, aDoneCB);
+}
+
+
+
 // MARK: - Managing devices
 
 
@@ -1164,32 +1405,157 @@ void Vdc::identifyAndAddDeviceCB(StatusCB aCompletedCB, ErrorPtr aError, Device
 
 
 
+// MARK: - batch identify and add
+
+namespace p44 {
+
+  /// state of a batch of devices being identified and added by identifyAndAddDevices()
+  class IdentifyBatch : public P44Obj
+  {
+  public:
+    DeviceList mPending; ///< devices not yet being identified
+    DeviceList mIdentified; ///< successfully identified devices, to be added when all are done
+    std::vector<MLTicket> mSlotTickets; ///< per identification slot ticket for retries and add delays
+    int mInProgress; ///< number of identifications in progress
+    size_t mFailed; ///< number of devices that could not be identified
+    StatusCB mCompletedCB;
+    int mMaxRetries;
+    MLMicroSeconds mRetryDelay;
+    MLMicroSeconds mAddDelay;
+    MLMicroSeconds mStartedAt;
+  };
+
+} // namespace p44
+
+
+size_t Vdc::addDevicesWithBridgingDefaults(DeviceList &aNewDevices)
+{
+  #if ENABLE_JSONBRIDGEAPI
+  // - apply vdc-level default bridging flags, see addDeviceWithBridgingDefaults()
+  if (mDefaultBridgingFlags!=DeviceSettings::bridge_none) {
+    for (DeviceList::iterator pos = aNewDevices.begin(); pos!=aNewDevices.end(); ++pos) {
+      (*pos)->mDeviceSettings->mBridgingFlags = (DeviceSettings::BridgingFlags)(mDefaultBridgingFlags | DeviceSettings::bridge_flags_vdcdefault);
+    }
+  }
+  #endif // ENABLE_JSONBRIDGEAPI
+  // Note: addDevices removes the devices not added (duplicates) from the list
+  getVdcHost().addDevices(aNewDevices);
+  #if ENABLE_JSONBRIDGEAPI
+  for (DeviceList::iterator pos = aNewDevices.begin(); pos!=aNewDevices.end(); ++pos) {
+    if ((*pos)->mDeviceSettings->mBridgingFlags & DeviceSettings::bridge_flags_vdcdefault) {
+      // these are still the vdc level defaults, need to be saved
+      (*pos)->mDeviceSettings->markDirty();
+    }
+  }
+  #endif // ENABLE_JSONBRIDGEAPI
+  return aNewDevices.size();
+}
+
+
+size_t Vdc::simpleIdentifyAndAddDevices(DeviceList &aNewDevices)
+{
+  DeviceList::iterator pos = aNewDevices.begin();
+  while (pos!=aNewDevices.end()) {
+    if (!(*pos)->identifyDevice(NoOP)) {
+      LOG(LOG_WARNING, "Could not identify device or device not supported -> ignored");
+      pos = aNewDevices.erase(pos);
+      continue;
+    }
+    ++pos;
+  }
+  addDevicesWithBridgingDefaults(aNewDevices);
+  // save in my own list
+  mDevices.insert(mDevices.end(), aNewDevices.begin(), aNewDevices.end());
+  return aNewDevices.size();
+}
+
+
 void Vdc::identifyAndAddDevices(DeviceList aToBeAddedDevices, StatusCB aCompletedCB, int aMaxRetries, MLMicroSeconds aRetryDelay, MLMicroSeconds aAddDelay)
 {
-  if (aToBeAddedDevices.size()>0) {
-    // more devices to add
-    DevicePtr dev = aToBeAddedDevices.front();
-    aToBeAddedDevices.pop_front();
-    identifyAndAddDevice(
-      dev,
-      boost::bind(&Vdc::identifyAndAddDevicesCB, this, aToBeAddedDevices, aCompletedCB, aMaxRetries, aRetryDelay, aAddDelay),
-      aMaxRetries, aRetryDelay
-    );
+  IdentifyBatchPtr batch = IdentifyBatchPtr(new IdentifyBatch);
+  batch->mPending = aToBeAddedDevices;
+  batch->mInProgress = 0;
+  batch->mFailed = 0;
+  batch->mCompletedCB = aCompletedCB;
+  batch->mMaxRetries = aMaxRetries;
+  batch->mRetryDelay = aRetryDelay;
+  batch->mAddDelay = aAddDelay;
+  batch->mStartedAt = MainLoop::now();
+  if (batch->mPending.empty()) {
+    batchIdentified(batch);
     return;
   }
-  // done
-  if (aCompletedCB) aCompletedCB(ErrorPtr());
+  // an add delay is for pacing identification, so it implies identifying one device after the other
+  int slots = aAddDelay>0 ? 1 : maxConcurrentIdentifications();
+  if (slots<1) slots = 1;
+  if ((size_t)slots>batch->mPending.size()) slots = (int)batch->mPending.size();
+  batch->mSlotTickets.resize(slots);
+  OLOG(LOG_INFO, "identifying %zu devices, %d at a time", batch->mPending.size(), slots);
+  for (int slot=0; slot<slots; slot++) {
+    batchIdentifyNext(batch, slot);
+  }
 }
 
 
-void Vdc::identifyAndAddDevicesCB(DeviceList aToBeAddedDevices, StatusCB aCompletedCB, int aMaxRetries, MLMicroSeconds aRetryDelay, MLMicroSeconds aAddDelay)
+void Vdc::batchIdentifyNext(IdentifyBatchPtr aBatch, int aSlot)
 {
-  // even without add delay, it's important to defer this call to avoid stacking up calls along aToBeAddedDevices
-  // Note: only now, remove the device from the list, which should deallocate it if it has not been added to the vdc(host) by now.
-  mIdentifyTicket.executeOnce(
-    boost::bind(&Vdc::identifyAndAddDevices, this, aToBeAddedDevices, aCompletedCB, aMaxRetries, aRetryDelay, aAddDelay),
-    aAddDelay
-  );
+  if (aBatch->mPending.empty()) {
+    // nothing more to start in this slot, done when all other slots are done as well
+    if (aBatch->mInProgress==0) batchIdentified(aBatch);
+    return;
+  }
+  DevicePtr dev = aBatch->mPending.front();
+  aBatch->mPending.pop_front();
+  aBatch->mInProgress++;
+  batchIdentifyDevice(aBatch, aSlot, dev, aBatch->mMaxRetries);
+}
+
+
+void Vdc::batchIdentifyDevice(IdentifyBatchPtr aBatch, int aSlot, DevicePtr aDevice, int aRetriesLeft)
+{
+  // Note: retries are handled per slot here, as concurrent identifications cannot share mIdentifyTicket
+  identifyDevice(aDevice, boost::bind(&Vdc::batchDeviceIdentified, this, aBatch, aSlot, aDevice, aRetriesLeft, _1, _2), 0, 0);
+}
+
+
+void Vdc::batchDeviceIdentified(IdentifyBatchPtr aBatch, int aSlot, DevicePtr aDevice, int aRetriesLeft, ErrorPtr aError, Device *aIdentifiedDevice)
+{
+  if (Error::isOK(aError)) {
+    // Note: wrapping into a DevicePtr keeps aIdentifiedDevice alive until it gets added
+    aBatch->mIdentified.push_back(DevicePtr(aIdentifiedDevice));
+  }
+  else if (aRetriesLeft>0) {
+    LOG(LOG_WARNING, "device identification failed: %s -> retrying %d times", aError->text(), aRetriesLeft);
+    aBatch->mSlotTickets[aSlot].executeOnce(boost::bind(&Vdc::batchIdentifyDevice, this, aBatch, aSlot, aDevice, aRetriesLeft-1), aBatch->mRetryDelay);
+    return;
+  }
+  else {
+    LOG(LOG_ERR, "Could not get device identification: %s -> ignored", aError->text());
+    aBatch->mFailed++;
+  }
+  aBatch->mInProgress--;
+  // even without add delay, it's important to defer this call to avoid stacking up calls along the pending list
+  aBatch->mSlotTickets[aSlot].executeOnce(boost::bind(&Vdc::batchIdentifyNext, this, aBatch, aSlot), aBatch->mAddDelay);
+}
+
+
+void Vdc::batchIdentified(IdentifyBatchPtr aBatch)
+{
+  MLMicroSeconds identifiedAt = MainLoop::now();
+  size_t identified = aBatch->mIdentified.size();
+  if (identified>0) {
+    addDevicesWithBridgingDefaults(aBatch->mIdentified);
+    // save in my own list
+    mDevices.insert(mDevices.end(), aBatch->mIdentified.begin(), aBatch->mIdentified.end());
+    OLOG(LOG_NOTICE,
+      "identified %zu devices in %.3f seconds (%zu failed), added %zu of them in %.3f seconds",
+      identified, (double)(identifiedAt-aBatch->mStartedAt)/Second, aBatch->mFailed,
+      aBatch->mIdentified.size(), (double)(MainLoop::now()-identifiedAt)/Second
+    );
+    METRICS_RECORD("vdc_batch_identify_seconds", identifiedAt-aBatch->mStartedAt);
+  }
+  aBatch->mIdentified.clear();
+  if (aBatch->mCompletedCB) aBatch->mCompletedCB(ErrorPtr());
 }
 
 
@@ -1344,6 +1710,9 @@ enum {
   hideWhenEmpty_key,
   effectSpeedOptimized_key,
   defaultBridgingFlags_key,
+  presenceSampleInterval_key,
+  presenceSamplesPerMinute_key,
+  applyDeadline_key,
   numVdcProperties
 };
 
@@ -1429,7 +1798,10 @@ PropertyDescriptorPtr Vdc::getDescriptorByIndex(int aPropIndex, int aDomain, Pro
       { "x-p44-maxOptimizerScenes", apivalue_uint64, maxOptimizerScenes_key, OKEY(vdc_key) },
       { "x-p44-maxOptimizerGroups", apivalue_uint64, maxOptimizerGroups_key, OKEY(vdc_key) },
       { "x-p44-hideWhenEmpty", apivalue_bool, hideWhenEmpty_key, OKEY(vdc_key) },
-      { "x-p44-effectSpeedOptimized", apivalue_bool, effectSpeedOptimized_key, OKEY(vdc_key) }
+      { "x-p44-effectSpeedOptimized", apivalue_bool, effectSpeedOptimized_key, OKEY(vdc_key) },
+      { "x-p44-presenceSampleInterval", apivalue_double, presenceSampleInterval_key, OKEY(vdc_key) },
+      { "x-p44-presenceSamplesPerMinute", apivalue_double, presenceSamplesPerMinute_key, OKEY(vdc_key) },
+      { "x-p44-applyDeadline", apivalue_double, applyDeadline_key, OKEY(vdc_key) }
       #if ENABLE_JSONBRIDGEAPI
       , { "x-p44-defaultBridgingFlags", apivalue_uint64, defaultBridgingFlags_key, OKEY(vdc_key) }
       #endif
@@ -1492,6 +1864,18 @@ bool Vdc::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Property
         case effectSpeedOptimized_key:
           aPropValue->setBoolValue(getVdcFlag(vdcflag_effectSpeedOptimized));
           return true;
+        case presenceSampleInterval_key:
+          aPropValue->setDoubleValue((double)presenceSampleInterval()/Second);
+          return true;
+        case presenceSamplesPerMinute_key: {
+          if (!backgroundPresenceSampling() || mPresenceSamplingStarted==Never) return false; // no background sampling
+          MLMicroSeconds t = MainLoop::now()-mPresenceSamplingStarted;
+          aPropValue->setDoubleValue(t>0 ? (double)mPresenceSamples*Minute/t : 0);
+          return true;
+        }
+        case applyDeadline_key:
+          aPropValue->setDoubleValue((double)applyDeadline()/Second);
+          return true;
         #if ENABLE_JSONBRIDGEAPI
         case defaultBridgingFlags_key:
           aPropValue->setUint32Value(mDefaultBridgingFlags);
@@ -1542,6 +1926,22 @@ bool Vdc::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Property
         case effectSpeedOptimized_key:
           setVdcFlag(vdcflag_effectSpeedOptimized, aPropValue->boolValue());
           return true;
+        case presenceSampleInterval_key: {
+          // <0 means vdc default, 0 means sampling on access only
+          double v = aPropValue->doubleValue();
+          if (setPVar(mPresenceSampleInterval, v<0 ? (MLMicroSeconds)-1 : (MLMicroSeconds)(v*Second))) {
+            mPresenceSamplingStarted = MainLoop::now();
+            mPresenceSamples = 0;
+            if (!mPresenceSamplingBusy) schedulePresenceSampling(presenceSampleStep());
+          }
+          return true;
+        }
+        case applyDeadline_key: {
+          // <0 means vdc default, 0 means no deadline at all
+          double v = aPropValue->doubleValue();
+          setPVar(mApplyDeadline, v<0 ? (MLMicroSeconds)-1 : (MLMicroSeconds)(v*Second));
+          return true;
+        }
         #if ENABLE_JSONBRIDGEAPI
         case defaultBridgingFlags_key:
           setPVar(mDefaultBridgingFlags, (DeviceSettings::BridgingFlags)aPropValue->int32Value());
@@ -1595,9 +1995,9 @@ const char *Vdc::tableName()
 // data field definitions
 
 #if ENABLE_JSONBRIDGEAPI
-static const size_t numFields = 9;
+static const size_t numFields = 11;
 #else
-static const size_t numFields = 8;
+static const size_t numFields = 10;
 #endif
 
 size_t Vdc::numFieldDefs()
@@ -1617,6 +2017,8 @@ const FieldDefinition *Vdc::getFieldDef(size_t aIndex)
     { "minDevicesForOptimizing", SQLITE_INTEGER },
     { "maxOptimizerScenes", SQLITE_INTEGER },
     { "maxOptimizerGroups", SQLITE_INTEGER },
+    { "presenceSampleInterval", SQLITE_INTEGER },
+    { "applyDeadline", SQLITE_INTEGER },
     #if ENABLE_JSONBRIDGEAPI
     { "defaultBridgingFlags", SQLITE_INTEGER }
     #endif
@@ -1647,6 +2049,8 @@ void Vdc::loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *a
   aRow->getIfNotNull(aIndex++, mMinDevicesForOptimizing);
   aRow->getIfNotNull(aIndex++, mMaxOptimizerScenes);
   aRow->getIfNotNull(aIndex++, mMaxOptimizerGroups);
+  aRow->getCastedIfNotNull<MLMicroSeconds, long long int>(aIndex++, mPresenceSampleInterval);
+  aRow->getCastedIfNotNull<MLMicroSeconds, long long int>(aIndex++, mApplyDeadline);
   #if ENABLE_JSONBRIDGEAPI
   aRow->getCastedIfNotNull<DeviceSettings::BridgingFlags, int>(aIndex++, mDefaultBridgingFlags);
   #endif
@@ -1667,6 +2071,8 @@ void Vdc::bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const c
   aStatement.bind(aIndex++, mMinDevicesForOptimizing);
   aStatement.bind(aIndex++, mMaxOptimizerScenes);
   aStatement.bind(aIndex++, mMaxOptimizerGroups);
+  aStatement.bind(aIndex++, (long long int)mPresenceSampleInterval);
+  aStatement.bind(aIndex++, (long long int)mApplyDeadline);
   #if ENABLE_JSONBRIDGEAPI
   aStatement.bind(aIndex++, mDefaultBridgingFlags);
   #endif
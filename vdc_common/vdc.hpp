@@ -27,6 +27,7 @@
 
 #include "vdchost.hpp"
 #include "devicesettings.hpp"
+#include "metrics.hpp"
 
 #include "dsuid.hpp"
 
@@ -130,7 +131,8 @@ namespace p44 {
       mRepeatAfter(Never),
       mRepeatVariant(0),
       mPendingCount(0),
-      mOptimizeHint(undefined)
+      mOptimizeHint(undefined),
+      mCreatedAt(MainLoop::now())
     {};
 
     ~NotificationDeliveryState();
@@ -144,6 +146,7 @@ namespace p44 {
     uint64_t mContentsHash; ///< this FNV64 hash represents the contents of all affected device's scenes (for callScene)
     NotificationType mCallType; ///< type of notification as originally called
     Tristate mOptimizeHint; ///< if not undefined, this requests or prevents optimisation of the called scene (when possible)
+    MLMicroSeconds mCreatedAt; ///< when the delivery was requested (for metrics)
 
   public:
 
@@ -214,6 +217,22 @@ namespace p44 {
   } OptimizerMode;
 
 
+  /// a device ready to apply its channel values, as passed to Vdc::applyChannelValuesBatch()
+  class BatchApplyItem
+  {
+  public:
+    DevicePtr mDevice; ///< the device. The target values are those of its output's channels that need applying
+    MLMicroSeconds mTransitionTime; ///< the transition time for the new values
+    bool mForDimming; ///< set when the apply is a dimming step (only a single channel's value changes)
+    SimpleCB mDoneCB; ///< must be called once the device's channel values are applied
+  };
+  typedef std::vector<BatchApplyItem> BatchApplyList;
+
+
+  class IdentifyBatch;
+  typedef boost::intrusive_ptr<IdentifyBatch> IdentifyBatchPtr;
+
+
   /// This is the base class for a "class" (usually: type of hardware) of virtual devices.
   /// In dS terminology, this object represents a vDC (virtual device connector).
   class Vdc : public PersistentParams, public DsAddressable
@@ -242,14 +261,35 @@ namespace p44 {
     MLTicket mIdentifyTicket; ///< identification ticket
     bool mCollecting; ///< currently collecting
 
+    /// background presence sampling
+    MLMicroSeconds mPresenceSampleInterval; ///< interval within which each device's presence is sampled once, <0 = vdc default, 0 = sample on access only
+    MLTicket mPresenceSamplingTicket; ///< ticket for next background presence sample
+    bool mPresenceSamplingBusy; ///< set while a background presence sample is in progress
+    long mPresenceSamples; ///< number of device presence states sampled in the background since mPresenceSamplingStarted
+    MLMicroSeconds mPresenceSamplingStarted; ///< when background presence sampling was (re)started
+
+    /// apply pipeline
+    MLMicroSeconds mApplyDeadline; ///< max time a device's apply or update may take before being force-ended, <0 = vdc default, 0 = no deadline
+
     /// notification optimizing
     NotificationDeliveryStateList mPendingDeliveries; ///< pending deliveries
     OptimizerEntryList mOptimizerCache; ///< the current optimizer cache
     long mTotalOptimizableCalls; ///< total of optimizable calls
     MLTicket mOptimizedCallRepeaterTicket; ///< vdc-level ticket for auto-repeating a call (e.g. dim stop)
     bool mDelivering; ///< set while the delivery/optimization process is running
+    bool mCollectingBatch; ///< set while device applies are collected for applyChannelValuesBatch()
+    BatchApplyList mBatchApplyItems; ///< the device applies collected so far
     ErrorPtr mVdcErr; ///< global error, set when something prevents or limits the vdc from working
 
+    #if ENABLE_METRICS
+    // per-vdc metrics, resolved once in addVdcToVdcHost() (when vdcClassIdentifier() is available)
+    MetricsHistogram *mSingleDeliveryMetric;
+    MetricsHistogram *mGroupedDeliveryMetric;
+    MetricsGauge *mPendingDeliveriesMetric;
+    MetricsCounter *mBatchAppliesMetric;
+    MetricsCounter *mBatchAppliedDevicesMetric;
+    #endif
+
   protected:
   
     DeviceVector mDevices; ///< the devices of this class
@@ -328,6 +368,12 @@ namespace p44 {
     /// @return a combination of rescanmode_xxx bits
     virtual int getRescanModes() const { return rescanmode_none; }; // by default, assume not rescannable
 
+    /// get max number of devices that may be in the process of (non-instant) identification at the same time
+    /// @return max number of concurrent identifications, 1 = one after the other
+    /// @note vdcs with devices that can be identified independently from each other (e.g. via separate
+    ///   connections) can override this to speed up identifyAndAddDevices()
+    virtual int maxConcurrentIdentifications() { return 1; };
+
     /// (re)collect devices from this vDCs for normal operation
     /// @param aCompletedCB will be called when device scan for this vDC has been completed
     /// @param aRescanFlags selects mode of rescan:
@@ -363,9 +409,30 @@ namespace p44 {
     /// @return true if vdc is currently collecting (scanning for) devices
     bool isCollecting() { return mCollecting; };
 
+    /// @return effective interval within which the presence of every device is sampled once in the background,
+    ///   Never if presence is only sampled on access
+    MLMicroSeconds presenceSampleInterval();
+
+    /// @return true if presence of this vdc's devices is refreshed by the background presence scheduler
+    bool backgroundPresenceSampling() { return presenceSampleInterval()>0; };
+
+    /// @return effective deadline for devices of this vdc to complete applying channel values (or updating them
+    ///   from hardware) before the apply pipeline force-ends the operation, 0 for no deadline
+    MLMicroSeconds applyDeadline();
+
+    /// check presence of multiple devices of this vdc at once
+    /// @param aDevices the devices to check
+    /// @param aDoneCB will be called when all devices have updated their presence state (via updatePresenceState())
+    /// @note base class checks devices one by one via checkPresence(). vdcs that can obtain the presence of many
+    ///   devices in a single operation (such as a device list request) should override this and presenceSampleBatchSize()
+    virtual void checkPresenceOfDevices(DeviceVector aDevices, StatusCB aDoneCB);
+
     /// @return true if vdc is configured for having/collecting devices
     virtual bool isConfigured() { return true; /* by default, vdcs need no extra configuration */ }
 
+    /// @return true if this vdc only controls simulated hardware
+    virtual bool isSimulated() { return false; }
+
     /// handle global events
     /// @param aEvent the event to handle
     virtual void handleGlobalEvent(VdchostEvent aEvent) P44_OVERRIDE;
@@ -418,6 +485,14 @@ namespace p44 {
     ///   known ones will just be ignored when encountered again)
     bool simpleIdentifyAndAddDevice(DevicePtr aNewDevice);
 
+    /// utility to identify and add multiple devices with simple identification in one batch
+    /// @param aNewDevices the devices to be identified and added. Each must support instant identifyDevice() returning true.
+    ///   On return, this list only contains the devices actually added.
+    /// @return number of devices added
+    /// @note this is more efficient than calling simpleIdentifyAndAddDevice() for each device, because
+    ///   persistent settings are loaded in one go and announcing is triggered only once for all devices.
+    size_t simpleIdentifyAndAddDevices(DeviceList &aNewDevices);
+
     /// utility method for implementation of scanForDevices in Vdc subclasses: identify device with retries
     /// @param aNewDevice the device to be identified and added
     /// @param aCompletedCB will be called when device has been added or had error
@@ -430,7 +505,9 @@ namespace p44 {
     /// @param aCompletedCB will be called when all devices have been added
     /// @param aMaxRetries how many retries (excluding the first try) should be attempted
     /// @param aRetryDelay how long to wait between retries
-    /// @param aAddDelay how long to wait between adding devices
+    /// @param aAddDelay how long to wait between identifying devices. If non-zero, devices are identified one after
+    ///   the other, otherwise up to maxConcurrentIdentifications() at the same time.
+    /// @note identified devices are added all together in one batch when all identifications have completed
     void identifyAndAddDevices(DeviceList aToBeAddedDevices, StatusCB aCompletedCB, int aMaxRetries = 0, MLMicroSeconds aRetryDelay = 0, MLMicroSeconds aAddDelay = 0);
 
 		/// @}
@@ -592,6 +669,32 @@ namespace p44 {
     /// @}
 
 
+    /// @name batch application of channel values of multiple devices
+    /// @{
+
+    /// @return true if this vdc wants channel values applied during a grouped delivery to be
+    ///   collected and passed to applyChannelValuesBatch() in one call
+    /// @note vdcs whose transport can carry updates for many devices in one operation should
+    ///   override this and applyChannelValuesBatch()
+    virtual bool supportsBatchApply() { return false; };
+
+    /// apply the channel values of multiple devices
+    /// @param aBatch the devices with their pending channel values and transition times.
+    ///   The mDoneCB of every item must be called when that device's values are applied.
+    /// @note base class applies device by device via Device::applyChannelValues()
+    virtual void applyChannelValuesBatch(BatchApplyList &aBatch);
+
+    /// called by devices about to apply channel values
+    /// @param aDevice the device
+    /// @param aDoneCB to be called when the device's values are applied
+    /// @param aForDimming set when the apply is a dimming step
+    /// @return true if the apply was added to the batch currently being collected, false if
+    ///   the device must apply its channel values by itself right now
+    bool collectForBatchApply(DevicePtr aDevice, SimpleCB aDoneCB, bool aForDimming);
+
+    /// @}
+
+
 
     /// description of object, mainly for debug and logging
     /// @return textual description of object
@@ -653,6 +756,19 @@ namespace p44 {
     ///   and thus cannot remove any settings, either)
     virtual void scanForDevices(StatusCB aCompletedCB, RescanMode aRescanFlags) = 0;
 
+    /// @return default interval for sampling the presence of all devices in the background, Never to sample on access only
+    /// @note base class returns Never. vdcs that can sample the presence of their devices cheaply (such as with
+    ///   a single device list request) might override this to enable background sampling by default
+    virtual MLMicroSeconds defaultPresenceSampleInterval();
+
+    /// @return default deadline for devices of this vdc to complete applying channel values
+    /// @note vdcs with slow transports (cloud APIs, bridges) should override this
+    virtual MLMicroSeconds defaultApplyDeadline();
+
+    /// @return max number of devices the background presence scheduler passes to one checkPresenceOfDevices() call, 0=all at once
+    /// @note vdcs which have an efficient bulk presence check should return 0 here
+    virtual size_t presenceSampleBatchSize() { return 1; };
+
 
     /// called to let vdc handle vdc-level methods
     /// @param aMethod the method
@@ -687,7 +803,15 @@ namespace p44 {
 
   private:
 
+    void schedulePresenceSampling(MLMicroSeconds aDelay);
+    MLMicroSeconds presenceSampleStep();
+    void presenceSamplingStep();
+    void presenceSamplingDone(MLMicroSeconds aStepStarted);
+    void checkNextDevicePresence(DeviceVector aDevices, size_t aIndex, StatusCB aDoneCB);
+    void devicePresenceChecked(DeviceVector aDevices, size_t aIndex, StatusCB aDoneCB, bool aPresent);
+
     void prepareNextNotification(NotificationDeliveryStatePtr aDeliveryState);
+    void applyCollectedBatch();
     void notificationPrepared(NotificationDeliveryStatePtr aDeliveryState, NotificationType aNotificationToApply);
     void preparedOperationExecuted(DevicePtr aDevice);
     void executePreparedNotification(NotificationDeliveryStatePtr aDeliveryState);
@@ -713,6 +837,7 @@ namespace p44 {
     void recollectDone();
 
     bool addDeviceWithBridgingDefaults(DevicePtr aNewDevice);
+    size_t addDevicesWithBridgingDefaults(DeviceList &aNewDevices);
 
     /// utility method for identifyAndAddDevice(s): identify device with retries
     /// @param aNewDevice the device to be identified
@@ -723,7 +848,10 @@ namespace p44 {
     void identifyDeviceCB(DevicePtr aNewDevice, IdentifyDeviceCB aIdentifyCB, int aMaxRetries, MLMicroSeconds aRetryDelay, ErrorPtr aError, Device *aIdentifiedDevice);
     void identifyDeviceFailed(DevicePtr aNewDevice, ErrorPtr aError, IdentifyDeviceCB aIdentifyCB);
     void identifyAndAddDeviceCB(StatusCB aCompletedCB, ErrorPtr aError, Device *aIdentifiedDevice);
-    void identifyAndAddDevicesCB(DeviceList aToBeAddedDevices, StatusCB aCompletedCB, int aMaxRetries, MLMicroSeconds aRetryDelay, MLMicroSeconds aAddDelay);
+    void batchIdentifyNext(IdentifyBatchPtr aBatch, int aSlot);
+    void batchIdentifyDevice(IdentifyBatchPtr aBatch, int aSlot, DevicePtr aDevice, int aRetriesLeft);
+    void batchDeviceIdentified(IdentifyBatchPtr aBatch, int aSlot, DevicePtr aDevice, int aRetriesLeft, ErrorPtr aError, Device *aIdentifiedDevice);
+    void batchIdentified(IdentifyBatchPtr aBatch);
 
     void performPair(VdcApiRequestPtr aRequest, Tristate aEstablish, bool aDisableProximityCheck, MLMicroSeconds aTimeout);
     void pairingEvent(VdcApiRequestPtr aRequest, bool aLearnIn, ErrorPtr aError);
@@ -21,6 +21,7 @@
 //
 
 #include "vdcapi.hpp"
+#include "metrics.hpp"
 
 using namespace p44;
 
@@ -155,6 +156,14 @@ ApiValuePtr VdcApiConnection::newApiValue()
 
 // MARK: - VdcApiRequest
 
+void VdcApiRequest::answered()
+{
+  if (mReceivedAt==Never) return; // already answered
+  METRICS_RECORD("api_request_seconds", MainLoop::now()-mReceivedAt);
+  mReceivedAt = Never;
+}
+
+
 ErrorPtr VdcApiRequest::sendStatus(ErrorPtr aStatusToSend)
 {
   if (Error::isOK(aStatusToSend)) {
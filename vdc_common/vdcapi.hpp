@@ -229,8 +229,12 @@ namespace p44 {
   {
     typedef P44Obj inherited;
 
+    MLMicroSeconds mReceivedAt; ///< when the request was received, Never once answered
+
   public:
 
+    VdcApiRequest() : mReceivedAt(MainLoop::now()) {};
+
     /// return the request ID as a string
     /// @return request ID as string
     virtual string requestId() = 0;
@@ -272,6 +276,12 @@ namespace p44 {
     /// @return API name for logging
     const char* apiName() { return connection()->apiName(); };
 
+  protected:
+
+    /// must be called by subclasses when sending the answer to the request, for request latency metrics
+    /// @note only the first call after receiving the request counts
+    void answered();
+
   };
 
 }
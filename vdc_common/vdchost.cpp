@@ -25,6 +25,9 @@
 #include "vdchost.hpp"
 #include "vdc.hpp"
 #include "device.hpp"
+#include "metrics.hpp"
+#include "jsonencoder.hpp"
+#include "localapivalue.hpp"
 
 #include "jsonvdcapi.hpp" // need it for the case of no vDC api, as default
 
@@ -106,13 +109,19 @@ VdcHost::VdcHost(bool aWithLocalController, bool aWithPersistentChannels) :
   mAllowCloud(false),
   DsAddressable(this),
   mCollecting(false),
+  mCollectStartedAt(Never),
+  mVdcCollectStartedAt(Never),
   mLastActivity(Never),
   mLastPeriodicRun(Never),
+  mPeriodicTaskDue(Never),
   mLearningMode(false),
   mLocalDimDirection(0), // undefined
   mMainloopStatsInterval(DEFAULT_MAINLOOP_STATS_INTERVAL),
   mMainLoopStatsCounter(0),
   mPersistentChannels(aWithPersistentChannels),
+  #if ENABLE_STATE_JOURNAL
+  mStateJournal(*this),
+  #endif
   #if P44SCRIPT_FULL_SUPPORT
   mMainScript(sourcecode|regular, "mainscript", "%O", &mMainScriptLogger),
   #endif
@@ -630,6 +639,7 @@ void VdcHost::collectDevices(StatusCB aCompletedCB, RescanMode aRescanFlags)
 {
   if (!mCollecting) {
     mCollecting = true;
+    mCollectStartedAt = MainLoop::now();
     if ((aRescanFlags & rescanmode_incremental)==0) {
       // only for non-incremental collect, close vdsm connection
       if (mVdsmSessionConnection) {
@@ -656,12 +666,17 @@ void VdcHost::collectFromNextVdc(StatusCB aCompletedCB, RescanMode aRescanFlags,
       vdc->vdcClassIdentifier(),
       vdc->getInstanceNumber()
     );
+    mVdcCollectStartedAt = MainLoop::now();
     vdc->collectDevices(boost::bind(&VdcHost::vdcCollected, this, aCompletedCB, aRescanFlags, aNextVdc, _1), aRescanFlags);
     return;
   }
   // all devices collected, but not yet initialized
   postEvent(vdchost_devices_collected);
-  LOG(LOG_NOTICE, "=== collected devices from all vdcs -> initializing devices now\n");
+  LOG(LOG_NOTICE,
+    "=== collected %zu devices from all vdcs in %.3f seconds -> initializing devices now\n",
+    mDSDevices.size(), (double)(MainLoop::now()-mCollectStartedAt)/Second
+  );
+  METRICS_RECORD("collect_devices_seconds", MainLoop::now()-mCollectStartedAt);
   // now initialize devices (which are already identified by now!)
   initializeNextDevice(aCompletedCB, mDSDevices.begin());
 }
@@ -672,7 +687,12 @@ void VdcHost::vdcCollected(StatusCB aCompletedCB, RescanMode aRescanFlags, VdcMa
   if (Error::notOK(aError)) {
     LOG(LOG_ERR, "vDC %s: error collecting devices: %s", aNextVdc->second->shortDesc().c_str(), aError->text());
   }
-  LOG(LOG_NOTICE, "=== done collecting from %s\n", aNextVdc->second->shortDesc().c_str());
+  MLMicroSeconds collectTime = MainLoop::now()-mVdcCollectStartedAt;
+  LOG(LOG_NOTICE,
+    "=== done collecting %zu devices from %s in %.3f seconds\n",
+    aNextVdc->second->getNumberOfDevices(), aNextVdc->second->shortDesc().c_str(), (double)collectTime/Second
+  );
+  METRICS_RECORD("vdc_collect_seconds", collectTime);
   // next
   aNextVdc++;
   // unwind call chain
@@ -699,7 +719,7 @@ void VdcHost::initializeNextDevice(StatusCB aCompletedCB, DsDeviceMap::iterator
     }
   }
   aCompletedCB(vdcInitErr);
-  LOG(LOG_NOTICE, "=== initialized all collected devices\n");
+  LOG(LOG_NOTICE, "=== initialized all collected devices, %.3f seconds after start of collecting\n", (double)(MainLoop::now()-mCollectStartedAt)/Second);
   mCollecting = false;
   // make sure at least one vdc can be announced to dS, even if all are empty and instructed to hide when empty
   bool someVisible = false;
@@ -781,6 +801,76 @@ bool VdcHost::addDevice(DevicePtr aDevice)
 }
 
 
+size_t VdcHost::addDevices(DeviceList &aDevices)
+{
+  MLMicroSeconds startedAt = MainLoop::now();
+  // insert into the container-wide map of devices in one pass
+  DeviceList::iterator pos = aDevices.begin();
+  while (pos!=aDevices.end()) {
+    DevicePtr dev = *pos;
+    if (!dev || mDSDevices.find(dev->getDsUid())!=mDSDevices.end()) {
+      if (dev) {
+        LOG(LOG_DEBUG, "- device %s already registered, not adding again", dev->shortDesc().c_str());
+        // first unwind call chain that triggered deletion, keep device living until then
+        MainLoop::currentMainLoop().executeNow(boost::bind(&VdcHost::duplicateIgnored, this, dev));
+      }
+      pos = aDevices.erase(pos);
+      continue;
+    }
+    dev->willBeAdded();
+    mDSDevices[dev->getDsUid()] = dev;
+    LOG(LOG_NOTICE, "--- added device: %s (not yet initialized)", dev->shortDesc().c_str());
+    ++pos;
+  }
+  if (aDevices.empty()) return 0;
+  MLMicroSeconds insertedAt = MainLoop::now();
+  // load the devices' persistent params (if there are any) within a single transaction
+  // Note: if a transaction is already active, BEGIN fails and the loads just run within that one
+  bool ownTransaction = aDevices.size()>1 && mDSParamStore.db().execute("BEGIN")==SQLITE_OK;
+  for (pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+    (*pos)->load();
+  }
+  if (ownTransaction) mDSParamStore.db().execute("COMMIT");
+  MLMicroSeconds loadedAt = MainLoop::now();
+  LOG(LOG_INFO,
+    "--- batch of %zu devices added: inserting %.3f seconds, loading settings %.3f seconds",
+    aDevices.size(), (double)(insertedAt-startedAt)/Second, (double)(loadedAt-insertedAt)/Second
+  );
+  METRICS_RECORD("device_batch_insert_seconds", insertedAt-startedAt);
+  METRICS_RECORD("device_batch_load_seconds", loadedAt-insertedAt);
+  // if not collecting, initialize devices right away.
+  // Otherwise, initialisation will be done when collecting is complete
+  if (!mCollecting) {
+    initializeNextBatchDevice(aDevices, loadedAt);
+  }
+  return aDevices.size();
+}
+
+
+void VdcHost::initializeNextBatchDevice(DeviceList aDevices, MLMicroSeconds aStartedAt)
+{
+  if (!aDevices.empty()) {
+    DevicePtr dev = aDevices.front();
+    aDevices.pop_front();
+    dev->initializeDevice(boost::bind(&VdcHost::batchDeviceInitialized, this, aDevices, aStartedAt, dev, _1), false);
+    return;
+  }
+  // all devices of the batch initialized
+  LOG(LOG_INFO, "--- batch of devices initialized in %.3f seconds", (double)(MainLoop::now()-aStartedAt)/Second);
+  METRICS_RECORD("device_batch_init_seconds", MainLoop::now()-aStartedAt);
+  // announce them together (no problem when called while already announcing)
+  startAnnouncing();
+}
+
+
+void VdcHost::batchDeviceInitialized(DeviceList aDevices, MLMicroSeconds aStartedAt, DevicePtr aDevice, ErrorPtr aError)
+{
+  deviceInitialized(aDevice, aError);
+  // unwind stack before starting next device
+  MainLoop::currentMainLoop().executeNow(boost::bind(&VdcHost::initializeNextBatchDevice, this, aDevices, aStartedAt));
+}
+
+
 void VdcHost::duplicateIgnored(DevicePtr aDevice)
 {
   LOG(LOG_INFO, "- ignored duplicate device: %s",aDevice->shortDesc().c_str());
@@ -930,6 +1020,10 @@ bool VdcHost::signalDeviceUserAction(Device &aDevice, bool aRegular)
 
 void VdcHost::periodicTask(MLMicroSeconds aNow)
 {
+  if (mPeriodicTaskDue!=Never) {
+    // how late the mainloop could run this timer is a measure for mainloop handler run times
+    METRICS_RECORD("mainloop_timer_lag_seconds", aNow>mPeriodicTaskDue ? aNow-mPeriodicTaskDue : 0);
+  }
   // cancel any pending executions
   mPeriodicTaskTicket.cancel();
   // prevent during activity as saving DB might affect performance
@@ -955,6 +1049,9 @@ void VdcHost::periodicTask(MLMicroSeconds aNow)
     if (mMainLoopStatsCounter<=0) {
       LOG(LOG_INFO, "%s", MainLoop::currentMainLoop().description().c_str());
       MainLoop::currentMainLoop().statistics_reset();
+      #if ENABLE_RRDB
+      LOG(LOG_INFO, "%s", RrdLogWriter::sharedRrdLogWriter().statisticsText().c_str());
+      #endif
       mMainLoopStatsCounter = mMainloopStatsInterval;
     }
     else {
@@ -962,6 +1059,7 @@ void VdcHost::periodicTask(MLMicroSeconds aNow)
     }
   }
   // schedule next run
+  mPeriodicTaskDue = MainLoop::now()+PERIODIC_TASK_INTERVAL;
   mPeriodicTaskTicket.executeOnce(boost::bind(&VdcHost::periodicTask, this, _2), PERIODIC_TASK_INTERVAL);
 }
 
@@ -1217,6 +1315,9 @@ void VdcHost::vdcApiConnectionStatusHandler(VdcApiConnectionPtr aApiConnection,
     }
     // - close if not already closed
     aApiConnection->closeConnection();
+    #if ENABLE_API_TRACE
+    mApiTraceRecorder.connectionClosed(aApiConnection);
+    #endif
     if (aApiConnection==mVdsmSessionConnection) {
       // this is the active session connection
       resetAnnouncing(); // stop possibly ongoing announcing
@@ -1235,8 +1336,15 @@ void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiReq
 {
   ErrorPtr respErr;
   signalActivity();
+  #if ENABLE_METRICS
+  MLMicroSeconds startedAt = MainLoop::now();
+  #endif
+  #if ENABLE_API_TRACE
+  mApiTraceRecorder.record(aApiConnection, aRequest!=NULL, aMethod, aParams);
+  #endif
   // now process
   if (aRequest) {
+    METRICS_COUNT("api_requests_total");
     // Methods
     // - Check session init/end methods
     if (aMethod=="hello") {
@@ -1259,6 +1367,7 @@ void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiReq
   else {
     // Notifications
     // Note: out of session, notifications are simply ignored
+    METRICS_COUNT("api_notifications_total");
     if (mVdsmSessionConnection) {
       respErr = handleNotificationForParams(aApiConnection, aMethod, aParams);
     }
@@ -1282,6 +1391,8 @@ void VdcHost::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, VdcApiReq
       }
     }
   }
+  // time spent synchronously in the handler (asynchronous completion of method calls is in api_request_seconds)
+  METRICS_RECORD("api_handler_seconds", MainLoop::now()-startedAt);
 }
 
 
@@ -1368,6 +1479,57 @@ ErrorPtr VdcHost::byeHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
 
 
 
+ErrorPtr VdcHost::scenePreviewHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams)
+{
+  ApiValuePtr o;
+  ErrorPtr err;
+  if (Error::notOK(err = checkParam(aParams, "scene", o))) return err;
+  SceneNo sceneNo = o->uint8Value();
+  DsZoneID zone = 0;
+  DsGroup group = group_undefined;
+  if ((o = aParams->get("zone_id"))) zone = o->uint16Value();
+  if ((o = aParams->get("group"))) group = (DsGroup)o->uint16Value();
+  ApiValuePtr result = aRequest->newApiValue();
+  result->setType(apivalue_object);
+  result->add("scene", result->newUint64(sceneNo));
+  result->add("zone_id", result->newUint64(zone));
+  result->add("group", result->newUint64(group));
+  ApiValuePtr devices = result->newObject();
+  for (DsDeviceMap::iterator pos = mDSDevices.begin(); pos!=mDSDevices.end(); ++pos) {
+    Device *devP = pos->second.get();
+    // same selection as addToAudienceByZoneAndGroup()
+    if (
+      (zone!=0 && devP->getZoneID()!=zone) ||
+      (group!=group_undefined && !(devP->getOutput() && devP->getOutput()->isMember(group)))
+    ) continue;
+    SceneTargetPtr target = devP->getSceneTarget(sceneNo);
+    if (!target) continue; // no scenes or no output
+    ApiValuePtr dev = devices->newObject();
+    dev->add("name", dev->newString(devP->getName()));
+    dev->add("applies", dev->newBool(target->applies()));
+    if (!target->mInArea) dev->add("notInArea", dev->newBool(true));
+    if (devP->getOutput()->hasLocalPriority() && !target->mScene->ignoresLocalPriority() && target->mScene->mSceneArea==0) {
+      dev->add("localPriority", dev->newBool(true)); // would be suppressed unless forced
+    }
+    if (target->applies()) {
+      dev->add("transitionTime", dev->newDouble((double)target->mTransitionTime/Second));
+      ApiValuePtr channels = dev->newObject();
+      for (size_t i=0; i<target->mChannelValues.size(); i++) {
+        if (target->mChannelDontCare[i]) continue;
+        ChannelBehaviourPtr ch = devP->getChannelByIndex((int)i);
+        if (ch) channels->add(ch->getApiId(aRequest->getApiVersion()), channels->newDouble(target->mChannelValues[i]));
+      }
+      dev->add("channels", channels);
+    }
+    devices->add(devP->getDsUid().getString(), dev);
+  }
+  result->add("devices", devices);
+  aRequest->sendResult(result);
+  return ErrorPtr();
+}
+
+
+
 DsAddressablePtr VdcHost::addressableForItemSpec(const string &aItemSpec)
 {
   string query = aItemSpec;
@@ -1738,6 +1900,71 @@ ErrorPtr VdcHost::handleMethod(VdcApiRequestPtr aRequest,  const string &aMethod
     return ErrorPtr();
   }
   #endif // P44SCRIPT_FULL_SUPPORT && !P44SCRIPT_REGISTERED_SOURCE
+  #if ENABLE_STATE_JOURNAL
+  if (aMethod=="x-p44-stateChanges") {
+    // changes since a given journal sequence number, for delta resync of (re)connecting clients
+    mStateJournal.handleChangesRequest(aRequest, aParams);
+    return ErrorPtr();
+  }
+  #endif // ENABLE_STATE_JOURNAL
+  #if ENABLE_API_TRACE
+  if (aMethod=="x-p44-apiTrace") {
+    // start or stop recording incoming API requests and notifications, or get recording status
+    ApiValuePtr o = aParams->get("record");
+    if (o) {
+      if (o->isType(apivalue_string)) {
+        // start recording to given file within the persistent data directory
+        string path;
+        ErrorPtr err = apiTraceFilePath(o->stringValue(), getPersistentDataDir(), path);
+        if (Error::isOK(err)) err = mApiTraceRecorder.start(path);
+        if (Error::notOK(err)) return err;
+      }
+      else if (!o->boolValue()) {
+        mApiTraceRecorder.stop();
+      }
+    }
+    aRequest->sendResult(mApiTraceRecorder.status(aRequest->newApiValue()));
+    return ErrorPtr();
+  }
+  if (aMethod=="x-p44-apiReplay") {
+    // replay a recorded API trace against this vdc host
+    ApiValuePtr o = aParams->get("path");
+    if (o) {
+      // trace files are confined to the persistent data directory
+      string path;
+      ErrorPtr err = apiTraceFilePath(o->stringValue(), getPersistentDataDir(), path);
+      if (Error::notOK(err)) return err;
+      o->setStringValue(path);
+    }
+    return ApiTraceReplayer::replay(*this, aRequest, aParams);
+  }
+  #endif // ENABLE_API_TRACE
+  #if ENABLE_POLL_SCHEDULER
+  if (aMethod=="x-p44-pollStats") {
+    // statistics of the poll scheduler
+    ApiValuePtr stats = aRequest->newApiValue();
+    stats->setType(apivalue_object);
+    mPollScheduler.getStats(stats);
+    aRequest->sendResult(stats);
+    return ErrorPtr();
+  }
+  #endif // ENABLE_POLL_SCHEDULER
+  #if ENABLE_JSON_TEXT_ENCODER
+  if (aMethod=="x-p44-jsonEncoderCheck") {
+    // check single pass JSON encoder against json-c output and timing on a synthetic device tree
+    return JsonTextEncoder::encoderCheck(aRequest, aParams);
+  }
+  #endif // ENABLE_JSON_TEXT_ENCODER
+  #if ENABLE_LOCAL_APIVALUE
+  if (aMethod=="x-p44-apiValueBenchmark") {
+    // compare JSON and in-process API values for internally generated notifications
+    return LocalApiValue::benchmark(aRequest, aParams);
+  }
+  #endif // ENABLE_LOCAL_APIVALUE
+  if (aMethod=="x-p44-scenePreview") {
+    // channel targets a scene call would set in a zone/group, without applying anything
+    return scenePreviewHandler(aRequest, aParams);
+  }
   if (aMethod=="x-p44-setIdentity") {
     ApiValuePtr o;
     ErrorPtr err;
@@ -1797,6 +2024,12 @@ enum {
   #endif
   nextVersion_key,
   deviceHardwareId_key,
+  #if ENABLE_RRDB
+  rrdLogging_key,
+  #endif
+  #if ENABLE_METRICS
+  metrics_key,
+  #endif
   numVdcHostProperties
 };
 
@@ -1836,6 +2069,12 @@ PropertyDescriptorPtr VdcHost::getDescriptorByIndex(int aPropIndex, int aDomain,
     #endif
     { "x-p44-nextVersion", apivalue_string, nextVersion_key, OKEY(vdchost_obj) },
     { "x-p44-deviceHardwareId", apivalue_string, deviceHardwareId_key, OKEY(vdchost_obj) },
+    #if ENABLE_RRDB
+    { "x-p44-rrdLogging", apivalue_null, rrdLogging_key, OKEY(vdchost_obj) },
+    #endif
+    #if ENABLE_METRICS
+    { "x-p44-metrics", apivalue_null, metrics_key, OKEY(vdchost_obj) },
+    #endif
   };
   int n = inherited::numProps(aDomain, aParentDescriptor);
   if (aPropIndex<n)
@@ -1930,6 +2169,18 @@ bool VdcHost::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
         case deviceHardwareId_key:
           aPropValue->setStringValue(getDeviceHardwareId());
           return true;
+        #if ENABLE_RRDB
+        case rrdLogging_key:
+          aPropValue->setType(apivalue_object); // make object (incoming object is NULL)
+          RrdLogWriter::sharedRrdLogWriter().getStatistics(aPropValue);
+          return true;
+        #endif
+        #if ENABLE_METRICS
+        case metrics_key:
+          aPropValue->setType(apivalue_object); // make object (incoming object is NULL)
+          Metrics::sharedMetrics().getMetrics(aPropValue);
+          return true;
+        #endif
       }
     }
     else {
@@ -2116,6 +2367,9 @@ void VdcHost::savePrivate()
 
 void VdcHost::save()
 {
+  #if ENABLE_METRICS
+  MLMicroSeconds startedAt = MainLoop::now();
+  #endif
   savePrivate();
   #if ENABLE_LOCALCONTROLLER
   if (mLocalController) mLocalController->save();
@@ -2128,6 +2382,7 @@ void VdcHost::save()
   for (DsDeviceMap::iterator pos = mDSDevices.begin(); pos!=mDSDevices.end(); ++pos) {
     pos->second->save();
   }
+  METRICS_RECORD("persistence_save_seconds", MainLoop::now()-startedAt);
 }
 
 
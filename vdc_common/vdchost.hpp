@@ -34,6 +34,10 @@
 #include "timeutils.hpp"
 
 #include "vdcapi.hpp"
+#include "statejournal.hpp"
+#include "apitrace.hpp"
+#include "settingsfileindex.hpp"
+#include "pollscheduler.hpp"
 
 using namespace std;
 
@@ -156,6 +160,12 @@ namespace p44 {
     friend class Vdc;
     friend class DsAddressable;
     friend class LocalController;
+    #if ENABLE_STATE_JOURNAL
+    friend class StateJournal;
+    #endif
+    #if ENABLE_API_TRACE
+    friend class ApiTraceReplayer;
+    #endif
 
     bool mExternalDsuid; ///< set when dSUID is set to a external value (usually UUIDv1 based)
     int mVdcHostInstance; ///< instance number of this vdc host (defaults to 0, can be set to >0 to have multiple vdchost on the same host/mac address)
@@ -181,10 +191,13 @@ namespace p44 {
     string mVdcModelNameTemplate; ///< how to generate vdc model names (that's what shows up in HW-Info in dS)
 
     bool mCollecting;
+    MLMicroSeconds mCollectStartedAt; ///< when the current collecting run has started
+    MLMicroSeconds mVdcCollectStartedAt; ///< when collecting from the current vdc has started
     MLTicket mAnnouncementTicket;
     MLTicket mPeriodicTaskTicket;
     MLMicroSeconds mLastActivity;
     MLMicroSeconds mLastPeriodicRun;
+    MLMicroSeconds mPeriodicTaskDue; ///< when the next periodic task run is scheduled (for mainloop latency metrics)
 
     MLMicroSeconds mTimeOfDayDiff; ///< current difference of monotonic ML time and a pseudo local time to detect changes (TZ changes, NTP updates)
 
@@ -220,6 +233,22 @@ namespace p44 {
     LocalControllerPtr mLocalController;
     #endif
 
+    #if ENABLE_STATE_JOURNAL
+    StateJournal mStateJournal; ///< journal of state changes for delta resync of API clients
+    #endif
+
+    #if ENABLE_API_TRACE
+    ApiTraceRecorder mApiTraceRecorder; ///< recorder for incoming API requests and notifications
+    #endif
+
+    #if ENABLE_SETTINGS_FROM_FILES
+    SettingsFileIndex mSettingsFileIndex; ///< index of the settings files in the config directory
+    #endif
+
+    #if ENABLE_POLL_SCHEDULER
+    PollScheduler mPollScheduler; ///< scheduler for polled devices
+    #endif
+
   protected:
 
     #if P44SCRIPT_FULL_SUPPORT
@@ -243,6 +272,26 @@ namespace p44 {
     LocalControllerPtr getLocalController();
     #endif
 
+    #if ENABLE_STATE_JOURNAL
+    /// @return the state change journal
+    StateJournal &getStateJournal() { return mStateJournal; };
+    #endif
+
+    #if ENABLE_POLL_SCHEDULER
+    /// @return the host-wide scheduler for polled devices
+    PollScheduler &getPollScheduler() { return mPollScheduler; };
+    #endif
+
+    #if ENABLE_SETTINGS_FROM_FILES
+    /// @return index of the CSV settings files in the config directory
+    SettingsFileIndex &getSettingsFileIndex() { return mSettingsFileIndex; };
+    #endif
+
+    #if ENABLE_API_TRACE
+    /// @return the API trace recorder
+    ApiTraceRecorder &getApiTraceRecorder() { return mApiTraceRecorder; };
+    #endif
+
     /// geolocation of the installation
     GeoLocation mGeolocation;
 
@@ -551,6 +600,16 @@ namespace p44 {
     ///   simpleIdentifyAndAddDevice() or identifyAndAddDevice()
     bool addDevice(DevicePtr aDevice);
 
+    /// called by vDC containers to add multiple devices to the container-wide devices list in one batch
+    /// @param aDevices the devices to add, each with a valid dSUID. On return, the list only contains
+    ///   those devices actually added (duplicates are removed from it).
+    /// @return number of devices added
+    /// @note the persistent settings of all devices are loaded within a single DB transaction, and
+    ///   when not collecting, announcing starts only after all devices of the batch are initialized.
+    /// @note this should NOT be called directly from vdc implementations. Use
+    ///   simpleIdentifyAndAddDevices() or identifyAndAddDevices()
+    size_t addDevices(DeviceList &aDevices);
+
     /// called by vDC containers to remove devices from the container-wide list
     /// @param aDevice a device object which has a valid dSUID
     /// @param aForget if set, parameters stored for the device will be deleted
@@ -724,10 +783,13 @@ namespace p44 {
     // vDC level method and notification handlers
     ErrorPtr helloHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     ErrorPtr byeHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
+    ErrorPtr scenePreviewHandler(VdcApiRequestPtr aRequest, ApiValuePtr aParams);
     ErrorPtr removeHandler(VdcApiRequestPtr aForRequest, DevicePtr aDevice);
     void removeResultHandler(DevicePtr aDevice, VdcApiRequestPtr aForRequest, bool aDisconnected);
     void duplicateIgnored(DevicePtr aDevice);
     void separateDeviceInitialized(DevicePtr aDevice, ErrorPtr aError);
+    void initializeNextBatchDevice(DeviceList aDevices, MLMicroSeconds aStartedAt);
+    void batchDeviceInitialized(DeviceList aDevices, MLMicroSeconds aStartedAt, DevicePtr aDevice, ErrorPtr aError);
 
     // handles freshly initialized device
     void deviceInitialized(DevicePtr aDevice, ErrorPtr aError);